@@ -64,6 +64,10 @@
 // todo need this for lwip FreeRTOS sys_arch to compile
 #define configENABLE_BACKWARD_COMPATIBILITY     1
 #define configNUM_THREAD_LOCAL_STORAGE_POINTERS 5
+// Index 0 is left to the application; TKJHAT waits for I2C completion on
+// index 1 (TKJHAT_I2C_NOTIFY_INDEX) and wakes its display render task on
+// index 2 (TKJHAT_DISPLAY_NOTIFY_INDEX)
+#define configTASK_NOTIFICATION_ARRAY_ENTRIES   3
 
 /* System */
 #define configSTACK_DEPTH_TYPE                  uint32_t
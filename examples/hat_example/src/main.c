@@ -266,7 +266,6 @@ int main() {
         sleep_ms(10);
     } 
     init_hat_sdk();
-    sleep_ms(300); //Wait some time so initialization of USB and hat is done.
     printf("Start tests\n");
     
     // Initialize LED
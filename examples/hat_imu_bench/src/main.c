@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pico/stdlib.h>
+#include <hardware/structs/systick.h>
+
+#include <tkjhat/sdk.h>
+
+// Cycle count of the IMU sample conversions on the Pico (no HAT needed).
+// The PC version of the same measurement is libs/TKJHAT/tools/imu_convert_bench.c.
+
+#define N 64
+
+typedef struct { float a[3], g[3], t; } sample_f;
+
+static ICM42670_raw_t raw[N];
+static ICM42670_q16_t q[N];
+static sample_f f[N];
+
+// SysTick counts down from 0xFFFFFF at the core clock (no FreeRTOS here)
+static inline void cycles_start(void) {
+    systick_hw->rvr = 0x00FFFFFF;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0x5;      // enable, processor clock
+}
+
+static inline uint32_t cycles_now(void) {
+    return systick_hw->cvr;
+}
+
+// What ICM42670_read_sensor_data() did before: seven divisions per sample
+static void __not_in_flash_func(convert_div)(const ICM42670_raw_t *r, sample_f *o, size_t n,
+                                             float ares, float gres) {
+    for (size_t i = 0; i < n; ++i) {
+        for (int k = 0; k < 3; ++k) {
+            o[i].a[k] = (float)r[i].accel[k] / ares;
+            o[i].g[k] = (float)r[i].gyro[k] / gres;
+        }
+        o[i].t = ((float)r[i].temp / 128.0f) + 25.0;
+    }
+}
+
+// Current float API: multiplications by the precomputed reciprocals
+static void __not_in_flash_func(convert_mul)(const ICM42670_scale_t *sc, const ICM42670_raw_t *r,
+                                             sample_f *o, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        for (int k = 0; k < 3; ++k) {
+            o[i].a[k] = (float)r[i].accel[k] * sc->accel_inv;
+            o[i].g[k] = (float)r[i].gyro[k] * sc->gyro_inv;
+        }
+        o[i].t = (float)r[i].temp * (1.0f / 128.0f) + 25.0f;
+    }
+}
+
+int main() {
+    stdio_init_all();
+    while (!stdio_usb_connected()){
+        sleep_ms(10);
+    }
+    sleep_ms(200);
+
+    ICM42670_scale_t sc;
+    ICM42670_scale_set_accel(&sc, 8192.0f);   // ±4 g
+    ICM42670_scale_set_gyro(&sc, 131.0f);     // ±250 dps
+    for (int i = 0; i < N; ++i) {
+        for (int k = 0; k < 3; ++k) {
+            raw[i].accel[k] = (int16_t)rand();
+            raw[i].gyro[k] = (int16_t)rand();
+        }
+        raw[i].temp = (int16_t)(rand() % 4000 - 2000);
+    }
+
+    cycles_start();
+    while (1) {
+        uint32_t t0 = cycles_now();
+        convert_div(raw, f, N, 8192.0f, 131.0f);
+        uint32_t t1 = cycles_now();
+        convert_mul(&sc, raw, f, N);
+        uint32_t t2 = cycles_now();
+        ICM42670_convert_q16(&sc, raw, q, N);
+        uint32_t t3 = cycles_now();
+
+        // Down-counter: elapsed = earlier - later (24 bits)
+        printf("cycles/sample: float div %lu | float mul %lu | Q16 %lu\n",
+               (unsigned long)(((t0 - t1) & 0xFFFFFF) / N),
+               (unsigned long)(((t1 - t2) & 0xFFFFFF) / N),
+               (unsigned long)(((t2 - t3) & 0xFFFFFF) / N));
+        sleep_ms(2000);
+    }
+    return 0;
+}
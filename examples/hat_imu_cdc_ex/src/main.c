@@ -64,7 +64,6 @@ static void usbTask(void *arg) {
 int main() {
     
     init_hat_sdk();
-    sleep_ms(300); //Wait some time so initialization of USB and hat is done.
     init_led();
     //usb_serial_print("Start acceleration test\n");
 
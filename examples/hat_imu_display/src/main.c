@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <pico/stdlib.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include <tkjhat/sdk.h>
+#include <tkjhat/ssd1306.h>
+
+// Real-time IMU view on the OLED, and the reference workload for display
+// and bus performance work:
+//  - top row: frame time and the part of it spent on I2C (IMU read + display flush), in ms
+//  - left: tilt bubble, moves with the accelerometer X/Y (1 g = edge of the ring)
+//  - right: scrolling traces of accel X, Y and Z (±2 g)
+// Every frame redraws the whole buffer; ssd1306_show() sends only what changed,
+// and the once-per-second report prints how many display bytes that was.
+
+#define FRAME_PERIOD_MS     25      // 40 FPS target; the frame time on screen shows what is reached
+
+#define BUBBLE_CX           28
+#define BUBBLE_CY           36
+#define BUBBLE_R            26
+#define BUBBLE_DOT_R        4
+
+#define TRACE_X0            60
+#define TRACE_W             (128 - TRACE_X0)
+#define TRACE_Y0            10
+#define TRACE_H             18      // per axis
+#define TRACE_RANGE_G       2.0f
+
+static ssd1306_t disp;
+static int8_t trace[3][TRACE_W];    // pixel offsets from the band centre, ring
+static int trace_pos;
+
+static void circle(int cx, int cy, int r, bool fill) {
+    int x = 0, y = r, f = 1 - r;
+    while (x <= y) {
+        if (fill) {
+            ssd1306_draw_line(&disp, cx - x, cy + y, cx + x, cy + y);
+            ssd1306_draw_line(&disp, cx - x, cy - y, cx + x, cy - y);
+            ssd1306_draw_line(&disp, cx - y, cy + x, cx + y, cy + x);
+            ssd1306_draw_line(&disp, cx - y, cy - x, cx + y, cy - x);
+        } else {
+            ssd1306_draw_pixel(&disp, cx + x, cy + y); ssd1306_draw_pixel(&disp, cx - x, cy + y);
+            ssd1306_draw_pixel(&disp, cx + x, cy - y); ssd1306_draw_pixel(&disp, cx - x, cy - y);
+            ssd1306_draw_pixel(&disp, cx + y, cy + x); ssd1306_draw_pixel(&disp, cx - y, cy + x);
+            ssd1306_draw_pixel(&disp, cx + y, cy - x); ssd1306_draw_pixel(&disp, cx - y, cy - x);
+        }
+        if (f >= 0) { y--; f -= 2 * y; }
+        x++;
+        f += 2 * x + 1;
+    }
+}
+
+static int clampi(int v, int lo, int hi) {
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+static void draw_bubble(float ax, float ay) {
+    circle(BUBBLE_CX, BUBBLE_CY, BUBBLE_R, false);
+    circle(BUBBLE_CX, BUBBLE_CY, BUBBLE_R / 2, false);
+    ssd1306_draw_line(&disp, BUBBLE_CX - 3, BUBBLE_CY, BUBBLE_CX + 3, BUBBLE_CY);
+    ssd1306_draw_line(&disp, BUBBLE_CX, BUBBLE_CY - 3, BUBBLE_CX, BUBBLE_CY + 3);
+
+    // The bubble floats to the high side: opposite to the gravity component
+    const int lim = BUBBLE_R - BUBBLE_DOT_R - 1;
+    int dx = clampi((int)(-ay * BUBBLE_R), -lim, lim);
+    int dy = clampi((int)(-ax * BUBBLE_R), -lim, lim);
+    circle(BUBBLE_CX + dx, BUBBLE_CY + dy, BUBBLE_DOT_R, true);
+}
+
+static void draw_traces(const float a[3]) {
+    const int half = TRACE_H / 2 - 1;
+    for (int k = 0; k < 3; ++k)
+        trace[k][trace_pos] = (int8_t)clampi((int)(-a[k] / TRACE_RANGE_G * half), -half, half);
+    trace_pos = (trace_pos + 1) % TRACE_W;
+
+    for (int k = 0; k < 3; ++k) {
+        int mid = TRACE_Y0 + k * TRACE_H + TRACE_H / 2;
+        for (int x = 0; x < TRACE_W; x += 4)            // dotted zero line
+            ssd1306_draw_pixel(&disp, TRACE_X0 + x, mid);
+        // Oldest sample on the left
+        int prev = trace[k][trace_pos];
+        for (int i = 1; i < TRACE_W; ++i) {
+            int cur = trace[k][(trace_pos + i) % TRACE_W];
+            ssd1306_draw_line(&disp, TRACE_X0 + i - 1, mid + prev, TRACE_X0 + i, mid + cur);
+            prev = cur;
+        }
+    }
+}
+
+static void display_task(void *pvParameters) {
+    (void)pvParameters;
+
+    if (init_ICM42670() != 0 || ICM42670_start_with_default_values() != 0)
+        printf("Failed to initialize ICM-42670P.\n");
+    disp.external_vcc = false;
+    ssd1306_init(&disp, 128, 64, SSD1306_I2C_ADDRESS, i2c_default);
+    ssd1306_poweron(&disp);
+
+    float ax = 0, ay = 0, az = 0, gx, gy, gz, t;
+    uint32_t frame_us = 0, i2c_us = 0, frames = 0;
+    uint64_t report_at = time_us_64() + 1000000;
+    uint64_t sum_frame = 0, sum_i2c = 0;
+    char line[24];
+    TickType_t wake = xTaskGetTickCount();
+
+    while (1) {
+        uint64_t t0 = time_us_64();
+        ICM42670_read_sensor_data(&ax, &ay, &az, &gx, &gy, &gz, &t);
+        uint64_t t1 = time_us_64();
+
+        ssd1306_clear(&disp);
+        snprintf(line, sizeof(line), "F%5.1f I2C%5.1f ms",
+                 frame_us / 1000.0f, i2c_us / 1000.0f);
+        ssd1306_draw_string(&disp, 0, 0, 1, line);
+        draw_bubble(ax, ay);
+        const float a[3] = { ax, ay, az };
+        draw_traces(a);
+
+        uint64_t t2 = time_us_64();
+        ssd1306_show(&disp);
+        uint64_t t3 = time_us_64();
+
+        // Shown on the next frame: the work of this one (without the pacing delay)
+        frame_us = (uint32_t)(t3 - t0);
+        i2c_us = (uint32_t)((t1 - t0) + (t3 - t2));
+        sum_frame += frame_us;
+        sum_i2c += i2c_us;
+        frames++;
+        if (t3 >= report_at) {
+            printf("%lu FPS, frame %lu us, i2c %lu us (mean), display %lu B/s sent, %lu B/s saved\n",
+                   (unsigned long)frames, (unsigned long)(sum_frame / frames),
+                   (unsigned long)(sum_i2c / frames), (unsigned long)disp.tx_bytes,
+                   (unsigned long)disp.tx_saved);
+            disp.tx_bytes = disp.tx_saved = 0;
+            frames = 0;
+            sum_frame = sum_i2c = 0;
+            report_at += 1000000;
+        }
+
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(FRAME_PERIOD_MS));
+    }
+}
+
+int main() {
+    stdio_init_all();
+    init_hat_sdk();
+
+    TaskHandle_t hDisplayTask = NULL;
+    xTaskCreate(display_task, "DisplayTask", 1024, NULL, 2, &hDisplayTask);
+
+    // Start the FreeRTOS scheduler
+    vTaskStartScheduler();
+
+    return 0;
+}
@@ -14,21 +14,21 @@ void imu_task(void *pvParameters) {
     (void)pvParameters;
     
     float ax, ay, az, gx, gy, gz, t;
-    // Setting up the sensor. 
-    if (init_ICM42670() == 0) {
+    // Setting up the sensors: IMU in LN mode with the default values,
+    // HDC2021 and VEML6030 with theirs. Reports how long each step took.
+    hat_boot_timing_t bt;
+    int failed = init_hat_sensors(&bt);
+    if (!(failed & HAT_SENSOR_IMU)) {
         printf("ICM-42670P initialized successfully!\n");
-        if (ICM42670_start_with_default_values() != 0){
-            printf("ICM-42670P could not initialize accelerometer or gyroscope");
-        }
-        /*int _enablegyro = ICM42670_enable_accel_gyro_ln_mode();
-        printf ("Enable gyro: %d\n",_enablegyro);
-        int _gyro = ICM42670_startGyro(ICM42670_GYRO_ODR_DEFAULT, ICM42670_GYRO_FSR_DEFAULT);
-        printf ("Gyro return:  %d\n", _gyro);
-        int _accel = ICM42670_startAccel(ICM42670_ACCEL_ODR_DEFAULT, ICM42670_ACCEL_FSR_DEFAULT);
-        printf ("Accel return:  %d\n", _accel);*/
     } else {
         printf("Failed to initialize ICM-42670P.\n");
     }
+    printf("Bring-up (us since reset): start %lu | IMU clock %lu, config %lu, first sample %lu | "
+           "HDC2021 config %lu, first sample %lu | VEML6030 on %lu | done %lu\n",
+           (unsigned long)bt.start_us, (unsigned long)bt.imu_clock_us,
+           (unsigned long)bt.imu_config_us, (unsigned long)bt.imu_first_sample_us,
+           (unsigned long)bt.hdc_config_us, (unsigned long)bt.hdc_first_sample_us,
+           (unsigned long)bt.veml_config_us, (unsigned long)bt.end_us);
     // Start collection data here. Infinite loop. 
     while (1)
     {
@@ -51,7 +51,6 @@ int main() {
         sleep_ms(10);
     }
     init_hat_sdk();
-    sleep_ms(300); //Wait some time so initialization of USB and hat is done.
     init_led();
     printf("Start acceleration test\n");
 
@@ -32,10 +32,12 @@ static void display_task(void *arg) {
 
     while(1) {
         
-        clear_display();
         char buf[5]; //Store a number of maximum 5 figures 
         sprintf(buf,"%d",counter++);
+        display_begin_frame();  // clear and text reach the panel together
+        clear_display();
         write_text(buf);
+        display_end_frame();
         vTaskDelay(pdMS_TO_TICKS(4000));
     }
 
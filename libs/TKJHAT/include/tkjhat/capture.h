@@ -0,0 +1,238 @@
+/*
+Version 0.84
+
+MIT License
+
+Copyright (c) 2025 , Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file tkjhat/capture.h
+ * @brief Pre-trigger capture of sensor frames into two RAM rings.
+ *
+ * @version 0.84
+ */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @defgroup capture Pre-trigger capture
+ * @brief Keep the frames before and after an event (tap, shock, loud sound).
+ *
+ * @details
+ * The producer (a sampling task or a sensor callback) pushes every frame
+ * with @ref capture_push. Frames have a fixed size, for example a
+ * @ref ICM42670_raw_t or one @c int16_t PCM sample, and go into a ring of
+ * @c capacity frames. When the trigger fires (@ref capture_trigger, or the
+ * predicate set with @ref capture_set_trigger), @c post more frames are
+ * recorded. The ring then holds @c pre frames of history, the trigger
+ * frame and what followed. It is frozen and published as a
+ * @ref capture_window_t, and recording continues in the second ring.
+ *
+ * The consumer takes the window with @ref capture_get and reads the frames
+ * in place; a wrapped ring is two segments, nothing is copied. It returns
+ * the ring with @ref capture_release. While the consumer drains one ring the
+ * other keeps recording. A window is lost (and counted in
+ * @ref capture_stats_t::dropped) only if it completes while the previous one
+ * is still held. The new ring starts empty, so a trigger soon after a
+ * window gets less history; @ref capture_window_t::pre_frames says how much.
+ *
+ * @c tools/capture_bench.c checks the windows on the PC, with a slow
+ * consumer, and measures the cost of a push.
+ *
+ * One producer and one consumer may run in different tasks, on different
+ * cores or in an interrupt: each ring's state is handed over with
+ * acquire/release stores, no locks.
+ *
+ * @code{.c}
+ * CAPTURE_DEFINE(shock_cap, sizeof(ICM42670_raw_t), 400);      // 2 x 400 frames
+ * static const capture_level_t shock = { .offset = 0, .count = 3, .level = 3 * 8192 }; // 3 g at ±4 g
+ *
+ * capture_init(&shock_cap, 200, 100);                  // 200 frames before, 100 from the trigger on
+ * capture_set_trigger(&shock_cap, capture_trigger_level, (void *)&shock);
+ *
+ * // sampling task, 400 Hz
+ * ICM42670_read_raw(&raw);
+ * capture_push(&shock_cap, &raw);
+ *
+ * // sending task
+ * capture_window_t win;
+ * if (capture_get(&shock_cap, &win)) {
+ *     for (int i = 0; i < 2; ++i)
+ *         if (win.len[i]) tud_cdc_n_write(1, win.part[i], win.len[i]);   // CDC1
+ *     tud_cdc_n_write_flush(1);
+ *     capture_release(&shock_cap, &win);
+ * }
+ * @endcode
+ *
+ * For the microphone, use @c int16_t frames and push each block from the
+ * PDM callback with @ref capture_push_n.
+ * @{
+ */
+
+/**
+ * @brief Trigger predicate, called for every pushed frame while armed.
+ *
+ * @param frame The new frame.
+ * @param ctx   Pointer given to @ref capture_set_trigger.
+ * @return true to trigger on this frame.
+ */
+typedef bool (*capture_trigger_fn)(const void *frame, void *ctx);
+
+/**
+ * @brief Context of @ref capture_trigger_level: any of @c count int16 values reaches @c level.
+ */
+typedef struct {
+    uint16_t offset;        /**< Byte offset of the first value in the frame. */
+    uint16_t count;         /**< Consecutive int16 values checked. */
+    int32_t level;          /**< Trigger when |value| >= level. */
+} capture_level_t;
+
+/**
+ * @brief Frozen capture, read in place until @ref capture_release.
+ *
+ * The frames are the concatenation of @c part[0] and @c part[1] (the
+ * second is empty unless the ring wrapped), oldest first.
+ */
+typedef struct {
+    const uint8_t *part[2]; /**< Frame data, in time order. */
+    size_t len[2];          /**< Bytes in each part. */
+    uint16_t frames;        /**< Frames in the window. */
+    uint16_t pre_frames;    /**< Frames before the trigger; frame @c pre_frames is the trigger frame. */
+    uint32_t first_frame;   /**< Running number of the first frame (spots gaps between windows). */
+    uint32_t seq;           /**< Window number. */
+    uint8_t ring;           /**< Internal: ring to release. */
+} capture_window_t;
+
+/**
+ * @brief Counters.
+ */
+typedef struct {
+    uint32_t frames;        /**< Frames pushed. */
+    uint32_t triggers;      /**< Triggers accepted. */
+    uint32_t windows;       /**< Windows published. */
+    uint32_t dropped;       /**< Windows lost: the other ring was still held by the consumer. */
+} capture_stats_t;
+
+/**
+ * @brief A capture. Declare it with @ref CAPTURE_DEFINE.
+ */
+typedef struct {
+    uint8_t *buf[2];                /**< The two rings. */
+    uint16_t frame_size;            /**< Bytes per frame. */
+    uint16_t capacity;              /**< Frames per ring. */
+    uint16_t pre;                   /**< History kept before the trigger. */
+    uint16_t post;                  /**< Frames recorded from the trigger on. */
+    capture_trigger_fn trigger;     /**< Predicate, may be NULL. */
+    void *trigger_ctx;              /**< Its context. */
+    // producer side
+    uint8_t active;                 /**< Ring being written. */
+    uint16_t pos;                   /**< Next slot in the active ring. */
+    uint16_t filled;                /**< Frames in the active ring, up to @c capacity. */
+    uint16_t post_left;             /**< Frames still to record, 0 while armed. */
+    uint16_t trig_pre;              /**< History available at the trigger. */
+    volatile bool trigger_req;      /**< Set by @ref capture_trigger. */
+    // shared
+    volatile uint8_t state[2];      /**< Per ring: free, recording or ready. */
+    capture_window_t ready[2];      /**< Published windows. */
+    capture_stats_t stats;          /**< Counters. */
+} capture_t;
+
+/**
+ * @brief Define a capture and its two rings.
+ *
+ * @param name       Name of the @ref capture_t variable.
+ * @param frame_sz   Bytes per frame.
+ * @param frames     Frames per ring (the RAM used is 2 x frames x frame_sz).
+ */
+#define CAPTURE_DEFINE(name, frame_sz, frames)                                      \
+    _Static_assert((frames) >= 2 && (frames) <= 65535, #name ": bad ring size");   \
+    static uint8_t name##_buf[2][(size_t)(frames) * (frame_sz)];                   \
+    static capture_t name = {                                                      \
+        .buf = { name##_buf[0], name##_buf[1] },                                   \
+        .frame_size = (frame_sz), .capacity = (frames),                            \
+    }
+
+/**
+ * @brief Set the window shape and start recording into the first ring.
+ *
+ * @param c    Capture.
+ * @param pre  Frames kept before the trigger frame.
+ * @param post Frames recorded from the trigger frame on (at least 1).
+ * @return 0 on success, -1 if @p pre + @p post does not fit in a ring.
+ */
+int capture_init(capture_t *c, uint16_t pre, uint16_t post);
+
+/**
+ * @brief Set the trigger predicate (NULL: only @ref capture_trigger).
+ *
+ * Call before recording starts or from the producer.
+ */
+void capture_set_trigger(capture_t *c, capture_trigger_fn fn, void *ctx);
+
+/**
+ * @brief Trigger on the next pushed frame. Can be called from any task or interrupt.
+ *
+ * Ignored while a window is already being completed.
+ */
+void capture_trigger(capture_t *c);
+
+/**
+ * @brief Record one frame. Producer only.
+ */
+void capture_push(capture_t *c, const void *frame);
+
+/**
+ * @brief Record @p n consecutive frames. Producer only.
+ */
+void capture_push_n(capture_t *c, const void *frames, size_t n);
+
+/**
+ * @brief Take the completed window, if any. Consumer only.
+ *
+ * @return true if @p win has been filled; it stays valid until
+ *         @ref capture_release.
+ */
+bool capture_get(capture_t *c, capture_window_t *win);
+
+/**
+ * @brief Give the ring of @p win back to the producer. Consumer only.
+ */
+void capture_release(capture_t *c, const capture_window_t *win);
+
+/**
+ * @brief Copy the counters.
+ */
+void capture_get_stats(const capture_t *c, capture_stats_t *stats);
+
+/**
+ * @brief Predicate: some int16 value in the frame reaches a level (see @ref capture_level_t).
+ */
+bool capture_trigger_level(const void *frame, void *ctx);
+
+/** @} */ // end of group capture
+
+#endif /* CAPTURE_H */
@@ -0,0 +1,261 @@
+/*
+Version 0.84
+
+MIT License
+
+Copyright (c) 2025 , Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file tkjhat/i2c_async.h
+ * @brief Asynchronous (DMA + IRQ driven) I2C transactions on @c i2c_default.
+ *
+ * @version 0.84
+ */
+
+#ifndef I2C_ASYNC_H
+#define I2C_ASYNC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+/**
+ * @defgroup i2c_async Asynchronous I2C transactions
+ * @brief Queue I2C transfers and let DMA and the I2C interrupt move the bytes.
+ *
+ * @details
+ * The blocking helpers (@ref i2c_write, @ref i2c_read) keep the calling task
+ * spinning on the CPU for the whole transfer. A full SSD1306 frame (1025 bytes)
+ * takes about 25 ms at 400 kHz. The asynchronous API instead takes a transfer
+ * descriptor (@ref i2c_xfer_t), appends it to a queue and returns immediately.
+ * One DMA channel feeds the I2C TX FIFO with the command words, a second one
+ * drains the RX FIFO, and the I2C interrupt completes the transfer and starts
+ * the next queued one.
+ *
+ * A transfer is one of:
+ * - **write**: START, address+W, @c tx bytes, STOP.
+ * - **read**: START, address+R, @c rx bytes, STOP.
+ * - **write-then-read**: START, address+W, @c tx bytes, repeated START,
+ *   address+R, @c rx bytes, STOP. This is the usual "select register, read
+ *   registers" access of the HAT sensors.
+ *
+ * Completion is signalled in any combination of these ways:
+ * - the @c status field of the descriptor changes to a final value,
+ * - the @c on_done callback is called (from the I2C interrupt),
+ * - the task that submitted the transfer receives a FreeRTOS task notification
+ *   on index @ref TKJHAT_I2C_NOTIFY_INDEX (see @ref i2c_xfer_wait). Index 0
+ *   stays free for the application; @c FreeRTOSConfig.h must set
+ *   @c configTASK_NOTIFICATION_ARRAY_ENTRIES above the index used.
+ *
+ * Descriptors and the buffers they point to are owned by the caller and must
+ * stay valid until the transfer has finished. Nothing is allocated by the queue.
+ *
+ * @note Do not start blocking transfers with the Pico SDK @c i2c_*_blocking
+ *       functions while asynchronous transfers are pending. @ref i2c_write and
+ *       @ref i2c_read wait for the asynchronous queue to drain first.
+ *
+ * @code{.c}
+ * static uint8_t reg = ICM42670_SENSOR_DATA_START_REG;
+ * static uint8_t raw[14];
+ * static i2c_xfer_t xfer;
+ *
+ * init_i2c_async();
+ * i2c_xfer_write_read(&xfer, ICM42670_I2C_ADDRESS, &reg, 1, raw, sizeof(raw));
+ * if (i2c_submit_async(&xfer)) {
+ *     // ... do something else ...
+ *     if (i2c_xfer_wait(&xfer, 10) == I2C_XFER_DONE) {
+ *         // raw[] holds the sample
+ *     }
+ * }
+ * @endcode
+ * @{
+ */
+
+/** @name Asynchronous I2C configuration
+ *  Can be overridden with compile definitions.
+ *  @{ */
+#ifndef TKJHAT_I2C_ASYNC_MAX_LEN
+#define TKJHAT_I2C_ASYNC_MAX_LEN                1040   /**< Max bytes (tx + rx) of one asynchronous transfer. */
+#endif
+#ifndef TKJHAT_I2C_NOTIFY_INDEX
+#define TKJHAT_I2C_NOTIFY_INDEX                 1      /**< FreeRTOS task notification index used for completion (0 is left to the application). */
+#endif
+/** @} */
+
+/**
+ * @brief State of an asynchronous transfer.
+ */
+typedef enum {
+    I2C_XFER_IDLE = 0,      /**< Descriptor prepared but not submitted. */
+    I2C_XFER_QUEUED,        /**< Waiting in the queue. */
+    I2C_XFER_BUSY,          /**< Bytes are being moved on the bus. */
+    I2C_XFER_DONE,          /**< Finished successfully. */
+    I2C_XFER_NAK,           /**< Address or data byte not acknowledged. */
+    I2C_XFER_ERROR,         /**< Any other abort (arbitration lost, timeout, ...). */
+} i2c_xfer_status_t;
+
+typedef struct i2c_xfer i2c_xfer_t;
+
+/**
+ * @brief Completion callback. Runs in interrupt context.
+ *
+ * Keep it short: set a flag, give a semaphore with the @c FromISR API,
+ * or submit the next transfer.
+ */
+typedef void (*i2c_xfer_done_handler_t)(i2c_xfer_t *xfer);
+
+/**
+ * @brief Descriptor of one asynchronous transfer.
+ *
+ * Fill it with @ref i2c_xfer_write, @ref i2c_xfer_read or
+ * @ref i2c_xfer_write_read, optionally set @c on_done / @c user_data, and
+ * submit it with @ref i2c_submit_async.
+ */
+struct i2c_xfer {
+    uint8_t addr;                       /**< 7-bit device address. */
+    const uint8_t *tx;                  /**< Bytes to write (may be NULL if @c tx_len is 0). */
+    size_t tx_len;                      /**< Number of bytes to write. */
+    uint8_t *rx;                        /**< Destination of read bytes (may be NULL if @c rx_len is 0). */
+    size_t rx_len;                      /**< Number of bytes to read. */
+    i2c_xfer_done_handler_t on_done;    /**< Optional completion callback (IRQ context). */
+    void *user_data;                    /**< Free for the caller. */
+
+    volatile i2c_xfer_status_t status;  /**< Current state, see ::i2c_xfer_status_t. */
+    uint32_t abort_source;              /**< Raw IC_TX_ABRT_SOURCE when the transfer failed. */
+    uint64_t submit_us;                 /**< time_us_64() when submitted. */
+    uint64_t start_us;                  /**< time_us_64() when the first byte was queued to the FIFO. */
+    uint64_t done_us;                   /**< time_us_64() when it finished. */
+
+    TaskHandle_t notify_task;           /**< Task to notify on completion (set by ::i2c_submit_async). */
+    i2c_xfer_t *next;                   /**< Internal queue link. */
+};
+
+/**
+ * @brief Initialize the asynchronous I2C engine on @c i2c_default.
+ *
+ * Claims two DMA channels and installs the I2C interrupt handler.
+ * Safe to call more than once.
+ *
+ * @pre Call @ref init_i2c_default() or @ref init_hat_sdk() before this function.
+ * @return @c true on success, @c false if no DMA channels were available.
+ */
+bool init_i2c_async(void);
+
+/**
+ * @brief Prepare a write-only transfer.
+ *
+ * @param xfer Descriptor to fill.
+ * @param addr 7-bit device address.
+ * @param src  Bytes to write. Must stay valid until the transfer has finished.
+ * @param len  Number of bytes.
+ */
+void i2c_xfer_write(i2c_xfer_t *xfer, uint8_t addr, const uint8_t *src, size_t len);
+
+/**
+ * @brief Prepare a read-only transfer.
+ *
+ * @param xfer Descriptor to fill.
+ * @param addr 7-bit device address.
+ * @param dst  Destination buffer. Must stay valid until the transfer has finished.
+ * @param len  Number of bytes.
+ */
+void i2c_xfer_read(i2c_xfer_t *xfer, uint8_t addr, uint8_t *dst, size_t len);
+
+/**
+ * @brief Prepare a write-then-read transfer (repeated START in between).
+ *
+ * @param xfer   Descriptor to fill.
+ * @param addr   7-bit device address.
+ * @param src    Bytes to write (usually the register address).
+ * @param tx_len Number of bytes to write.
+ * @param dst    Destination buffer for the read.
+ * @param rx_len Number of bytes to read.
+ */
+void i2c_xfer_write_read(i2c_xfer_t *xfer, uint8_t addr,
+                         const uint8_t *src, size_t tx_len,
+                         uint8_t *dst, size_t rx_len);
+
+/**
+ * @brief Queue a transfer. Returns immediately.
+ *
+ * If called from a running FreeRTOS task, that task is recorded in
+ * @c notify_task and will be notified on completion.
+ *
+ * @param xfer Prepared descriptor. Must not already be queued.
+ * @return @c false if the engine is not initialized, the descriptor is
+ *         already pending, or @c tx_len + @c rx_len is 0 or larger than
+ *         @ref TKJHAT_I2C_ASYNC_MAX_LEN.
+ */
+bool i2c_submit_async(i2c_xfer_t *xfer);
+
+/**
+ * @brief Wait until a transfer has finished.
+ *
+ * Inside a FreeRTOS task the caller blocks on its task notification, so other
+ * tasks run while the bytes move. Before the scheduler starts it busy-waits.
+ *
+ * @param xfer       A submitted descriptor.
+ * @param timeout_ms Maximum time to wait.
+ * @return Final status, or ::I2C_XFER_QUEUED / ::I2C_XFER_BUSY on timeout.
+ */
+i2c_xfer_status_t i2c_xfer_wait(i2c_xfer_t *xfer, uint32_t timeout_ms);
+
+/**
+ * @brief Check whether any asynchronous transfer is queued or running.
+ *
+ * @return @c true while the queue is not empty.
+ */
+bool i2c_async_busy(void);
+
+/**
+ * @brief Abort the running transfer and fail every queued one.
+ *
+ * Each pending descriptor ends with ::I2C_XFER_ERROR; its @c on_done callback
+ * runs (here in the caller's context) and its task is notified. Used by
+ * @ref i2c_bus_recover.
+ */
+void i2c_async_reset(void);
+
+/**
+ * @brief Put the controller back in the engine's idle state after
+ *        @c i2c_init() reset it.
+ *
+ * The reset value of IC_INTR_MASK enables TX_EMPTY and other interrupts the
+ * engine does not handle; with the I2C interrupt enabled they would fire
+ * forever. Masks them all and turns the DMA handshake off. Called by
+ * @ref i2c_bus_recover after re-initializing the controller.
+ */
+void i2c_async_rearm(void);
+
+/**
+ * @brief Busy-wait until the asynchronous queue is empty.
+ *
+ * Used by the blocking helpers before they touch the controller.
+ */
+void i2c_async_wait_idle(void);
+
+/** @} */ // end of group i2c_async
+
+#endif /* I2C_ASYNC_H */
@@ -0,0 +1,265 @@
+/*
+Version 0.84
+
+MIT License
+
+Copyright (c) 2025 , Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file tkjhat/i2c_bus.h
+ * @brief Shared-bus arbitration for the devices on @c i2c_default.
+ *
+ * @version 0.84
+ */
+
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "pico/stdlib.h"
+#include <FreeRTOS.h>
+#include <task.h>
+
+/**
+ * @defgroup i2c_bus I2C bus manager
+ * @brief Serializes and prioritizes the HAT devices sharing @c i2c_default.
+ *
+ * @details
+ * The VEML6030, HDC2021, ICM-42670 and SSD1306 all sit on the same bus.
+ * Every SDK driver sends its transactions through @ref i2c_bus_transfer, so
+ * two tasks can no longer interleave transfers and corrupt each other.
+ *
+ * Once @ref init_i2c_bus_manager has been called, a bus-owner task executes
+ * the transactions. Each device has a policy (@ref i2c_bus_policy_t):
+ * - a **priority**: the pending transaction of the highest priority device
+ *   goes first,
+ * - a **deadline**: among equal priorities the earliest absolute deadline
+ *   (submit time + deadline) goes first,
+ * - a **chunk size**: long writes that start with @c chunk_prefix are sent
+ *   in chunks of at most this many data bytes. Before each chunk the owner
+ *   looks at the queue again, so a pending IMU read waits for one chunk
+ *   instead of a whole 1 KB framebuffer. The SSD1306 uses this with the
+ *   0x40 data control byte; its RAM pointer keeps advancing between chunks.
+ *
+ * Without the manager (or before the scheduler starts) transactions run
+ * directly in the calling task, protected by a mutex.
+ *
+ * Every transaction is bounded in time: @ref TKJHAT_I2C_TIMEOUT_BASE_US plus
+ * @ref TKJHAT_I2C_TIMEOUT_PER_BYTE_US per byte. A NAK fails the transaction
+ * with @c PICO_ERROR_GENERIC. A timeout usually means a target is holding
+ * SDA low, so the bus is recovered (@ref i2c_bus_recover) and the transaction
+ * fails with @c PICO_ERROR_TIMEOUT. A misbehaving sensor costs its caller a
+ * bounded time instead of hanging every task that uses the bus.
+ *
+ * | Device   | Priority | Deadline | Chunk |
+ * |----------|----------|----------|-------|
+ * | ICM42670 | 3        | 500 µs   | -     |
+ * | VEML6030 | 2        | 20 ms    | -     |
+ * | HDC2021  | 2        | 20 ms    | -     |
+ * | SSD1306  | 1        | 50 ms    | 16 B  |
+ * | other    | 2        | 10 ms    | -     |
+ *
+ * @{
+ */
+
+/** @name Bus timeouts
+ *  Can be overridden with compile definitions.
+ *  @{ */
+#ifndef TKJHAT_I2C_TIMEOUT_BASE_US
+#define TKJHAT_I2C_TIMEOUT_BASE_US              1000   /**< Fixed part of a transaction timeout (µs). */
+#endif
+#ifndef TKJHAT_I2C_TIMEOUT_PER_BYTE_US
+#define TKJHAT_I2C_TIMEOUT_PER_BYTE_US          50     /**< Added per byte (µs); one byte takes ~23 µs at 400 kHz. */
+#endif
+/** @} */
+
+/**
+ * @brief Devices known by the bus manager.
+ */
+typedef enum {
+    I2C_BUS_DEV_ICM42670 = 0,   /**< IMU (0x69 / 0x68). */
+    I2C_BUS_DEV_VEML6030,       /**< Ambient light sensor (0x10). */
+    I2C_BUS_DEV_HDC2021,        /**< Temperature & humidity sensor (0x40). */
+    I2C_BUS_DEV_SSD1306,        /**< OLED display (0x3C). */
+    I2C_BUS_DEV_OTHER,          /**< Any other address. */
+    I2C_BUS_DEV_COUNT
+} i2c_bus_device_t;
+
+/**
+ * @brief Scheduling policy of one device.
+ */
+typedef struct {
+    uint8_t priority;           /**< Higher value wins. */
+    uint32_t deadline_us;       /**< Relative deadline used to order equal priorities. */
+    uint16_t chunk_size;        /**< Max data bytes per chunk of a long write (0 = never split). */
+    int16_t chunk_prefix;       /**< First byte a write must have to be split, repeated before every chunk (-1 = none). */
+} i2c_bus_policy_t;
+
+/**
+ * @brief Per-device statistics, in microseconds where applicable.
+ */
+typedef struct {
+    uint32_t transfers;         /**< Completed transactions. */
+    uint32_t errors;            /**< Transactions that failed (NAK, timeout...). */
+    uint32_t naks;              /**< Transfers not acknowledged (or aborted for another reason). */
+    uint32_t timeouts;          /**< Transfers that did not finish in time. */
+    uint32_t recoveries;        /**< Bus recoveries triggered by this device. */
+    uint32_t chunks;            /**< Bus transactions used (> transfers when writes are split). */
+    uint32_t bytes;             /**< Payload bytes moved. */
+    uint32_t deadline_misses;   /**< Transactions finished after their deadline. */
+    uint32_t queue_latency_last_us; /**< Submit to first byte, last transaction. */
+    uint32_t queue_latency_max_us;  /**< Submit to first byte, worst case. */
+    uint64_t queue_latency_sum_us;  /**< Submit to first byte, sum over successful transactions (divide by @c transfers for the mean). */
+    uint32_t total_latency_max_us;  /**< Submit to completion, worst case. */
+} i2c_bus_stats_t;
+
+/**
+ * @brief Prepare the bus bookkeeping.
+ *
+ * Called by @ref init_i2c(); only needed if you set up @c i2c_default yourself.
+ *
+ * @param sda_pin  SDA GPIO of @c i2c_default.
+ * @param scl_pin  SCL GPIO of @c i2c_default.
+ * @param baudrate Bus speed, restored after a recovery.
+ */
+void init_i2c_bus(uint sda_pin, uint scl_pin, uint baudrate);
+
+/**
+ * @brief Start the bus-owner task.
+ *
+ * Also initializes @ref i2c_async so the owner sleeps while DMA moves the bytes.
+ *
+ * @param task_priority FreeRTOS priority of the owner task. Use a priority at
+ *                      least as high as the highest task that uses the bus.
+ * @return @c true on success.
+ *
+ * @pre Call @ref init_i2c_default() or @ref init_hat_sdk() first.
+ */
+bool init_i2c_bus_manager(UBaseType_t task_priority);
+
+/**
+ * @brief Check whether the bus-owner task is running.
+ */
+bool i2c_bus_manager_running(void);
+
+/**
+ * @brief Map a 7-bit address to a device.
+ */
+i2c_bus_device_t i2c_bus_device_from_addr(uint8_t addr);
+
+/**
+ * @brief Change the scheduling policy of a device.
+ */
+void i2c_bus_set_policy(i2c_bus_device_t dev, const i2c_bus_policy_t *policy);
+
+/**
+ * @brief Read the scheduling policy of a device.
+ */
+void i2c_bus_get_policy(i2c_bus_device_t dev, i2c_bus_policy_t *policy);
+
+/**
+ * @brief Run one complete I2C transaction on @c i2c_default.
+ *
+ * Writes @p tx_len bytes and then (repeated START) reads @p rx_len bytes;
+ * either length may be 0. Blocks the calling task until the transaction has
+ * finished; with the manager running the task sleeps meanwhile.
+ *
+ * @return Number of bytes transferred (@p tx_len + @p rx_len) on success,
+ *         or a negative @c PICO_ERROR_* code.
+ *
+ * @note Do not call from interrupts.
+ */
+int i2c_bus_transfer(uint8_t addr, const uint8_t *tx, size_t tx_len,
+                     uint8_t *rx, size_t rx_len);
+
+/**
+ * @brief Write with a timeout, counting errors and recovering the bus on timeout.
+ *
+ * Low-level building block of @ref i2c_write. The caller must hold the bus
+ * (@ref i2c_bus_lock).
+ *
+ * @return Bytes written, or a negative @c PICO_ERROR_* code.
+ */
+int i2c_bus_write_raw(uint8_t addr, const uint8_t *src, size_t len, bool nostop);
+
+/**
+ * @brief Read with a timeout, counting errors and recovering the bus on timeout.
+ *
+ * Low-level building block of @ref i2c_read. The caller must hold the bus
+ * (@ref i2c_bus_lock).
+ *
+ * @return Bytes read, or a negative @c PICO_ERROR_* code.
+ */
+int i2c_bus_read_raw(uint8_t addr, uint8_t *dst, size_t len, bool nostop);
+
+/**
+ * @brief Free a stuck bus and re-initialize @c i2c_default.
+ *
+ * Aborts pending @ref i2c_async transfers, takes SDA/SCL as GPIOs, clocks SCL
+ * up to 9 times until the target releases SDA, generates a STOP and
+ * re-initializes the controller. Called automatically after a timeout.
+ *
+ * @return @c true if both lines are high (bus idle) afterwards.
+ */
+bool i2c_bus_recover(void);
+
+/**
+ * @brief Number of bus recoveries since boot.
+ */
+uint32_t i2c_bus_recovery_count(void);
+
+/**
+ * @brief Take exclusive use of the bus for several raw transfers.
+ *
+ * Only needed when calling the Pico SDK @c i2c_*_blocking functions directly.
+ * @ref i2c_write and @ref i2c_read take it for you and keep it between a
+ * @c nostop write and the read that follows. The lock is recursive: every
+ * call must be paired with @ref i2c_bus_unlock. No-op before the scheduler starts.
+ */
+void i2c_bus_lock(void);
+
+/**
+ * @brief Release the bus taken with @ref i2c_bus_lock.
+ */
+void i2c_bus_unlock(void);
+
+/**
+ * @brief Check whether the calling task holds the bus lock.
+ */
+bool i2c_bus_locked_by_me(void);
+
+/**
+ * @brief Copy the statistics of a device.
+ */
+void i2c_bus_get_stats(i2c_bus_device_t dev, i2c_bus_stats_t *stats);
+
+/**
+ * @brief Reset the statistics of all devices.
+ */
+void i2c_bus_reset_stats(void);
+
+/** @} */ // end of group i2c_bus
+
+#endif /* I2C_BUS_H */
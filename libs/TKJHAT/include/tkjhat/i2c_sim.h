@@ -0,0 +1,285 @@
+/*
+Version 0.84
+
+MIT License
+
+Copyright (c) 2025 , Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file tkjhat/i2c_sim.h
+ * @brief Simulated I2C bus with register-level models of the HAT devices.
+ *
+ * @version 0.84
+ */
+
+#ifndef I2C_SIM_H
+#define I2C_SIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @defgroup i2c_sim Simulated I2C devices
+ * @brief Run the HAT drivers without a HAT.
+ *
+ * @details
+ * Configure the SDK with @c -DTKJHAT_I2C_SIM=ON and every transfer made
+ * through @ref i2c_bus (all SDK drivers, @ref i2c_write, @ref i2c_read)
+ * goes to the devices attached with @ref i2c_sim_attach instead of the
+ * pins. An address without a device answers with a NAK.
+ *
+ * Models are provided for the four HAT devices. They follow the datasheet
+ * register layout closely enough for the SDK drivers to run their normal
+ * bring-up paths:
+ * | Model                 | Registers                                                         |
+ * |-----------------------|-------------------------------------------------------------------|
+ * | @ref i2c_sim_icm42670_t | WHO_AM_I, MCLK_RDY, soft reset, PWR_MGMT0, ACCEL/GYRO_CONFIG0, data 0x09-0x16, INT_STATUS_DRDY |
+ * | @ref i2c_sim_hdc2021_t  | TEMP/HUMIDITY, DRDY_STATUS, CONFIG (soft reset, AMM), MEASUREMENT_CONFIG, thresholds, IDs |
+ * | @ref i2c_sim_veml6030_t | ALS_CONF (gain, integration time, shutdown), ALS                |
+ * | @ref i2c_sim_ssd1306_t  | Command stream, addressing modes, GDDRAM                          |
+ *
+ * Sensor outputs come from @ref i2c_sim_channel_t "channels": a constant, or
+ * a function of time such as @ref i2c_sim_wave. The conversions use the
+ * scale selected by the driver (FSR, gain...), so the values read back by
+ * the SDK should match the channel values up to quantization.
+ *
+ * @code{.c}
+ * static i2c_sim_icm42670_t imu;
+ * static i2c_sim_wave_t tilt = { .offset = 0.0f, .amplitude = 0.5f, .period_us = 2000000 };
+ *
+ * i2c_sim_icm42670_init(&imu);
+ * imu.accel[2].value = 1.0f;                        // 1 g on Z
+ * imu.accel[0].fn = i2c_sim_wave;                   // slow oscillation on X
+ * imu.accel[0].ctx = &tilt;
+ * i2c_sim_attach(&imu.rf.dev);
+ *
+ * init_ICM42670();                                  // runs against the model
+ * @endcode
+ *
+ * Status bits that the drivers poll follow simulated time: MCLK_RDY comes
+ * back 1 ms after a soft reset, INT_STATUS_DRDY is set once per output data
+ * period while a sensor is on, and DRDY_STATUS at the end of a triggered or
+ * automatic conversion. Both data-ready bits clear when they are read.
+ *
+ * The models take the register names from sdk.h and the time from
+ * @c time_us_64(). tools/i2c_sim_test.c builds them on a PC against the
+ * fakes in tools/host.
+ * @{
+ */
+
+/** @name Simulated bus configuration
+ *  @{ */
+#ifndef TKJHAT_I2C_SIM
+#define TKJHAT_I2C_SIM                          0      /**< Set to 1 (CMake option TKJHAT_I2C_SIM) to route the bus to the models. */
+#endif
+/** @} */
+
+typedef struct i2c_sim_device i2c_sim_device_t;
+
+/**
+ * @brief One device on the simulated bus.
+ *
+ * Models embed it as their first member. Custom devices fill the callbacks.
+ */
+struct i2c_sim_device {
+    uint8_t addr;                                           /**< 7-bit address. */
+    bool nak;                                               /**< Fault injection: do not acknowledge. */
+    bool stuck;                                             /**< Fault injection: hold the bus (transfers time out until recovery). */
+    void (*start)(i2c_sim_device_t *dev, bool read);        /**< (Repeated) START addressed to this device. */
+    size_t (*write)(i2c_sim_device_t *dev, const uint8_t *src, size_t len); /**< Bytes written; returns bytes acknowledged. */
+    void (*read)(i2c_sim_device_t *dev, uint8_t *dst, size_t len);          /**< Bytes requested by the controller. */
+    void (*stop)(i2c_sim_device_t *dev);                    /**< STOP condition. */
+    uint32_t transactions;                                  /**< Addressed transfers (START or repeated START). */
+    uint32_t bytes;                                         /**< Data bytes moved. */
+    i2c_sim_device_t *next;                                 /**< Internal list link. */
+};
+
+/**
+ * @brief Signal generator: value of a channel at time @p t_us.
+ */
+typedef float (*i2c_sim_signal_t)(void *ctx, uint64_t t_us);
+
+/**
+ * @brief Source of one simulated physical quantity.
+ */
+typedef struct {
+    float value;            /**< Used when @c fn is NULL. */
+    i2c_sim_signal_t fn;    /**< Optional generator. */
+    void *ctx;              /**< Passed to @c fn. */
+} i2c_sim_channel_t;
+
+/**
+ * @brief Parameters of @ref i2c_sim_wave.
+ */
+typedef struct {
+    float offset;           /**< Mean value. */
+    float amplitude;        /**< Peak deviation from @c offset. */
+    uint32_t period_us;     /**< Period of the sine (0 = constant @c offset). */
+    float noise;            /**< Peak of a uniform pseudo-random noise added to the sine. */
+    uint32_t seed;          /**< Noise generator state (any value). */
+} i2c_sim_wave_t;
+
+/**
+ * @brief Sine plus noise, for use as a channel generator with an @ref i2c_sim_wave_t context.
+ */
+float i2c_sim_wave(void *ctx, uint64_t t_us);
+
+/**
+ * @brief Current value of a channel.
+ */
+float i2c_sim_channel_value(const i2c_sim_channel_t *ch, uint64_t t_us);
+
+/**
+ * @brief Put a device on the simulated bus.
+ */
+void i2c_sim_attach(i2c_sim_device_t *dev);
+
+/**
+ * @brief Remove a device from the simulated bus.
+ */
+void i2c_sim_detach(i2c_sim_device_t *dev);
+
+/**
+ * @brief Simulated counterpart of @c i2c_write_timeout_us.
+ *
+ * @return @p len, @c PICO_ERROR_GENERIC on NAK, or @c PICO_ERROR_TIMEOUT if the device is stuck.
+ */
+int i2c_sim_write(uint8_t addr, const uint8_t *src, size_t len, bool nostop);
+
+/**
+ * @brief Simulated counterpart of @c i2c_read_timeout_us.
+ */
+int i2c_sim_read(uint8_t addr, uint8_t *dst, size_t len, bool nostop);
+
+/**
+ * @brief Simulated bus recovery: releases every stuck device.
+ */
+void i2c_sim_recover(void);
+
+/* =========================
+ *  MODELS
+ * ========================= */
+
+/**
+ * @brief Devices with 8-bit auto-incrementing registers (ICM-42670, HDC2021).
+ */
+typedef struct i2c_sim_regfile i2c_sim_regfile_t;
+struct i2c_sim_regfile {
+    i2c_sim_device_t dev;   /**< Bus device. */
+    uint8_t regs[256];      /**< Register file. */
+    uint8_t ptr;            /**< Register pointer. */
+    bool ptr_set;           /**< The first byte of the current write has been received. */
+    void (*on_write)(i2c_sim_regfile_t *rf, uint8_t reg);  /**< Model hook after a register is written. */
+    void (*on_read)(i2c_sim_regfile_t *rf);                /**< Model hook when a read starts at @c ptr. */
+    void (*on_read_done)(i2c_sim_regfile_t *rf, uint8_t first, size_t len); /**< Model hook after @p len registers from @p first were read (clear-on-read bits). */
+};
+
+/**
+ * @brief ICM-42670 model.
+ */
+typedef struct {
+    i2c_sim_regfile_t rf;           /**< Register file (bank 0). */
+    i2c_sim_channel_t accel[3];     /**< Acceleration X/Y/Z in g. */
+    i2c_sim_channel_t gyro[3];      /**< Angular rate X/Y/Z in dps. */
+    i2c_sim_channel_t temp;         /**< Die temperature in °C. */
+    uint32_t resets;                /**< Soft resets seen. */
+    uint64_t reset_us;              /**< Time of the last soft reset. */
+    uint64_t next_sample_us;        /**< Time of the next output sample (sets INT_STATUS_DRDY). */
+} i2c_sim_icm42670_t;
+
+/**
+ * @brief HDC2021 model.
+ */
+typedef struct {
+    i2c_sim_regfile_t rf;           /**< Register file. */
+    i2c_sim_channel_t temp;         /**< Temperature in °C. */
+    i2c_sim_channel_t humidity;     /**< Relative humidity in %. */
+    uint32_t resets;                /**< Soft resets seen. */
+    uint32_t triggers;              /**< Measurements triggered. */
+    uint64_t conversion_us;         /**< End of the running conversion (0 = idle). */
+} i2c_sim_hdc2021_t;
+
+/**
+ * @brief VEML6030 model (16-bit little-endian command registers).
+ */
+typedef struct {
+    i2c_sim_device_t dev;           /**< Bus device. */
+    uint16_t regs[16];              /**< Command registers. */
+    uint8_t cmd;                    /**< Selected command code. */
+    uint8_t rx[3];                  /**< Bytes of the current write. */
+    uint8_t rx_len;                 /**< Number of bytes in @c rx. */
+    uint8_t tx_pos;                 /**< Byte of the register being read. */
+    i2c_sim_channel_t lux;          /**< Illuminance in lux. */
+} i2c_sim_veml6030_t;
+
+/**
+ * @brief SSD1306 model.
+ */
+typedef struct {
+    i2c_sim_device_t dev;           /**< Bus device. */
+    uint8_t gddram[8][128];         /**< Display RAM, [page][column]. */
+    uint8_t mode;                   /**< Memory addressing mode (0 horizontal, 1 vertical, 2 page). */
+    uint8_t col, col_start, col_end;    /**< Column pointer and window. */
+    uint8_t page, page_start, page_end; /**< Page pointer and window. */
+    uint8_t start_line;             /**< Display start line (0x40 command). */
+    uint8_t contrast;               /**< Contrast (0x81 command). */
+    bool display_on;                /**< 0xAF / 0xAE. */
+    bool inverted;                  /**< 0xA7 / 0xA6. */
+    uint32_t commands;              /**< Command bytes received (arguments included). */
+    uint32_t data_bytes;            /**< GDDRAM bytes received. */
+
+    // Stream parser state
+    uint8_t control;                /**< Current control byte. */
+    bool expect_control;            /**< Next byte is a control byte. */
+    uint8_t cmd[3];                 /**< Command being assembled. */
+    uint8_t cmd_len, cmd_need;      /**< Bytes of @c cmd received / needed. */
+} i2c_sim_ssd1306_t;
+
+/**
+ * @brief Initialize an ICM-42670 model at @ref ICM42670_I2C_ADDRESS, at rest (0 g, 0 dps, 25 °C).
+ */
+void i2c_sim_icm42670_init(i2c_sim_icm42670_t *m);
+
+/**
+ * @brief Initialize an HDC2021 model at @ref HDC2021_I2C_ADDRESS (22 °C, 40 %RH).
+ */
+void i2c_sim_hdc2021_init(i2c_sim_hdc2021_t *m);
+
+/**
+ * @brief Initialize a VEML6030 model at @ref VEML6030_I2C_ADDR (300 lux).
+ */
+void i2c_sim_veml6030_init(i2c_sim_veml6030_t *m);
+
+/**
+ * @brief Initialize an SSD1306 model at @ref SSD1306_I2C_ADDRESS, display off and RAM cleared.
+ */
+void i2c_sim_ssd1306_init(i2c_sim_ssd1306_t *m);
+
+/**
+ * @brief Read one pixel from the simulated display RAM.
+ */
+bool i2c_sim_ssd1306_pixel(const i2c_sim_ssd1306_t *m, uint8_t x, uint8_t y);
+
+/** @} */ // end of group i2c_sim
+
+#endif /* I2C_SIM_H */
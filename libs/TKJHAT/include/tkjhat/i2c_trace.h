@@ -0,0 +1,160 @@
+/*
+Version 0.84
+
+MIT License
+
+Copyright (c) 2025 , Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file tkjhat/i2c_trace.h
+ * @brief RAM trace of the I2C transactions, for offline analysis.
+ *
+ * @version 0.84
+ */
+
+#ifndef I2C_TRACE_H
+#define I2C_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @defgroup i2c_trace I2C trace recorder
+ * @brief Record what the bus was doing and analyse it on the PC.
+ *
+ * @details
+ * Configure the SDK with @c -DTKJHAT_I2C_TRACE=ON to compile the recorder in.
+ * Every transfer on @c i2c_default is then logged into a RAM ring buffer of
+ * @ref TKJHAT_I2C_TRACE_DEPTH entries (16 bytes each): start time, duration,
+ * address, direction, length and result. This covers @ref i2c_write,
+ * @ref i2c_read, all SDK drivers and the SSD1306 display. When the buffer is
+ * full the oldest entries are overwritten. Without the option the recording
+ * calls compile to nothing.
+ *
+ * Dump the buffer over the CDC0 debug port and save it to a file:
+ * @code{.c}
+ * i2c_trace_dump(usb_serial_print);
+ * @endcode
+ *
+ * The dump is CSV text. @c libs/TKJHAT/tools/i2c_trace_replay.py reads it,
+ * replays it against a model of the bus and HAT devices, and reports bus
+ * utilization and worst-case latency for each device.
+ * @{
+ */
+
+/** @name Trace configuration
+ *  Can be overridden with compile definitions.
+ *  @{ */
+#ifndef TKJHAT_I2C_TRACE
+#define TKJHAT_I2C_TRACE                        0      /**< Set to 1 (CMake option TKJHAT_I2C_TRACE) to compile the recorder in. */
+#endif
+#ifndef TKJHAT_I2C_TRACE_DEPTH
+#define TKJHAT_I2C_TRACE_DEPTH                  256    /**< Entries in the ring buffer (power of two). */
+#endif
+/** @} */
+
+/** @name Trace entry flags
+ *  @{ */
+#define I2C_TRACE_READ                          0x01   /**< Read transfer (otherwise write). */
+#define I2C_TRACE_NOSTOP                        0x02   /**< Ended without STOP (repeated START follows). */
+#define I2C_TRACE_ASYNC                         0x04   /**< Done by DMA (@ref i2c_async); @c len is tx + rx. */
+/** @} */
+
+/**
+ * @brief One recorded transfer.
+ */
+typedef struct {
+    uint32_t t_us;          /**< Start, low 32 bits of time_us_64(). */
+    uint32_t dur_us;        /**< Duration. */
+    uint16_t len;           /**< Bytes requested. */
+    uint8_t addr;           /**< 7-bit address. */
+    uint8_t flags;          /**< @ref I2C_TRACE_READ, @ref I2C_TRACE_NOSTOP, @ref I2C_TRACE_ASYNC. */
+    int16_t result;         /**< Bytes transferred, or a negative @c PICO_ERROR_* code. */
+    uint16_t seq;           /**< Running number, to spot overwritten entries. */
+} i2c_trace_entry_t;
+
+/**
+ * @brief Line output used by @ref i2c_trace_dump (same signature as @c usb_serial_print).
+ */
+typedef int (*i2c_trace_print_t)(const char *line);
+
+#if TKJHAT_I2C_TRACE
+
+/**
+ * @brief Set up the recorder lock. Called once by @ref init_i2c_bus, before
+ *        any transfer; entries passed earlier are dropped.
+ */
+void i2c_trace_init(void);
+
+/**
+ * @brief Append one entry. Called by the bus layer.
+ */
+void i2c_trace_record(uint8_t addr, uint8_t flags, size_t len,
+                      uint64_t start_us, uint64_t end_us, int result);
+
+/**
+ * @brief Pause (@c false) or resume (@c true) recording. Enabled at boot.
+ */
+void i2c_trace_enable(bool enable);
+
+/**
+ * @brief Drop all entries.
+ */
+void i2c_trace_clear(void);
+
+/**
+ * @brief Copy up to @p max entries, oldest first.
+ *
+ * @return Number of entries copied.
+ */
+size_t i2c_trace_snapshot(i2c_trace_entry_t *dst, size_t max);
+
+/**
+ * @brief Print the buffer as CSV, oldest entry first.
+ *
+ * Recording is paused during the dump, without changing the
+ * @ref i2c_trace_enable setting. The first lines are a header starting
+ * with @c '#'.
+ *
+ * @param print Output function, e.g. @c usb_serial_print.
+ */
+void i2c_trace_dump(i2c_trace_print_t print);
+
+#else
+
+// Recording disabled: empty inlines, so call sites need no #if
+static inline void i2c_trace_init(void) {}
+static inline void i2c_trace_record(uint8_t addr, uint8_t flags, size_t len,
+                                    uint64_t start_us, uint64_t end_us, int result) {
+    (void)addr; (void)flags; (void)len; (void)start_us; (void)end_us; (void)result;
+}
+static inline void i2c_trace_enable(bool enable) { (void)enable; }
+static inline void i2c_trace_clear(void) {}
+static inline size_t i2c_trace_snapshot(i2c_trace_entry_t *dst, size_t max) { (void)dst; (void)max; return 0; }
+static inline void i2c_trace_dump(i2c_trace_print_t print) { (void)print; }
+
+#endif /* TKJHAT_I2C_TRACE */
+
+/** @} */ // end of group i2c_trace
+
+#endif /* I2C_TRACE_H */
@@ -0,0 +1,123 @@
+/*
+Version 0.84
+
+MIT License
+
+Copyright (c) 2025 , Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file tkjhat/imu_fixed.h
+ * @brief Integer IMU samples and batch fixed-point conversion.
+ *
+ * @version 0.84
+ */
+
+#ifndef IMU_FIXED_H
+#define IMU_FIXED_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @defgroup imu_fixed IMU fixed-point conversion
+ * @brief Convert ICM-42670 samples without floating point.
+ *
+ * @details
+ * The RP2040 (Cortex-M0+) has no FPU: every @c float operation is a
+ * library call, and a division costs several times a multiplication.
+ * @ref ICM42670_read_raw returns the sensor counts as @c int16_t, and
+ * @ref ICM42670_convert_q16 converts arrays of them to Q16.16 fixed point
+ * (1.0 = 65536) with one integer multiply and shift per value. The
+ * multipliers are computed once, when the full-scale range is set
+ * (@ref ICM42670_scale_set_accel, @ref ICM42670_scale_set_gyro).
+ *
+ * | Field        | Q16.16 unit | 1.0 equals |
+ * |--------------|-------------|------------|
+ * | accel[]      | g           | 65536      |
+ * | gyro[]       | dps         | 65536      |
+ * | temp         | °C          | 65536      |
+ *
+ * @code{.c}
+ * ICM42670_raw_t raw[16];
+ * ICM42670_q16_t q[16];
+ * for (int i = 0; i < 16; i++) ICM42670_read_raw(&raw[i]);
+ * ICM42670_convert_q16(ICM42670_get_scale(), raw, q, 16);
+ * int32_t az_mg = (q[0].accel[2] * 1000) >> 16;  // milli-g
+ * @endcode
+ *
+ * The module is plain C with no Pico SDK dependency, so it also builds on
+ * the PC (see @c tools/imu_convert_bench.c).
+ * @{
+ */
+
+/**
+ * @brief One sample as read from the data registers (sensor counts).
+ */
+typedef struct {
+    int16_t accel[3];       /**< Accel X/Y/Z counts. */
+    int16_t gyro[3];        /**< Gyro X/Y/Z counts. */
+    int16_t temp;           /**< Temperature counts (°C = temp / 128 + 25). */
+} ICM42670_raw_t;
+
+/**
+ * @brief One sample in Q16.16 fixed point.
+ */
+typedef struct {
+    int32_t accel[3];       /**< Acceleration in g, Q16.16. */
+    int32_t gyro[3];        /**< Angular rate in dps, Q16.16. */
+    int32_t temp;           /**< Temperature in °C, Q16.16. */
+} ICM42670_q16_t;
+
+/**
+ * @brief Precomputed conversion factors for the selected full-scale ranges.
+ *
+ * Q16.16 value = (counts * k) >> shift. @c k is below 2^16, so the product
+ * of a 16-bit count never overflows 32 bits.
+ */
+typedef struct {
+    int32_t accel_k;        /**< Accel multiplier. */
+    uint8_t accel_shift;    /**< Accel shift. */
+    int32_t gyro_k;         /**< Gyro multiplier. */
+    uint8_t gyro_shift;     /**< Gyro shift. */
+    float accel_inv;        /**< 1 / (counts per g), for the float API. */
+    float gyro_inv;         /**< 1 / (counts per dps), for the float API. */
+} ICM42670_scale_t;
+
+/**
+ * @brief Set the accel factors from the sensitivity in counts per g (e.g. 8192 at ±4 g).
+ */
+void ICM42670_scale_set_accel(ICM42670_scale_t *scale, float counts_per_g);
+
+/**
+ * @brief Set the gyro factors from the sensitivity in counts per dps (e.g. 131 at ±250 dps).
+ */
+void ICM42670_scale_set_gyro(ICM42670_scale_t *scale, float counts_per_dps);
+
+/**
+ * @brief Convert @p n raw samples to Q16.16. Integer arithmetic only.
+ */
+void ICM42670_convert_q16(const ICM42670_scale_t *scale, const ICM42670_raw_t *raw,
+                          ICM42670_q16_t *out, size_t n);
+
+/** @} */ // end of group imu_fixed
+
+#endif /* IMU_FIXED_H */
@@ -0,0 +1,156 @@
+/*
+Version 0.84
+
+MIT License
+
+Copyright (c) 2025 , Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file tkjhat/imu_fusion.h
+ * @brief Fixed-point Mahony orientation filter for the ICM-42670.
+ *
+ * @version 0.84
+ */
+
+#ifndef IMU_FUSION_H
+#define IMU_FUSION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "imu_fixed.h"
+
+/**
+ * @defgroup imu_fusion IMU orientation filter
+ * @brief Orientation and linear acceleration from accel + gyro, integer arithmetic only.
+ *
+ * @details
+ * A Mahony complementary filter: the gyroscope is integrated into a
+ * quaternion and the accelerometer pulls the estimate back towards gravity
+ * (proportional gain @c kp, integral gain @c ki for the gyro bias). Yaw has
+ * no absolute reference (no magnetometer) and drifts with the gyro bias.
+ *
+ * Everything is done with 32/64-bit integers on @ref ICM42670_q16_t samples,
+ * so an update costs a few thousand cycles on the RP2040 (no FPU) and the
+ * filter keeps up with 400 Hz and more on one core. The time step comes
+ * from the sample time stamps (e.g. @ref ICM42670_sample_t::time_us).
+ *
+ * Formats: quaternion components in Q2.30 (1.0 = 2^30), gains in Q16.16,
+ * vectors and angles in Q16.16 (g, degrees).
+ *
+ * @code{.c}
+ * imu_fusion_t f;
+ * ICM42670_raw_t raw;
+ * ICM42670_q16_t s;
+ * int32_t roll, pitch, yaw, lin[3];
+ *
+ * imu_fusion_init(&f, IMU_FUSION_KP_DEFAULT, IMU_FUSION_KI_DEFAULT);
+ * for (;;) {
+ *     ICM42670_read_raw(&raw);
+ *     ICM42670_convert_q16(ICM42670_get_scale(), &raw, &s, 1);
+ *     imu_fusion_update(&f, &s, time_us_64());
+ *     imu_fusion_euler(&f, &roll, &pitch, &yaw);      // degrees, Q16
+ *     imu_fusion_linear_accel(&f, &s, lin);           // g, gravity removed
+ * }
+ * @endcode
+ *
+ * @c tools/imu_fusion_bench.c runs the filter on the PC against synthetic
+ * rotations and reports the angle error and the cost of an update.
+ * @{
+ */
+
+/** @name Filter configuration
+ *  Can be overridden with compile definitions.
+ *  @{ */
+#ifndef IMU_FUSION_KP_DEFAULT
+#define IMU_FUSION_KP_DEFAULT                   65536  /**< Proportional gain, Q16 (1.0 rad/s per rad of tilt error). */
+#endif
+#ifndef IMU_FUSION_KI_DEFAULT
+#define IMU_FUSION_KI_DEFAULT                   3277   /**< Integral gain, Q16 (0.05), learns the gyro bias. */
+#endif
+#ifndef IMU_FUSION_MAX_DT_US
+#define IMU_FUSION_MAX_DT_US                    100000 /**< Longer gaps between samples are clamped to this. */
+#endif
+/** @} */
+
+/**
+ * @brief Quaternion, Q2.30 components (w is the scalar part).
+ */
+typedef struct {
+    int32_t w, x, y, z;
+} imu_quat_t;
+
+/**
+ * @brief Filter state.
+ */
+typedef struct {
+    imu_quat_t q;           /**< Sensor-to-world orientation. */
+    int32_t bias[3];        /**< Integral feedback (gyro bias estimate) in rad/s, Q2.30. */
+    int32_t kp;             /**< Proportional gain, Q16. */
+    int32_t ki;             /**< Integral gain, Q16. */
+    uint64_t last_us;       /**< Time of the previous sample. */
+    bool started;           /**< The first sample has set the initial tilt. */
+    uint32_t updates;       /**< Samples processed. */
+    uint32_t accel_rejected;/**< Samples whose acceleration was too far from 1 g to correct the tilt. */
+} imu_fusion_t;
+
+/**
+ * @brief Reset the filter. The first update takes the tilt from the accelerometer.
+ *
+ * @param f  Filter.
+ * @param kp Proportional gain, Q16 (e.g. @ref IMU_FUSION_KP_DEFAULT).
+ * @param ki Integral gain, Q16 (0 disables the bias estimate).
+ */
+void imu_fusion_init(imu_fusion_t *f, int32_t kp, int32_t ki);
+
+/**
+ * @brief Process one sample.
+ *
+ * @param f       Filter.
+ * @param s       Sample in Q16 (see @ref ICM42670_convert_q16).
+ * @param time_us Sample time in µs; the step is the difference to the previous one.
+ */
+void imu_fusion_update(imu_fusion_t *f, const ICM42670_q16_t *s, uint64_t time_us);
+
+/**
+ * @brief Current orientation.
+ */
+static inline imu_quat_t imu_fusion_quat(const imu_fusion_t *f) { return f->q; }
+
+/**
+ * @brief Roll, pitch and yaw (Z-Y-X) in degrees, Q16 (about ±0.1° approximation error).
+ */
+void imu_fusion_euler(const imu_fusion_t *f, int32_t *roll, int32_t *pitch, int32_t *yaw);
+
+/**
+ * @brief Gravity as seen by the accelerometer at the current orientation, in g (Q16).
+ */
+void imu_fusion_gravity(const imu_fusion_t *f, int32_t g[3]);
+
+/**
+ * @brief Acceleration of sample @p s with gravity removed, in g (Q16), sensor axes.
+ */
+void imu_fusion_linear_accel(const imu_fusion_t *f, const ICM42670_q16_t *s, int32_t lin[3]);
+
+/** @} */ // end of group imu_fusion
+
+#endif /* IMU_FUSION_H */
@@ -0,0 +1,187 @@
+/*
+Version 0.84
+
+MIT License
+
+Copyright (c) 2025 , Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file tkjhat/raster.h
+ * @brief Integer drawing primitives on a page-organized 1-bpp framebuffer.
+ *
+ * @version 0.84
+ */
+
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @defgroup raster Raster core
+ * @brief Lines, spans and rectangles for the SSD1306 buffer layout, without floating point.
+ *
+ * @details
+ * The framebuffer has the layout of the SSD1306 RAM: @c pages rows of
+ * @c width bytes, each byte one column of 8 pixels (bit 0 on top). The
+ * primitives write whole bytes where they can:
+ *
+ * - vertical lines and rectangles use one byte mask per page (a full page
+ *   is a @c memset);
+ * - horizontal spans OR one bit into consecutive bytes;
+ * - lines use Bresenham's algorithm. Off-screen parts are skipped without
+ *   being stepped through, so the loop runs at most @c width or
+ *   @c height times.
+ *
+ * Every primitive clips to the framebuffer; coordinates may be negative or
+ * far outside. Lines are symmetric: (a, b) and (b, a) set the same pixels.
+ *
+ * The optional span arrays are the change tracking of @ref ssd1306_t:
+ * per page, the columns written (@c dirty) and the columns that may hold
+ * set pixels (@c ink). Spans are empty when @c lo > @c hi. Marking is
+ * conservative: a span may cover bytes that did not actually change.
+ *
+ * @c ssd1306_raster() returns the view of a display's back buffer:
+ * @code{.c}
+ * raster_t r = ssd1306_raster(&disp);
+ * raster_line(&r, 0, 63, 127, 0, true);
+ * raster_fill_rect(&r, 10, 10, 20, 12, true);
+ * ssd1306_show(&disp);
+ * @endcode
+ *
+ * Text is drawn a glyph column at a time: the column bits of the font,
+ * shifted to the row, are ORed into the one or two bytes per page they
+ * cover (one when @c y is a multiple of 8). Glyphs at scale 3 and up are
+ * expanded once into a @ref raster_glyph_cache_t and blitted from there;
+ * at scale 2 expanding on every call is as fast.
+ *
+ * @c tools/raster_bench.c checks every primitive against per-pixel
+ * reference code and compares the speed with the previous drawing code.
+ * @{
+ */
+
+/** @name Glyph cache configuration
+ *  Can be overridden with compile definitions.
+ *  @{ */
+#ifndef RASTER_GLYPH_CACHE
+#define RASTER_GLYPH_CACHE      16      /**< Slots in a glyph cache (power of two). */
+#endif
+#ifndef RASTER_GLYPH_MAX_W
+#define RASTER_GLYPH_MAX_W      8       /**< Widest font, in columns, whose glyphs are cached. */
+#endif
+/** @} */
+
+/**
+ * @brief View of a framebuffer and its change tracking.
+ */
+typedef struct {
+    uint8_t *buf;           /**< @c pages * @c width bytes, page-major. */
+    uint8_t width;          /**< Columns (at most 255). */
+    uint8_t height;         /**< Rows, a multiple of 8. */
+    uint8_t *dirty_lo;      /**< Per page: first written column, or NULL. */
+    uint8_t *dirty_hi;      /**< Per page: last written column. */
+    uint8_t *ink_lo;        /**< Per page: first column that may be set, or NULL. */
+    uint8_t *ink_hi;        /**< Per page: last column that may be set. */
+} raster_t;
+
+/**
+ * @brief One glyph expanded for a scale: column bits, bit 0 on top.
+ */
+typedef struct {
+    const uint8_t *font;    /**< Font of the glyph, NULL if the slot is empty. */
+    uint8_t c;              /**< Character. */
+    uint8_t scale;          /**< Scale the columns are expanded for. */
+    uint32_t col[RASTER_GLYPH_MAX_W];   /**< Each font column with every row repeated @c scale times. */
+} raster_glyph_t;
+
+/**
+ * @brief Direct-mapped cache of scaled glyphs. Zero it before first use.
+ *
+ * Glyphs are cached at scale 3 and up, when the font is at most
+ * @ref RASTER_GLYPH_MAX_W columns wide and the scaled glyph at most 32
+ * rows high (@c font_8x5 at scales 3 and 4). A cache must not be used by two tasks at the same time.
+ */
+typedef struct {
+    raster_glyph_t slot[RASTER_GLYPH_CACHE];    /**< Indexed by character and scale. */
+} raster_glyph_cache_t;
+
+/**
+ * @brief Set (@p on) or clear one pixel.
+ */
+void raster_pixel(const raster_t *r, int32_t x, int32_t y, bool on);
+
+/**
+ * @brief Horizontal span from @p x0 to @p x1 (inclusive, any order) on row @p y.
+ */
+void raster_hline(const raster_t *r, int32_t x0, int32_t x1, int32_t y, bool on);
+
+/**
+ * @brief Vertical span from @p y0 to @p y1 (inclusive, any order) in column @p x.
+ */
+void raster_vline(const raster_t *r, int32_t x, int32_t y0, int32_t y1, bool on);
+
+/**
+ * @brief Line from (x0, y0) to (x1, y1), both ends included.
+ */
+void raster_line(const raster_t *r, int32_t x0, int32_t y0, int32_t x1, int32_t y1, bool on);
+
+/**
+ * @brief Filled rectangle of @p w x @p h pixels with its top-left corner at (x, y).
+ *
+ * Nothing is drawn if @p w or @p h is 0 or negative.
+ */
+void raster_fill_rect(const raster_t *r, int32_t x, int32_t y, int32_t w, int32_t h, bool on);
+
+/**
+ * @brief One pixel wide outline of the rectangle of @ref raster_fill_rect.
+ */
+void raster_rect(const raster_t *r, int32_t x, int32_t y, int32_t w, int32_t h, bool on);
+
+/**
+ * @brief Draw character @p c of @p font with its top-left corner at (x, y).
+ *
+ * Only the set pixels of the glyph are drawn; the background is left as
+ * it is. Characters outside the font and a @p scale of 0 draw nothing.
+ *
+ * @param cache Glyph cache, used for scales above 2, or NULL to expand
+ *              the glyph on every call.
+ * @param scale Size of one font pixel, in pixels.
+ * @param font  Font in the format of @c tkjhat/font.h.
+ */
+void raster_char(const raster_t *r, raster_glyph_cache_t *cache, int32_t x, int32_t y,
+                 uint32_t scale, const uint8_t *font, char c);
+
+/**
+ * @brief Draw the string @p s, one @ref raster_char per character.
+ *
+ * Characters advance by the font width plus its spacing, times @p scale.
+ * Characters that start beyond the right edge are only counted.
+ *
+ * @return x of the next character, saturated to INT32_MAX.
+ */
+int32_t raster_text(const raster_t *r, raster_glyph_cache_t *cache, int32_t x, int32_t y,
+                    uint32_t scale, const uint8_t *font, const char *s);
+
+/** @} */ // end of group raster
+
+#endif /* RASTER_H */
@@ -0,0 +1,198 @@
+/*
+Version 0.84
+
+MIT License
+
+Copyright (c) 2025 , Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file tkjhat/regmap.h
+ * @brief Table-driven register maps with a RAM shadow of the configuration registers.
+ *
+ * @version 0.84
+ */
+
+#ifndef REGMAP_H
+#define REGMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @defgroup regmap Register maps
+ * @brief Cached configuration registers and coalesced burst writes.
+ *
+ * @details
+ * A driver describes the configuration registers of its device once, in a
+ * @c const table of @ref regmap_reg_t sorted by register address, and
+ * declares the map with @ref REGMAP_DEFINE. The map keeps a RAM copy
+ * (shadow) of every register that is not @ref REGMAP_VOLATILE:
+ *
+ * - @ref regmap_read answers from the shadow, no bus traffic.
+ * - @ref regmap_update_bits changes a field. The register is read from the
+ *   device only the first time (or after @ref regmap_invalidate); unchanged
+ *   values are not written at all.
+ * - Between @ref regmap_batch_begin and @ref regmap_batch_end the changes are
+ *   only recorded. @ref regmap_batch_end writes all changed registers with as
+ *   few transactions as possible: registers with consecutive addresses are
+ *   sent as one burst write (the HAT sensors auto-increment the register
+ *   address), bridging over up to @ref REGMAP_BRIDGE_MAX unchanged cached
+ *   registers when that saves a transaction.
+ *
+ * Outside a batch every change is written immediately, so the driver
+ * functions keep their usual behaviour when called on their own.
+ *
+ * @code{.c}
+ * static const regmap_reg_t my_regs[] = {
+ *     { .reg = 0x0E, .reset = 0x00, .self_clear = 0x80 },   // CONFIG, SOFT_RES
+ *     { .reg = 0x0F, .reset = 0x00, .self_clear = 0x01 },   // MEASUREMENT_CONFIG, MEAS_TRIG
+ * };
+ * REGMAP_DEFINE(my_map, 0x40, my_regs);
+ *
+ * regmap_batch_begin(&my_map);
+ * regmap_update_bits(&my_map, 0x0E, 0x70, 0x50);
+ * regmap_update_bits(&my_map, 0x0F, 0x01, 0x01);
+ * regmap_batch_end(&my_map);               // one 3-byte write
+ * @endcode
+ *
+ * Bus access goes through @ref i2c_bus_transfer. Functions return 0 on
+ * success or a negative @c PICO_ERROR_* code. A map must only be used from
+ * one task at a time.
+ * @{
+ */
+
+/** @name Register map configuration
+ *  Can be overridden with compile definitions.
+ *  @{ */
+#ifndef REGMAP_MAX_REGS
+#define REGMAP_MAX_REGS                         32     /**< Max registers per map (shadow bitmaps are 32 bits wide). */
+#endif
+#ifndef REGMAP_BRIDGE_MAX
+#define REGMAP_BRIDGE_MAX                       2      /**< Max unchanged registers rewritten to join two bursts. */
+#endif
+/** @} */
+
+/** @name Register flags
+ *  Values for regmap_reg_t::flags.
+ *  @{ */
+#define REGMAP_VOLATILE                         0x01   /**< Not cached: always read from and written to the device directly. */
+#define REGMAP_WRITE_LAST                       0x02   /**< Never part of a burst; written alone after the other registers (e.g. power control). */
+/** @} */
+
+/**
+ * @brief Description of one register.
+ */
+typedef struct {
+    uint8_t reg;            /**< Register address. */
+    uint8_t reset;          /**< Value after a device reset (see @ref regmap_reset_cache). */
+    uint8_t flags;          /**< @ref REGMAP_VOLATILE, @ref REGMAP_WRITE_LAST. */
+    uint8_t self_clear;     /**< Bits the device clears by itself after they are written (reset, trigger...). */
+    uint16_t settle_us;     /**< Wait after this register has been written. */
+} regmap_reg_t;
+
+/**
+ * @brief A device register map. Declare it with @ref REGMAP_DEFINE.
+ */
+typedef struct {
+    uint8_t dev_addr;               /**< 7-bit I2C address of the device. */
+    uint8_t count;                  /**< Number of entries in @c regs. */
+    const regmap_reg_t *regs;       /**< Register table, sorted by address. */
+    uint8_t *shadow;                /**< RAM copy, one byte per entry. */
+    uint32_t valid;                 /**< Bit i set: shadow[i] matches the device. */
+    uint32_t dirty;                 /**< Bit i set: shadow[i] waits to be written. */
+    uint8_t batch;                  /**< Nesting depth of @ref regmap_batch_begin. */
+    uint32_t transactions;          /**< Bus transactions issued through this map. */
+} regmap_t;
+
+/**
+ * @brief Define a register map and its shadow storage.
+ *
+ * @param name     Name of the @ref regmap_t variable.
+ * @param addr     7-bit I2C address.
+ * @param table    @c const array of @ref regmap_reg_t sorted by address.
+ */
+#define REGMAP_DEFINE(name, addr, table)                                            \
+    _Static_assert(sizeof(table) / sizeof((table)[0]) <= REGMAP_MAX_REGS,          \
+                   #table " has too many registers");                             \
+    static uint8_t name##_shadow[sizeof(table) / sizeof((table)[0])];              \
+    static regmap_t name = {                                                       \
+        .dev_addr = (addr),                                                        \
+        .count = sizeof(table) / sizeof((table)[0]),                               \
+        .regs = (table),                                                           \
+        .shadow = name##_shadow,                                                   \
+    }
+
+/**
+ * @brief Read a register, from the shadow when possible.
+ */
+int regmap_read(regmap_t *map, uint8_t reg, uint8_t *value);
+
+/**
+ * @brief Set a register to @p value.
+ *
+ * Written immediately outside a batch; skipped if the device already holds it.
+ */
+int regmap_write(regmap_t *map, uint8_t reg, uint8_t value);
+
+/**
+ * @brief Replace the bits in @p mask with the matching bits of @p value.
+ */
+int regmap_update_bits(regmap_t *map, uint8_t reg, uint8_t mask, uint8_t value);
+
+/**
+ * @brief Start collecting changes. Batches may nest.
+ */
+void regmap_batch_begin(regmap_t *map);
+
+/**
+ * @brief End a batch; the outermost one writes all pending changes.
+ */
+int regmap_batch_end(regmap_t *map);
+
+/**
+ * @brief Write all pending changes now, even inside a batch.
+ */
+int regmap_flush(regmap_t *map);
+
+/**
+ * @brief Load the shadow from the device, one burst read per run of consecutive registers.
+ *
+ * Pending changes are discarded.
+ */
+int regmap_sync(regmap_t *map);
+
+/**
+ * @brief Set the shadow to the reset values of the table, without bus traffic.
+ *
+ * Call after resetting the device.
+ */
+void regmap_reset_cache(regmap_t *map);
+
+/**
+ * @brief Forget the shadow; registers are read again on next use.
+ */
+void regmap_invalidate(regmap_t *map);
+
+/** @} */ // end of group regmap
+
+#endif /* REGMAP_H */
@@ -112,6 +112,15 @@ SOFTWARE.
 
 #include "pdm_microphone.h"   // pdm_samples_ready_handler_t
 #include "pins.h"
+#include "i2c_async.h"        // asynchronous I2C transactions
+#include "i2c_bus.h"          // shared-bus arbitration
+#include "regmap.h"           // cached sensor configuration registers
+#include "i2c_trace.h"        // optional I2C transaction recorder
+#include "imu_fixed.h"        // integer IMU samples and Q16 conversion
+#include "imu_fusion.h"       // fixed-point orientation filter
+#include "window_stats.h"     // sliding-window statistics
+#include "capture.h"          // pre-trigger capture rings
+#include "raster.h"           // integer drawing primitives
 
 /* =========================
  *  CONSTANTS AND MACROS
@@ -147,6 +156,8 @@ SOFTWARE.
 #define HDC2021_TEMP_HIGH                       0x01   /**< Temperature high byte register. */
 #define HDC2021_HUMIDITY_LOW                    0x02   /**< Humidity low byte register. */
 #define HDC2021_HUMIDITY_HIGH                   0x03   /**< Humidity high byte register. */
+#define HDC2021_DRDY_STATUS_REG                 0x04   /**< Interrupt/DRDY status (cleared on read). */
+#define HDC2021_DRDY_STATUS                     0x80   /**< DRDY_STATUS bit: conversion complete. */
 #define HDC2021_CONFIG                          0x0E   /**< Configuration register. */
 #define HDC2021_MEASUREMENT_CONFIG              0x0F   /**< Measurement configuration register. */
 #define HDC2021_TEMP_THR_L                      0x13   /**< Low temperature threshold. */
@@ -208,9 +219,17 @@ SOFTWARE.
  *  @{ */
 #define ICM42670_ACCEL_CONFIG0_REG              0x21   /**< Accelerometer ODR/FSR (see bit fields below). */
 #define ICM42670_GYRO_CONFIG0_REG               0x20   /**< Gyroscope ODR/FSR (see bit fields below). */
+#define ICM42670_TEMP_CONFIG0_REG               0x22   /**< Temperature filter bandwidth. */
+#define ICM42670_GYRO_CONFIG1_REG               0x23   /**< Gyroscope UI filter bandwidth [2:0]. */
+#define ICM42670_ACCEL_CONFIG1_REG              0x24   /**< Accelerometer averaging [6:4], UI filter bandwidth [2:0]. */
 #define ICM42670_PWR_MGMT0_REG                  0x1F   /**< Power state / sensor mode control. */
 #define ICM42670_REG_SIGNAL_PATH_RESET          0x02   /**< Signal path reset register. */
 #define ICM42670_RESET_CONFIG_BITS              0x10   /**< Value used for soft reset sequence. */
+#define ICM42670_RESET_WAIT_US                  1000   /**< No register access this long after a soft reset (datasheet). */
+#define ICM42670_REG_MCLK_RDY                   0x00   /**< Clock status register. */
+#define ICM42670_MCLK_RDY                       0x08   /**< MCLK_RDY bit: internal clock running (register access allowed). */
+#define ICM42670_INT_STATUS_DRDY_REG            0x39   /**< Data-ready status (cleared on read). */
+#define ICM42670_DATA_RDY_INT                   0x01   /**< INT_STATUS_DRDY bit: new sensor data. */
 /** @} */
 
 /** @name Accelerometer FSR encodings
@@ -272,6 +291,89 @@ SOFTWARE.
 #define ICM42670_SENSOR_DATA_START_REG          0x09   /**< First data register for TEMP/ACCEL/GYRO burst read. */
 /** @} */
 
+/** @name FIFO
+ *  FIFO configuration, watermark interrupt and read port.
+ *  @{ */
+#define ICM42670_FIFO_CONFIG1_REG               0x28   /**< FIFO_MODE (bit 1), FIFO_BYPASS (bit 0). */
+#define ICM42670_FIFO_CONFIG2_REG               0x29   /**< FIFO watermark [7:0]. */
+#define ICM42670_FIFO_CONFIG3_REG               0x2A   /**< FIFO watermark [11:8]. */
+#define ICM42670_INT_SOURCE0_REG                0x2B   /**< Interrupts routed to INT1. */
+#define ICM42670_INTF_CONFIG0_REG               0x35   /**< FIFO count format and endianness. */
+#define ICM42670_INT_STATUS_REG                 0x3A   /**< Interrupt status (cleared on read). */
+#define ICM42670_FIFO_COUNTH_REG                0x3D   /**< FIFO count, high byte (low byte follows). */
+#define ICM42670_FIFO_DATA_REG                  0x3F   /**< FIFO read port. */
+#define ICM42670_FIFO_FLUSH                     0x04   /**< SIGNAL_PATH_RESET bit: flush the FIFO. */
+#define ICM42670_FIFO_BYPASS                    0x01   /**< FIFO_CONFIG1 bit: FIFO disabled. */
+#define ICM42670_FIFO_COUNT_RECORDS             0x40   /**< INTF_CONFIG0 bit: count and watermark in packets. */
+#define ICM42670_INT_FIFO_THS                   0x04   /**< INT_SOURCE0 / INT_STATUS bit: FIFO watermark. */
+#define ICM42670_INT_FIFO_FULL                  0x02   /**< INT_SOURCE0 / INT_STATUS bit: FIFO full. */
+#define ICM42670_INT_DRDY                       0x08   /**< INT_SOURCE0 bit: UI data ready. */
+#define ICM42670_FIFO_PACKET_SIZE               16     /**< Bytes per packet: header, accel, gyro, temp, timestamp. */
+#define ICM42670_FIFO_MAX_PACKETS               144    /**< FIFO capacity in packets (2.25 KB). */
+/** @} */
+
+/** @name APEX
+ *  On-chip motion processing (pedometer, tilt, free fall, wake-on-motion, significant motion).
+ *  @{ */
+#define ICM42670_APEX_CONFIG0_REG               0x25   /**< DMP_INIT_EN (bit 2), DMP_MEM_RESET_EN (bit 0). */
+#define ICM42670_APEX_CONFIG1_REG               0x26   /**< Feature enables, DMP_ODR [1:0]. */
+#define ICM42670_WOM_CONFIG_REG                 0x27   /**< Wake-on-motion mode and enable. */
+#define ICM42670_INT_SOURCE1_REG                0x2C   /**< SMD and WoM interrupts routed to INT1. */
+#define ICM42670_APEX_DATA0_REG                 0x31   /**< Step count, low byte (then high byte, cadence, activity). */
+#define ICM42670_INT_STATUS2_REG                0x3B   /**< SMD / WoM status (cleared on read). */
+#define ICM42670_INT_STATUS3_REG                0x3C   /**< Step / tilt / free-fall status (cleared on read). */
+#define ICM42670_DMP_MEM_RESET                  0x01   /**< APEX_CONFIG0: clear the DMP memory. */
+#define ICM42670_DMP_INIT                       0x04   /**< APEX_CONFIG0: initialize the DMP (self-clearing). */
+#define ICM42670_APEX_SMD_EN                    0x40   /**< APEX_CONFIG1: significant motion. */
+#define ICM42670_APEX_FF_EN                     0x20   /**< APEX_CONFIG1: free fall. */
+#define ICM42670_APEX_TILT_EN                   0x10   /**< APEX_CONFIG1: tilt. */
+#define ICM42670_APEX_PED_EN                    0x08   /**< APEX_CONFIG1: pedometer. */
+#define ICM42670_DMP_ODR_50HZ                   0x02   /**< APEX_CONFIG1: DMP runs at 50 Hz. */
+#define ICM42670_WOM_EN_VALUE                   0x03   /**< WOM_CONFIG: enabled, each sample compared with the previous one, any axis. */
+#define ICM42670_INT_SMD                        0x08   /**< INT_SOURCE1 / INT_STATUS2 bit: significant motion. */
+#define ICM42670_INT_WOM_XYZ                    0x07   /**< INT_SOURCE1 / INT_STATUS2 bits: wake-on-motion X/Y/Z. */
+#define ICM42670_INT_STEP_DET                   0x20   /**< INT_SOURCE6 / INT_STATUS3 bit: step detected. */
+#define ICM42670_INT_STEP_CNT_OVF               0x10   /**< INT_SOURCE6 / INT_STATUS3 bit: step counter overflow. */
+#define ICM42670_INT_TILT_DET                   0x08   /**< INT_SOURCE6 / INT_STATUS3 bit: tilt. */
+#define ICM42670_INT_FF_DET                     0x04   /**< INT_STATUS3 bit: free fall. */
+#define ICM42670_INT_FF_EN                      0x80   /**< INT_SOURCE6 bit: free fall. */
+/** @} */
+
+/** @name MREG access
+ *  Registers of the MREG1 bank are reached through a bank/address/data window.
+ *  @{ */
+#define ICM42670_BLK_SEL_W_REG                  0x79   /**< Write window: bank (then MADDR_W 0x7A, M_W 0x7B). */
+#define ICM42670_BLK_SEL_R_REG                  0x7C   /**< Read window: bank (then MADDR_R 0x7D, M_R 0x7E). */
+#define ICM42670_M_R_REG                        0x7E   /**< Read window: data. */
+#define ICM42670_MREG1_FIFO_CONFIG5             0x01   /**< MREG1: sensors written to the FIFO. */
+#define ICM42670_FIFO_CONFIG5_VALUE             0x23   /**< Accel + gyro in the FIFO, watermark interrupt while count >= watermark. */
+#define ICM42670_MREG1_INT_SOURCE6              0x2F   /**< MREG1: APEX interrupts routed to INT1. */
+#define ICM42670_MREG1_WOM_X_THR                0x4B   /**< MREG1: WoM threshold X (then Y 0x4C, Z 0x4D), 1/256 g per LSB. */
+#define ICM42670_MREG1_OFFSET_USER0             0x4E   /**< MREG1: first of the nine user offset registers (0x4E-0x56). */
+/** @} */
+
+/** @name User offsets
+ *  12-bit signed corrections added to the sensor output by the IMU.
+ *  @{ */
+#define ICM42670_OFFSET_MAX                     2047   /**< Largest offset magnitude. */
+#define ICM42670_ACCEL_OFFSET_PER_G             2000   /**< Accel offset LSB per g (0.5 mg, range ±1 g). */
+#define ICM42670_GYRO_OFFSET_PER_DPS            32     /**< Gyro offset LSB per dps (1/32 dps, range ±64 dps). */
+/** @} */
+
+/** @name Calibration
+ *  Limits of ::ICM42670_calibrate. Can be overridden with compile definitions.
+ *  @{ */
+#ifndef ICM42670_CALIB_SETTLE_MS
+#define ICM42670_CALIB_SETTLE_MS                50     /**< Wait after clearing the offsets before sampling. */
+#endif
+#ifndef ICM42670_CALIB_ACCEL_MAX_STD_G
+#define ICM42670_CALIB_ACCEL_MAX_STD_G          0.02f  /**< Accel standard deviation above which the board is moving. */
+#endif
+#ifndef ICM42670_CALIB_GYRO_MAX_STD_DPS
+#define ICM42670_CALIB_GYRO_MAX_STD_DPS         0.5f   /**< Gyro standard deviation above which the board is moving. */
+#endif
+/** @} */
+
 /** @} */ /* end of group  of registers*/
 
 
@@ -300,6 +402,9 @@ SOFTWARE.
  *
  * @note Most drivers call these internally; you usually only need
  * `init_hat_sdk()` or `init_i2c_default()` in your main program.
+ *
+ * @see @ref i2c_async for the non-blocking, DMA-driven variant.
+ * @see @ref i2c_bus for how the drivers share the bus between tasks.
  * @{
  */
 
@@ -312,6 +417,65 @@ SOFTWARE.
  */
 void init_hat_sdk(void);
 
+/** @name Sensor bring-up
+ *  @{ */
+#ifndef TKJHAT_BOOT_TIMEOUT_US
+#define TKJHAT_BOOT_TIMEOUT_US                  100000 /**< Give up on a sensor that is not ready after this long. */
+#endif
+#define HAT_SENSOR_IMU                          0x01   /**< ICM-42670 failed (see @ref init_hat_sensors). */
+#define HAT_SENSOR_HDC2021                      0x02   /**< HDC2021 failed. */
+#define HAT_SENSOR_VEML6030                     0x04   /**< VEML6030 failed. */
+/** @} */
+
+/**
+ * @brief Time stamps of @ref init_hat_sensors, in µs since reset.
+ *
+ * Zero means the step did not complete.
+ */
+typedef struct {
+    uint32_t start_us;           /**< Call entry (USB, clocks and I2C set up before). */
+    uint32_t imu_clock_us;       /**< IMU clock running again after the soft reset. */
+    uint32_t imu_config_us;      /**< IMU configured, accel + gyro in LN mode. */
+    uint32_t hdc_config_us;      /**< HDC2021 out of reset and configured. */
+    uint32_t veml_config_us;     /**< VEML6030 powered on. */
+    uint32_t imu_first_sample_us;/**< First IMU data-ready flag. */
+    uint32_t hdc_first_sample_us;/**< First HDC2021 conversion complete. */
+    uint32_t end_us;             /**< Return. */
+} hat_boot_timing_t;
+
+/**
+ * @brief Bring up the IMU, HDC2021 and VEML6030 together, waiting on status bits.
+ *
+ * Equivalent to @ref init_ICM42670 + @ref ICM42670_start_with_default_values,
+ * @ref init_hdc2021_ and @ref init_veml6030, but the resets of the IMU and the
+ * HDC2021 run at the same time and every wait polls the device's own ready
+ * bit instead of sleeping for a fixed time:
+ *
+ * 1. Soft reset of the IMU and HDC2021, VEML6030 power-on (three short writes).
+ * 2. Poll IMU MCLK_RDY, then write its configuration as one batch.
+ * 3. Poll the HDC2021 reset bit, then write its configuration as one batch.
+ * 4. Poll IMU DRDY and HDC2021 DRDY_STATUS until both have data.
+ *
+ * Typically returns about 15 ms after the call, bounded by the
+ * accelerometer start-up. The gyroscope needs about 45 ms after LN mode
+ * before its data settles. The first VEML6030 result is ready one
+ * integration time (100 ms) after @c veml_config_us, which no polling
+ * can shorten.
+ *
+ * @code{.c}
+ * hat_boot_timing_t t;
+ * init_hat_sdk();
+ * int failed = init_hat_sensors(&t);
+ * printf("first IMU sample %lu us after reset\n", (unsigned long)t.imu_first_sample_us);
+ * @endcode
+ *
+ * @param timing Receives the time stamps, may be NULL.
+ * @return 0 when all sensors are up, otherwise a mask of the failed ones
+ *         (@ref HAT_SENSOR_IMU, @ref HAT_SENSOR_HDC2021, @ref HAT_SENSOR_VEML6030).
+ * @pre @ref init_hat_sdk (or @ref init_i2c_default).
+ */
+int init_hat_sensors(hat_boot_timing_t *timing);
+
 /**
  * @brief Initialize an I2C instance with explicit pins.
  *
@@ -365,6 +529,10 @@ void init_i2c_default(void);
  *               condition (repeated start).
  *
  * @return @c true if all bytes were written, @c false otherwise.
+ *
+ * @note Waits for pending @ref i2c_async transfers before starting.
+ * @note Fails after a bounded time if the device does not answer; a stuck bus
+ *       is recovered automatically (see @ref i2c_bus).
  */
 bool i2c_write(uint8_t addr, const uint8_t *src, size_t len, bool nostop);
 
@@ -395,6 +563,10 @@ bool i2c_write(uint8_t addr, const uint8_t *src, size_t len, bool nostop);
  *               condition (repeated start).
  *
  * @return @c true if all bytes were read, @c false otherwise.
+ *
+ * @note Waits for pending @ref i2c_async transfers before starting.
+ * @note Fails after a bounded time if the device does not answer; a stuck bus
+ *       is recovered automatically (see @ref i2c_bus).
  */
 bool i2c_read(uint8_t addr, uint8_t *dst, size_t len, bool nostop);
 /** @} */ // end of General
@@ -822,9 +994,37 @@ int get_microphone_samples(int16_t *buffer, size_t samples);
  * | Address | @ref SSD1306_I2C_ADDRESS | 0x3C | OLED I2C address |
  *
  * @pre The I2C interface must be initialized (use @ref init_i2c_default() or @ref init_hat_sdk()).
+ *
+ * Drawing functions only change a RAM buffer; the panel is updated when a
+ * frame ends. Each helper is a frame on its own, so a single call shows up
+ * right away. To build a screen from several calls, wrap them in
+ * @ref display_begin_frame / @ref display_end_frame: the panel is then
+ * updated once, with only the parts that changed, and never shows a half
+ * drawn screen.
+ *
+ * Without a render task the update is done by the task that ends the frame.
+ * After @ref init_display_render_task a dedicated task does it instead, at
+ * most @ref TKJHAT_DISPLAY_MAX_FPS times per second: frames ended in between
+ * are merged, and ending a frame returns at once. The display is double
+ * buffered: the task sends the finished frame (through the bus manager,
+ * which moves it with DMA) while the next one is being drawn.
  * @{
  */
 
+/** @name Display configuration
+ *  Can be overridden with compile definitions.
+ *  @{ */
+#ifndef TKJHAT_DISPLAY_MAX_FPS
+#define TKJHAT_DISPLAY_MAX_FPS                  30     /**< Default update rate limit of the render task. */
+#endif
+#ifndef TKJHAT_DISPLAY_NOTIFY_INDEX
+#define TKJHAT_DISPLAY_NOTIFY_INDEX             2      /**< Task notification index on which the render task is woken (apart from @ref TKJHAT_I2C_NOTIFY_INDEX, which its flushes wait on). */
+#endif
+#ifndef TKJHAT_DISPLAY_TASK_STACK
+#define TKJHAT_DISPLAY_TASK_STACK               1024   /**< Render task stack in words (the I2C error path calls printf). */
+#endif
+/** @} */
+
 
 /**
  * @brief Initialize the SSD1306 OLED (@ref SSD1306_I2C_ADDRESS — 0x3C).
@@ -838,6 +1038,63 @@ int get_microphone_samples(int16_t *buffer, size_t samples);
  */
 void init_display(void);
 
+/**
+ * @brief Start the task that sends frames to the panel.
+ *
+ * Afterwards @ref display_end_frame (and every drawing helper) only wakes the
+ * task, so drawing tasks do not wait for the I2C transfer. The task holds
+ * the display lock only while it swaps the buffers (microseconds).
+ *
+ * @param task_priority FreeRTOS priority of the render task. Below the
+ *                      sensor tasks is usually right.
+ * @param max_fps       Update rate limit, 0 for @ref TKJHAT_DISPLAY_MAX_FPS.
+ * @return @c true on success.
+ *
+ * @pre Call @ref init_display first. @c FreeRTOSConfig.h must set
+ *      @c configTASK_NOTIFICATION_ARRAY_ENTRIES above @ref TKJHAT_DISPLAY_NOTIFY_INDEX.
+ */
+bool init_display_render_task(UBaseType_t task_priority, uint32_t max_fps);
+
+/**
+ * @brief Start a frame: following drawing calls are sent together.
+ *
+ * Takes the display lock, so other tasks wait until @ref display_end_frame
+ * and the render task cannot send a half drawn screen. Frames can be nested;
+ * the panel is updated when the outermost one ends.
+ */
+void display_begin_frame(void);
+
+/**
+ * @brief End a frame started with @ref display_begin_frame.
+ *
+ * Updates the panel (or asks the render task to) when the outermost frame ends.
+ */
+void display_end_frame(void);
+
+/**
+ * @brief Display update timing, see @ref display_get_timing.
+ */
+typedef struct {
+    uint32_t frames;        /**< Panel updates done so far (at most @c max_fps per second with the render task). */
+    uint32_t flush_us;      /**< Duration of the last update on the bus. */
+    uint32_t frame_us;      /**< Time between the last two updates. */
+    uint32_t tx_bytes;      /**< Bytes sent to the panel so far. */
+} display_timing_t;
+
+/**
+ * @brief Check whether every ended frame has reached the panel.
+ *
+ * @return @c true if no update is pending or running.
+ */
+bool display_flush_done(void);
+
+/**
+ * @brief Read the measured update timing.
+ *
+ * @param[out] timing Filled with the current values.
+ */
+void display_get_timing(display_timing_t *timing);
+
 /**
  * @brief Write a text string centered-ish on the display.
  *
@@ -846,7 +1103,8 @@ void init_display(void);
  *
  * @param text Null-terminated C string. Ignored if @c NULL.
  *
- * @note This helper calls @c ssd1306_show() internally.
+ * @note Does not wait: call @c vTaskDelay / @c sleep_ms yourself to keep the
+ *       text on screen for a while.
  * @see write_text_xy()
  */
 void write_text(const char *text);
@@ -863,10 +1121,39 @@ void write_text(const char *text);
  * @param y0  Start Y in pixels (values < 0 are clamped to 0).
  * @param text Null-terminated C string. Ignored if @c NULL.
  *
- * @note Calls @c ssd1306_show() internally.
+ * @note Updates the panel unless called inside a frame.
  */
 void write_text_xy(int16_t x0, int16_t y0, const char *text);
 
+/**
+ * @brief Print @p text on the display used as a scrolling log console.
+ *
+ * The first call clears the display and opens the console: 8 lines of 21
+ * characters that scroll up when full, with @c '\n', @c '\r', @c '\t'
+ * and line wrap as on a terminal. Scrolling moves the display start line,
+ * so a new line sends one page (about 130 bytes) instead of the whole
+ * screen.
+ *
+ * With the render task (init_display_render_task()) lines printed in a
+ * burst are sent together, at most @ref TKJHAT_DISPLAY_MAX_FPS times per
+ * second; without it every call updates the panel unless called inside a
+ * frame.
+ *
+ * @param text Null-terminated C string. Ignored if @c NULL.
+ *
+ * @note Do not use the other drawing functions while the console is open;
+ *       call display_console_close() first.
+ */
+void display_console_print(const char *text);
+
+/**
+ * @brief Close the console opened by display_console_print().
+ *
+ * The text stays on screen and the other drawing functions can be used
+ * again (the next update sends the whole screen once).
+ */
+void display_console_close(void);
+
 /**
  * @brief Set the text cursor for subsequent text rendering.
  *
@@ -891,7 +1178,7 @@ void set_text_cursor (int16_t x0, int16_t y0);
  * @param r    Radius in pixels (>= 0).
  * @param fill If @c true, draws a filled disk; otherwise, only the outline.
  *
- * @post Calls @c ssd1306_show() once at the end.
+ * @note Updates the panel unless called inside a frame.
  */
 void draw_circle(int16_t x0, int16_t y0, int16_t r, bool fill);
 
@@ -905,7 +1192,7 @@ void draw_circle(int16_t x0, int16_t y0, int16_t r, bool fill);
  * @param x1 End X.
  * @param y1 End Y.
  *
- * @note Calls @c ssd1306_show() internally.
+ * @note Updates the panel unless called inside a frame.
  */
 void draw_line(int16_t x0, int16_t y0, int16_t x1, int16_t y1);
 
@@ -921,14 +1208,15 @@ void draw_line(int16_t x0, int16_t y0, int16_t x1, int16_t y1);
  * @param h  Height in pixels.
  * @param fill If @c true, filled rectangle; otherwise, outline only.
  *
- * @note Calls @c ssd1306_show() internally.
+ * @note Updates the panel unless called inside a frame.
  */
 void draw_square(uint32_t x, uint32_t y, uint32_t w, uint32_t h, bool fill);
 
 /**
  * @brief Clear the display.
  *
- * Clears the off-screen buffer and updates the panel (screen goes blank).
+ * Clears the off-screen buffer and updates the panel (screen goes blank),
+ * unless called inside a frame.
  */
 void clear_display(void);
 
@@ -952,11 +1240,13 @@ void stop_display(void);
  *     init_hat_sdk();      // Initialize I2C (SDA=@ref DEFAULT_I2C_SDA_PIN, SCL=@ref DEFAULT_I2C_SCL_PIN)
  *     init_display();          // Initialize SSD1306 (@ref SSD1306_I2C_ADDRESS — 0x3C)
  *
+ *     display_begin_frame();   // Send the whole screen at once
  *     clear_display();         // Start clean
  *     write_text_xy(10, 20, "Hello!"); // Write text
  *
  *     draw_circle(64, 32, 10, false);  // Draw circle outline
  *     draw_square(0, 0, 20, 20, true); // Draw filled rectangle
+ *     display_end_frame();
  *
  *     while (true) { tight_loop_contents(); }
  * }
@@ -1277,6 +1567,101 @@ int ICM42670_startGyro(uint16_t odr_hz, uint16_t fsr_dps);
  */
 int ICM42670_enable_accel_gyro_ln_mode(void);
 
+/**
+ * @brief Accelerometer in low-power (LP) mode, gyroscope off.
+ *
+ * Lowest current with motion sensing; used by the wake-on-motion mode
+ * (::ICM42670_wom_start) while the board is still.
+ *
+ * @return 0 on success, negative value on error.
+ */
+int ICM42670_enable_ultra_low_power_mode(void);
+
+/**
+ * @brief Accelerometer and gyroscope in low-power (LP) mode.
+ *
+ * @return 0 on success, negative value on error.
+ */
+int ICM42670_enable_accel_gyro_lp_mode(void);
+
+/**
+ * @brief UI low-pass filter bandwidth (GYRO_CONFIG1 / ACCEL_CONFIG1 [2:0]).
+ *
+ * The on-chip filter runs in low-noise mode. Pick a bandwidth below ODR/2
+ * and the sensor does the anti-alias filtering instead of the MCU.
+ */
+typedef enum {
+    ICM42670_BW_BYPASS = 0,     /**< Filter off. */
+    ICM42670_BW_180HZ,          /**< 180 Hz (reset value). */
+    ICM42670_BW_121HZ,          /**< 121 Hz. */
+    ICM42670_BW_73HZ,           /**< 73 Hz. */
+    ICM42670_BW_53HZ,           /**< 53 Hz. */
+    ICM42670_BW_34HZ,           /**< 34 Hz. */
+    ICM42670_BW_25HZ,           /**< 25 Hz. */
+    ICM42670_BW_16HZ,           /**< 16 Hz. */
+} ICM42670_bw_t;
+
+/**
+ * @brief Accelerometer averaging in low-power mode (ACCEL_CONFIG1 [6:4]).
+ *
+ * The gyroscope of the ICM-42670 has no averaging setting.
+ */
+typedef enum {
+    ICM42670_AVG_2X = 0,        /**< 2 samples. */
+    ICM42670_AVG_4X,            /**< 4 samples. */
+    ICM42670_AVG_8X,            /**< 8 samples. */
+    ICM42670_AVG_16X,           /**< 16 samples. */
+    ICM42670_AVG_32X,           /**< 32 samples (reset value). */
+    ICM42670_AVG_64X,           /**< 64 samples. */
+} ICM42670_avg_t;
+
+/**
+ * @brief Complete sensor configuration, applied by ::ICM42670_configure.
+ */
+typedef struct {
+    uint16_t accel_odr_hz;      /**< 25, 50, 100, 200, 400, 800, 1600. */
+    uint16_t accel_fsr_g;       /**< 2, 4, 8, 16. */
+    ICM42670_bw_t accel_bw;     /**< UI filter (LN mode). */
+    ICM42670_avg_t accel_avg;   /**< Averaging (LP mode). */
+    uint16_t gyro_odr_hz;       /**< 25, 50, 100, 200, 400, 800, 1600. */
+    uint16_t gyro_fsr_dps;      /**< 250, 500, 1000, 2000. */
+    ICM42670_bw_t gyro_bw;      /**< UI filter (LN mode). */
+} ICM42670_config_t;
+
+/** SDK defaults: the values of ::ICM42670_start_with_default_values and the chip's filter reset values. */
+#define ICM42670_CONFIG_DEFAULT {                                           \
+    .accel_odr_hz = ICM42670_ACCEL_ODR_DEFAULT,                             \
+    .accel_fsr_g  = ICM42670_ACCEL_FSR_DEFAULT,                             \
+    .accel_bw     = ICM42670_BW_180HZ,                                      \
+    .accel_avg    = ICM42670_AVG_32X,                                       \
+    .gyro_odr_hz  = ICM42670_GYRO_ODR_DEFAULT,                              \
+    .gyro_fsr_dps = ICM42670_GYRO_FSR_DEFAULT,                              \
+    .gyro_bw      = ICM42670_BW_180HZ,                                      \
+}
+
+/**
+ * @brief Apply ODR, full scale, filter bandwidth and averaging of both sensors.
+ *
+ * All values are checked before anything is written. The five configuration
+ * registers (GYRO_CONFIG0 to ACCEL_CONFIG1) are consecutive and are sent as
+ * one burst write; registers that already hold the value are not
+ * rewritten. The power mode is not changed.
+ *
+ * @code{.c}
+ * ICM42670_config_t cfg = ICM42670_CONFIG_DEFAULT;
+ * cfg.accel_odr_hz = 200;
+ * cfg.accel_bw = ICM42670_BW_53HZ;    // anti-aliasing done by the sensor
+ * cfg.gyro_odr_hz = 200;
+ * cfg.gyro_bw = ICM42670_BW_53HZ;
+ * ICM42670_configure(&cfg);
+ * ICM42670_enable_accel_gyro_ln_mode();
+ * @endcode
+ *
+ * @return 0 on success, -1 invalid full scale, -2 invalid ODR, -3 I2C error,
+ *         -4 invalid bandwidth or averaging.
+ */
+int ICM42670_configure(const ICM42670_config_t *cfg);
+
 /**
  * @brief Start IMU with SDK default settings and enable LN mode.
  *
@@ -1302,6 +1687,10 @@ int ICM42670_start_with_default_values(void);
  * - Angular rate (@p gx, @p gy, @p gz) in **degrees/second (dps)**.
  * - Temperature (@p t) in **°C**.
  *
+ * Wrapper over ::ICM42670_read_raw. On the RP2040 every float operation is
+ * done in software; for high sample rates use the raw API and
+ * @ref ICM42670_convert_q16.
+ *
  * @param ax Pointer to store accel X (g).
  * @param ay Pointer to store accel Y (g).
  * @param az Pointer to store accel Z (g).
@@ -1316,6 +1705,365 @@ int ICM42670_read_sensor_data(float *ax, float *ay, float *az,
                               float *gx, float *gy, float *gz,
                               float *t);
 
+/**
+ * @brief Read one sample as raw sensor counts (no floating point).
+ *
+ * Convert with @ref ICM42670_convert_q16 and the factors from
+ * @ref ICM42670_get_scale, preferably in batches.
+ *
+ * @param raw Destination.
+ *
+ * @return 0 on success, negative value on error.
+ */
+int ICM42670_read_raw(ICM42670_raw_t *raw);
+
+/**
+ * @brief Conversion factors for the ranges set by ::ICM42670_startAccel and ::ICM42670_startGyro.
+ */
+const ICM42670_scale_t *ICM42670_get_scale(void);
+
+/**
+ * @brief One sample read from the IMU FIFO.
+ */
+typedef struct {
+    float ax, ay, az;       /**< Acceleration in g. */
+    float gx, gy, gz;       /**< Angular rate in dps. */
+    float t;                /**< Temperature in °C (0.5 °C resolution in the FIFO). */
+    uint16_t timestamp;     /**< Sensor time stamp in µs (16 bits, wraps every 65.5 ms). FIFO only. */
+    uint64_t time_us;       /**< Sample time on the time_us_64() clock, from the INT1 edge (see ::ICM42670_fifo_read). */
+} ICM42670_sample_t;
+
+/**
+ * @brief Stream accel + gyro samples through the IMU FIFO.
+ *
+ * The sensor stores one packet per ODR period and pulls @ref ICM42670_INT
+ * (INT1, active-low) low once @p watermark packets are waiting. A task then
+ * sleeps in @ref ICM42670_wait_interrupt and fetches the whole batch with
+ * @ref ICM42670_fifo_read, so 800-1600 Hz ODR costs one wake-up and one I2C
+ * burst every @p watermark samples instead of one per sample.
+ *
+ * @code{.c}
+ * ICM42670_sample_t batch[32];
+ * ICM42670_startAccel(800, 4);
+ * ICM42670_startGyro(800, 250);
+ * ICM42670_enable_accel_gyro_ln_mode();
+ * ICM42670_fifo_start(32);                       // wake up every 40 ms
+ * for (;;) {
+ *     if (!ICM42670_wait_interrupt(100)) continue;
+ *     int n = ICM42670_fifo_read(batch, 32);
+ *     for (int i = 0; i < n; i++) process(&batch[i]);
+ * }
+ * @endcode
+ *
+ * @param watermark Packets per interrupt (1..@ref ICM42670_FIFO_MAX_PACKETS).
+ *
+ * @return 0 on success, -1 invalid watermark, -2 interrupt pin setup failed,
+ *         -3 I2C error.
+ *
+ * @pre Configure and enable the sensors first (e.g. ::ICM42670_start_with_default_values()):
+ *      the MREG1 bank used for the FIFO setup needs the sensor clock running.
+ */
+int ICM42670_fifo_start(uint16_t watermark);
+
+/**
+ * @brief Stop FIFO streaming, disable the watermark interrupt and flush the FIFO.
+ *
+ * @return 0 on success, negative value on error.
+ */
+int ICM42670_fifo_stop(void);
+
+/**
+ * @brief Number of packets waiting in the FIFO.
+ *
+ * @return Packet count, or a negative value on error.
+ */
+int ICM42670_fifo_count(void);
+
+/**
+ * @brief Read and decode the packets waiting in the FIFO.
+ *
+ * Reads the FIFO count, then up to @p max packets in a single I2C burst.
+ * Packets the sensor marks as invalid (e.g. right after a sensor is
+ * enabled) are dropped.
+ *
+ * The packet that crossed the watermark gets the time of the INT1 edge
+ * (see @ref ICM42670_wait_interrupt). The others are placed from it by
+ * adding up the 16-bit sensor time stamp differences between neighbouring
+ * packets, so batches may span more than the 65.5 ms wrap. When @p max
+ * stops the read before that packet, the next read carries on from the
+ * newest packet returned, and the edge is matched once its packet is read.
+ *
+ * @param samples Destination array (also used as the raw read buffer).
+ * @param max     Capacity of @p samples.
+ *
+ * @return Number of samples stored, or a negative value on error.
+ */
+int ICM42670_fifo_read(ICM42670_sample_t *samples, size_t max);
+
+/**
+ * @brief Deliver every new sample through the INT1 data-ready interrupt.
+ *
+ * Instead of polling with a delay, which drifts against the sensor ODR and
+ * returns duplicated or skipped samples, the task calls
+ * @ref ICM42670_read_sample: it sleeps until INT1 signals a new sample, then
+ * reads it. The time of the INT1 edge is captured in the interrupt with
+ * @c time_us_64() and returned with the sample.
+ *
+ * @code{.c}
+ * ICM42670_sample_t s;
+ * ICM42670_start_with_default_values();
+ * ICM42670_drdy_start();
+ * for (;;) {
+ *     if (ICM42670_read_sample(&s, 100) == 0)
+ *         printf("%llu %f %f %f\n", s.time_us, s.ax, s.ay, s.az);
+ * }
+ * @endcode
+ *
+ * Samples the task was too slow to read are counted by
+ * @ref ICM42670_drdy_missed.
+ *
+ * @return 0 on success, -2 interrupt pin setup failed, -3 I2C error.
+ */
+int ICM42670_drdy_start(void);
+
+/**
+ * @brief Disable the data-ready interrupt.
+ *
+ * @return 0 on success, negative value on error.
+ */
+int ICM42670_drdy_stop(void);
+
+/**
+ * @brief Wait for the next data-ready interrupt and read that sample.
+ *
+ * @param s          Destination; @c time_us is the INT1 edge time.
+ * @param timeout_ms Maximum wait in milliseconds.
+ *
+ * @return 0 on success, -1 timeout, -2 I2C error.
+ *
+ * @pre ::ICM42670_drdy_start().
+ */
+int ICM42670_read_sample(ICM42670_sample_t *s, uint32_t timeout_ms);
+
+/**
+ * @brief Data-ready interrupts that were not followed by a read (samples lost).
+ */
+uint32_t ICM42670_drdy_missed(void);
+
+/** @name APEX events
+ *  Bits of ::ICM42670_apex_start features and of ICM42670_apex_event_t::events.
+ *  @{ */
+#define ICM42670_APEX_STEP                      0x01   /**< Pedometer: a step was detected. */
+#define ICM42670_APEX_STEP_OVERFLOW             0x02   /**< Pedometer: the 16-bit step count wrapped (event only). */
+#define ICM42670_APEX_TILT                      0x04   /**< The board was tilted by more than 35° and held for a few seconds. */
+#define ICM42670_APEX_FREEFALL                  0x08   /**< Free fall. */
+#define ICM42670_APEX_SMD                       0x10   /**< Significant motion (sustained movement such as walking). */
+/** @} */
+
+/**
+ * @brief What the APEX engine reported with one INT1 interrupt.
+ */
+typedef struct {
+    uint8_t events;         /**< @ref ICM42670_APEX_STEP ... bits. */
+    uint16_t steps;         /**< Step count since ::ICM42670_apex_start (pedometer enabled). */
+    uint8_t cadence;        /**< Samples between the last two steps, in 1/4 of the 50 Hz DMP period. */
+    uint8_t activity;       /**< 0 unknown, 1 walking, 2 running. */
+    uint64_t time_us;       /**< Time of the INT1 edge. */
+} ICM42670_apex_event_t;
+
+/**
+ * @brief Run motion detection on the IMU's APEX engine and deliver events through INT1.
+ *
+ * The on-chip DMP analyses the accelerometer at 50 Hz and raises INT1 only
+ * when something happens, so the application does not stream data: a task
+ * sleeps in ::ICM42670_apex_wait and the MCU does nothing in between. For
+ * the lowest current run only the accelerometer, in low-power mode:
+ *
+ * @code{.c}
+ * ICM42670_apex_event_t ev;
+ * ICM42670_startAccel(50, 4);
+ * ICM42670_enable_ultra_low_power_mode();          // accel LP, gyro off
+ * ICM42670_apex_start(ICM42670_APEX_STEP | ICM42670_APEX_TILT);
+ * for (;;) {
+ *     if (ICM42670_apex_wait(&ev, 60000) > 0 && (ev.events & ICM42670_APEX_STEP))
+ *         printf("steps: %u\n", ev.steps);
+ * }
+ * @endcode
+ *
+ * The ICM-42670-P has no tap detector. Significant motion uses the
+ * wake-on-motion comparators, which are enabled with a default threshold.
+ *
+ * @param features @ref ICM42670_APEX_STEP, @ref ICM42670_APEX_TILT,
+ *                 @ref ICM42670_APEX_FREEFALL and/or @ref ICM42670_APEX_SMD.
+ *
+ * @return 0 on success, -1 accel not started at 50 Hz or more,
+ *         -2 interrupt pin setup failed, -3 I2C error, -4 DMP did not initialize.
+ */
+int ICM42670_apex_start(uint8_t features);
+
+/**
+ * @brief Disable the APEX features and their interrupts.
+ *
+ * @return 0 on success, negative value on error.
+ */
+int ICM42670_apex_stop(void);
+
+/**
+ * @brief Wait for the next APEX interrupt.
+ *
+ * @param ev         Filled with the events and pedometer data.
+ * @param timeout_ms Maximum wait in milliseconds.
+ *
+ * @return 1 if an event was received, 0 on timeout, negative value on I2C error.
+ */
+int ICM42670_apex_wait(ICM42670_apex_event_t *ev, uint32_t timeout_ms);
+
+/**
+ * @brief States of the wake-on-motion mode.
+ */
+typedef enum {
+    ICM42670_WOM_OFF = 0,   /**< Mode not running. */
+    ICM42670_WOM_IDLE,      /**< Accel in LP mode at the idle ODR, gyro off, waiting for motion. */
+    ICM42670_WOM_ACTIVE,    /**< Accel + gyro in LN mode at the active ODR. */
+} ICM42670_wom_state_t;
+
+/**
+ * @brief Wake-on-motion mode settings.
+ */
+typedef struct {
+    uint16_t threshold_mg;  /**< Change between two accel samples that counts as motion (4-996 mg). */
+    uint16_t idle_odr_hz;   /**< Accel ODR while idle (e.g. 25). */
+    uint16_t active_odr_hz; /**< Accel and gyro ODR while active (e.g. 100). */
+    uint16_t accel_fsr_g;   /**< Accel full scale (2, 4, 8, 16). */
+    uint16_t gyro_fsr_dps;  /**< Gyro full scale (250, 500, 1000, 2000). */
+    uint32_t quiet_ms;      /**< Back to idle after this long without motion. */
+} ICM42670_wom_config_t;
+
+/**
+ * @brief Transitions and time spent in each state.
+ */
+typedef struct {
+    ICM42670_wom_state_t state; /**< Current state. */
+    uint32_t wakeups;           /**< IDLE to ACTIVE transitions. */
+    uint32_t sleeps;            /**< ACTIVE to IDLE transitions. */
+    uint64_t idle_us;           /**< Total time idle. */
+    uint64_t active_us;         /**< Total time active. */
+    uint64_t last_change_us;    /**< Time of the last transition. */
+} ICM42670_wom_stats_t;
+
+/**
+ * @brief Start the managed low-power mode: sleep in accel LP until motion, then sample in LN.
+ *
+ * The IMU starts idle: accelerometer in LP mode at @c idle_odr_hz, gyro off
+ * (::ICM42670_enable_ultra_low_power_mode) and the wake-on-motion
+ * comparators on INT1. The firmware task calls ::ICM42670_wom_update in its
+ * loop:
+ *
+ * @code{.c}
+ * const ICM42670_wom_config_t cfg = {
+ *     .threshold_mg = 50, .idle_odr_hz = 25, .active_odr_hz = 100,
+ *     .accel_fsr_g = 4, .gyro_fsr_dps = 250, .quiet_ms = 5000,
+ * };
+ * ICM42670_wom_start(&cfg);
+ * for (;;) {
+ *     if (ICM42670_wom_update(portMAX_DELAY) == ICM42670_WOM_ACTIVE) {
+ *         ICM42670_read_sensor_data(&ax, &ay, &az, &gx, &gy, &gz, &t);
+ *         ...
+ *         vTaskDelay(pdMS_TO_TICKS(10));
+ *     }
+ * }
+ * @endcode
+ *
+ * @return 0 on success, -1 invalid configuration, -2 interrupt pin setup
+ *         failed, -3 I2C error.
+ */
+int ICM42670_wom_start(const ICM42670_wom_config_t *cfg);
+
+/**
+ * @brief Advance the wake-on-motion mode.
+ *
+ * - Idle: blocks until motion or @p timeout_ms. On motion the accel and gyro
+ *   switch to LN mode at the active ODR and the state becomes ACTIVE (the
+ *   gyro needs about 45 ms before its data is valid).
+ * - Active: does not block. Reads the motion status (one short I2C read) and
+ *   returns to idle once no motion was seen for @c quiet_ms.
+ *
+ * @return The state after the call (@ref ICM42670_WOM_OFF if not started),
+ *         or a negative value on I2C error.
+ */
+int ICM42670_wom_update(uint32_t timeout_ms);
+
+/**
+ * @brief Stop the mode: wake-on-motion interrupt off, sensors left as they are.
+ *
+ * @return 0 on success, negative value on error.
+ */
+int ICM42670_wom_stop(void);
+
+/**
+ * @brief Copy the transition counters and state times (current state included).
+ */
+void ICM42670_wom_get_stats(ICM42670_wom_stats_t *stats);
+
+/**
+ * @brief Bias corrections in the units of the IMU offset registers.
+ *
+ * Persist the values returned by ::ICM42670_calibrate and restore them with
+ * ::ICM42670_set_offsets after every ::init_ICM42670 (the soft reset clears them).
+ */
+typedef struct {
+    int16_t accel[3];       /**< Accel X/Y/Z, @ref ICM42670_ACCEL_OFFSET_PER_G per g. */
+    int16_t gyro[3];        /**< Gyro X/Y/Z, @ref ICM42670_GYRO_OFFSET_PER_DPS per dps. */
+} ICM42670_offsets_t;
+
+/**
+ * @brief Measure the accel and gyro biases and correct them in the sensor.
+ *
+ * Clears the user offsets, reads @p samples samples at the accelerometer
+ * ODR while the board lies still, and computes mean and standard deviation
+ * of every axis with a running (Welford) update. The axis with the largest
+ * acceleration is taken as vertical and expected to read exactly ±1 g.
+ * The negated biases are written to the offset registers, so every later
+ * read (registers, FIFO, interrupts) is corrected by the sensor itself at no
+ * cost for the MCU.
+ *
+ * @param samples Samples to average (e.g. 200: 2 s at 100 Hz).
+ * @param offsets Receives the values written, to be persisted.
+ *
+ * @return 0 on success, -1 invalid argument or sensors not started,
+ *         -2 I2C error, -3 the board moved during the measurement
+ *         (offsets left at zero).
+ *
+ * @pre Sensors running (e.g. ::ICM42670_start_with_default_values()).
+ */
+int ICM42670_calibrate(uint16_t samples, ICM42670_offsets_t *offsets);
+
+/**
+ * @brief Write previously computed offsets (e.g. restored from flash at boot).
+ *
+ * @return 0 on success, negative value on error.
+ *
+ * @pre Sensors running: the offset registers are in the MREG1 bank.
+ */
+int ICM42670_set_offsets(const ICM42670_offsets_t *offsets);
+
+/**
+ * @brief Read back the offsets currently applied by the IMU.
+ *
+ * @return 0 on success, negative value on error.
+ */
+int ICM42670_get_offsets(ICM42670_offsets_t *offsets);
+
+/**
+ * @brief Block the calling task until the IMU raises INT1.
+ *
+ * @param timeout_ms Maximum wait in milliseconds.
+ *
+ * @return true if the interrupt fired, false on timeout or if no IMU
+ *         interrupt mode has been started.
+ */
+bool ICM42670_wait_interrupt(uint32_t timeout_ms);
+
 /** @} */ // end of group ICM42670
 
 
@@ -31,8 +31,11 @@ SOFTWARE.
 #ifndef _inc_ssd1306
 #define _inc_ssd1306
 #include <pico/stdlib.h>
+#include <pico/sync.h>
 #include <hardware/i2c.h>
 
+#include "raster.h"
+
 /**
 *	@brief defines commands used in ssd1306
 */
@@ -56,8 +59,42 @@ typedef enum {
     SET_CHARGE_PUMP = 0x8D
 } ssd1306_command_t;
 
+#define SSD1306_MAX_PAGES 8 /**< pages of the tallest supported display (64 rows) */
+#define SSD1306_CMDLIST_MAX 32 /**< command bytes sent in one transaction by ssd1306_cmdlist_t */
+
+/**
+*	@brief state of the front buffer (ssd1306_t::flush_state)
+*/
+enum {
+    SSD1306_FLUSH_IDLE,		/**< sent; the next swap may take it */
+    SSD1306_FLUSH_PENDING,	/**< swapped in, not being sent yet */
+    SSD1306_FLUSH_SENDING	/**< a ssd1306_flush() is sending it */
+};
+/**
+*	@brief largest data run sent in the same transaction as its address window
+*
+*	The shared transaction needs Co=1 control bytes, 4 bytes more than a
+*	separate command transaction. That pays off only if starting a
+*	transaction costs more than ~90 us (4 bytes at 400 kHz), so it is off
+*	by default; 16 matches the bus manager chunk size.
+*/
+#ifndef SSD1306_INLINE_DATA_MAX
+#define SSD1306_INLINE_DATA_MAX 0
+#endif
+
 /**
 *	@brief holds the configuration
+*
+*	The drawing functions record, per page, the columns they changed
+*	(dirty span) and the columns that may hold set pixels (ink span).
+*	ssd1306_show() sends only the dirty spans; ssd1306_clear() turns the
+*	ink spans into dirty ones, so clearing an empty area costs nothing.
+*
+*	There are two buffers: drawing goes to buffer (back), the display is
+*	sent from front. ssd1306_swap() exchanges them and ssd1306_flush() sends
+*	front, so one task can draw the next frame while another one flushes.
+*	flush_state says who owns front; it changes under lock, so the drawing
+*	task and the flushing task may run on different cores.
 */
 typedef struct {
     uint8_t width; 		/**< width of display */
@@ -68,8 +105,74 @@ typedef struct {
     bool external_vcc; 	/**< whether display uses external vcc */ 
     uint8_t *buffer;	/**< display buffer */
     size_t bufsize;		/**< buffer size */
+    uint8_t dirty_lo[SSD1306_MAX_PAGES];	/**< first changed column per page (> dirty_hi: nothing to send) */
+    uint8_t dirty_hi[SSD1306_MAX_PAGES];	/**< last changed column per page */
+    uint8_t ink_lo[SSD1306_MAX_PAGES];	/**< first column per page that may hold set pixels */
+    uint8_t ink_hi[SSD1306_MAX_PAGES];	/**< last column per page that may hold set pixels */
+    uint32_t tx_bytes;	/**< bytes sent to the display by ssd1306_show (control bytes included) */
+    uint32_t tx_saved;	/**< bytes ssd1306_show did not send, compared with sending the whole buffer every time */
+    uint8_t *front;		/**< buffer being sent; only touched by ssd1306_flush */
+    uint8_t send_lo[SSD1306_MAX_PAGES];	/**< first column per page of front still to send */
+    uint8_t send_hi[SSD1306_MAX_PAGES];	/**< last column per page of front still to send */
+    volatile uint8_t flush_state;	/**< SSD1306_FLUSH_IDLE, _PENDING or _SENDING; changed under lock */
+    critical_section_t lock;	/**< guards flush_state */
+    uint32_t flush_us;	/**< duration of the last flush */
+    uint32_t frame_us;	/**< time between the last two swaps (frame period) */
+    uint64_t last_swap_us;	/**< time of the last swap */
+    uint8_t win[4];		/**< column start/end and page start/end last set; win[0] > win[1]: unknown */
+    raster_glyph_cache_t glyphs;	/**< scaled glyphs of the text functions */
+    uint8_t start_line;	/**< display start line for the back buffer: buffer row shown at the top */
+    uint8_t start_front;	/**< start line of the front buffer */
+    uint8_t start_sent;	/**< start line last sent to the display */
 } ssd1306_t;
 
+/**
+*	@brief command list: several commands sent after one control byte
+*
+*	Fill with ssd1306_cmdlist_add() and send with ssd1306_cmdlist_send();
+*	the list is sent early if it would overflow. A command and its
+*	arguments are always kept in the same transaction. The driver sends
+*	its own commands (power-up sequence, address window, contrast...)
+*	the same way.
+*/
+typedef struct {
+    ssd1306_t *p;		/**< display the list is sent to */
+    uint8_t len;		/**< bytes in buf, control byte included */
+    uint8_t buf[1+SSD1306_CMDLIST_MAX];	/**< 0x00 control byte, then the commands */
+} ssd1306_cmdlist_t;
+
+#ifndef SSD1306_CONSOLE_MIN_US
+#define SSD1306_CONSOLE_MIN_US 50000 /**< default time between two console updates (20 per second) */
+#endif
+
+/**
+*	@brief text console: lines of the builtin font that scroll up
+*
+*	Each text line is one page of the buffer. The pages are used as a ring:
+*	on a new line at the bottom, the oldest page is cleared for it and the
+*	display start line moves down by 8 rows, so the panel shows the ring
+*	from its oldest line without the buffer being moved. A newline then
+*	costs the start line command (sent with the window commands) and the
+*	bytes of one page.
+*
+*	Text goes into the buffer only; ssd1306_console_update() sends it at
+*	most once per min_us, so a burst of lines is sent as one update.
+*	While the console is open the buffer rows are rotated: draw on the
+*	display with the other functions only after ssd1306_console_close().
+*/
+typedef struct {
+    ssd1306_t *p;		/**< display of the console */
+    uint8_t rows;		/**< text lines (one per page) */
+    uint8_t cols;		/**< characters per line */
+    uint8_t top;		/**< page shown as the top line */
+    uint8_t row;		/**< cursor line, 0 is the top line */
+    uint8_t col;		/**< cursor column */
+    bool newline;		/**< '\n' received: the next character starts a new line */
+    bool pending;		/**< text drawn but not sent yet */
+    uint32_t min_us;	/**< minimum time between two updates */
+    uint64_t last_us;	/**< time of the last update */
+} ssd1306_console_t;
+
 /**
 *	@brief initialize display
 *
@@ -85,6 +188,40 @@ typedef struct {
 */
 bool ssd1306_init(ssd1306_t *p, uint16_t width, uint16_t height, uint8_t address, i2c_inst_t *i2c_instance);
 
+/**
+*	@brief start an empty command list
+*
+*	@param[out] l : command list
+*	@param[in] p : instance of display
+*/
+void ssd1306_cmdlist_begin(ssd1306_cmdlist_t *l, ssd1306_t *p);
+
+/**
+*	@brief append one command
+*
+*	@param[in] l : command list
+*	@param[in] cmd : command byte followed by its arguments (or several
+*	commands that must stay in one transaction)
+*	@param[in] len : bytes in cmd (at most SSD1306_CMDLIST_MAX)
+*
+*	@return false if len is over SSD1306_CMDLIST_MAX, or the list was
+*	full and could not be sent (see ssd1306_cmdlist_send()); nothing added
+*/
+bool ssd1306_cmdlist_add(ssd1306_cmdlist_t *l, const uint8_t *cmd, size_t len);
+
+/**
+*	@brief send the commands in one transaction and empty the list
+*
+*	The next flush sets the address window and start line again, so the
+*	commands may change them. Not sent while a frame is swapped in or
+*	being flushed (flush_state not SSD1306_FLUSH_IDLE); the list is kept.
+*
+*	@param[in] l : command list
+*
+*	@return true if the list was sent
+*/
+bool ssd1306_cmdlist_send(ssd1306_cmdlist_t *l);
+
 /**
 *	@brief deinitialize display
 *
@@ -128,12 +265,86 @@ void ssd1306_contrast(ssd1306_t *p, uint8_t val);
 void ssd1306_invert(ssd1306_t *p, uint8_t inv);
 
 /**
-	@brief display buffer, should be called on change
+	@brief send the changed parts of the buffer, should be called on change
+
+	Same as ssd1306_swap() followed by ssd1306_flush(). If another task is
+	still flushing the previous frame, nothing is done and false is
+	returned; the changes stay in the buffer for the next call.
+
+	Each run of dirty pages is sent as one rectangle: one command
+	transaction sets the column and page window, then the data follows
+	(one transaction if the rectangle is as wide as the display, else one
+	per page). The window is skipped if it is the one already set (or
+	covers the rectangle with fewer than 8 extra bytes), and a single page
+	of up to SSD1306_INLINE_DATA_MAX bytes shares one transaction with its
+	window. Neighbouring pages are merged into one
+	rectangle when that needs fewer bytes on the bus. Nothing is sent if
+	nothing changed.
+
+	@param[in] p : instance of display
+
+	@return false if a flush by another task is still running
+*/
+bool ssd1306_show(ssd1306_t *p);
+
+/**
+	@brief make the drawn frame the one to send
+
+	Exchanges the buffers and copies the changed spans into the new back
+	buffer, so drawing continues on top of the frame just finished. Fast
+	(a few hundred bytes copied at most); no I2C traffic.
+
+	@param[in] p : instance of display
+
+	@return false if the previous flush has not finished (nothing done)
+*/
+bool ssd1306_swap(ssd1306_t *p);
+
+/**
+	@brief send the front buffer swapped in by ssd1306_swap()
+
+	Blocks while the bytes are on the bus. p->buffer may be drawn into
+	meanwhile from another task; p->flush_us holds the duration afterwards.
+	Only one caller sends a swapped frame: a second, concurrent call
+	returns at once.
+
+	@param[in] p : instance of display
+
+	@return false if there was no swapped frame waiting (nothing sent)
+*/
+bool ssd1306_flush(ssd1306_t *p);
+
+/**
+	@brief check whether the last swapped frame has been sent
+
+	@param[in] p : instance of display
+
+	@return true if no flush is pending
+*/
+bool ssd1306_flush_done(const ssd1306_t *p);
+
+/**
+	@brief set the display start line (the buffer row shown at the top)
+
+	Sent by the next ssd1306_show() or ssd1306_flush(), in the same
+	transaction as the first address window, before the data.
+
+	@param[in] p : instance of display
+	@param[in] line : 0 to 63
+
+*/
+void ssd1306_set_start_line(ssd1306_t *p, uint8_t line);
+
+/**
+	@brief mark the whole display as changed
+
+	Call after writing p->buffer directly, or when the display RAM may not
+	match the buffer (e.g. after a reset of the panel).
 
 	@param[in] p : instance of display
 
 */
-void ssd1306_show(ssd1306_t *p);
+void ssd1306_invalidate(ssd1306_t *p);
 
 /**
 	@brief clear display buffer
@@ -161,6 +372,17 @@ void ssd1306_clear_pixel(ssd1306_t *p, uint32_t x, uint32_t y);
 */
 void ssd1306_draw_pixel(ssd1306_t *p, uint32_t x, uint32_t y);
 
+/**
+	@brief raster core view of the back buffer, for the raster_* functions
+
+	The view is valid until the next ssd1306_swap() (or ssd1306_show()).
+
+	@param[in] p : instance of display
+
+	@return view with the display's change tracking
+*/
+raster_t ssd1306_raster(ssd1306_t *p);
+
 /**
 	@brief draw line on buffer
 
@@ -271,4 +493,79 @@ void ssd1306_draw_string_with_font(ssd1306_t *p, uint32_t x, uint32_t y, uint32_
 */
 void ssd1306_draw_string(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t scale, const char *s);
 
+/**
+	@brief start a text console on the display
+
+	Clears the buffer and sets the start line to 0. Lines are 8 rows of
+	font_8x5, 21 characters on a 128 pixel wide display.
+
+	@param[in] c : console to initialize
+	@param[in] p : instance of display, 64 rows high (the start line wraps
+	               at 64 rows, so lower displays are not supported)
+	@param[in] min_us : minimum time between two updates, 0 for SSD1306_CONSOLE_MIN_US
+
+	@return false if the display height is not 64
+*/
+bool ssd1306_console_init(ssd1306_console_t *c, ssd1306_t *p, uint32_t min_us);
+
+/**
+	@brief write one character at the cursor
+
+	'\n' starts a new line (when the next character arrives, so the last
+	line is not left empty), '\r' goes back to the start of the line and
+	'\t' to the next multiple of 4 columns. Full lines wrap. Other control
+	characters are ignored. No I2C traffic.
+
+	@param[in] c : console
+	@param[in] ch : character
+*/
+void ssd1306_console_putc(ssd1306_console_t *c, char ch);
+
+/**
+	@brief write a string at the cursor, as ssd1306_console_putc()
+
+	@param[in] c : console
+	@param[in] s : text
+*/
+void ssd1306_console_print(ssd1306_console_t *c, const char *s);
+
+/**
+	@brief send the new text if there is any and min_us has passed since the last update
+
+	Call it after printing and periodically; text that is not sent yet
+	waits for a later call.
+
+	@param[in] c : console
+
+	@return true if the display was updated
+*/
+bool ssd1306_console_update(ssd1306_console_t *c);
+
+/**
+	@brief send the new text now, ignoring min_us
+
+	@param[in] c : console
+
+	@return false if another task was still flushing the display (the
+	text stays pending)
+*/
+bool ssd1306_console_show(ssd1306_console_t *c);
+
+/**
+	@brief clear the console and put the cursor on the top line
+
+	@param[in] c : console
+*/
+void ssd1306_console_clear(ssd1306_console_t *c);
+
+/**
+	@brief end the console: rotate the buffer back so row 0 is the top row
+
+	The screen keeps its content; the start line goes back to 0 with the
+	next ssd1306_show().
+
+	@param[in] c : console
+*/
+void ssd1306_console_close(ssd1306_console_t *c);
+
 #endif
\ No newline at end of file
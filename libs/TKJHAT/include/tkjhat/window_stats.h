@@ -0,0 +1,203 @@
+/*
+Version 0.84
+
+MIT License
+
+Copyright (c) 2025 , Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file tkjhat/window_stats.h
+ * @brief Sliding-window statistics over several sensor channels, O(1) per sample.
+ *
+ * @version 0.84
+ */
+
+#ifndef WINDOW_STATS_H
+#define WINDOW_STATS_H
+
+#include <stdint.h>
+
+#include "imu_fixed.h"
+
+/**
+ * @defgroup window_stats Sliding-window statistics
+ * @brief Mean, variance, standard deviation, RMS, minimum and maximum over the last N samples.
+ *
+ * @details
+ * A window holds the last @c window samples of @c channels channels (e.g.
+ * the seven channels of the IMU, or one for the light sensor). Every
+ * @ref wstats_push adds one sample per channel and drops the oldest one:
+ *
+ * - sum and sum of squares are updated with the new and the old sample
+ *   (64-bit integers, exact, so they never drift);
+ * - minimum and maximum come from monotonic deques, amortized O(1).
+ *
+ * Reading the statistics (@ref wstats_get) is O(1) as well, so the cost
+ * does not depend on the window length. No floating point is used: results
+ * are in the unit of the samples with @ref WSTATS_FRAC_BITS fractional bits.
+ *
+ * Samples are integers: raw sensor counts (@ref ICM42670_raw_t, see
+ * @ref wstats_push_imu), lux, hundredths of a degree, Q16 values up to
+ * ±64. They are clamped to ±@ref WSTATS_SAMPLE_MAX.
+ *
+ * Memory is laid out structure-of-arrays: the ring holds one row of
+ * @c channels samples per time step (a push writes one contiguous row), and
+ * the per-channel sums sit in their own arrays. Declare a window with
+ * @ref WSTATS_DEFINE:
+ *
+ * @code{.c}
+ * WSTATS_DEFINE(imu_win, WSTATS_IMU_CHANNELS, 100);   // last second at 100 Hz
+ *
+ * ICM42670_raw_t raw;
+ * wstats_result_t az;
+ * for (;;) {
+ *     ICM42670_read_raw(&raw);
+ *     wstats_push_imu(&imu_win, &raw);
+ *     wstats_get(&imu_win, WSTATS_IMU_AZ, &az);
+ *     // az.std / 256.0f / aRes = vibration on Z in g
+ *     vTaskDelay(pdMS_TO_TICKS(10));
+ * }
+ * @endcode
+ *
+ * Scalar sensors use one-channel windows:
+ *
+ * @code{.c}
+ * WSTATS_DEFINE(light_win, 1, 60);
+ * int32_t lux = (int32_t)veml6030_read_light();
+ * wstats_push(&light_win, &lux);
+ * @endcode
+ *
+ * @c tools/window_stats_bench.c checks the results against a direct
+ * computation on the PC and compares the cost with an O(window) float loop.
+ * @{
+ */
+
+/** @name Window limits
+ *  Can be overridden with compile definitions.
+ *  @{ */
+#ifndef WSTATS_MAX_WINDOW
+#define WSTATS_MAX_WINDOW                       256    /**< Longest window (keeps the 64-bit sums from overflowing). */
+#endif
+#define WSTATS_SAMPLE_MAX                       4194303 /**< Samples are clamped to ±(2^22 - 1). */
+#define WSTATS_FRAC_BITS                        8      /**< Fractional bits of the results (variance: twice as many). */
+/** @} */
+
+/** @name IMU channels
+ *  Channel order used by @ref wstats_push_imu.
+ *  @{ */
+#define WSTATS_IMU_AX                           0      /**< Accel X. */
+#define WSTATS_IMU_AY                           1      /**< Accel Y. */
+#define WSTATS_IMU_AZ                           2      /**< Accel Z. */
+#define WSTATS_IMU_GX                           3      /**< Gyro X. */
+#define WSTATS_IMU_GY                           4      /**< Gyro Y. */
+#define WSTATS_IMU_GZ                           5      /**< Gyro Z. */
+#define WSTATS_IMU_TEMP                         6      /**< Temperature. */
+#define WSTATS_IMU_CHANNELS                     7      /**< Channels of an IMU window. */
+/** @} */
+
+/**
+ * @brief A multi-channel window. Declare it with @ref WSTATS_DEFINE.
+ */
+typedef struct {
+    uint16_t channels;      /**< Channels per sample. */
+    uint16_t window;        /**< Samples kept. */
+    uint16_t pos;           /**< Ring row the next sample goes to. */
+    uint16_t count;         /**< Samples currently in the window. */
+    int64_t *sum;           /**< [channels] Sum of the samples. */
+    uint64_t *sumsq;        /**< [channels] Sum of the squared samples. */
+    int32_t *ring;          /**< [window][channels] The samples, one row per push. */
+    uint16_t *maxq;         /**< [channels][window] Ring rows of decreasing samples (deque). */
+    uint16_t *minq;         /**< [channels][window] Ring rows of increasing samples (deque). */
+    uint16_t *qstate;       /**< [channels][4] Head and length of both deques. */
+} wstats_t;
+
+/**
+ * @brief Statistics of one channel. Fixed point, @ref WSTATS_FRAC_BITS fractional bits.
+ */
+typedef struct {
+    int32_t mean;           /**< Average. */
+    int32_t min;            /**< Smallest sample. */
+    int32_t max;            /**< Largest sample. */
+    int32_t std;            /**< Standard deviation (population). */
+    int32_t rms;            /**< Root mean square. */
+    uint64_t var;           /**< Variance, 2 x @ref WSTATS_FRAC_BITS fractional bits. */
+    uint16_t count;         /**< Samples the values are computed from. */
+} wstats_result_t;
+
+/**
+ * @brief Define an empty window and its storage.
+ *
+ * @param name     Name of the @ref wstats_t variable.
+ * @param nch      Channels per sample.
+ * @param win      Samples in the window (1 to @ref WSTATS_MAX_WINDOW).
+ */
+#define WSTATS_DEFINE(name, nch, win)                                               \
+    _Static_assert((win) >= 1 && (win) <= WSTATS_MAX_WINDOW, #name ": bad window"); \
+    static int64_t name##_sum[(nch)];                                              \
+    static uint64_t name##_sumsq[(nch)];                                           \
+    static int32_t name##_ring[(win) * (nch)];                                     \
+    static uint16_t name##_maxq[(win) * (nch)];                                    \
+    static uint16_t name##_minq[(win) * (nch)];                                    \
+    static uint16_t name##_qstate[4 * (nch)];                                      \
+    static wstats_t name = {                                                       \
+        .channels = (nch), .window = (win),                                        \
+        .sum = name##_sum, .sumsq = name##_sumsq, .ring = name##_ring,             \
+        .maxq = name##_maxq, .minq = name##_minq, .qstate = name##_qstate,         \
+    }
+
+/**
+ * @brief Empty the window.
+ */
+void wstats_reset(wstats_t *w);
+
+/**
+ * @brief Add one sample for every channel, dropping the oldest once the window is full.
+ *
+ * @param w Window.
+ * @param x @c w->channels values.
+ */
+void wstats_push(wstats_t *w, const int32_t *x);
+
+/**
+ * @brief Add a raw IMU sample (channels @ref WSTATS_IMU_AX to @ref WSTATS_IMU_TEMP).
+ *
+ * The window must have @ref WSTATS_IMU_CHANNELS channels. Results are in
+ * sensor counts: divide by @c aRes / @c gRes (or use the scale of
+ * @ref ICM42670_get_scale) for g and dps.
+ */
+void wstats_push_imu(wstats_t *w, const ICM42670_raw_t *raw);
+
+/**
+ * @brief Statistics of channel @p ch over the samples in the window.
+ *
+ * All fields are 0 while the window is empty.
+ */
+void wstats_get(const wstats_t *w, uint16_t ch, wstats_result_t *r);
+
+/**
+ * @brief Number of samples in the window.
+ */
+static inline uint16_t wstats_count(const wstats_t *w) { return w->count; }
+
+/** @} */ // end of group window_stats
+
+#endif /* WINDOW_STATS_H */
@@ -0,0 +1,164 @@
+/*
+
+Version 0.84
+
+MIT License
+
+Copyright (c) 2025 Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <string.h>
+
+#include <tkjhat/capture.h>
+
+// Ring states. The producer moves FREE -> RECORDING -> READY, the consumer
+// READY -> FREE: each transition has a single writer.
+#define RING_FREE       0
+#define RING_RECORDING  1
+#define RING_READY      2
+
+static inline uint8_t load_state(const capture_t *c, int ring) {
+    return __atomic_load_n(&c->state[ring], __ATOMIC_ACQUIRE);
+}
+
+static inline void store_state(capture_t *c, int ring, uint8_t s) {
+    __atomic_store_n(&c->state[ring], s, __ATOMIC_RELEASE);
+}
+
+int capture_init(capture_t *c, uint16_t pre, uint16_t post) {
+    if (post == 0 || (uint32_t)pre + post > c->capacity) return -1;
+    c->pre = pre;
+    c->post = post;
+    c->active = 0;
+    c->pos = c->filled = c->post_left = c->trig_pre = 0;
+    c->trigger_req = false;
+    c->stats = (capture_stats_t){ 0 };
+    store_state(c, 1, RING_FREE);
+    store_state(c, 0, RING_RECORDING);
+    return 0;
+}
+
+void capture_set_trigger(capture_t *c, capture_trigger_fn fn, void *ctx) {
+    c->trigger_ctx = ctx;
+    c->trigger = fn;
+}
+
+void capture_trigger(capture_t *c) {
+    c->trigger_req = true;
+}
+
+// The last trig_pre + post frames of the active ring form the window
+static void freeze(capture_t *c) {
+    const uint16_t cap = c->capacity;
+    const size_t fs = c->frame_size;
+    const uint16_t frames = c->trig_pre + c->post;
+    const uint16_t end = c->pos;
+    const uint16_t start = end >= frames ? end - frames : end + cap - frames;
+    const uint8_t ring = c->active, other = ring ^ 1;
+    const uint8_t *buf = c->buf[ring];
+
+    c->trigger_req = false;     // requests during the window are ignored
+    if (load_state(c, other) != RING_FREE) {
+        // Consumer still has the previous window: keep recording over this one
+        c->stats.dropped++;
+        return;
+    }
+
+    capture_window_t *w = &c->ready[ring];
+    w->part[0] = buf + start * fs;
+    if ((uint32_t)start + frames <= cap) {
+        w->len[0] = frames * fs;
+        w->part[1] = NULL;
+        w->len[1] = 0;
+    } else {
+        w->len[0] = (size_t)(cap - start) * fs;
+        w->part[1] = buf;
+        w->len[1] = (size_t)end * fs;
+    }
+    w->frames = frames;
+    w->pre_frames = c->trig_pre;
+    w->first_frame = c->stats.frames - frames;
+    w->seq = c->stats.windows++;
+    w->ring = ring;
+    store_state(c, ring, RING_READY);
+
+    store_state(c, other, RING_RECORDING);
+    c->active = other;
+    c->pos = c->filled = 0;
+}
+
+void capture_push(capture_t *c, const void *frame) {
+    memcpy(c->buf[c->active] + (size_t)c->pos * c->frame_size, frame, c->frame_size);
+    c->stats.frames++;
+    if (++c->pos == c->capacity) c->pos = 0;
+    if (c->filled < c->capacity) c->filled++;
+
+    if (c->post_left == 0) {
+        // Armed: does this frame trigger?
+        bool fire = false;
+        if (c->trigger_req) {
+            c->trigger_req = false;
+            fire = true;
+        }
+        if (!fire && c->trigger) fire = c->trigger(frame, c->trigger_ctx);
+        if (!fire) return;
+        c->stats.triggers++;
+        c->trig_pre = c->filled - 1 < c->pre ? c->filled - 1 : c->pre;
+        c->post_left = c->post;
+    }
+    if (--c->post_left == 0) freeze(c);
+}
+
+void capture_push_n(capture_t *c, const void *frames, size_t n) {
+    const uint8_t *p = frames;
+    for (size_t i = 0; i < n; ++i, p += c->frame_size)
+        capture_push(c, p);
+}
+
+bool capture_get(capture_t *c, capture_window_t *win) {
+    for (int ring = 0; ring < 2; ++ring) {
+        if (load_state(c, ring) == RING_READY) {
+            *win = c->ready[ring];
+            return true;
+        }
+    }
+    return false;
+}
+
+void capture_release(capture_t *c, const capture_window_t *win) {
+    store_state(c, win->ring, RING_FREE);
+}
+
+void capture_get_stats(const capture_t *c, capture_stats_t *stats) {
+    *stats = c->stats;
+}
+
+bool capture_trigger_level(const void *frame, void *ctx) {
+    const capture_level_t *l = ctx;
+    const uint8_t *p = (const uint8_t *)frame + l->offset;
+    for (uint16_t i = 0; i < l->count; ++i) {
+        int16_t v;
+        memcpy(&v, p + 2 * i, sizeof(v));
+        int32_t a = v < 0 ? -(int32_t)v : v;
+        if (a >= l->level) return true;
+    }
+    return false;
+}
@@ -0,0 +1,336 @@
+/*
+
+Version 0.84
+
+MIT License
+
+Copyright (c) 2025 Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <tkjhat/i2c_async.h>
+#include <tkjhat/i2c_trace.h>
+
+#include "pico/stdlib.h"
+#include "pico/sync.h"
+#include "hardware/dma.h"
+#include "hardware/i2c.h"
+#include "hardware/irq.h"
+
+#if TKJHAT_I2C_NOTIFY_INDEX >= configTASK_NOTIFICATION_ARRAY_ENTRIES
+#error "TKJHAT_I2C_NOTIFY_INDEX needs configTASK_NOTIFICATION_ARRAY_ENTRIES > TKJHAT_I2C_NOTIFY_INDEX in FreeRTOSConfig.h"
+#endif
+
+// The I2C block takes 16-bit command words in IC_DATA_CMD:
+//   [7:0] data, [8] CMD (1 = read), [9] STOP, [10] RESTART.
+// Writes and read requests are therefore expanded into this buffer and
+// pushed by the TX DMA channel; the RX DMA channel collects the read bytes.
+static uint16_t cmd_buf[TKJHAT_I2C_ASYNC_MAX_LEN];
+
+static struct {
+    bool initialized;
+    int tx_dma;
+    int rx_dma;
+    uint irq;
+    critical_section_t lock;
+    i2c_xfer_t *head;           // running transfer (NULL when idle)
+    i2c_xfer_t *tail;
+    uint32_t abort_source;      // TX_ABRT reason seen for the running transfer
+} engine;
+
+static void i2c_async_irq_handler(void);
+
+
+/* =========================
+ *  DESCRIPTOR HELPERS
+ * ========================= */
+
+static void xfer_fill(i2c_xfer_t *xfer, uint8_t addr,
+                      const uint8_t *src, size_t tx_len,
+                      uint8_t *dst, size_t rx_len) {
+    xfer->addr = addr;
+    xfer->tx = src;
+    xfer->tx_len = tx_len;
+    xfer->rx = dst;
+    xfer->rx_len = rx_len;
+    xfer->status = I2C_XFER_IDLE;
+    xfer->abort_source = 0;
+    xfer->notify_task = NULL;
+    xfer->next = NULL;
+    xfer->on_done = NULL;       // set by the caller after filling, if wanted
+    xfer->user_data = NULL;
+}
+
+void i2c_xfer_write(i2c_xfer_t *xfer, uint8_t addr, const uint8_t *src, size_t len) {
+    xfer_fill(xfer, addr, src, len, NULL, 0);
+}
+
+void i2c_xfer_read(i2c_xfer_t *xfer, uint8_t addr, uint8_t *dst, size_t len) {
+    xfer_fill(xfer, addr, NULL, 0, dst, len);
+}
+
+void i2c_xfer_write_read(i2c_xfer_t *xfer, uint8_t addr,
+                         const uint8_t *src, size_t tx_len,
+                         uint8_t *dst, size_t rx_len) {
+    xfer_fill(xfer, addr, src, tx_len, dst, rx_len);
+}
+
+
+/* =========================
+ *  ENGINE
+ * ========================= */
+
+bool init_i2c_async(void) {
+    if (engine.initialized) return true;
+
+    engine.tx_dma = dma_claim_unused_channel(false);
+    engine.rx_dma = dma_claim_unused_channel(false);
+    if (engine.tx_dma < 0 || engine.rx_dma < 0) {
+        if (engine.tx_dma >= 0) dma_channel_unclaim(engine.tx_dma);
+        if (engine.rx_dma >= 0) dma_channel_unclaim(engine.rx_dma);
+        return false;
+    }
+
+    critical_section_init(&engine.lock);
+    engine.head = engine.tail = NULL;
+
+    engine.irq = I2C0_IRQ + i2c_hw_index(i2c_default);
+    i2c_get_hw(i2c_default)->intr_mask = 0;
+    irq_set_exclusive_handler(engine.irq, i2c_async_irq_handler);
+    irq_set_enabled(engine.irq, true);
+
+    engine.initialized = true;
+    return true;
+}
+
+// Program both DMA channels and the controller for engine.head.
+// Called with engine.lock held (or from the IRQ handler).
+static void start_head(void) {
+    i2c_xfer_t *x = engine.head;
+    i2c_hw_t *hw = i2c_get_hw(i2c_default);
+    size_t n = 0;
+
+    for (size_t i = 0; i < x->tx_len; ++i)
+        cmd_buf[n++] = x->tx[i];
+    for (size_t i = 0; i < x->rx_len; ++i)
+        cmd_buf[n++] = I2C_IC_DATA_CMD_CMD_BITS;
+    if (x->tx_len && x->rx_len)
+        cmd_buf[x->tx_len] |= I2C_IC_DATA_CMD_RESTART_BITS;
+    cmd_buf[n - 1] |= I2C_IC_DATA_CMD_STOP_BITS;
+
+    // Same target-address sequence as the SDK blocking functions
+    hw->enable = 0;
+    hw->tar = x->addr;
+    hw->enable = 1;
+
+    (void)hw->clr_intr;
+    engine.abort_source = 0;
+    hw->intr_mask = I2C_IC_INTR_MASK_M_STOP_DET_BITS | I2C_IC_INTR_MASK_M_TX_ABRT_BITS;
+    hw->dma_tdlr = 8;
+    hw->dma_rdlr = 0;
+    hw->dma_cr = I2C_IC_DMA_CR_TDMAE_BITS | I2C_IC_DMA_CR_RDMAE_BITS;
+
+    if (x->rx_len) {
+        dma_channel_config c = dma_channel_get_default_config(engine.rx_dma);
+        channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+        channel_config_set_read_increment(&c, false);
+        channel_config_set_write_increment(&c, true);
+        channel_config_set_dreq(&c, i2c_get_dreq(i2c_default, false));
+        dma_channel_configure(engine.rx_dma, &c, x->rx, &hw->data_cmd, x->rx_len, true);
+    }
+
+    dma_channel_config c = dma_channel_get_default_config(engine.tx_dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, i2c_get_dreq(i2c_default, true));
+
+    x->status = I2C_XFER_BUSY;
+    x->start_us = time_us_64();
+    dma_channel_configure(engine.tx_dma, &c, &hw->data_cmd, cmd_buf, n, true);
+}
+
+bool i2c_submit_async(i2c_xfer_t *xfer) {
+    if (!engine.initialized || !xfer) return false;
+    size_t total = xfer->tx_len + xfer->rx_len;
+    if (total == 0 || total > TKJHAT_I2C_ASYNC_MAX_LEN) return false;
+    if (xfer->status == I2C_XFER_QUEUED || xfer->status == I2C_XFER_BUSY) return false;
+
+    xfer->notify_task = (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING)
+                        ? xTaskGetCurrentTaskHandle() : NULL;
+    xfer->abort_source = 0;
+    xfer->next = NULL;
+    xfer->submit_us = time_us_64();
+    xfer->status = I2C_XFER_QUEUED;
+
+    critical_section_enter_blocking(&engine.lock);
+    if (engine.head == NULL) {
+        engine.head = engine.tail = xfer;
+        start_head();
+    } else {
+        engine.tail->next = xfer;
+        engine.tail = xfer;
+    }
+    critical_section_exit(&engine.lock);
+    return true;
+}
+
+static void i2c_async_irq_handler(void) {
+    i2c_hw_t *hw = i2c_get_hw(i2c_default);
+    uint32_t stat = hw->intr_stat;
+    const uint32_t owned = I2C_IC_INTR_MASK_M_STOP_DET_BITS | I2C_IC_INTR_MASK_M_TX_ABRT_BITS;
+
+    // Anything else (e.g. TX_EMPTY after the controller was reset) is not
+    // ours and would fire again at once: mask it, and all of it when idle
+    if (stat & ~owned) {
+        critical_section_enter_blocking(&engine.lock);
+        hw->intr_mask = engine.head ? owned : 0;
+        critical_section_exit(&engine.lock);
+    }
+
+    if (stat & I2C_IC_INTR_STAT_R_TX_ABRT_BITS) {
+        // The controller flushes the TX FIFO and issues a STOP by itself.
+        // Stop feeding it before releasing the flush, then finish on STOP_DET.
+        engine.abort_source |= hw->tx_abrt_source;
+        dma_channel_abort(engine.tx_dma);
+        dma_channel_abort(engine.rx_dma);
+        (void)hw->clr_tx_abrt;
+    }
+    if (!(stat & I2C_IC_INTR_STAT_R_STOP_DET_BITS))
+        return;
+    (void)hw->clr_stop_det;
+
+    uint32_t abort_source = engine.abort_source;
+    engine.abort_source = 0;
+
+    critical_section_enter_blocking(&engine.lock);
+    i2c_xfer_t *done = engine.head;
+    if (done == NULL) {
+        // Stray STOP from a blocking transfer; nothing of ours is running.
+        hw->intr_mask = 0;
+        critical_section_exit(&engine.lock);
+        return;
+    }
+
+    if (!abort_source) {
+        // STOP_DET can fire before the RX channel moved the last byte
+        while (dma_channel_is_busy(engine.rx_dma) && done->rx_len)
+            tight_loop_contents();
+    }
+    hw->dma_cr = 0;
+
+    done->done_us = time_us_64();
+    done->abort_source = abort_source;
+    if (!abort_source)
+        done->status = I2C_XFER_DONE;
+    else if (abort_source & (I2C_IC_TX_ABRT_SOURCE_ABRT_7B_ADDR_NOACK_BITS |
+                             I2C_IC_TX_ABRT_SOURCE_ABRT_TXDATA_NOACK_BITS))
+        done->status = I2C_XFER_NAK;
+    else
+        done->status = I2C_XFER_ERROR;
+
+    engine.head = done->next;
+    if (engine.head == NULL) {
+        engine.tail = NULL;
+        hw->intr_mask = 0;
+    } else {
+        start_head();
+    }
+    critical_section_exit(&engine.lock);
+
+    i2c_trace_record(done->addr, I2C_TRACE_ASYNC | (done->rx_len ? I2C_TRACE_READ : 0),
+                     done->tx_len + done->rx_len, done->start_us, done->done_us,
+                     done->status == I2C_XFER_DONE ? (int)(done->tx_len + done->rx_len)
+                                                   : PICO_ERROR_GENERIC);
+
+    if (done->on_done) done->on_done(done);
+
+    if (done->notify_task) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveIndexedFromISR(done->notify_task, TKJHAT_I2C_NOTIFY_INDEX, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+}
+
+static inline bool xfer_pending(const i2c_xfer_t *xfer) {
+    return xfer->status == I2C_XFER_QUEUED || xfer->status == I2C_XFER_BUSY;
+}
+
+i2c_xfer_status_t i2c_xfer_wait(i2c_xfer_t *xfer, uint32_t timeout_ms) {
+    absolute_time_t deadline = make_timeout_time_ms(timeout_ms);
+    bool in_task = xTaskGetSchedulerState() == taskSCHEDULER_RUNNING &&
+                   xfer->notify_task == xTaskGetCurrentTaskHandle();
+
+    while (xfer_pending(xfer)) {
+        int64_t left_us = absolute_time_diff_us(get_absolute_time(), deadline);
+        if (left_us <= 0) break;
+        if (in_task) {
+            TickType_t ticks = pdMS_TO_TICKS((left_us + 999) / 1000);
+            ulTaskNotifyTakeIndexed(TKJHAT_I2C_NOTIFY_INDEX, pdTRUE, ticks ? ticks : 1);
+        } else {
+            tight_loop_contents();
+        }
+    }
+    return xfer->status;
+}
+
+void i2c_async_rearm(void) {
+    if (!engine.initialized) return;
+    i2c_hw_t *hw = i2c_get_hw(i2c_default);
+
+    critical_section_enter_blocking(&engine.lock);
+    hw->intr_mask = 0;
+    hw->dma_cr = 0;
+    critical_section_exit(&engine.lock);
+}
+
+void i2c_async_reset(void) {
+    if (!engine.initialized) return;
+    i2c_hw_t *hw = i2c_get_hw(i2c_default);
+
+    critical_section_enter_blocking(&engine.lock);
+    hw->intr_mask = 0;
+    dma_channel_abort(engine.tx_dma);
+    dma_channel_abort(engine.rx_dma);
+    hw->dma_cr = 0;
+    i2c_xfer_t *list = engine.head;
+    engine.head = engine.tail = NULL;
+    engine.abort_source = 0;
+    critical_section_exit(&engine.lock);
+
+    uint64_t now = time_us_64();
+    while (list) {
+        i2c_xfer_t *x = list;
+        list = x->next;
+        x->done_us = now;
+        x->status = I2C_XFER_ERROR;
+        if (x->on_done) x->on_done(x);
+        if (x->notify_task) xTaskNotifyGiveIndexed(x->notify_task, TKJHAT_I2C_NOTIFY_INDEX);
+    }
+}
+
+bool i2c_async_busy(void) {
+    return engine.head != NULL;
+}
+
+void i2c_async_wait_idle(void) {
+    while (engine.head != NULL)
+        tight_loop_contents();
+}
@@ -0,0 +1,494 @@
+/*
+
+Version 0.84
+
+MIT License
+
+Copyright (c) 2025 Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <tkjhat/i2c_bus.h>
+#include <tkjhat/i2c_async.h>
+#include <tkjhat/i2c_sim.h>
+#include <tkjhat/i2c_trace.h>
+#include <tkjhat/sdk.h>
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "pico/sync.h"
+#include "hardware/i2c.h"
+
+#include <semphr.h>
+
+#define I2C_BUS_MAX_CHUNK       256
+
+// A pending transaction. Lives on the stack of the task that submitted it.
+typedef struct bus_req {
+    uint8_t addr;
+    i2c_bus_device_t dev;
+    const uint8_t *tx;
+    size_t tx_len;
+    uint8_t *rx;
+    size_t rx_len;
+    size_t tx_sent;             // bytes of tx already on the bus (split writes)
+    uint64_t submit_us;
+    uint64_t deadline_us;
+    uint64_t first_us;          // first byte queued, 0 = not started
+    uint32_t seq;
+    int result;
+    volatile bool done;
+    TaskHandle_t task;
+    struct bus_req *next;
+} bus_req_t;
+
+static i2c_bus_policy_t policies[I2C_BUS_DEV_COUNT] = {
+    [I2C_BUS_DEV_ICM42670] = { .priority = 3, .deadline_us = 500,   .chunk_size = 0,  .chunk_prefix = -1 },
+    [I2C_BUS_DEV_VEML6030] = { .priority = 2, .deadline_us = 20000, .chunk_size = 0,  .chunk_prefix = -1 },
+    [I2C_BUS_DEV_HDC2021]  = { .priority = 2, .deadline_us = 20000, .chunk_size = 0,  .chunk_prefix = -1 },
+    [I2C_BUS_DEV_SSD1306]  = { .priority = 1, .deadline_us = 50000, .chunk_size = 16, .chunk_prefix = 0x40 },
+    [I2C_BUS_DEV_OTHER]    = { .priority = 2, .deadline_us = 10000, .chunk_size = 0,  .chunk_prefix = -1 },
+};
+
+static i2c_bus_stats_t stats[I2C_BUS_DEV_COUNT];
+
+// Protects the pending list, policies and statistics. FreeRTOS critical
+// sections are avoided on purpose: the direct path also runs before the
+// scheduler starts, where they would leave interrupts disabled.
+static critical_section_t bus_cs;
+static bool bus_cs_ready;
+
+// Pins and speed of i2c_default, needed to recover a stuck bus
+static uint bus_sda = DEFAULT_I2C_SDA_PIN;
+static uint bus_scl = DEFAULT_I2C_SCL_PIN;
+static uint bus_baudrate = 400 * 1000;
+static uint32_t bus_recoveries;
+
+static SemaphoreHandle_t bus_mutex;
+static TaskHandle_t owner_task;
+static bus_req_t *pending;
+static uint32_t next_seq;
+
+// Owner-only resources
+static i2c_xfer_t owner_xfer;
+static uint8_t chunk_buf[I2C_BUS_MAX_CHUNK + 1];
+
+
+/* =========================
+ *  DEVICES AND POLICIES
+ * ========================= */
+
+static void bus_state_init(void) {
+    if (bus_cs_ready) return;
+    critical_section_init(&bus_cs);
+    bus_cs_ready = true;
+}
+
+void init_i2c_bus(uint sda_pin, uint scl_pin, uint baudrate) {
+    bus_state_init();
+    i2c_trace_init();
+    bus_sda = sda_pin;
+    bus_scl = scl_pin;
+    bus_baudrate = baudrate;
+}
+
+i2c_bus_device_t i2c_bus_device_from_addr(uint8_t addr) {
+    switch (addr) {
+        case ICM42670_I2C_ADDRESS:
+        case 0x68:                  return I2C_BUS_DEV_ICM42670;
+        case VEML6030_I2C_ADDR:     return I2C_BUS_DEV_VEML6030;
+        case HDC2021_I2C_ADDRESS:   return I2C_BUS_DEV_HDC2021;
+        case SSD1306_I2C_ADDRESS:   return I2C_BUS_DEV_SSD1306;
+        default:                    return I2C_BUS_DEV_OTHER;
+    }
+}
+
+void i2c_bus_set_policy(i2c_bus_device_t dev, const i2c_bus_policy_t *policy) {
+    if (dev >= I2C_BUS_DEV_COUNT || !policy) return;
+    bus_state_init();
+    critical_section_enter_blocking(&bus_cs);
+    policies[dev] = *policy;
+    if (policies[dev].chunk_size > I2C_BUS_MAX_CHUNK)
+        policies[dev].chunk_size = I2C_BUS_MAX_CHUNK;
+    critical_section_exit(&bus_cs);
+}
+
+void i2c_bus_get_policy(i2c_bus_device_t dev, i2c_bus_policy_t *policy) {
+    if (dev >= I2C_BUS_DEV_COUNT || !policy) return;
+    *policy = policies[dev];
+}
+
+void i2c_bus_get_stats(i2c_bus_device_t dev, i2c_bus_stats_t *out) {
+    if (dev >= I2C_BUS_DEV_COUNT || !out) return;
+    bus_state_init();
+    critical_section_enter_blocking(&bus_cs);
+    *out = stats[dev];
+    critical_section_exit(&bus_cs);
+}
+
+void i2c_bus_reset_stats(void) {
+    bus_state_init();
+    critical_section_enter_blocking(&bus_cs);
+    memset(stats, 0, sizeof(stats));
+    critical_section_exit(&bus_cs);
+}
+
+static void stats_account(const bus_req_t *r, uint64_t end_us) {
+    i2c_bus_stats_t *s = &stats[r->dev];
+    uint32_t queued = (uint32_t)(r->first_us - r->submit_us);
+    uint32_t total = (uint32_t)(end_us - r->submit_us);
+
+    critical_section_enter_blocking(&bus_cs);
+    if (r->result < 0) {
+        s->errors++;
+    } else {
+        s->transfers++;
+        s->bytes += r->tx_len + r->rx_len;
+        // Same population as transfers, so sum / transfers is the mean
+        s->queue_latency_sum_us += queued;
+    }
+    s->queue_latency_last_us = queued;
+    if (queued > s->queue_latency_max_us) s->queue_latency_max_us = queued;
+    if (total > s->total_latency_max_us) s->total_latency_max_us = total;
+    if (end_us > r->deadline_us) s->deadline_misses++;
+    critical_section_exit(&bus_cs);
+}
+
+
+/* =========================
+ *  BUS LOCK
+ * ========================= */
+
+static inline bool scheduler_running(void) {
+    return xTaskGetSchedulerState() == taskSCHEDULER_RUNNING;
+}
+
+void i2c_bus_lock(void) {
+    if (!scheduler_running()) return;
+    if (bus_mutex == NULL) {
+        vTaskSuspendAll();
+        if (bus_mutex == NULL)
+            bus_mutex = xSemaphoreCreateRecursiveMutex();
+        xTaskResumeAll();
+    }
+    xSemaphoreTakeRecursive(bus_mutex, portMAX_DELAY);
+}
+
+void i2c_bus_unlock(void) {
+    if (!scheduler_running() || bus_mutex == NULL) return;
+    xSemaphoreGiveRecursive(bus_mutex);
+}
+
+bool i2c_bus_locked_by_me(void) {
+    if (!scheduler_running() || bus_mutex == NULL) return false;
+    return xSemaphoreGetMutexHolder(bus_mutex) == xTaskGetCurrentTaskHandle();
+}
+
+
+/* =========================
+ *  TIMEOUTS AND RECOVERY
+ * ========================= */
+
+static inline uint32_t bus_timeout_us(size_t len) {
+    return TKJHAT_I2C_TIMEOUT_BASE_US + (uint32_t)len * TKJHAT_I2C_TIMEOUT_PER_BYTE_US;
+}
+
+// Count a failed transfer; a timeout means the bus may be stuck, so recover it.
+static void bus_note_error(i2c_bus_device_t dev, int rc) {
+    if (rc >= 0) return;
+    critical_section_enter_blocking(&bus_cs);
+    if (rc == PICO_ERROR_TIMEOUT) stats[dev].timeouts++;
+    else stats[dev].naks++;
+    critical_section_exit(&bus_cs);
+
+    if (rc == PICO_ERROR_TIMEOUT) {
+        i2c_bus_recover();
+        critical_section_enter_blocking(&bus_cs);
+        stats[dev].recoveries++;
+        critical_section_exit(&bus_cs);
+    }
+}
+
+// Open-drain emulation: drive low, or release and let the pull-up win.
+static inline void line_low(uint pin)     { gpio_set_dir(pin, GPIO_OUT); }
+static inline void line_release(uint pin) { gpio_set_dir(pin, GPIO_IN); }
+
+bool i2c_bus_recover(void) {
+    bus_state_init();
+    i2c_bus_lock();
+#if TKJHAT_I2C_SIM
+    i2c_sim_recover();
+    bool idle = true;
+#else
+    i2c_async_reset();
+    i2c_deinit(i2c_default);
+
+    gpio_set_function(bus_sda, GPIO_FUNC_SIO);
+    gpio_set_function(bus_scl, GPIO_FUNC_SIO);
+    gpio_put(bus_sda, 0);
+    gpio_put(bus_scl, 0);
+    line_release(bus_sda);
+    line_release(bus_scl);
+    busy_wait_us(5);
+
+    // A target holding SDA low is in the middle of a byte: clock it out
+    // (at most 9 clocks, ~100 kHz) until it releases SDA.
+    for (int i = 0; i < 9 && !gpio_get(bus_sda); ++i) {
+        line_low(bus_scl);
+        busy_wait_us(5);
+        line_release(bus_scl);
+        busy_wait_us(5);
+    }
+    // STOP condition: SDA rises while SCL is high
+    line_low(bus_scl);
+    busy_wait_us(5);
+    line_low(bus_sda);
+    busy_wait_us(5);
+    line_release(bus_scl);
+    busy_wait_us(5);
+    line_release(bus_sda);
+    busy_wait_us(5);
+    bool idle = gpio_get(bus_sda) && gpio_get(bus_scl);
+
+    i2c_init(i2c_default, bus_baudrate);
+    i2c_async_rearm();
+    gpio_set_function(bus_sda, GPIO_FUNC_I2C);
+    gpio_set_function(bus_scl, GPIO_FUNC_I2C);
+#endif
+
+    critical_section_enter_blocking(&bus_cs);
+    bus_recoveries++;
+    critical_section_exit(&bus_cs);
+    i2c_bus_unlock();
+    return idle;
+}
+
+uint32_t i2c_bus_recovery_count(void) {
+    return bus_recoveries;
+}
+
+
+/* =========================
+ *  TRANSACTIONS
+ * ========================= */
+
+int i2c_bus_write_raw(uint8_t addr, const uint8_t *src, size_t len, bool nostop) {
+    uint64_t start_us = time_us_64();
+#if TKJHAT_I2C_SIM
+    int rc = i2c_sim_write(addr, src, len, nostop);
+#else
+    int rc = i2c_write_timeout_us(i2c_default, addr, src, len, nostop, bus_timeout_us(len));
+#endif
+    i2c_trace_record(addr, nostop ? I2C_TRACE_NOSTOP : 0, len, start_us, time_us_64(), rc);
+    bus_note_error(i2c_bus_device_from_addr(addr), rc);
+    return rc;
+}
+
+int i2c_bus_read_raw(uint8_t addr, uint8_t *dst, size_t len, bool nostop) {
+    uint64_t start_us = time_us_64();
+#if TKJHAT_I2C_SIM
+    int rc = i2c_sim_read(addr, dst, len, nostop);
+#else
+    int rc = i2c_read_timeout_us(i2c_default, addr, dst, len, nostop, bus_timeout_us(len));
+#endif
+    i2c_trace_record(addr, I2C_TRACE_READ | (nostop ? I2C_TRACE_NOSTOP : 0), len,
+                     start_us, time_us_64(), rc);
+    bus_note_error(i2c_bus_device_from_addr(addr), rc);
+    return rc;
+}
+
+// One bus transaction with the SDK blocking functions, bounded in time.
+static int bus_execute_blocking(uint8_t addr, const uint8_t *tx, size_t tx_len,
+                                uint8_t *rx, size_t rx_len) {
+    int rc;
+    if (tx_len) {
+        rc = i2c_bus_write_raw(addr, tx, tx_len, rx_len > 0);
+        if (rc < 0) return rc;
+        if (rc != (int)tx_len) return PICO_ERROR_GENERIC;
+    }
+    if (rx_len) {
+        rc = i2c_bus_read_raw(addr, rx, rx_len, false);
+        if (rc < 0) return rc;
+        if (rc != (int)rx_len) return PICO_ERROR_GENERIC;
+    }
+    return (int)(tx_len + rx_len);
+}
+
+// One bus transaction from the owner task: DMA when possible, so the owner
+// sleeps while the bytes move.
+static int bus_execute_owner(uint8_t addr, const uint8_t *tx, size_t tx_len,
+                             uint8_t *rx, size_t rx_len) {
+#if TKJHAT_I2C_SIM
+    return bus_execute_blocking(addr, tx, tx_len, rx, rx_len);
+#else
+    i2c_xfer_write_read(&owner_xfer, addr, tx, tx_len, rx, rx_len);
+    if (!i2c_submit_async(&owner_xfer))
+        return bus_execute_blocking(addr, tx, tx_len, rx, rx_len);
+
+    int rc;
+    uint32_t timeout_ms = (bus_timeout_us(tx_len + rx_len) + 999) / 1000;
+    switch (i2c_xfer_wait(&owner_xfer, timeout_ms)) {
+        case I2C_XFER_DONE: return (int)(tx_len + rx_len);
+        case I2C_XFER_QUEUED:
+        case I2C_XFER_BUSY: rc = PICO_ERROR_TIMEOUT; break;
+        default:            rc = PICO_ERROR_GENERIC; break;
+    }
+    bus_note_error(i2c_bus_device_from_addr(addr), rc);
+    return rc;
+#endif
+}
+
+// Better candidate: higher priority, then earlier deadline, then older.
+static bool req_before(const bus_req_t *a, const bus_req_t *b) {
+    uint8_t pa = policies[a->dev].priority, pb = policies[b->dev].priority;
+    if (pa != pb) return pa > pb;
+    if (a->deadline_us != b->deadline_us) return a->deadline_us < b->deadline_us;
+    return (int32_t)(a->seq - b->seq) < 0;
+}
+
+static bus_req_t *pick_next(void) {
+    bus_req_t *best = NULL;
+    critical_section_enter_blocking(&bus_cs);
+    for (bus_req_t *r = pending; r; r = r->next)
+        if (!best || req_before(r, best)) best = r;
+    critical_section_exit(&bus_cs);
+    return best;
+}
+
+static void unlink_req(bus_req_t *r) {
+    critical_section_enter_blocking(&bus_cs);
+    for (bus_req_t **pp = &pending; *pp; pp = &(*pp)->next) {
+        if (*pp == r) { *pp = r->next; break; }
+    }
+    critical_section_exit(&bus_cs);
+}
+
+// Run one bus transaction of @p r: the whole request, or the next chunk of
+// a split write. The queue is re-evaluated between chunks.
+static void run_slice(bus_req_t *r) {
+    const i2c_bus_policy_t *pol = &policies[r->dev];
+    bool last = true;
+    int rc;
+
+    i2c_bus_lock();
+    if (r->first_us == 0) r->first_us = time_us_64();
+
+    bool split = pol->chunk_size && r->rx_len == 0 && pol->chunk_prefix >= 0 &&
+                 r->tx_len > (size_t)pol->chunk_size + 1 &&
+                 r->tx[0] == (uint8_t)pol->chunk_prefix;
+    if (!split) {
+        rc = bus_execute_owner(r->addr, r->tx, r->tx_len, r->rx, r->rx_len);
+    } else if (r->tx_sent == 0) {
+        // First chunk goes straight from the caller's buffer (prefix included)
+        size_t n = 1 + pol->chunk_size;
+        rc = bus_execute_owner(r->addr, r->tx, n, NULL, 0);
+        r->tx_sent = n;
+        last = false;
+    } else {
+        size_t n = r->tx_len - r->tx_sent;
+        if (n > pol->chunk_size) n = pol->chunk_size;
+        chunk_buf[0] = (uint8_t)pol->chunk_prefix;
+        memcpy(&chunk_buf[1], r->tx + r->tx_sent, n);
+        rc = bus_execute_owner(r->addr, chunk_buf, n + 1, NULL, 0);
+        r->tx_sent += n;
+        last = r->tx_sent >= r->tx_len;
+    }
+    i2c_bus_unlock();
+
+    critical_section_enter_blocking(&bus_cs);
+    stats[r->dev].chunks++;
+    critical_section_exit(&bus_cs);
+
+    if (rc < 0 || last) {
+        r->result = rc < 0 ? rc : (int)(r->tx_len + r->rx_len);
+        unlink_req(r);
+        stats_account(r, time_us_64());
+        // The waiter may return and reuse *r as soon as done is set, so the
+        // handle is read first and r is not touched afterwards.
+        TaskHandle_t task = r->task;
+        r->done = true;
+        xTaskNotifyGiveIndexed(task, TKJHAT_I2C_NOTIFY_INDEX);
+    }
+}
+
+static void bus_owner_task(void *arg) {
+    (void)arg;
+    for (;;) {
+        bus_req_t *r;
+        while ((r = pick_next()) != NULL)
+            run_slice(r);
+        ulTaskNotifyTakeIndexed(TKJHAT_I2C_NOTIFY_INDEX, pdTRUE, portMAX_DELAY);
+    }
+}
+
+bool init_i2c_bus_manager(UBaseType_t task_priority) {
+    if (owner_task) return true;
+    bus_state_init();
+    init_i2c_async();   // optional: falls back to blocking transfers
+    return xTaskCreate(bus_owner_task, "i2c_bus", 1024, NULL,
+                       task_priority, &owner_task) == pdPASS;
+}
+
+bool i2c_bus_manager_running(void) {
+    return owner_task != NULL && scheduler_running();
+}
+
+int i2c_bus_transfer(uint8_t addr, const uint8_t *tx, size_t tx_len,
+                     uint8_t *rx, size_t rx_len) {
+    if (tx_len + rx_len == 0) return 0;
+    bus_state_init();
+
+    bus_req_t r = {
+        .addr = addr,
+        .dev = i2c_bus_device_from_addr(addr),
+        .tx = tx, .tx_len = tx_len,
+        .rx = rx, .rx_len = rx_len,
+        .submit_us = time_us_64(),
+    };
+    r.deadline_us = r.submit_us + policies[r.dev].deadline_us;
+
+    if (!i2c_bus_manager_running() || xTaskGetCurrentTaskHandle() == owner_task ||
+        i2c_bus_locked_by_me()) {
+        // Direct path: run in the caller, serialized by the bus mutex
+        i2c_async_wait_idle();
+        i2c_bus_lock();
+        r.first_us = time_us_64();
+        r.result = bus_execute_blocking(addr, tx, tx_len, rx, rx_len);
+        i2c_bus_unlock();
+        critical_section_enter_blocking(&bus_cs);
+        stats[r.dev].chunks++;
+        critical_section_exit(&bus_cs);
+        stats_account(&r, time_us_64());
+        return r.result;
+    }
+
+    r.task = xTaskGetCurrentTaskHandle();
+    critical_section_enter_blocking(&bus_cs);
+    r.seq = next_seq++;
+    r.next = pending;
+    pending = &r;
+    critical_section_exit(&bus_cs);
+
+    xTaskNotifyGiveIndexed(owner_task, TKJHAT_I2C_NOTIFY_INDEX);
+    while (!r.done)
+        ulTaskNotifyTakeIndexed(TKJHAT_I2C_NOTIFY_INDEX, pdTRUE, portMAX_DELAY);
+    return r.result;
+}
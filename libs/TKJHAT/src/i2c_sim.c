@@ -0,0 +1,550 @@
+/*
+
+Version 0.84
+
+MIT License
+
+Copyright (c) 2025 Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <tkjhat/i2c_sim.h>
+#include <tkjhat/sdk.h>
+
+#include <math.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+static i2c_sim_device_t *devices;
+
+
+/* =========================
+ *  SIGNALS
+ * ========================= */
+
+float i2c_sim_wave(void *ctx, uint64_t t_us) {
+    i2c_sim_wave_t *w = ctx;
+    float v = w->offset;
+    if (w->period_us)
+        v += w->amplitude * sinf(6.2831853f * (float)(t_us % w->period_us) / (float)w->period_us);
+    if (w->noise != 0.0f) {
+        // xorshift32, mapped to [-1, 1]
+        uint32_t x = w->seed ? w->seed : 0x2545F491u;
+        x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+        w->seed = x;
+        v += w->noise * ((float)(x >> 8) / 8388607.5f - 1.0f);
+    }
+    return v;
+}
+
+float i2c_sim_channel_value(const i2c_sim_channel_t *ch, uint64_t t_us) {
+    return ch->fn ? ch->fn(ch->ctx, t_us) : ch->value;
+}
+
+static inline int16_t sat16(float v) {
+    if (v >= 32767.0f) return 32767;
+    if (v <= -32768.0f) return -32768;
+    return (int16_t)lrintf(v);
+}
+
+static inline uint16_t satu16(float v) {
+    if (v >= 65535.0f) return 65535;
+    if (v <= 0.0f) return 0;
+    return (uint16_t)lrintf(v);
+}
+
+
+/* =========================
+ *  BUS
+ * ========================= */
+
+void i2c_sim_attach(i2c_sim_device_t *dev) {
+    i2c_sim_detach(dev);
+    dev->next = devices;
+    devices = dev;
+}
+
+void i2c_sim_detach(i2c_sim_device_t *dev) {
+    for (i2c_sim_device_t **pp = &devices; *pp; pp = &(*pp)->next) {
+        if (*pp == dev) { *pp = dev->next; break; }
+    }
+}
+
+static i2c_sim_device_t *find_dev(uint8_t addr) {
+    for (i2c_sim_device_t *d = devices; d; d = d->next)
+        if (d->addr == addr) return d;
+    return NULL;
+}
+
+// START + address phase shared by reads and writes
+static int sim_address(i2c_sim_device_t *d, bool read) {
+    if (d == NULL || d->nak) return PICO_ERROR_GENERIC;
+    for (i2c_sim_device_t *s = devices; s; s = s->next)
+        if (s->stuck) return PICO_ERROR_TIMEOUT;   // SDA held low by someone
+    d->transactions++;
+    if (d->start) d->start(d, read);
+    return 0;
+}
+
+int i2c_sim_write(uint8_t addr, const uint8_t *src, size_t len, bool nostop) {
+    i2c_sim_device_t *d = find_dev(addr);
+    int rc = sim_address(d, false);
+    if (rc) return rc;
+
+    size_t n = d->write ? d->write(d, src, len) : 0;
+    d->bytes += n;
+    if (n < len) {
+        // The controller sends a STOP after a data NAK
+        if (d->stop) d->stop(d);
+        return PICO_ERROR_GENERIC;
+    }
+    if (!nostop && d->stop) d->stop(d);
+    return (int)len;
+}
+
+int i2c_sim_read(uint8_t addr, uint8_t *dst, size_t len, bool nostop) {
+    i2c_sim_device_t *d = find_dev(addr);
+    int rc = sim_address(d, true);
+    if (rc) return rc;
+
+    memset(dst, 0xFF, len);     // released SDA reads as ones
+    if (d->read) d->read(d, dst, len);
+    d->bytes += len;
+    if (!nostop && d->stop) d->stop(d);
+    return (int)len;
+}
+
+void i2c_sim_recover(void) {
+    for (i2c_sim_device_t *d = devices; d; d = d->next)
+        d->stuck = false;
+}
+
+
+/* =========================
+ *  8-BIT REGISTER FILE
+ * ========================= */
+
+static void rf_start(i2c_sim_device_t *dev, bool read) {
+    i2c_sim_regfile_t *rf = (i2c_sim_regfile_t *)dev;
+    rf->ptr_set = false;
+    if (read && rf->on_read) rf->on_read(rf);
+}
+
+static size_t rf_write(i2c_sim_device_t *dev, const uint8_t *src, size_t len) {
+    i2c_sim_regfile_t *rf = (i2c_sim_regfile_t *)dev;
+    for (size_t i = 0; i < len; ++i) {
+        if (!rf->ptr_set) {
+            rf->ptr = src[i];
+            rf->ptr_set = true;
+            continue;
+        }
+        uint8_t reg = rf->ptr++;
+        rf->regs[reg] = src[i];
+        if (rf->on_write) rf->on_write(rf, reg);
+    }
+    return len;
+}
+
+static void rf_read(i2c_sim_device_t *dev, uint8_t *dst, size_t len) {
+    i2c_sim_regfile_t *rf = (i2c_sim_regfile_t *)dev;
+    uint8_t first = rf->ptr;
+    for (size_t i = 0; i < len; ++i)
+        dst[i] = rf->regs[rf->ptr++];
+    if (rf->on_read_done) rf->on_read_done(rf, first, len);
+}
+
+// The register pointer wraps, so a long read can cover any register
+static inline bool rf_covered(uint8_t reg, uint8_t first, size_t len) {
+    return (size_t)(uint8_t)(reg - first) < len;
+}
+
+static void rf_init(i2c_sim_regfile_t *rf, uint8_t addr) {
+    memset(rf, 0, sizeof(*rf));
+    rf->dev.addr = addr;
+    rf->dev.start = rf_start;
+    rf->dev.write = rf_write;
+    rf->dev.read = rf_read;
+}
+
+
+/* =========================
+ *  ICM-42670
+ * ========================= */
+
+#define ICM_DATA_FIRST          ICM42670_SENSOR_DATA_START_REG
+#define ICM_DATA_LAST           0x16
+#define ICM_RESET_US            1000    // no register access after a soft reset
+
+static void icm_reset_regs(i2c_sim_icm42670_t *m) {
+    uint8_t *r = m->rf.regs;
+    memset(r, 0, sizeof(m->rf.regs));
+    r[ICM42670_REG_MCLK_RDY] = ICM42670_MCLK_RDY;
+    r[ICM42670_GYRO_CONFIG0_REG] = 0x06;
+    r[ICM42670_ACCEL_CONFIG0_REG] = 0x06;
+    r[ICM42670_REG_WHO_AM_I] = ICM42670_WHO_AM_I_RESPONSE;
+}
+
+static void icm_put16(uint8_t *r, uint8_t reg, int16_t v) {
+    r[reg] = (uint8_t)((uint16_t)v >> 8);       // big-endian
+    r[reg + 1] = (uint8_t)v;
+}
+
+// Output data period of the ODR code in ACCEL_CONFIG0 (GYRO_CONFIG0 when
+// the accelerometer is off): 1600 Hz for 0x05, halving at each step.
+static uint32_t icm_period_us(const uint8_t *r) {
+    uint8_t odr = (r[ICM42670_PWR_MGMT0_REG] & 0x03) ? r[ICM42670_ACCEL_CONFIG0_REG]
+                                                     : r[ICM42670_GYRO_CONFIG0_REG];
+    odr &= 0x0F;
+    return odr <= 0x05 ? 625u : 625u << (odr - 0x05);
+}
+
+// MCLK_RDY drops for the reset time; DRDY is set once per output sample and
+// stays set until read.
+static void icm_update_status(i2c_sim_icm42670_t *m, uint64_t now) {
+    uint8_t *r = m->rf.regs;
+    if (now - m->reset_us < ICM_RESET_US) r[ICM42670_REG_MCLK_RDY] &= (uint8_t)~ICM42670_MCLK_RDY;
+    else                                  r[ICM42670_REG_MCLK_RDY] |= ICM42670_MCLK_RDY;
+
+    if (!(r[ICM42670_PWR_MGMT0_REG] & 0x0F) || now < m->next_sample_us) return;
+    uint32_t period = icm_period_us(r);
+    r[ICM42670_INT_STATUS_DRDY_REG] |= ICM42670_DATA_RDY_INT;
+    m->next_sample_us += period * ((now - m->next_sample_us) / period + 1);
+}
+
+// Latch one coherent sample into the data registers, like the device does
+// for a burst read.
+static void icm_on_read(i2c_sim_regfile_t *rf) {
+    i2c_sim_icm42670_t *m = (i2c_sim_icm42670_t *)rf;
+    uint8_t *r = rf->regs;
+    uint64_t now = time_us_64();
+    icm_update_status(m, now);
+    if (rf->ptr < ICM_DATA_FIRST || rf->ptr > ICM_DATA_LAST) return;
+
+    uint8_t pwr = r[ICM42670_PWR_MGMT0_REG];
+    bool accel_on = (pwr & 0x03) != 0;
+    bool gyro_on = (pwr & 0x0C) != 0;
+    float a_lsb = (float)(2048 << (r[ICM42670_ACCEL_CONFIG0_REG] >> 5));  // ±16 g .. ±2 g
+    float g_lsb = 16.4f * (float)(1 << (r[ICM42670_GYRO_CONFIG0_REG] >> 5)); // ±2000 .. ±250 dps
+
+    icm_put16(r, 0x09, sat16((i2c_sim_channel_value(&m->temp, now) - 25.0f) * 128.0f));
+    for (int i = 0; i < 3; ++i) {
+        icm_put16(r, 0x0B + 2 * i, accel_on
+                  ? sat16(i2c_sim_channel_value(&m->accel[i], now) * a_lsb) : INT16_MIN);
+        icm_put16(r, 0x11 + 2 * i, gyro_on
+                  ? sat16(i2c_sim_channel_value(&m->gyro[i], now) * g_lsb) : INT16_MIN);
+    }
+}
+
+static void icm_on_write(i2c_sim_regfile_t *rf, uint8_t reg) {
+    i2c_sim_icm42670_t *m = (i2c_sim_icm42670_t *)rf;
+    if (reg == ICM42670_REG_SIGNAL_PATH_RESET && (rf->regs[reg] & ICM42670_RESET_CONFIG_BITS)) {
+        icm_reset_regs(m);
+        m->reset_us = time_us_64();
+        m->next_sample_us = 0;
+        m->resets++;
+    } else if (reg == ICM42670_PWR_MGMT0_REG && (rf->regs[reg] & 0x0F) && !m->next_sample_us) {
+        m->next_sample_us = time_us_64() + icm_period_us(rf->regs);    // first sample
+    } else if (reg == ICM42670_PWR_MGMT0_REG && !(rf->regs[reg] & 0x0F)) {
+        m->next_sample_us = 0;
+    }
+    if (reg == ICM42670_REG_WHO_AM_I)
+        rf->regs[reg] = ICM42670_WHO_AM_I_RESPONSE;     // read-only
+}
+
+static void icm_on_read_done(i2c_sim_regfile_t *rf, uint8_t first, size_t len) {
+    if (rf_covered(ICM42670_INT_STATUS_DRDY_REG, first, len))
+        rf->regs[ICM42670_INT_STATUS_DRDY_REG] &= (uint8_t)~ICM42670_DATA_RDY_INT;
+}
+
+void i2c_sim_icm42670_init(i2c_sim_icm42670_t *m) {
+    memset(m, 0, sizeof(*m));
+    rf_init(&m->rf, ICM42670_I2C_ADDRESS);
+    m->rf.on_write = icm_on_write;
+    m->rf.on_read = icm_on_read;
+    m->rf.on_read_done = icm_on_read_done;
+    m->temp.value = 25.0f;
+    icm_reset_regs(m);
+    m->reset_us = time_us_64() - ICM_RESET_US;     // powered up long ago
+}
+
+
+/* =========================
+ *  HDC2021
+ * ========================= */
+
+// 14-bit temperature + 14-bit humidity (datasheet: 610 us + 660 us)
+#define HDC_CONVERSION_US       1300
+
+static void hdc_reset_regs(i2c_sim_hdc2021_t *m) {
+    uint8_t *r = m->rf.regs;
+    memset(r, 0, sizeof(m->rf.regs));
+    m->conversion_us = 0;
+    r[HDC2021_TEMP_THR_L] = 0x01;
+    r[HDC2021_TEMP_THR_H] = 0xFF;
+    r[HDC2021_HUMID_THR_H] = 0xFF;
+    r[0xFC] = 0x49;     // manufacturer ID 0x5449 (LSB first)
+    r[0xFD] = 0x54;
+    r[0xFE] = 0xD0;     // device ID 0x07D0
+    r[0xFF] = 0x07;
+}
+
+// Auto measurement mode period from CONFIG bits 6:4, in ms (0 = AMM off)
+static uint32_t hdc_amm_period_ms(const uint8_t *r) {
+    static const uint32_t periods[8] = { 0, 120000, 60000, 10000, 5000, 1000, 500, 200 };
+    return periods[(r[HDC2021_CONFIG] >> 4) & 0x07];
+}
+
+static void hdc_update_status(i2c_sim_hdc2021_t *m, uint64_t now) {
+    if (!m->conversion_us || now < m->conversion_us) return;
+    m->rf.regs[HDC2021_DRDY_STATUS_REG] |= HDC2021_DRDY_STATUS;
+    uint32_t period_ms = hdc_amm_period_ms(m->rf.regs);
+    m->conversion_us = period_ms ? m->conversion_us + 1000ull * period_ms : 0;
+    if (m->conversion_us && m->conversion_us <= now)    // missed periods
+        m->conversion_us = now + 1000ull * period_ms;
+}
+
+static void hdc_on_read(i2c_sim_regfile_t *rf) {
+    i2c_sim_hdc2021_t *m = (i2c_sim_hdc2021_t *)rf;
+    uint8_t *r = rf->regs;
+    uint64_t now = time_us_64();
+    hdc_update_status(m, now);
+    if (rf->ptr > HDC2021_HUMIDITY_HIGH) return;
+
+    uint16_t t = satu16((i2c_sim_channel_value(&m->temp, now) + 40.0f) * 65536.0f / 165.0f);
+    uint16_t h = satu16(i2c_sim_channel_value(&m->humidity, now) * 65536.0f / 100.0f);
+    r[HDC2021_TEMP_LOW] = (uint8_t)t;
+    r[HDC2021_TEMP_HIGH] = (uint8_t)(t >> 8);
+    r[HDC2021_HUMIDITY_LOW] = (uint8_t)h;
+    r[HDC2021_HUMIDITY_HIGH] = (uint8_t)(h >> 8);
+}
+
+static void hdc_on_write(i2c_sim_regfile_t *rf, uint8_t reg) {
+    i2c_sim_hdc2021_t *m = (i2c_sim_hdc2021_t *)rf;
+    if (reg == HDC2021_CONFIG && (rf->regs[reg] & 0x80)) {
+        hdc_reset_regs(m);
+        m->resets++;
+    } else if (reg == HDC2021_MEASUREMENT_CONFIG && (rf->regs[reg] & 0x01)) {
+        rf->regs[reg] &= (uint8_t)~0x01;    // MEAS_TRIG self-clears
+        m->conversion_us = time_us_64() + HDC_CONVERSION_US;
+        m->triggers++;
+    } else if (reg >= 0xFC) {
+        static const uint8_t ids[4] = { 0x49, 0x54, 0xD0, 0x07 };
+        rf->regs[reg] = ids[reg - 0xFC];    // read-only
+    }
+}
+
+static void hdc_on_read_done(i2c_sim_regfile_t *rf, uint8_t first, size_t len) {
+    if (rf_covered(HDC2021_DRDY_STATUS_REG, first, len))
+        rf->regs[HDC2021_DRDY_STATUS_REG] = 0;
+}
+
+void i2c_sim_hdc2021_init(i2c_sim_hdc2021_t *m) {
+    memset(m, 0, sizeof(*m));
+    rf_init(&m->rf, HDC2021_I2C_ADDRESS);
+    m->rf.on_write = hdc_on_write;
+    m->rf.on_read = hdc_on_read;
+    m->rf.on_read_done = hdc_on_read_done;
+    m->temp.value = 22.0f;
+    m->humidity.value = 40.0f;
+    hdc_reset_regs(m);
+}
+
+
+/* =========================
+ *  VEML6030
+ * ========================= */
+
+// Lux per count at gain 1 and 100 ms integration time (datasheet / app note)
+#define VEML_BASE_RESOLUTION    0.0576f
+
+static float veml_resolution(uint16_t conf) {
+    static const float gains[4] = { 1.0f, 2.0f, 0.125f, 0.25f };
+    float gain = gains[(conf >> 11) & 0x03];
+    float it_ms;
+    switch ((conf >> 6) & 0x0F) {
+        case 0x0C: it_ms = 25.0f;  break;
+        case 0x08: it_ms = 50.0f;  break;
+        case 0x01: it_ms = 200.0f; break;
+        case 0x02: it_ms = 400.0f; break;
+        case 0x03: it_ms = 800.0f; break;
+        default:   it_ms = 100.0f; break;
+    }
+    return VEML_BASE_RESOLUTION * (100.0f / it_ms) / gain;
+}
+
+static void veml_start(i2c_sim_device_t *dev, bool read) {
+    i2c_sim_veml6030_t *m = (i2c_sim_veml6030_t *)dev;
+    m->rx_len = 0;
+    m->tx_pos = 0;
+    uint16_t conf = m->regs[VEML6030_CONFIG_REG];
+    if (read && (m->cmd == VEML6030_ALS_REG || m->cmd == 0x05) && !(conf & 0x01)) {
+        float lux = i2c_sim_channel_value(&m->lux, time_us_64());
+        uint16_t counts = satu16(lux / veml_resolution(conf));
+        m->regs[VEML6030_ALS_REG] = counts;
+        m->regs[0x05] = counts;     // WHITE, same spectrum in the model
+    }
+}
+
+static size_t veml_write(i2c_sim_device_t *dev, const uint8_t *src, size_t len) {
+    i2c_sim_veml6030_t *m = (i2c_sim_veml6030_t *)dev;
+    for (size_t i = 0; i < len; ++i) {
+        if (m->rx_len >= sizeof(m->rx)) return i;      // NAK extra bytes
+        m->rx[m->rx_len++] = src[i];
+        if (m->rx_len == 1) {
+            if (src[i] >= 16) return i;                 // unknown command code
+            m->cmd = src[i];
+        } else if (m->rx_len == 3 && m->cmd <= 0x03) {
+            m->regs[m->cmd] = (uint16_t)(m->rx[1] | (m->rx[2] << 8));
+        }
+    }
+    return len;
+}
+
+static void veml_read(i2c_sim_device_t *dev, uint8_t *dst, size_t len) {
+    i2c_sim_veml6030_t *m = (i2c_sim_veml6030_t *)dev;
+    for (size_t i = 0; i < len && m->tx_pos < 2; ++i, ++m->tx_pos)
+        dst[i] = (uint8_t)(m->regs[m->cmd] >> (8 * m->tx_pos));     // LSB first
+}
+
+void i2c_sim_veml6030_init(i2c_sim_veml6030_t *m) {
+    memset(m, 0, sizeof(*m));
+    m->dev.addr = VEML6030_I2C_ADDR;
+    m->dev.start = veml_start;
+    m->dev.write = veml_write;
+    m->dev.read = veml_read;
+    m->regs[VEML6030_CONFIG_REG] = 0x0001;     // shut down after power-on
+    m->lux.value = 300.0f;
+}
+
+
+/* =========================
+ *  SSD1306
+ * ========================= */
+
+// Argument bytes following each command byte
+static uint8_t ssd_args(uint8_t c) {
+    switch (c) {
+        case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xAD:
+        case 0xD3: case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+            return 1;
+        case 0x21: case 0x22: case 0xA3:
+            return 2;
+        case 0x29: case 0x2A:
+            return 5;
+        case 0x26: case 0x27:
+            return 6;
+        default:
+            return 0;
+    }
+}
+
+static void ssd_command(i2c_sim_ssd1306_t *m) {
+    uint8_t c = m->cmd[0];
+    if (c == 0xAE || c == 0xAF)          m->display_on = c & 1;
+    else if (c == 0xA6 || c == 0xA7)     m->inverted = c & 1;
+    else if (c >= 0x40 && c <= 0x7F)     m->start_line = c & 0x3F;
+    else if (c == 0x81)                  m->contrast = m->cmd[1];
+    else if (c == 0x20)                  m->mode = m->cmd[1] & 0x03;
+    else if (c == 0x21) {
+        m->col_start = m->col = m->cmd[1] & 0x7F;
+        m->col_end = m->cmd[2] & 0x7F;
+    } else if (c == 0x22) {
+        m->page_start = m->page = m->cmd[1] & 0x07;
+        m->page_end = m->cmd[2] & 0x07;
+    }
+    else if (c >= 0xB0 && c <= 0xB7)     m->page = c & 0x07;
+    else if (c <= 0x0F)                  m->col = (m->col & 0xF0) | c;
+    else if (c >= 0x10 && c <= 0x1F)     m->col = (uint8_t)(((c & 0x07) << 4) | (m->col & 0x0F));
+}
+
+static void ssd_data(i2c_sim_ssd1306_t *m, uint8_t b) {
+    m->gddram[m->page][m->col] = b;
+    m->data_bytes++;
+    switch (m->mode) {
+        case 0:     // horizontal
+            if (m->col++ >= m->col_end) {
+                m->col = m->col_start;
+                m->page = (m->page >= m->page_end) ? m->page_start : m->page + 1;
+            }
+            break;
+        case 1:     // vertical
+            if (m->page++ >= m->page_end) {
+                m->page = m->page_start;
+                m->col = (m->col >= m->col_end) ? m->col_start : m->col + 1;
+            }
+            break;
+        default:    // page
+            m->col = (m->col + 1) & 0x7F;
+            break;
+    }
+}
+
+static void ssd_start(i2c_sim_device_t *dev, bool read) {
+    i2c_sim_ssd1306_t *m = (i2c_sim_ssd1306_t *)dev;
+    m->expect_control = true;
+    m->cmd_len = m->cmd_need = 0;
+    (void)read;
+}
+
+static size_t ssd_write(i2c_sim_device_t *dev, const uint8_t *src, size_t len) {
+    i2c_sim_ssd1306_t *m = (i2c_sim_ssd1306_t *)dev;
+    for (size_t i = 0; i < len; ++i) {
+        uint8_t b = src[i];
+        if (m->expect_control) {
+            m->control = b;
+            m->expect_control = false;
+            continue;
+        }
+        if (m->control & 0x40) {
+            ssd_data(m, b);
+        } else {
+            m->commands++;
+            if (m->cmd_need == 0) {
+                m->cmd_len = 0;
+                m->cmd_need = 1 + ssd_args(b);
+            }
+            if (m->cmd_len < sizeof(m->cmd)) m->cmd[m->cmd_len] = b;
+            if (++m->cmd_len == m->cmd_need) {
+                ssd_command(m);
+                m->cmd_need = 0;
+            }
+        }
+        // Co = 1: only this byte belonged to the control byte
+        if (m->control & 0x80) m->expect_control = true;
+    }
+    return len;
+}
+
+void i2c_sim_ssd1306_init(i2c_sim_ssd1306_t *m) {
+    memset(m, 0, sizeof(*m));
+    m->dev.addr = SSD1306_I2C_ADDRESS;
+    m->dev.start = ssd_start;
+    m->dev.write = ssd_write;
+    m->mode = 2;            // page addressing after reset
+    m->col_end = 127;
+    m->page_end = 7;
+    m->contrast = 0x7F;
+}
+
+bool i2c_sim_ssd1306_pixel(const i2c_sim_ssd1306_t *m, uint8_t x, uint8_t y) {
+    if (x >= 128 || y >= 64) return false;
+    return (m->gddram[y >> 3][x] >> (y & 7)) & 1;
+}
@@ -0,0 +1,132 @@
+/*
+
+Version 0.84
+
+MIT License
+
+Copyright (c) 2025 Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <tkjhat/i2c_trace.h>
+
+#if TKJHAT_I2C_TRACE
+
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+#include "pico/sync.h"
+
+_Static_assert((TKJHAT_I2C_TRACE_DEPTH & (TKJHAT_I2C_TRACE_DEPTH - 1)) == 0,
+               "TKJHAT_I2C_TRACE_DEPTH must be a power of two");
+
+static i2c_trace_entry_t ring[TKJHAT_I2C_TRACE_DEPTH];
+static uint32_t head;           // total entries written
+static volatile bool enabled = true;
+static volatile uint8_t dumping;    // dumps in progress; recording pauses, enabled is left alone
+
+// Entries are written from tasks on both cores and from the I2C interrupt.
+// The lock is set up once by i2c_trace_init(), before any of them run;
+// until then nothing is recorded.
+static critical_section_t lock;
+static volatile bool lock_ready;
+
+void i2c_trace_init(void) {
+    if (lock_ready) return;
+    critical_section_init(&lock);
+    lock_ready = true;
+}
+
+void i2c_trace_record(uint8_t addr, uint8_t flags, size_t len,
+                      uint64_t start_us, uint64_t end_us, int result) {
+    if (!enabled || dumping || !lock_ready) return;
+    critical_section_enter_blocking(&lock);
+    if (!enabled || dumping) {  // paused since the check above
+        critical_section_exit(&lock);
+        return;
+    }
+    i2c_trace_entry_t *e = &ring[head & (TKJHAT_I2C_TRACE_DEPTH - 1)];
+    e->t_us = (uint32_t)start_us;
+    e->dur_us = (uint32_t)(end_us - start_us);
+    e->len = len > UINT16_MAX ? UINT16_MAX : (uint16_t)len;
+    e->addr = addr;
+    e->flags = flags;
+    e->result = (int16_t)result;
+    e->seq = (uint16_t)head;
+    head++;
+    critical_section_exit(&lock);
+}
+
+void i2c_trace_enable(bool enable) {
+    enabled = enable;
+}
+
+void i2c_trace_clear(void) {
+    if (!lock_ready) return;
+    critical_section_enter_blocking(&lock);
+    head = 0;
+    critical_section_exit(&lock);
+}
+
+size_t i2c_trace_snapshot(i2c_trace_entry_t *dst, size_t max) {
+    if (!lock_ready) return 0;
+    critical_section_enter_blocking(&lock);
+    uint32_t count = head < TKJHAT_I2C_TRACE_DEPTH ? head : TKJHAT_I2C_TRACE_DEPTH;
+    if (count > max) count = max;
+    uint32_t first = head - count;
+    for (uint32_t i = 0; i < count; ++i)
+        dst[i] = ring[(first + i) & (TKJHAT_I2C_TRACE_DEPTH - 1)];
+    critical_section_exit(&lock);
+    return count;
+}
+
+void i2c_trace_dump(i2c_trace_print_t print) {
+    char line[80];
+    if (!lock_ready) return;
+    // Under the lock: a record in progress finishes first, and any later one
+    // sees the dump. A separate count, so i2c_trace_enable() calls made by
+    // other tasks meanwhile still hold afterwards
+    critical_section_enter_blocking(&lock);
+    dumping++;
+    critical_section_exit(&lock);
+
+    uint32_t total = head;
+    uint32_t count = total < TKJHAT_I2C_TRACE_DEPTH ? total : TKJHAT_I2C_TRACE_DEPTH;
+    print("# tkjhat i2c trace v1\n");
+    snprintf(line, sizeof(line), "# recorded=%lu kept=%lu\n",
+             (unsigned long)total, (unsigned long)count);
+    print(line);
+    print("t_us,dur_us,addr,dir,len,result,flags\n");
+
+    // Recording is paused, so the ring can be read without the lock
+    for (uint32_t i = total - count; i != total; ++i) {
+        const i2c_trace_entry_t *e = &ring[i & (TKJHAT_I2C_TRACE_DEPTH - 1)];
+        snprintf(line, sizeof(line), "%lu,%lu,0x%02X,%c,%u,%d,%u\n",
+                 (unsigned long)e->t_us, (unsigned long)e->dur_us, e->addr,
+                 (e->flags & I2C_TRACE_READ) ? 'R' : 'W', e->len, e->result, e->flags);
+        print(line);
+    }
+
+    critical_section_enter_blocking(&lock);
+    dumping--;
+    critical_section_exit(&lock);
+}
+
+#endif /* TKJHAT_I2C_TRACE */
@@ -0,0 +1,72 @@
+/*
+
+Version 0.84
+
+MIT License
+
+Copyright (c) 2025 Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <tkjhat/imu_fixed.h>
+
+// Largest shift keeping k below 2^16: |count| <= 2^15, so count * k fits in int32
+static void scale_from_sensitivity(float counts_per_unit, int32_t *k, uint8_t *shift) {
+    if (counts_per_unit <= 0.0f) {
+        *k = 0;
+        *shift = 0;
+        return;
+    }
+    float f = 65536.0f / counts_per_unit;
+    uint8_t sh = 0;
+    while (sh < 30 && f * 2.0f < 65536.0f) {
+        f *= 2.0f;
+        sh++;
+    }
+    *k = (int32_t)(f + 0.5f);
+    *shift = sh;
+}
+
+void ICM42670_scale_set_accel(ICM42670_scale_t *scale, float counts_per_g) {
+    scale_from_sensitivity(counts_per_g, &scale->accel_k, &scale->accel_shift);
+    scale->accel_inv = counts_per_g > 0.0f ? 1.0f / counts_per_g : 0.0f;
+}
+
+void ICM42670_scale_set_gyro(ICM42670_scale_t *scale, float counts_per_dps) {
+    scale_from_sensitivity(counts_per_dps, &scale->gyro_k, &scale->gyro_shift);
+    scale->gyro_inv = counts_per_dps > 0.0f ? 1.0f / counts_per_dps : 0.0f;
+}
+
+// Right shift of a negative value is arithmetic with GCC on ARM and x86
+void ICM42670_convert_q16(const ICM42670_scale_t *scale, const ICM42670_raw_t *raw,
+                          ICM42670_q16_t *out, size_t n) {
+    const int32_t ak = scale->accel_k, gk = scale->gyro_k;
+    const uint8_t as = scale->accel_shift, gs = scale->gyro_shift;
+    for (size_t i = 0; i < n; ++i) {
+        out[i].accel[0] = (raw[i].accel[0] * ak) >> as;
+        out[i].accel[1] = (raw[i].accel[1] * ak) >> as;
+        out[i].accel[2] = (raw[i].accel[2] * ak) >> as;
+        out[i].gyro[0] = (raw[i].gyro[0] * gk) >> gs;
+        out[i].gyro[1] = (raw[i].gyro[1] * gk) >> gs;
+        out[i].gyro[2] = (raw[i].gyro[2] * gk) >> gs;
+        // counts / 128 + 25 °C
+        out[i].temp = raw[i].temp * 512 + (25 << 16);
+    }
+}
@@ -0,0 +1,197 @@
+/*
+
+Version 0.84
+
+MIT License
+
+Copyright (c) 2025 Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <tkjhat/imu_fusion.h>
+
+#define Q30_ONE         (1 << 30)
+#define Q16_ONE         (1 << 16)
+#define DEG2RAD_Q30     18740330        // pi / 180
+#define ACCEL_MIN_Q16   (Q16_ONE / 2)   // tilt correction only between 0.5 g ...
+#define ACCEL_MAX_Q16   (Q16_ONE * 3 / 2)   // ... and 1.5 g
+#define BIAS_ERR_MAX    (Q30_ONE / 10)  // bias learnt only once the tilt error is below ~6 deg
+
+static inline int32_t mul30(int32_t a, int32_t b) {
+    return (int32_t)(((int64_t)a * b) >> 30);
+}
+
+static uint32_t isqrt64(uint64_t x) {
+    uint64_t res = 0, bit = 1ull << 62;
+    while (bit > x) bit >>= 2;
+    while (bit) {
+        if (x >= res + bit) {
+            x -= res + bit;
+            res = (res >> 1) + bit;
+        } else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)res;
+}
+
+// atan2 in degrees, Q16. Octant reduction and
+// atan(z) ~ pi/4 z - z (z - 1) (0.2447 + 0.0663 z), error below 0.1 deg
+static int32_t atan2_deg(int32_t y, int32_t x) {
+    if (x == 0 && y == 0) return 0;
+    uint32_t ax = x < 0 ? -(uint32_t)x : (uint32_t)x;
+    uint32_t ay = y < 0 ? -(uint32_t)y : (uint32_t)y;
+    bool steep = ay > ax;
+    int64_t z = steep ? ((int64_t)ax << 16) / ay : ((int64_t)ay << 16) / ax;
+    int64_t c = 918825 + ((248953 * z) >> 16);        // 14.0203 + 3.7987 z degrees
+    int32_t t = (int32_t)(45 * z - ((((z * (z - Q16_ONE)) >> 16) * c) >> 16));
+    if (steep) t = 90 * Q16_ONE - t;
+    if (x < 0) t = 180 * Q16_ONE - t;
+    return y < 0 ? -t : t;
+}
+
+// Gravity direction in sensor axes (third row of the rotation matrix), Q30
+static void gravity_q30(const imu_quat_t *q, int32_t v[3]) {
+    v[0] = 2 * (mul30(q->x, q->z) - mul30(q->w, q->y));
+    v[1] = 2 * (mul30(q->w, q->x) + mul30(q->y, q->z));
+    v[2] = mul30(q->w, q->w) - mul30(q->x, q->x) - mul30(q->y, q->y) + mul30(q->z, q->z);
+}
+
+// Unit vector of the acceleration (Q30) and its norm (Q16)
+static uint32_t accel_unit(const int32_t a[3], int32_t u[3]) {
+    uint64_t n2 = (uint64_t)((int64_t)a[0] * a[0] + (int64_t)a[1] * a[1] + (int64_t)a[2] * a[2]);
+    uint32_t norm = isqrt64(n2);
+    if (norm == 0) return 0;
+    for (int i = 0; i < 3; ++i)
+        u[i] = (int32_t)(((int64_t)a[i] << 30) / norm);
+    return norm;
+}
+
+// Orientation with zero yaw whose gravity direction is u
+static void quat_from_gravity(const int32_t u[3], imu_quat_t *q) {
+    int64_t half = ((int64_t)Q30_ONE + u[2]) << 29;    // (1 + uz) / 2, Q60
+    if (half < (1ll << 40)) {                           // upside down: 180 deg about X
+        *q = (imu_quat_t){ 0, Q30_ONE, 0, 0 };
+        return;
+    }
+    int32_t w = (int32_t)isqrt64((uint64_t)half);
+    q->w = w;
+    q->x = (int32_t)(((int64_t)u[1] << 29) / w);
+    q->y = (int32_t)(-((int64_t)u[0] << 29) / w);
+    q->z = 0;
+}
+
+void imu_fusion_init(imu_fusion_t *f, int32_t kp, int32_t ki) {
+    *f = (imu_fusion_t){ .q = { Q30_ONE, 0, 0, 0 }, .kp = kp, .ki = ki };
+}
+
+void imu_fusion_update(imu_fusion_t *f, const ICM42670_q16_t *s, uint64_t time_us) {
+    int32_t u[3];
+    uint32_t norm = accel_unit(s->accel, u);
+
+    if (!f->started) {
+        if (norm == 0) return;
+        quat_from_gravity(u, &f->q);
+        f->last_us = time_us;
+        f->started = true;
+        f->updates++;
+        return;
+    }
+
+    uint64_t dt_us = time_us - f->last_us;
+    f->last_us = time_us;
+    if (dt_us > IMU_FUSION_MAX_DT_US) dt_us = IMU_FUSION_MAX_DT_US;
+    // seconds in Q32: 2^32 / 10^6 = 281474977 / 2^16
+    uint32_t dt = (uint32_t)((dt_us * 281474977ull) >> 16);
+
+    // Angular rate in rad/s, Q16
+    int32_t w[3];
+    for (int i = 0; i < 3; ++i)
+        w[i] = (int32_t)(((int64_t)s->gyro[i] * DEG2RAD_Q30) >> 30);
+
+    if (norm >= ACCEL_MIN_Q16 && norm <= ACCEL_MAX_Q16) {
+        // Tilt error: measured x estimated gravity direction
+        int32_t v[3], e[3];
+        gravity_q30(&f->q, v);
+        e[0] = mul30(u[1], v[2]) - mul30(u[2], v[1]);
+        e[1] = mul30(u[2], v[0]) - mul30(u[0], v[2]);
+        e[2] = mul30(u[0], v[1]) - mul30(u[1], v[0]);
+        // A large error is a transient (start-up, shock), not bias: do not wind up
+        bool learn = f->ki && e[0] < BIAS_ERR_MAX && e[0] > -BIAS_ERR_MAX &&
+                     e[1] < BIAS_ERR_MAX && e[1] > -BIAS_ERR_MAX &&
+                     e[2] < BIAS_ERR_MAX && e[2] > -BIAS_ERR_MAX;
+        for (int i = 0; i < 3; ++i) {
+            if (learn) {
+                int64_t rate = ((int64_t)f->ki * e[i]) >> 16;   // rad/s^2, Q30
+                f->bias[i] += (int32_t)((rate * dt) >> 32);
+            }
+            w[i] += (int32_t)(((int64_t)f->kp * e[i]) >> 30) + (f->bias[i] >> 14);
+        }
+    } else {
+        f->accel_rejected++;
+        for (int i = 0; i < 3; ++i) w[i] += f->bias[i] >> 14;
+    }
+
+    // q += q * (0, w dt / 2)
+    int32_t hx = (int32_t)(((int64_t)w[0] * dt) >> 19);
+    int32_t hy = (int32_t)(((int64_t)w[1] * dt) >> 19);
+    int32_t hz = (int32_t)(((int64_t)w[2] * dt) >> 19);
+    imu_quat_t q = f->q;
+    f->q.w = q.w - mul30(q.x, hx) - mul30(q.y, hy) - mul30(q.z, hz);
+    f->q.x = q.x + mul30(q.w, hx) + mul30(q.y, hz) - mul30(q.z, hy);
+    f->q.y = q.y + mul30(q.w, hy) - mul30(q.x, hz) + mul30(q.z, hx);
+    f->q.z = q.z + mul30(q.w, hz) + mul30(q.x, hy) - mul30(q.y, hx);
+
+    // Renormalize: |q| stays close to 1, so one Newton step of 1/sqrt is enough
+    int64_t n2 = (int64_t)f->q.w * f->q.w + (int64_t)f->q.x * f->q.x +
+                 (int64_t)f->q.y * f->q.y + (int64_t)f->q.z * f->q.z;
+    int32_t inv = (int32_t)((3 * (int64_t)Q30_ONE - (n2 >> 30)) >> 1);
+    f->q.w = mul30(f->q.w, inv);
+    f->q.x = mul30(f->q.x, inv);
+    f->q.y = mul30(f->q.y, inv);
+    f->q.z = mul30(f->q.z, inv);
+    f->updates++;
+}
+
+void imu_fusion_euler(const imu_fusion_t *f, int32_t *roll, int32_t *pitch, int32_t *yaw) {
+    const imu_quat_t *q = &f->q;
+    *roll = atan2_deg(2 * (mul30(q->w, q->x) + mul30(q->y, q->z)),
+                      Q30_ONE - 2 * (mul30(q->x, q->x) + mul30(q->y, q->y)));
+    int32_t sp = 2 * (mul30(q->w, q->y) - mul30(q->z, q->x));
+    if (sp > Q30_ONE) sp = Q30_ONE;
+    if (sp < -Q30_ONE) sp = -Q30_ONE;
+    int32_t cp = (int32_t)isqrt64((uint64_t)(((int64_t)1 << 60) - (int64_t)sp * sp));
+    *pitch = atan2_deg(sp, cp);
+    *yaw = atan2_deg(2 * (mul30(q->w, q->z) + mul30(q->x, q->y)),
+                     Q30_ONE - 2 * (mul30(q->y, q->y) + mul30(q->z, q->z)));
+}
+
+void imu_fusion_gravity(const imu_fusion_t *f, int32_t g[3]) {
+    int32_t v[3];
+    gravity_q30(&f->q, v);
+    for (int i = 0; i < 3; ++i) g[i] = v[i] >> 14;
+}
+
+void imu_fusion_linear_accel(const imu_fusion_t *f, const ICM42670_q16_t *s, int32_t lin[3]) {
+    int32_t g[3];
+    imu_fusion_gravity(f, g);
+    for (int i = 0; i < 3; ++i) lin[i] = s->accel[i] - g[i];
+}
@@ -0,0 +1,394 @@
+/*
+
+Version 0.84
+
+MIT License
+
+Copyright (c) 2025 Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <string.h>
+
+#include <tkjhat/raster.h>
+
+// Larger coordinates would overflow the 64-bit Bresenham start-up terms
+#define COORD_MAX   (1 << 28)
+
+// Spans are kept as lo > hi when empty
+static inline void span_mark(uint8_t *lo, uint8_t *hi, uint32_t pg, uint32_t x0, uint32_t x1) {
+    if (!lo) return;
+    if (x0 < lo[pg]) lo[pg] = (uint8_t)x0;
+    if (x1 > hi[pg]) hi[pg] = (uint8_t)x1;
+}
+
+static inline void mark(const raster_t *r, uint32_t pg, uint32_t x0, uint32_t x1, bool on) {
+    span_mark(r->dirty_lo, r->dirty_hi, pg, x0, x1);
+    if (on) span_mark(r->ink_lo, r->ink_hi, pg, x0, x1);
+}
+
+// Coordinates already inside the buffer
+static inline void plot(const raster_t *r, uint32_t x, uint32_t y, bool on) {
+    uint8_t *b = &r->buf[(y >> 3) * r->width + x];
+    uint8_t m = (uint8_t)(1u << (y & 7));
+    uint8_t v = on ? (uint8_t)(*b | m) : (uint8_t)(*b & ~m);
+    if (v != *b) {
+        *b = v;
+        mark(r, y >> 3, x, x, on);
+    }
+}
+
+// Sort [a, b] and clip it to [0, n - 1]; false if nothing is left
+static bool clip(int32_t *a, int32_t *b, uint32_t n) {
+    if (*a > *b) { int32_t t = *a; *a = *b; *b = t; }
+    if (*b < 0 || *a >= (int32_t)n) return false;
+    if (*a < 0) *a = 0;
+    if (*b >= (int32_t)n) *b = (int32_t)n - 1;
+    return true;
+}
+
+// Last coordinate of a run of n pixels starting at a, saturated to int32
+static inline int32_t run_end(int32_t a, int32_t n) {
+    int64_t e = (int64_t)a + n - 1;
+    return e > INT32_MAX ? INT32_MAX : (int32_t)e;
+}
+
+// Bits of page pg covered by rows y0..y1
+static inline uint8_t page_mask(uint32_t pg, uint32_t y0, uint32_t y1) {
+    uint8_t m = 0xFF;
+    if (pg == y0 >> 3) m &= (uint8_t)(0xFF << (y0 & 7));
+    if (pg == y1 >> 3) m &= (uint8_t)(0xFF >> (7 - (y1 & 7)));
+    return m;
+}
+
+// Apply mask to columns x0..x1 of page pg
+static void page_span(const raster_t *r, uint32_t pg, uint32_t x0, uint32_t x1, uint8_t mask, bool on) {
+    uint8_t *b = r->buf + pg * r->width;
+    if (mask == 0xFF) {
+        memset(b + x0, on ? 0xFF : 0x00, x1 - x0 + 1);
+        mark(r, pg, x0, x1, on);
+        return;
+    }
+    // Track whether any byte changed, so redrawing a span costs no bus bytes
+    uint8_t seen;
+    if (on) {
+        seen = 0xFF;
+        for (uint32_t x = x0; x <= x1; ++x) {
+            seen &= b[x];
+            b[x] |= mask;
+        }
+        if ((seen & mask) == mask) return;
+    } else {
+        seen = 0;
+        for (uint32_t x = x0; x <= x1; ++x) {
+            seen |= b[x];
+            b[x] &= (uint8_t)~mask;
+        }
+        if (!(seen & mask)) return;
+    }
+    mark(r, pg, x0, x1, on);
+}
+
+void raster_pixel(const raster_t *r, int32_t x, int32_t y, bool on) {
+    if ((uint32_t)x >= r->width || (uint32_t)y >= r->height) return;
+    plot(r, (uint32_t)x, (uint32_t)y, on);
+}
+
+void raster_hline(const raster_t *r, int32_t x0, int32_t x1, int32_t y, bool on) {
+    if ((uint32_t)y >= r->height || !clip(&x0, &x1, r->width)) return;
+    page_span(r, (uint32_t)y >> 3, (uint32_t)x0, (uint32_t)x1, (uint8_t)(1u << (y & 7)), on);
+}
+
+void raster_vline(const raster_t *r, int32_t x, int32_t y0, int32_t y1, bool on) {
+    if ((uint32_t)x >= r->width || !clip(&y0, &y1, r->height)) return;
+    for (uint32_t pg = (uint32_t)y0 >> 3; pg <= (uint32_t)y1 >> 3; ++pg) {
+        uint8_t m = page_mask(pg, (uint32_t)y0, (uint32_t)y1);
+        uint8_t *b = &r->buf[pg * r->width + (uint32_t)x];
+        uint8_t v = on ? (uint8_t)(*b | m) : (uint8_t)(*b & ~m);
+        if (v != *b) {
+            *b = v;
+            mark(r, pg, (uint32_t)x, (uint32_t)x, on);
+        }
+    }
+}
+
+void raster_fill_rect(const raster_t *r, int32_t x, int32_t y, int32_t w, int32_t h, bool on) {
+    if (w <= 0 || h <= 0) return;
+    int32_t x1 = run_end(x, w), y1 = run_end(y, h);
+    if (!clip(&x, &x1, r->width) || !clip(&y, &y1, r->height)) return;
+    for (uint32_t pg = (uint32_t)y >> 3; pg <= (uint32_t)y1 >> 3; ++pg)
+        page_span(r, pg, (uint32_t)x, (uint32_t)x1, page_mask(pg, (uint32_t)y, (uint32_t)y1), on);
+}
+
+void raster_rect(const raster_t *r, int32_t x, int32_t y, int32_t w, int32_t h, bool on) {
+    if (w <= 0 || h <= 0) return;
+    int32_t x1 = run_end(x, w), y1 = run_end(y, h);
+    raster_hline(r, x, x1, y, on);
+    raster_hline(r, x, x1, y1, on);
+    raster_vline(r, x, y, y1, on);
+    raster_vline(r, x1, y, y1, on);
+}
+
+void raster_line(const raster_t *r, int32_t x0, int32_t y0, int32_t x1, int32_t y1, bool on) {
+    if (y0 == y1) { raster_hline(r, x0, x1, y0, on); return; }
+    if (x0 == x1) { raster_vline(r, x0, y0, y1, on); return; }
+    if (x0 < -COORD_MAX || x0 > COORD_MAX || x1 < -COORD_MAX || x1 > COORD_MAX ||
+        y0 < -COORD_MAX || y0 > COORD_MAX || y1 < -COORD_MAX || y1 > COORD_MAX)
+        return;
+
+    // Step along the major axis (a), increasing; b is the minor axis
+    int32_t adx = x1 > x0 ? x1 - x0 : x0 - x1;
+    int32_t ady = y1 > y0 ? y1 - y0 : y0 - y1;
+    bool steep = ady > adx;
+    int32_t a0 = steep ? y0 : x0, b0 = steep ? x0 : y0;
+    int32_t a1 = steep ? y1 : x1, b1 = steep ? x1 : y1;
+    if (a0 > a1) {
+        int32_t t = a0; a0 = a1; a1 = t;
+        t = b0; b0 = b1; b1 = t;
+    }
+    int32_t da = a1 - a0;
+    int32_t db = b1 > b0 ? b1 - b0 : b0 - b1;
+    int32_t sb = b1 > b0 ? 1 : -1;
+    int32_t na = steep ? r->height : r->width;
+    int32_t nb = steep ? r->width : r->height;
+
+    // Steps k0..k1 have the major coordinate on screen
+    int64_t k0 = a0 < 0 ? -(int64_t)a0 : 0;
+    int64_t k1 = a1 >= na ? (int64_t)na - 1 - a0 : da;
+
+    // After k steps the minor offset is j(k) = ceil((2*db*k - da) / (2*da)),
+    // at least 0. Narrow k0..k1 to the steps where it is on screen too:
+    // j(k) >= J  <=>  k >= floor(da*(2J-1) / (2*db)) + 1   (J > 0)
+    // j(k) <= J  <=>  k <= floor(da*(2J+1) / (2*db))
+    int64_t jmin = sb > 0 ? -(int64_t)b0 : (int64_t)b0 - nb + 1;
+    int64_t jmax = sb > 0 ? (int64_t)nb - 1 - b0 : b0;
+    if (jmax < 0) return;
+    if (jmin > 0) {
+        int64_t k = (int64_t)da * (2 * jmin - 1) / (2 * (int64_t)db) + 1;
+        if (k > k0) k0 = k;
+    }
+    int64_t k = (int64_t)da * (2 * jmax + 1) / (2 * (int64_t)db);
+    if (k < k1) k1 = k;
+    if (k0 > k1) return;
+
+    // Bresenham state at step k0, without stepping there
+    int64_t n = 2 * (int64_t)db * k0 - da;
+    int64_t j = n > 0 ? (n + 2 * (int64_t)da - 1) / (2 * (int64_t)da) : 0;
+    int32_t err = (int32_t)(2 * (int64_t)db * (k0 + 1) - da - 2 * (int64_t)da * j);
+    uint32_t a = (uint32_t)(a0 + k0), b = (uint32_t)(b0 + sb * (int32_t)j);
+    uint32_t steps = (uint32_t)(k1 - k0) + 1;
+
+    // Every pixel from here is on screen. Marking is per page segment
+    // (the line crosses each page once), written when the page changes.
+    const uint8_t set = on ? 0xFF : 0x00;
+    uint32_t x = steep ? b : a, y = steep ? a : b;
+    uint32_t pg = y >> 3, seg_x0 = x;
+    uint8_t *p = &r->buf[pg * r->width + x];
+    uint8_t m = (uint8_t)(1u << (y & 7));
+    uint8_t changed = 0;
+
+#define PLOT() do { \
+        uint8_t v_ = (uint8_t)((*p & ~m) | (set & m)); \
+        changed |= v_ ^ *p; \
+        *p = v_; \
+    } while (0)
+#define NEXT_ROW() do { \
+        if (sb > 0) { m = (uint8_t)(m << 1); if (!m) { m = 0x01; p += r->width; } } \
+        else        { m >>= 1;               if (!m) { m = 0x80; p -= r->width; } } \
+    } while (0)
+#define PAGE_DONE(xlast) do { \
+        if (changed) mark(r, pg, seg_x0 < (xlast) ? seg_x0 : (xlast), seg_x0 < (xlast) ? (xlast) : seg_x0, on); \
+        changed = 0; \
+    } while (0)
+
+    if (!steep) {
+        // One column per step, the row moves by at most one
+        for (;;) {
+            PLOT();
+            if (--steps == 0) break;
+            if (err > 0) {
+                err -= 2 * da;
+                NEXT_ROW();
+                if (m == (sb > 0 ? 0x01 : 0x80)) {
+                    PAGE_DONE(x);
+                    pg += sb;
+                    seg_x0 = x + 1;
+                }
+            }
+            err += 2 * db;
+            ++p;
+            ++x;
+        }
+        PAGE_DONE(x);
+    } else {
+        // One row per step, the column moves by at most one
+        for (;;) {
+            PLOT();
+            if (--steps == 0) break;
+            uint32_t xl = x;
+            if (err > 0) {
+                err -= 2 * da;
+                p += sb;
+                x += sb;
+            }
+            err += 2 * db;
+            m = (uint8_t)(m << 1);
+            if (!m) {
+                m = 0x01;
+                PAGE_DONE(xl);
+                p += r->width;
+                ++pg;
+                seg_x0 = x;
+            }
+        }
+        PAGE_DONE(x);
+    }
+#undef PLOT
+#undef NEXT_ROW
+#undef PAGE_DONE
+}
+
+// Font header: height, width, spacing, first and last character, then per
+// character width columns of (height + 7) / 8 bytes each
+#define FONT_DATA   5
+
+_Static_assert((RASTER_GLYPH_CACHE & (RASTER_GLYPH_CACHE - 1)) == 0,
+               "RASTER_GLYPH_CACHE must be a power of two");
+
+// Column w of glyph index g, parts bytes (at most 4) joined, bit 0 on top
+static inline uint32_t font_column(const uint8_t *font, uint32_t parts, uint32_t g, uint32_t w) {
+    const uint8_t *d = font + FONT_DATA + (g * font[1] + w) * parts;
+    uint32_t v = 0;
+    for (uint32_t i = 0; i < parts; ++i) v |= (uint32_t)d[i] << (8 * i);
+    return v;
+}
+
+// Repeat every bit scale times; the result must fit in 32 bits
+static uint32_t stretch(uint32_t bits, uint32_t scale) {
+    uint32_t v = 0, run = (1u << scale) - 1;
+    for (uint32_t j = 0; bits; ++j, bits >>= 1)
+        if (bits & 1) v |= run << (j * scale);
+    return v;
+}
+
+// Columns of glyph c from the cache, expanding them on a miss
+static const uint32_t *glyph_columns(raster_glyph_cache_t *cache, raster_glyph_t *tmp,
+                                     const uint8_t *font, uint32_t parts, uint8_t c, uint32_t scale) {
+    raster_glyph_t *g = tmp;
+    if (cache) {
+        g = &cache->slot[(c + 7u * scale) & (RASTER_GLYPH_CACHE - 1)];
+        if (g->font == font && g->c == c && g->scale == scale) return g->col;
+    }
+    for (uint32_t w = 0; w < font[1]; ++w) {
+        uint32_t bits = font_column(font, parts, (uint32_t)(c - font[3]), w);
+        g->col[w] = scale == 1 ? bits : stretch(bits, scale);
+    }
+    g->font = font;
+    g->c = c;
+    g->scale = (uint8_t)scale;
+    return g->col;
+}
+
+// Filled rectangle given in 64 bits, clipped before it is narrowed
+static void fill64(const raster_t *r, int64_t x, int64_t y, int64_t w, int64_t h) {
+    int64_t x1 = x + w - 1, y1 = y + h - 1;
+    if (x < 0) x = 0;
+    if (y < 0) y = 0;
+    if (x1 >= r->width) x1 = r->width - 1;
+    if (y1 >= r->height) y1 = r->height - 1;
+    if (x > x1 || y > y1) return;
+    raster_fill_rect(r, (int32_t)x, (int32_t)y, (int32_t)(x1 - x + 1), (int32_t)(y1 - y + 1), true);
+}
+
+void raster_char(const raster_t *r, raster_glyph_cache_t *cache, int32_t x, int32_t y,
+                 uint32_t scale, const uint8_t *font, char c) {
+    uint8_t ch = (uint8_t)c;
+    if (ch < font[3] || ch > font[4] || scale == 0) return;
+    uint32_t parts = ((uint32_t)font[0] + 7) >> 3, rows = parts * 8;
+    if (x >= (int32_t)r->width || y >= (int32_t)r->height ||
+        x + (int64_t)font[1] * scale <= 0 || y + (int64_t)rows * scale <= 0)
+        return;
+
+    if (font[1] > RASTER_GLYPH_MAX_W || rows * scale > 32) {
+        // Big glyphs: one rectangle per run of set bits in a column
+        for (uint32_t w = 0; w < font[1]; ++w) {
+            const uint8_t *d = font + FONT_DATA + ((uint32_t)(ch - font[3]) * font[1] + w) * parts;
+            int64_t gx = x + (int64_t)w * scale;
+            if (gx >= r->width) break;
+            uint32_t j = 0;
+            while (j < rows) {
+                if (!((d[j >> 3] >> (j & 7)) & 1)) { ++j; continue; }
+                uint32_t j0 = j;
+                while (j < rows && ((d[j >> 3] >> (j & 7)) & 1)) ++j;
+                fill64(r, gx, y + (int64_t)j0 * scale, scale, (int64_t)(j - j0) * scale);
+            }
+        }
+        return;
+    }
+
+    // Stretching a scale 2 column is about as cheap as the cache lookup
+    // and keeps the cache for the bigger glyphs, so only 3 and up use it
+    raster_glyph_t tmp;
+    const uint32_t *col = glyph_columns(scale > 2 ? cache : NULL, &tmp, font, parts, ch, scale);
+
+    // Rows above the top edge are shifted out (fewer than 32, the glyph is
+    // partly visible); the rest start at row y0
+    uint32_t cut = 0, y0 = (uint32_t)y, pages = r->height >> 3;
+    if (y < 0) {
+        cut = (uint32_t)-y;
+        y0 = 0;
+    }
+    uint32_t pg0 = y0 >> 3, shift = y0 & 7;
+    uint32_t np = pages - pg0 < 5 ? pages - pg0 : 5;
+    uint32_t lo = UINT32_MAX, hi = 0, changed = 0;
+    for (uint32_t w = 0; w < font[1]; ++w) {
+        int64_t cx0 = x + (int64_t)w * scale, cx1 = cx0 + scale - 1;
+        if (cx0 >= r->width) break;
+        if (cx1 < 0) continue;
+        if (cx0 < 0) cx0 = 0;
+        if (cx1 >= r->width) cx1 = r->width - 1;
+        // One byte per page, two when y0 is not page aligned
+        uint64_t v = (uint64_t)(col[w] >> cut) << shift;
+        uint8_t *b = r->buf + pg0 * r->width;
+        for (uint32_t i = 0; v && i < np; ++i, v >>= 8, b += r->width) {
+            uint8_t m = (uint8_t)v;
+            if (!m) continue;
+            for (uint32_t cx = (uint32_t)cx0; cx <= (uint32_t)cx1; ++cx) {
+                if ((b[cx] & m) == m) continue;
+                b[cx] |= m;
+                changed |= 1u << i;
+                if (cx < lo) lo = cx;
+                if (cx > hi) hi = cx;
+            }
+        }
+    }
+    // One span per page: from the first to the last column that changed
+    for (uint32_t i = 0; changed; ++i, changed >>= 1)
+        if (changed & 1) mark(r, pg0 + i, lo, hi, true);
+}
+
+int32_t raster_text(const raster_t *r, raster_glyph_cache_t *cache, int32_t x, int32_t y,
+                    uint32_t scale, const uint8_t *font, const char *s) {
+    int64_t cx = x, adv = ((int64_t)font[1] + font[2]) * scale;
+    for (; *s; ++s, cx += adv) {
+        if (cx < r->width) raster_char(r, cache, (int32_t)cx, y, scale, font, *s);
+    }
+    return cx > INT32_MAX ? INT32_MAX : (int32_t)cx;
+}
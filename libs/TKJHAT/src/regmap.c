@@ -0,0 +1,199 @@
+/*
+
+Version 0.84
+
+MIT License
+
+Copyright (c) 2025 Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <tkjhat/regmap.h>
+#include <tkjhat/i2c_bus.h>
+
+#include "pico/stdlib.h"
+
+#define BIT(i)  (1u << (i))
+
+static int find_reg(const regmap_t *map, uint8_t reg) {
+    for (int i = 0; i < map->count; ++i)
+        if (map->regs[i].reg == reg) return i;
+    return -1;
+}
+
+static inline bool cached(const regmap_t *map, int i) {
+    return !(map->regs[i].flags & REGMAP_VOLATILE);
+}
+
+// Entry i and i-1 are adjacent registers that may share a burst.
+static inline bool burst_joins(const regmap_t *map, int i) {
+    return map->regs[i].reg == map->regs[i - 1].reg + 1 &&
+           !(map->regs[i].flags & (REGMAP_VOLATILE | REGMAP_WRITE_LAST));
+}
+
+static int bus_write(regmap_t *map, const uint8_t *buf, size_t len) {
+    map->transactions++;
+    int rc = i2c_bus_transfer(map->dev_addr, buf, len, NULL, 0);
+    if (rc < 0) return rc;
+    return rc == (int)len ? 0 : PICO_ERROR_GENERIC;
+}
+
+static int bus_read(regmap_t *map, uint8_t reg, uint8_t *dst, size_t len) {
+    map->transactions++;
+    int rc = i2c_bus_transfer(map->dev_addr, &reg, 1, dst, len);
+    if (rc < 0) return rc;
+    return rc == (int)(len + 1) ? 0 : PICO_ERROR_GENERIC;
+}
+
+// Write entries first..last in one transaction and update the bookkeeping.
+static int write_run(regmap_t *map, int first, int last) {
+    uint8_t buf[REGMAP_MAX_REGS + 1];
+    uint16_t settle = 0;
+    size_t n = 0;
+
+    buf[n++] = map->regs[first].reg;
+    for (int i = first; i <= last; ++i)
+        buf[n++] = map->shadow[i];
+
+    int rc = bus_write(map, buf, n);
+    if (rc != 0) {
+        // The device may or may not have taken part of the burst
+        for (int i = first; i <= last; ++i) map->valid &= ~BIT(i);
+        return rc;
+    }
+    for (int i = first; i <= last; ++i) {
+        map->dirty &= ~BIT(i);
+        map->shadow[i] &= ~map->regs[i].self_clear;
+        if (map->regs[i].settle_us > settle) settle = map->regs[i].settle_us;
+    }
+    if (settle) busy_wait_us(settle);
+    return 0;
+}
+
+int regmap_flush(regmap_t *map) {
+    int rc;
+
+    for (int i = 0; i < map->count; ++i) {
+        if (!(map->dirty & BIT(i)) || (map->regs[i].flags & REGMAP_WRITE_LAST))
+            continue;
+        // Extend the burst over following registers while a dirty one is
+        // at most REGMAP_BRIDGE_MAX clean (but known) registers away.
+        int last = i;
+        for (int k = i + 1; k < map->count && burst_joins(map, k); ++k) {
+            if (map->dirty & BIT(k)) last = k;
+            else if (!(map->valid & BIT(k)) || k - last > REGMAP_BRIDGE_MAX) break;
+        }
+        if ((rc = write_run(map, i, last)) != 0) return rc;
+        i = last;
+    }
+    for (int i = 0; i < map->count; ++i) {
+        if ((map->dirty & BIT(i)) && (rc = write_run(map, i, i)) != 0) return rc;
+    }
+    return 0;
+}
+
+int regmap_read(regmap_t *map, uint8_t reg, uint8_t *value) {
+    int i = find_reg(map, reg);
+    if (i >= 0 && (map->valid & BIT(i))) {
+        *value = map->shadow[i];
+        return 0;
+    }
+    int rc = bus_read(map, reg, value, 1);
+    if (rc == 0 && i >= 0 && cached(map, i)) {
+        map->shadow[i] = *value;
+        map->valid |= BIT(i);
+    }
+    return rc;
+}
+
+int regmap_update_bits(regmap_t *map, uint8_t reg, uint8_t mask, uint8_t value) {
+    int i = find_reg(map, reg);
+    uint8_t old = 0;
+    int rc;
+
+    if (i < 0 || !cached(map, i)) {
+        // Plain read-modify-write on the device
+        if (mask != 0xFF && (rc = bus_read(map, reg, &old, 1)) != 0) return rc;
+        uint8_t buf[2] = { reg, (uint8_t)((old & ~mask) | (value & mask)) };
+        return bus_write(map, buf, sizeof(buf));
+    }
+
+    if (!(map->valid & BIT(i))) {
+        if (mask != 0xFF && (rc = bus_read(map, reg, &old, 1)) != 0) return rc;
+        map->shadow[i] = old;
+        map->valid |= BIT(i);
+        if (mask == 0xFF) map->dirty |= BIT(i);   // device content unknown
+    }
+
+    uint8_t v = (map->shadow[i] & ~mask) | (value & mask);
+    if (v != map->shadow[i] || (v & map->regs[i].self_clear)) {
+        map->shadow[i] = v;
+        map->dirty |= BIT(i);
+    }
+    return map->batch ? 0 : regmap_flush(map);
+}
+
+int regmap_write(regmap_t *map, uint8_t reg, uint8_t value) {
+    return regmap_update_bits(map, reg, 0xFF, value);
+}
+
+void regmap_batch_begin(regmap_t *map) {
+    map->batch++;
+}
+
+int regmap_batch_end(regmap_t *map) {
+    if (map->batch && --map->batch) return 0;
+    return regmap_flush(map);
+}
+
+int regmap_sync(regmap_t *map) {
+    uint8_t buf[REGMAP_MAX_REGS];
+
+    map->dirty = 0;
+    for (int i = 0; i < map->count; ++i) {
+        if (!cached(map, i)) continue;
+        int last = i;
+        while (last + 1 < map->count && cached(map, last + 1) &&
+               map->regs[last + 1].reg == map->regs[last].reg + 1)
+            ++last;
+
+        int rc = bus_read(map, map->regs[i].reg, buf, last - i + 1);
+        if (rc != 0) return rc;
+        for (int k = i; k <= last; ++k) {
+            map->shadow[k] = buf[k - i];
+            map->valid |= BIT(k);
+        }
+        i = last;
+    }
+    return 0;
+}
+
+void regmap_reset_cache(regmap_t *map) {
+    map->valid = map->dirty = 0;
+    for (int i = 0; i < map->count; ++i) {
+        if (!cached(map, i)) continue;
+        map->shadow[i] = map->regs[i].reset;
+        map->valid |= BIT(i);
+    }
+}
+
+void regmap_invalidate(regmap_t *map) {
+    map->valid = map->dirty = 0;
+}
@@ -30,11 +30,24 @@ SOFTWARE.
 //#include "tusb.h" //is it needed?
 #include "hardware/irq.h"
 #include "hardware/pwm.h"
+#include "hardware/sync.h"
 #include <tkjhat/ssd1306.h>
 #include <tkjhat/pdm_microphone.h>
+#include <tkjhat/i2c_bus.h>
+#include <tkjhat/regmap.h>
 #include <stdio.h>
 #include <math.h>
 
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+#if TKJHAT_DISPLAY_NOTIFY_INDEX >= configTASK_NOTIFICATION_ARRAY_ENTRIES
+#error "TKJHAT_DISPLAY_NOTIFY_INDEX needs configTASK_NOTIFICATION_ARRAY_ENTRIES > TKJHAT_DISPLAY_NOTIFY_INDEX in FreeRTOSConfig.h"
+#endif
+#if TKJHAT_DISPLAY_NOTIFY_INDEX == TKJHAT_I2C_NOTIFY_INDEX
+#error "TKJHAT_DISPLAY_NOTIFY_INDEX must differ from TKJHAT_I2C_NOTIFY_INDEX: the render task waits for I2C completion too"
+#endif
+
 
 
 
@@ -249,26 +262,54 @@ void deinit_buzzer() {
  * ========================= */
 // Initialize I2C peripheral
 void init_i2c(uint sda_pin, uint scl_pin) {
-    i2c_init(i2c_default, 400*1000);
+    uint baudrate = i2c_init(i2c_default, 400*1000);
     gpio_set_function(sda_pin, GPIO_FUNC_I2C);
     gpio_set_function(scl_pin, GPIO_FUNC_I2C);
     gpio_pull_up(sda_pin);
     gpio_pull_up(scl_pin);
+    init_i2c_bus(sda_pin, scl_pin, baudrate);
 }
 
 void init_i2c_default(){
     init_i2c(DEFAULT_I2C_SDA_PIN, DEFAULT_I2C_SCL_PIN);
 }
 
+// True while a nostop transfer keeps the bus lock for the next call.
+// Only the lock holder touches it.
+static bool i2c_split_held;
+
+// Take the bus for one i2c_write()/i2c_read() call. A nostop call keeps one
+// level of the (recursive) lock so nobody can slip in before the read.
+static void i2c_split_begin(void) {
+    i2c_async_wait_idle();
+    i2c_bus_lock();
+}
+
+static void i2c_split_end(bool nostop) {
+    if (nostop && !i2c_split_held) {
+        i2c_split_held = true;
+        return;
+    }
+    i2c_bus_unlock();
+    if (!nostop && i2c_split_held) {
+        i2c_split_held = false;
+        i2c_bus_unlock();
+    }
+}
+
 // Generic I2C write function
 bool i2c_write(uint8_t addr, const uint8_t *src, size_t len, bool nostop) {
-    int bytes_written = i2c_write_blocking(i2c_default, addr, src, len, nostop);
+    i2c_split_begin();
+    int bytes_written = i2c_bus_write_raw(addr, src, len, nostop);
+    i2c_split_end(nostop);
     return bytes_written == (int)len;
 }
 
 // Generic I2C read function
 bool i2c_read(uint8_t addr, uint8_t *dst, size_t len, bool nostop) {
-    int bytes_read = i2c_read_blocking(i2c_default, addr, dst, len, nostop);
+    i2c_split_begin();
+    int bytes_read = i2c_bus_read_raw(addr, dst, len, nostop);
+    i2c_split_end(nostop);
     return bytes_read == (int)len;
 }
 
@@ -329,8 +370,101 @@ int get_microphone_samples(int16_t* buffer, size_t samples) {
 // Library used can be found at: https://github.com/daschr/pico-ssd1306https://github.com/daschr/pico-ssd1306
  static ssd1306_t disp;
 
+// Drawing only touches disp.buffer (back buffer); the panel is updated when
+// the outermost frame ends: by the render task if it runs, else directly by
+// the caller. The render task holds the lock only to swap the buffers and
+// sends the front buffer while the next frame is drawn.
+static SemaphoreHandle_t disp_mutex;      // recursive, guards disp
+static TaskHandle_t render_task;
+static TickType_t render_period;
+static uint8_t frame_depth;               // begin/end nesting of the lock holder
+static volatile uint32_t frames_flushed;
+static volatile uint32_t frames_ended, frames_swapped;   // render task backlog
+
+static inline bool disp_rtos(void) {
+    return xTaskGetSchedulerState() == taskSCHEDULER_RUNNING;
+}
+
+static void disp_lock(void) {
+    if (!disp_rtos()) return;
+    if (disp_mutex == NULL) {
+        vTaskSuspendAll();
+        if (disp_mutex == NULL)
+            disp_mutex = xSemaphoreCreateRecursiveMutex();
+        xTaskResumeAll();
+    }
+    xSemaphoreTakeRecursive(disp_mutex, portMAX_DELAY);
+}
+
+static void disp_unlock(void) {
+    if (!disp_rtos() || disp_mutex == NULL) return;
+    xSemaphoreGiveRecursive(disp_mutex);
+}
+
+static void display_render_task(void *arg) {
+    (void)arg;
+    for (;;) {
+        // Frames ended while flushing or waiting leave the notification set,
+        // so they are coalesced into the next flush. The flush itself waits
+        // for the I2C bus on TKJHAT_I2C_NOTIFY_INDEX, hence a separate index.
+        ulTaskNotifyTakeIndexed(TKJHAT_DISPLAY_NOTIFY_INDEX, pdTRUE, portMAX_DELAY);
+        TickType_t start = xTaskGetTickCount();
+        disp_lock();
+        bool swapped = ssd1306_swap(&disp);
+        frames_swapped = frames_ended;
+        disp_unlock();
+        if (swapped) {
+            ssd1306_flush(&disp);
+            frames_flushed++;
+        }
+        TickType_t spent = xTaskGetTickCount() - start;
+        if (spent < render_period)
+            vTaskDelay(render_period - spent);
+    }
+}
+
+bool init_display_render_task(UBaseType_t task_priority, uint32_t max_fps) {
+    if (render_task) return true;
+    if (max_fps == 0) max_fps = TKJHAT_DISPLAY_MAX_FPS;
+    render_period = pdMS_TO_TICKS(1000 / max_fps);
+    return xTaskCreate(display_render_task, "display", TKJHAT_DISPLAY_TASK_STACK, NULL,
+                       task_priority, &render_task) == pdPASS;
+}
+
+void display_begin_frame(void) {
+    disp_lock();
+    frame_depth++;
+}
+
+void display_end_frame(void) {
+    if (frame_depth == 0) return;
+    if (--frame_depth == 0) {
+        if (render_task && disp_rtos()) {
+            frames_ended++;
+            xTaskNotifyGiveIndexed(render_task, TKJHAT_DISPLAY_NOTIFY_INDEX);
+        } else {
+            ssd1306_show(&disp);
+            frames_flushed++;
+        }
+    }
+    disp_unlock();
+}
+
+bool display_flush_done(void) {
+    // A frame ended but not swapped yet counts as pending too
+    return frames_swapped == frames_ended && ssd1306_flush_done(&disp);
+}
+
+void display_get_timing(display_timing_t *timing) {
+    timing->frames = frames_flushed;
+    timing->flush_us = disp.flush_us;
+    timing->frame_us = disp.frame_us;
+    timing->tx_bytes = disp.tx_bytes;
+}
+
 // Display-related functions
  void init_display() {
+    disp_lock();
     // Initialize the SSD1306 display with external VCC
     disp.external_vcc = false;
     ssd1306_init(&disp, 128, 64, SSD1306_I2C_ADDRESS, i2c_default);
@@ -340,6 +474,7 @@ int get_microphone_samples(int16_t* buffer, size_t samples) {
 
     // Clear the display
     ssd1306_clear(&disp);
+    disp_unlock();
 }
 
 
@@ -352,11 +487,9 @@ void write_text_xy(int16_t x0, int16_t y0, const char *text) {
 
     const uint8_t scale = 1; //Default font scale is 1
 
+    display_begin_frame();
     ssd1306_draw_string(&disp, (uint32_t)x0, (uint32_t)y0, scale, text);
-    ssd1306_show(&disp);
-
-    // Delay for 800 milliseconds
-    sleep_ms(800);
+    display_end_frame();
 }
 
 void write_text(const char *text) {
@@ -364,13 +497,32 @@ void write_text(const char *text) {
     if (!text)return;
 
     // Draw the text at the specified position with a font size of 2
+    display_begin_frame();
     ssd1306_draw_string(&disp, 8, 24, 2, text);
+    display_end_frame();
+}
 
-    // Update the display
-    ssd1306_show(&disp);
+// Log console on disp; guarded by the display lock like disp itself
+static ssd1306_console_t console;
+static bool console_open;
 
-    // Delay for 800 milliseconds
-    sleep_ms(800);
+void display_console_print(const char *text) {
+    if (!text) return;
+    display_begin_frame();
+    if (!console_open)
+        console_open = ssd1306_console_init(&console, &disp, 0);
+    if (console_open)
+        ssd1306_console_print(&console, text);
+    display_end_frame();
+}
+
+void display_console_close(void) {
+    display_begin_frame();
+    if (console_open) {
+        ssd1306_console_close(&console);
+        console_open = false;
+    }
+    display_end_frame();
 }
 
 /**
@@ -381,45 +533,32 @@ void write_text(const char *text) {
  *
  * Coordinate system: origin (0,0) = top-left; X→right, Y→down.
  *
- * Preconditions:
- *  - `disp` must be initialized via ssd1306_init().
- *
+ * @param r Raster view of `disp` (ssd1306_raster()).
  * @param x X coordinate in pixels (0 .. disp.width-1). Negative values are ignored.
  * @param y Y coordinate in pixels (0 .. disp.height-1). Negative values are ignored.
  *
- * @note This does NOT call ssd1306_show(). Batch draws, then call ssd1306_show(&disp).
+ * @note Caller holds the frame (display_begin_frame()).
  */
-static inline void putp(int16_t x, int16_t y) {
-    if (x >= 0 && y >= 0 &&
-        x < (int16_t)disp.width && y < (int16_t)disp.height) {
-        ssd1306_draw_pixel(&disp, (uint32_t)x, (uint32_t)y);
-    }
+static inline void putp(const raster_t *r, int16_t x, int16_t y) {
+    raster_pixel(r, x, y, true);
 }
 
 /**
  * @brief Draw a clipped horizontal span into the off-screen buffer.
  *
- * Draws solid pixels from x1 to x2 inclusive on row y. The span is clipped
- * to display bounds; fully off-screen spans are skipped.
- *
- * Preconditions:
- *  - `disp` must be initialized.
+ * Draws solid pixels from x1 to x2 inclusive on row y, one bit OR-ed into
+ * each byte. The span is clipped to display bounds; fully off-screen spans
+ * are skipped.
  *
+ * @param r  Raster view of `disp` (ssd1306_raster()).
  * @param x1 Left end (can be < 0; will be clipped).
  * @param x2 Right end (can be >= width; will be clipped).
  * @param y  Row index (0 .. disp.height-1). Outside rows are ignored.
  *
- * @note No ssd1306_show() here; meant for filled-shape routines.
+ * @note Caller holds the frame; meant for filled-shape routines.
  */
-static inline void hspan(int16_t x1, int16_t x2, int16_t y) {
-    if (y < 0 || y >= (int16_t)disp.height) return;
-    if (x1 > x2) { int16_t t = x1; x1 = x2; x2 = t; }
-    if (x2 < 0 || x1 >= (int16_t)disp.width) return;
-    if (x1 < 0) x1 = 0;
-    if (x2 >= (int16_t)disp.width) x2 = (int16_t)disp.width - 1;
-
-    for (int16_t x = x1; x <= x2; ++x)
-        ssd1306_draw_pixel(&disp, (uint32_t)x, (uint32_t)y);
+static inline void hspan(const raster_t *r, int16_t x1, int16_t x2, int16_t y) {
+    raster_hline(r, x1, x2, y, true);
 }
 
 
@@ -427,9 +566,11 @@ void draw_circle(int16_t x0, int16_t y0, int16_t r, bool fill) {
     // Draw a circle using the Bresenham algorithm
     if (r < 0) 
         return;
+    display_begin_frame();
+    const raster_t ras = ssd1306_raster(&disp);
     if (r == 0) { 
-        putp(x0, y0); 
-        ssd1306_show(&disp); 
+        putp(&ras, x0, y0); 
+        display_end_frame(); 
         return; 
     }
 
@@ -441,12 +582,12 @@ void draw_circle(int16_t x0, int16_t y0, int16_t r, bool fill) {
     int16_t y = r;
 
     if (fill) {
-        hspan((int16_t)(x0 - r), (int16_t)(x0 + r), y0);  // center row
+        hspan(&ras, (int16_t)(x0 - r), (int16_t)(x0 + r), y0);  // center row
     } else {
-        putp(x0, (int16_t)(y0 + r));
-        putp(x0, (int16_t)(y0 - r));
-        putp((int16_t)(x0 + r), y0);
-        putp((int16_t)(x0 - r), y0);
+        putp(&ras, x0, (int16_t)(y0 + r));
+        putp(&ras, x0, (int16_t)(y0 - r));
+        putp(&ras, (int16_t)(x0 + r), y0);
+        putp(&ras, (int16_t)(x0 - r), y0);
     }
 
     while (x < y) {
@@ -454,52 +595,52 @@ void draw_circle(int16_t x0, int16_t y0, int16_t r, bool fill) {
         x++; ddF_x += 2; f += ddF_x;
 
         if (fill) {
-            hspan((int16_t)(x0 - x), (int16_t)(x0 + x), (int16_t)(y0 + y));
-            hspan((int16_t)(x0 - x), (int16_t)(x0 + x), (int16_t)(y0 - y));
-            hspan((int16_t)(x0 - y), (int16_t)(x0 + y), (int16_t)(y0 + x));
-            hspan((int16_t)(x0 - y), (int16_t)(x0 + y), (int16_t)(y0 - x));
+            hspan(&ras, (int16_t)(x0 - x), (int16_t)(x0 + x), (int16_t)(y0 + y));
+            hspan(&ras, (int16_t)(x0 - x), (int16_t)(x0 + x), (int16_t)(y0 - y));
+            hspan(&ras, (int16_t)(x0 - y), (int16_t)(x0 + y), (int16_t)(y0 + x));
+            hspan(&ras, (int16_t)(x0 - y), (int16_t)(x0 + y), (int16_t)(y0 - x));
         } else {
-            putp((int16_t)(x0 + x), (int16_t)(y0 + y));
-            putp((int16_t)(x0 - x), (int16_t)(y0 + y));
-            putp((int16_t)(x0 + x), (int16_t)(y0 - y));
-            putp((int16_t)(x0 - x), (int16_t)(y0 - y));
-            putp((int16_t)(x0 + y), (int16_t)(y0 + x));
-            putp((int16_t)(x0 - y), (int16_t)(y0 + x));
-            putp((int16_t)(x0 + y), (int16_t)(y0 - x));
-            putp((int16_t)(x0 - y), (int16_t)(y0 - x));
+            putp(&ras, (int16_t)(x0 + x), (int16_t)(y0 + y));
+            putp(&ras, (int16_t)(x0 - x), (int16_t)(y0 + y));
+            putp(&ras, (int16_t)(x0 + x), (int16_t)(y0 - y));
+            putp(&ras, (int16_t)(x0 - x), (int16_t)(y0 - y));
+            putp(&ras, (int16_t)(x0 + y), (int16_t)(y0 + x));
+            putp(&ras, (int16_t)(x0 - y), (int16_t)(y0 + x));
+            putp(&ras, (int16_t)(x0 + y), (int16_t)(y0 - x));
+            putp(&ras, (int16_t)(x0 - y), (int16_t)(y0 - x));
         }
     }
-    ssd1306_show(&disp);  // remove if batching multiple draws
+    display_end_frame();
 }
 
  void draw_line(int16_t x0, int16_t y0, int16_t x1, int16_t y1) {
     // Draw a line between the specified points
+    display_begin_frame();
     ssd1306_draw_line(&disp, x0, y0, x1, y1);
-
-    // Update the display
-    ssd1306_show(&disp);
+    display_end_frame();
 }
 
  void draw_square(uint32_t x, uint32_t y, uint32_t w, uint32_t h, bool fill) {
     // Draw a square at the specified position with the given width and height
+    display_begin_frame();
     if (fill)
         ssd1306_draw_square(&disp, x, y, w, h);
     else
         ssd1306_draw_empty_square(&disp, x, y, w, h);
-
-    // Update the display
-    ssd1306_show(&disp);
+    display_end_frame();
 }
 
 void clear_display() {
     // Clear the display
+    display_begin_frame();
     ssd1306_clear(&disp);
-    // Update the display
-    ssd1306_show(&disp);
+    display_end_frame();
 }
 
 void stop_display() {
+    disp_lock();
     ssd1306_poweroff(&disp);
+    disp_unlock();
 }
 
 
@@ -524,9 +665,9 @@ void init_veml6030() {
         0x10                  // Low byte: 100ms integration time (010 in bits 6-8), power on (bit 0 = 0)
     };
     
-    // Write configuration to sensor
-    i2c_write_blocking(i2c_default, VEML6030_I2C_ADDR, config, sizeof(config), false);
-    sleep_ms(10);
+    // Write configuration to sensor. The first result is ready one
+    // integration time later; waiting here would not make it sooner.
+    i2c_bus_transfer(VEML6030_I2C_ADDR, config, sizeof(config), NULL, 0);
 }
 
 // Read light level from VEML6030
@@ -573,10 +714,8 @@ uint32_t veml6030_read_light() {
 static uint16_t _veml6030_read_register(uint8_t reg) {
     uint8_t data[2] = {0,0};
 
-    // Select ALS output register
-    i2c_write_blocking(i2c_default, VEML6030_I2C_ADDR, &reg, 1, true);
-    // Read two bytes (MSB first)
-    i2c_read_blocking(i2c_default, VEML6030_I2C_ADDR, data, sizeof(data), false);
+    // Select ALS output register and read two bytes
+    i2c_bus_transfer(VEML6030_I2C_ADDR, &reg, 1, data, sizeof(data));
     //data [0] contains the LSB and data[1] the MSB
     return ((uint16_t)data[0]) |((uint16_t) data[1]<<8);
 }
@@ -589,7 +728,7 @@ void veml6030_stop(){
     };
     
     // Write configuration to sensor
-    i2c_write_blocking(i2c_default, VEML6030_I2C_ADDR, config, sizeof(config), false);
+    i2c_bus_transfer(VEML6030_I2C_ADDR, config, sizeof(config), NULL, 0);
     sleep_ms(10);
 }
 
@@ -603,72 +742,77 @@ void veml6030_stop(){
 // https://www.ti.com/lit/ds/symlink/hdc2021.pdf?ts=1757522824481&ref_url=https%253A%252F%252Fwww.ti.com%252Fproduct%252FHDC2021
 // https://www.ti.com/lit/ug/snau250/snau250.pdf?ts=1757438909914
 
- static int8_t read_hdc2021_register(uint8_t reg) {
-    uint8_t data;
-    i2c_write(HDC2021_I2C_ADDRESS, &reg, 1, true);
-    i2c_read(HDC2021_I2C_ADDRESS, &data, 1, false);
-    return data;
-}
-
- static void write_register(uint8_t reg, uint8_t value) {
-    uint8_t data[2] = {reg, value};
-    i2c_write(HDC2021_I2C_ADDRESS, data, sizeof(data), false);
+// Configuration registers. Reset values from the datasheet (section 8.6).
+static const regmap_reg_t hdc2021_regs[] = {
+    { .reg = HDC2021_CONFIG,             .reset = 0x00, .self_clear = 0x80 }, // SOFT_RES
+    { .reg = HDC2021_MEASUREMENT_CONFIG, .reset = 0x00, .self_clear = 0x01 }, // MEAS_TRIG
+    { .reg = HDC2021_TEMP_THR_L,         .reset = 0x01 },
+    { .reg = HDC2021_TEMP_THR_H,         .reset = 0xFF },
+    { .reg = HDC2021_HUMID_THR_L,        .reset = 0x00 },
+    { .reg = HDC2021_HUMID_THR_H,        .reset = 0xFF },
+};
+REGMAP_DEFINE(hdc2021_map, HDC2021_I2C_ADDRESS, hdc2021_regs);
+
+// SOFT_RES clears itself when the reset is done (the part NAKs meanwhile)
+static int hdc2021_reset_wait(uint32_t timeout_us) {
+    uint64_t deadline = time_us_64() + timeout_us;
+    do {
+        uint8_t reg = HDC2021_CONFIG, v;
+        if (i2c_bus_transfer(HDC2021_I2C_ADDRESS, &reg, 1, &v, 1) == 2 && !(v & 0x80)) {
+            regmap_reset_cache(&hdc2021_map);
+            return 0;
+        }
+        busy_wait_us(100);
+    } while (time_us_64() < deadline);
+    return -1;
 }
 
- static void hdc2021_reset() {
-    uint8_t configContents = read_hdc2021_register(HDC2021_CONFIG);
-    write_register(HDC2021_CONFIG, configContents | 0x80);
-    sleep_ms(50);
+static void hdc2021_reset_start() {
+    regmap_write(&hdc2021_map, HDC2021_CONFIG, 0x80);
 }
 
 static void hdc2021_setMeasurementMode() {
-    uint8_t configContents = read_hdc2021_register(HDC2021_MEASUREMENT_CONFIG);
-    write_register(HDC2021_MEASUREMENT_CONFIG, configContents & 0xF9);
+    regmap_update_bits(&hdc2021_map, HDC2021_MEASUREMENT_CONFIG, 0x06, 0x00); // Temp + humidity
 }
 
 static void hdc2021_setRate() {
-    uint8_t configContents = read_hdc2021_register(HDC2021_CONFIG);
-    configContents = (configContents & 0x8F) | 0x50; // Set 1 measurement/second
-    write_register(HDC2021_CONFIG, configContents);
+    regmap_update_bits(&hdc2021_map, HDC2021_CONFIG, 0x70, 0x50); // Set 1 measurement/second
 }
 
 static void hdc2021_setTempRes() {
-    uint8_t configContents = read_hdc2021_register(HDC2021_MEASUREMENT_CONFIG);
-    write_register(HDC2021_MEASUREMENT_CONFIG, configContents & 0x3F); // 14-bit
+    regmap_update_bits(&hdc2021_map, HDC2021_MEASUREMENT_CONFIG, 0xC0, 0x00); // 14-bit
 }
 
 static void hdc2021_setHumidityRes() {
-    uint8_t configContents = read_hdc2021_register(HDC2021_MEASUREMENT_CONFIG);
-    write_register(HDC2021_MEASUREMENT_CONFIG, configContents & 0xCF); // 14-bit
+    regmap_update_bits(&hdc2021_map, HDC2021_MEASUREMENT_CONFIG, 0x30, 0x00); // 14-bit
 }
 
  static void hdc2021_triggerMeasurement() {
-    uint8_t configContents = read_hdc2021_register(HDC2021_MEASUREMENT_CONFIG);
-    write_register(HDC2021_MEASUREMENT_CONFIG, configContents | 0x01);
+    regmap_update_bits(&hdc2021_map, HDC2021_MEASUREMENT_CONFIG, 0x01, 0x01);
 }
 
 void hdc2021_set_low_temp_threshold(float temp) {
     temp = (temp < -40.0f) ? -40.0f : (temp > 125.0f) ? 125.0f : temp;
     uint8_t temp_thresh = (uint8_t)((temp + 40.0f) * 256.0f / 165.0f);
-    write_register(HDC2021_TEMP_THR_L, temp_thresh);
+    regmap_write(&hdc2021_map, HDC2021_TEMP_THR_L, temp_thresh);
 }
 
 void hdc2021_set_high_temp_threshold(float temp) {
     temp = (temp < -40.0f) ? -40.0f : (temp > 125.0f) ? 125.0f : temp;
     uint8_t temp_thresh = (uint8_t)((temp + 40.0f) * 256.0f / 165.0f);
-    write_register(HDC2021_TEMP_THR_H, temp_thresh);
+    regmap_write(&hdc2021_map, HDC2021_TEMP_THR_H, temp_thresh);
 }
 
 void hdc2021_set_high_humidity_threshold(float humid) {
     humid = (humid < 0.0f) ? 0.0f : (humid > 100.0f) ? 100.0f : humid;
     uint8_t humid_thresh = (uint8_t)(humid * 2.56f);
-    write_register(HDC2021_HUMID_THR_H, humid_thresh);
+    regmap_write(&hdc2021_map, HDC2021_HUMID_THR_H, humid_thresh);
 }
 
 void hdc2021_set_low_humidity_threshold(float humid) {
     humid = (humid < 0.0f) ? 0.0f : (humid > 100.0f) ? 100.0f : humid;
     uint8_t humid_thresh = (uint8_t)(humid * 2.56f);
-    write_register(HDC2021_HUMID_THR_L, humid_thresh);
+    regmap_write(&hdc2021_map, HDC2021_HUMID_THR_L, humid_thresh);
 }
 // By default it sets following modes: 
 // Measurement methods: Temp + Measurement
@@ -676,8 +820,10 @@ void hdc2021_set_low_humidity_threshold(float humid) {
 // Temperature resolution: 14 bits
 // Humidity resolution: 14 bits
 // It triggers continous measurements. 
- void init_hdc2021_() {
-    hdc2021_reset();
+// After the reset everything is collected in the shadow and sent as two burst
+// writes (CONFIG..MEASUREMENT_CONFIG and the four thresholds).
+static int hdc2021_configure(void) {
+    regmap_batch_begin(&hdc2021_map);
     hdc2021_set_high_temp_threshold(50);
     hdc2021_set_low_temp_threshold(-30);
     hdc2021_set_high_humidity_threshold(100);
@@ -687,15 +833,21 @@ void hdc2021_set_low_humidity_threshold(float humid) {
     hdc2021_setTempRes();
     hdc2021_setHumidityRes();
     hdc2021_triggerMeasurement();
+    return regmap_batch_end(&hdc2021_map);
+}
+
+ void init_hdc2021_() {
+    hdc2021_reset_start();
+    hdc2021_reset_wait(TKJHAT_BOOT_TIMEOUT_US);
+    hdc2021_configure();
 }
 
 // Note that sampling rate is 1Hz
 float hdc2021_read_temperature() {
     uint8_t reg = HDC2021_TEMP_LOW;
-    uint8_t data[2];
+    uint8_t data[2] = {0, 0};
     
-    i2c_write(HDC2021_I2C_ADDRESS, &reg, 1, true);
-    i2c_read(HDC2021_I2C_ADDRESS, data, 2, false);
+    i2c_bus_transfer(HDC2021_I2C_ADDRESS, &reg, 1, data, 2);
     uint16_t raw = ((uint16_t) data[1] << 8) | data[0];
     return (raw * 165.0f / 65536.0f) - 40.0f;
 }
@@ -703,27 +855,22 @@ float hdc2021_read_temperature() {
 //Note that sampling rate is 1 HX
 float hdc2021_read_humidity() {
     uint8_t reg = HDC2021_HUMIDITY_LOW;
-    uint8_t data[2];
+    uint8_t data[2] = {0, 0};
     
-    i2c_write(HDC2021_I2C_ADDRESS, &reg, 1, true);
-    i2c_read(HDC2021_I2C_ADDRESS, data, 2, false);
+    i2c_bus_transfer(HDC2021_I2C_ADDRESS, &reg, 1, data, 2);
     
     uint16_t raw = ((uint16_t) data[1] << 8) | data[0];
     return (raw * 100.0f / 65536.0f);
 }
 
 void stop_hdc2021() {
-    uint8_t cfg = read_hdc2021_register(HDC2021_CONFIG);  // 0x0E
-    cfg &= 0x8F;  // clear AMM[2:0] (bits 6:4) -> 000 = AMM disabled
-    write_register(HDC2021_CONFIG, cfg);
+    regmap_batch_begin(&hdc2021_map);
+    // clear AMM[2:0] (bits 6:4) -> 000 = AMM disabled
+    // turn heater (bit 3) & DRDY/INT_EN (bit 2, pin Hi-Z) off to minimize current
+    regmap_update_bits(&hdc2021_map, HDC2021_CONFIG, 0x7C, 0x00);
     // Make sure we don't accidentally retrigger
-    uint8_t meas = read_hdc2021_register(HDC2021_MEASUREMENT_CONFIG); // 0x0F
-    meas &= (uint8_t)~0x01; // clear MEAS_TRIG (bit 0)
-    write_register(HDC2021_MEASUREMENT_CONFIG, meas);
-    //turn heater & DRDY pin off to minimize current
-    cfg &= ~(uint8_t)(1<<3); // HEAT_EN=0
-    cfg &= ~(uint8_t)(1<<2); // DRDY/INT_EN=0 (pin Hi-Z)
-
+    regmap_update_bits(&hdc2021_map, HDC2021_MEASUREMENT_CONFIG, 0x01, 0x00);
+    regmap_batch_end(&hdc2021_map);
 }
 
 /* =========================
@@ -734,47 +881,46 @@ void stop_hdc2021() {
 // https://invensense.tdk.com/wp-content/uploads/2021/07/DS-000451-ICM-42670-P-v1.0.pdf
 
 float aRes, gRes;      // scale resolutions per LSB for the sensors
+static ICM42670_scale_t icm_scale;     // the same, as multipliers (see imu_fixed.h)
+static uint16_t icm_accel_odr_hz;      // paces the calibration reads
+
+// Configuration registers (bank 0). PWR_MGMT0 goes after the sensor
+// configuration and needs 200 µs before the next write when a sensor turns on.
+static const regmap_reg_t icm42670_regs[] = {
+    { .reg = ICM42670_REG_SIGNAL_PATH_RESET, .flags = REGMAP_VOLATILE },
+    { .reg = ICM42670_INT_CONFIG,            .reset = 0x00 },
+    { .reg = ICM42670_PWR_MGMT0_REG,         .reset = 0x00, .flags = REGMAP_WRITE_LAST, .settle_us = 200 },
+    { .reg = ICM42670_GYRO_CONFIG0_REG,      .reset = 0x06 },
+    { .reg = ICM42670_ACCEL_CONFIG0_REG,     .reset = 0x06 },
+    { .reg = ICM42670_TEMP_CONFIG0_REG,      .reset = 0x40 }, // only here to join the CONFIG burst
+    { .reg = ICM42670_GYRO_CONFIG1_REG,      .reset = 0x31 },
+    { .reg = ICM42670_ACCEL_CONFIG1_REG,     .reset = 0x41 },
+    { .reg = ICM42670_APEX_CONFIG0_REG,      .flags = REGMAP_VOLATILE },
+    { .reg = ICM42670_APEX_CONFIG1_REG,      .reset = 0x02 },
+    { .reg = ICM42670_WOM_CONFIG_REG,        .reset = 0x00 },
+    { .reg = ICM42670_FIFO_CONFIG1_REG,      .reset = 0x01 },
+    { .reg = ICM42670_FIFO_CONFIG2_REG,      .reset = 0x00 },
+    { .reg = ICM42670_FIFO_CONFIG3_REG,      .reset = 0x00 },
+    { .reg = ICM42670_INT_SOURCE0_REG,       .reset = 0x10 },
+    { .reg = ICM42670_INT_SOURCE1_REG,       .reset = 0x00 },
+    { .reg = ICM42670_INTF_CONFIG0_REG,      .reset = 0x30 },
+};
+REGMAP_DEFINE(icm42670_map, ICM42670_I2C_ADDRESS, icm42670_regs);
 
 static int icm_i2c_write_byte(uint8_t reg, uint8_t value) {
-    uint8_t buf[2] = { reg, value };
-    //printf("Before writing to i2c reg:0x%x, val:0x%x\n", reg, value);
-    int result = i2c_write_blocking(i2c_default, ICM42670_I2C_ADDRESS, buf, 2, false);
-    //printf("After writing to i2c. Result: %d\n",result);
-    return result == 2 ? 0 : -1;
+    return regmap_write(&icm42670_map, reg, value) == 0 ? 0 : -1;
 }
 
 // helper to read a byte from a register
 static int icm_i2c_read_byte(uint8_t reg, uint8_t *value) {
-    int result = i2c_write_blocking(i2c_default, ICM42670_I2C_ADDRESS, &reg, 1, true);
-    if (result != 1) return -1;
-    result = i2c_read_blocking(i2c_default, ICM42670_I2C_ADDRESS, value, 1, false);
-    return result == 1 ? 0 : -1;
+    int result = i2c_bus_transfer(ICM42670_I2C_ADDRESS, &reg, 1, value, 1);
+    return result == 2 ? 0 : -1;
 }
 
 static int icm_i2c_read_bytes(uint8_t reg, uint8_t *buffer, uint8_t len) {
-    int result = i2c_write_blocking(i2c_default, ICM42670_I2C_ADDRESS, &reg, 1, true);
-    if (result != 1) return -1;
-    result = i2c_read_blocking(i2c_default, ICM42670_I2C_ADDRESS, buffer, len, false);
-    return result == len ? 0 : -2;
-}
-
-static int icm_soft_reset(void) {
-    int rc = icm_i2c_write_byte(ICM42670_REG_SIGNAL_PATH_RESET, ICM42670_RESET_CONFIG_BITS);
-    if (rc != 0) 
-        return -1;
-    busy_wait_us(400);   // small wait: datasheet calls for ~200 µs before other writes
-    //Wait till the MCKL_READY is on (clock is running again)
-        // 2) Poll MCLK_RDY (Bank0 @ 0x00, bit3) with a short timeout
-    for (int i = 0; i < 100; ++i) {           // ~5 ms total @ 50 µs step
-        uint8_t v = 0;
-        if (icm_i2c_read_byte(0x00, &v) == 0 && (v & (1u << 3))) {
-            // 3) Give the spec'd settling gap before next writes
-            busy_wait_us(200);
-            return 0;
-        }
-        busy_wait_us(50);
-    }
-    return -2;
+    int result = i2c_bus_transfer(ICM42670_I2C_ADDRESS, &reg, 1, buffer, len);
+    if (result == PICO_ERROR_GENERIC) return -1;
+    return result == len + 1 ? 0 : -2;
 }
 
 //TRY TO SOLVE PROBLEM OF FLOATING AD0 pin, JUST IN CASE THE ADDRESS IS CHANGING. 
@@ -785,8 +931,7 @@ static int ICM42670_autodetect_address(void) {
         int hits = 0;
         for (int t = 0; t < 4; ++t) {
             uint8_t who = 0, reg = ICM42670_REG_WHO_AM_I;
-            if (i2c_write_blocking(i2c_default, cand[i], &reg, 1, true) != 1) continue;
-            if (i2c_read_blocking(i2c_default, cand[i], &who, 1, false) != 1) continue;
+            if (i2c_bus_transfer(cand[i], &reg, 1, &who, 1) != 2) continue;
             if (who == ICM42670_WHO_AM_I_RESPONSE) ++hits;
         }
         if (hits >= 3) { return cand[i]; } // majority wins
@@ -794,14 +939,50 @@ static int ICM42670_autodetect_address(void) {
     return -1;
 }
 
-//TODO do initial calibration. 
-static void calibrateAccel(float *dest1){
+static uint64_t icm_reset_us;      // time of the last soft reset
 
+static int icm_reset_start(void) {
+    icm_reset_us = time_us_64();
+    return icm_i2c_write_byte(ICM42670_REG_SIGNAL_PATH_RESET, ICM42670_RESET_CONFIG_BITS);
 }
 
-static void calibrateGyro(float *dest2){
+// The datasheet allows no register access for 1 ms after a soft reset;
+// whatever the caller did since the reset counts towards it. After that
+// the part NAKs or reports MCLK_RDY = 0 until the reset is over, so the
+// rest of the wait is a poll until the clock runs again.
+static int icm_reset_wait(uint32_t timeout_us) {
+    uint64_t deadline = time_us_64() + timeout_us;
+    int64_t left = (int64_t)(icm_reset_us + ICM42670_RESET_WAIT_US - time_us_64());
+    if (left > 0) busy_wait_us((uint64_t)left);
+    do {
+        uint8_t v = 0;
+        if (icm_i2c_read_byte(ICM42670_REG_MCLK_RDY, &v) == 0 && (v & ICM42670_MCLK_RDY)) {
+            regmap_reset_cache(&icm42670_map);
+            return 0;
+        }
+        busy_wait_us(50);
+    } while (time_us_64() < deadline);
+    return -2;
+}
 
+static int icm_soft_reset(void) {
+    if (icm_reset_start() != 0)
+        return -1;
+    return icm_reset_wait(5000);
+}
 
+// WHO_AM_I, falling back to the address scan only when it does not answer
+static int icm_check_identity(void) {
+    uint8_t who = 0;
+    if (icm_i2c_read_byte(ICM42670_REG_WHO_AM_I, &who) == 0 && who == ICM42670_WHO_AM_I_RESPONSE)
+        return 0;
+    int address = ICM42670_autodetect_address();
+    if (address == -1)
+        printf("Address could not be found");
+    else
+        printf("Address: 0x%02X\n", address);
+    if (icm_i2c_read_byte(ICM42670_REG_WHO_AM_I, &who) != 0) return -2;
+    return who == ICM42670_WHO_AM_I_RESPONSE ? 0 : -3;
 }
 
 int init_ICM42670() {
@@ -810,195 +991,838 @@ int init_ICM42670() {
     //Soft reset
     icm_soft_reset();
     
-    //DETECT ADDRESS FOR AD0 floating pin: 
-    int address = ICM42670_autodetect_address();
-    if (address == -1){
-        printf("Address could not be found");
-    }
-    else 
-        printf ("Address: 0x%02X\n",address);
-    // Step 1: Check WHO_AM_I
-    uint8_t who = 0;
-    if (icm_i2c_read_byte(ICM42670_REG_WHO_AM_I, &who) != 0) {
-        return -2;
-    };
-    if (who != ICM42670_WHO_AM_I_RESPONSE) {
-        return -3;
-    };   
-
-    // Step 2: Configure INT1 pin - push-pull, active-low, pulsed
-    // TODO: it breaks the sensor. After this instruction, it blocks the following write. Only happens after cold power-on. Working when flashing.  
-    /*if(icm_i2c_write_byte(ICM42670_INT_CONFIG, ICM42670_INT1_CONFIG_VALUE) != 0){ 
-        return -4;
-    }*/
-    // tiny guard delay after init writes
-    busy_wait_us(400);
-    
-    // Step 3: Success
-    blink_led(2);
+    // Step 1: Check WHO_AM_I (detects the address for a floating AD0 pin if it fails)
+    int rc = icm_check_identity();
+    if (rc != 0)
+        return rc;
+
+    // INT1 (INT_CONFIG) is not touched here: the functions that use the pin,
+    // such as ICM42670_fifo_start(), configure it in their register batch,
+    // after the reset wait has seen MCLK_RDY.
     return 0;
 }
 
-int ICM42670_startAccel(uint16_t odr_hz, uint16_t fsr_g) {
-    uint8_t fsr_bits = 0;
-    uint8_t odr_bits = 0;
-
-    // Map FSR to register bits, aRes (See Datasheet Table 2)
-    switch (fsr_g) {
-        case 2:  
-            fsr_bits = ICM42670_ACCEL_FSR_2G;
-            aRes = 16384; 
-            break;
-        case 4:  
-            fsr_bits = ICM42670_ACCEL_FSR_4G;
-            aRes = 8192;
-            break;
-        case 8:  
-            fsr_bits = ICM42670_ACCEL_FSR_8G; 
-            aRes =4096;
-            break;
-        case 16: 
-            fsr_bits = ICM42670_ACCEL_FSR_16G;
-            aRes = 2048;
-            break;
-        default: return -1; // invalid FSR
-    }
+// ODR and full-scale encodings (datasheet tables 1, 2 and section 14).
+// X(value, register bits, LSB per unit x 10)
+#define ICM42670_ODR_TABLE(X)                                                  \
+    X(25, 0x0B, 0) X(50, 0x0A, 0) X(100, 0x09, 0) X(200, 0x08, 0)             \
+    X(400, 0x07, 0) X(800, 0x06, 0) X(1600, 0x05, 0)
+#define ICM42670_ACCEL_FSR_TABLE(X)                                            \
+    X(2, ICM42670_ACCEL_FSR_2G, 163840) X(4, ICM42670_ACCEL_FSR_4G, 81920)     \
+    X(8, ICM42670_ACCEL_FSR_8G, 40960) X(16, ICM42670_ACCEL_FSR_16G, 20480)
+#define ICM42670_GYRO_FSR_TABLE(X)                                             \
+    X(250, ICM42670_GYRO_FSR_250DPS, 1310) X(500, ICM42670_GYRO_FSR_500DPS, 655) \
+    X(1000, ICM42670_GYRO_FSR_1000DPS, 328) X(2000, ICM42670_GYRO_FSR_2000DPS, 164)
+
+// The encodings follow the datasheet formulas: ODR = 1600 Hz >> (bits - 5),
+// FSR = max >> bits, LSB x FSR = 32768 (the datasheet rounds the gyro
+// sensitivities). A typo in a table row fails the build.
+#define ICM42670_CHECK_ODR(v, bits, lsb) \
+    _Static_assert((1600 >> ((bits) - 5)) == (v), "ODR table: " #v " Hz");
+#define ICM42670_CHECK_ACCEL_FSR(v, bits, lsb) \
+    _Static_assert((16 >> (bits)) == (v) && (lsb) * (v) == 327680, "accel FSR table: " #v " g");
+#define ICM42670_CHECK_GYRO_FSR(v, bits, lsb) \
+    _Static_assert((2000 >> (bits)) == (v) && (lsb) * (v) >= 327500 && (lsb) * (v) <= 328000, "gyro FSR table: " #v " dps");
+ICM42670_ODR_TABLE(ICM42670_CHECK_ODR)
+ICM42670_ACCEL_FSR_TABLE(ICM42670_CHECK_ACCEL_FSR)
+ICM42670_GYRO_FSR_TABLE(ICM42670_CHECK_GYRO_FSR)
+_Static_assert(ICM42670_ACCEL_ODR_100HZ == 0x09 && ICM42670_GYRO_ODR_100HZ == 0x09,
+               "accel and gyro share the ODR encoding");
+
+typedef struct {
+    uint16_t value;
+    uint8_t bits;
+    uint32_t lsb10;
+} icm_code_t;
+
+#define ICM42670_CODE_ROW(v, b, l) { (v), (b), (l) },
+static const icm_code_t icm_odr_codes[] = { ICM42670_ODR_TABLE(ICM42670_CODE_ROW) };
+static const icm_code_t icm_accel_fsr_codes[] = { ICM42670_ACCEL_FSR_TABLE(ICM42670_CODE_ROW) };
+static const icm_code_t icm_gyro_fsr_codes[] = { ICM42670_GYRO_FSR_TABLE(ICM42670_CODE_ROW) };
+
+#define icm_lookup(table, v) icm_find_code((table), sizeof(table) / sizeof((table)[0]), (v))
+static const icm_code_t *icm_find_code(const icm_code_t *table, size_t n, uint16_t value) {
+    for (size_t i = 0; i < n; ++i)
+        if (table[i].value == value) return &table[i];
+    return NULL;
+}
+
+// CONFIG0 layout: [7:5] = fsr, [3:0] = odr
+static inline uint8_t icm_config0(const icm_code_t *fsr, const icm_code_t *odr) {
+    return (uint8_t)((fsr->bits << 5) | (odr->bits & 0x0F));
+}
+
+static void icm_apply_accel_scale(const icm_code_t *fsr, uint16_t odr_hz) {
+    aRes = fsr->lsb10 / 10.0f;
+    ICM42670_scale_set_accel(&icm_scale, aRes);
+    icm_accel_odr_hz = odr_hz;
+}
+
+static void icm_apply_gyro_scale(const icm_code_t *fsr) {
+    gRes = fsr->lsb10 / 10.0f;
+    ICM42670_scale_set_gyro(&icm_scale, gRes);
+}
 
-    // Map ODR to register bits
-    switch (odr_hz) {
-        case 25:   odr_bits = ICM42670_ACCEL_ODR_25HZ; break;
-        case 50:   odr_bits = ICM42670_ACCEL_ODR_50HZ; break;
-        case 100:  odr_bits = ICM42670_ACCEL_ODR_100HZ; break;
-        case 200:  odr_bits = ICM42670_ACCEL_ODR_200HZ; break;
-        case 400:  odr_bits = ICM42670_ACCEL_ODR_400HZ; break;
-        case 800:  odr_bits = ICM42670_ACCEL_ODR_800HZ; break;
-        case 1600: odr_bits = ICM42670_ACCEL_ODR_1600HZ; break;
-        default:   return -2; // invalid ODR
-    }
+int ICM42670_startAccel(uint16_t odr_hz, uint16_t fsr_g) {
+    const icm_code_t *fsr = icm_lookup(icm_accel_fsr_codes, fsr_g);
+    if (!fsr) return -1; // invalid FSR
+    const icm_code_t *odr = icm_lookup(icm_odr_codes, odr_hz);
+    if (!odr) return -2; // invalid ODR
 
-    // Combine into ACCEL_CONFIG0: [7:5] = fsr, [3:0] = odr
-    uint8_t accel_config0_val = (fsr_bits << 5) | (odr_bits & 0x0F);
-    int rc = icm_i2c_write_byte(ICM42670_ACCEL_CONFIG0_REG, accel_config0_val);
-    busy_wait_us(400); 
-    if (rc != 0) return -3;
+    if (icm_i2c_write_byte(ICM42670_ACCEL_CONFIG0_REG, icm_config0(fsr, odr)) != 0) return -3;
+    icm_apply_accel_scale(fsr, odr_hz);
     return 0; // success
 }
 
 int ICM42670_startGyro(uint16_t odr_hz, uint16_t fsr_dps) {
-    uint8_t fsr_bits = 0;
-    uint8_t odr_bits = 0;
- 
-    // Map FSR, gRes (See Datasheet Table 1)
-    switch (fsr_dps) {
-        case 250:  
-            fsr_bits = 0x03;
-            gRes = 131; 
-            break;
-        case 500:  
-            fsr_bits = 0x02;
-            gRes = 65.5;
-            break;
-        case 1000: 
-            fsr_bits = 0x01;
-            gRes = 32.8;
-            break;
-        case 2000: 
-            fsr_bits = 0x00;
-            gRes = 16.4;
-            break;
-        default:   return -1;
-    }
+    const icm_code_t *fsr = icm_lookup(icm_gyro_fsr_codes, fsr_dps);
+    if (!fsr) return -1;
+    const icm_code_t *odr = icm_lookup(icm_odr_codes, odr_hz);
+    if (!odr) return -2;
 
-    // Map ODR
-    switch (odr_hz) {
-        case 25:   odr_bits = 0x0B; break;
-        case 50:   odr_bits = 0x0A; break;
-        case 100:  odr_bits = 0x09; break;
-        case 200:  odr_bits = 0x08; break;
-        case 400:  odr_bits = 0x07; break;
-        case 800:  odr_bits = 0x06; break;
-        case 1600: odr_bits = 0x05; break;
-        default:   return -2;
-    }
+    if (icm_i2c_write_byte(ICM42670_GYRO_CONFIG0_REG, icm_config0(fsr, odr)) != 0) return -3;
+    icm_apply_gyro_scale(fsr);
+    return 0;
+}
 
-    // Write GYRO_CONFIG0
-    uint8_t gyro_config0_val = (fsr_bits << 5) | (odr_bits & 0x0F);
-    if (icm_i2c_write_byte(ICM42670_GYRO_CONFIG0_REG, gyro_config0_val) != 0) return -3;
-    busy_wait_us(400); 
+// GYRO_CONFIG0..ACCEL_CONFIG1 are 0x20..0x24: the batch sends them as one
+// burst (TEMP_CONFIG0 in the middle is rewritten with its shadow value).
+int ICM42670_configure(const ICM42670_config_t *cfg) {
+    const icm_code_t *afsr = icm_lookup(icm_accel_fsr_codes, cfg->accel_fsr_g);
+    const icm_code_t *gfsr = icm_lookup(icm_gyro_fsr_codes, cfg->gyro_fsr_dps);
+    const icm_code_t *aodr = icm_lookup(icm_odr_codes, cfg->accel_odr_hz);
+    const icm_code_t *godr = icm_lookup(icm_odr_codes, cfg->gyro_odr_hz);
+    if (!afsr || !gfsr) return -1;
+    if (!aodr || !godr) return -2;
+    if ((unsigned)cfg->accel_bw > ICM42670_BW_16HZ || (unsigned)cfg->gyro_bw > ICM42670_BW_16HZ ||
+        (unsigned)cfg->accel_avg > ICM42670_AVG_64X) return -4;
+
+    regmap_batch_begin(&icm42670_map);
+    regmap_write(&icm42670_map, ICM42670_GYRO_CONFIG0_REG, icm_config0(gfsr, godr));
+    regmap_write(&icm42670_map, ICM42670_ACCEL_CONFIG0_REG, icm_config0(afsr, aodr));
+    regmap_update_bits(&icm42670_map, ICM42670_GYRO_CONFIG1_REG, 0x07, (uint8_t)cfg->gyro_bw);
+    regmap_update_bits(&icm42670_map, ICM42670_ACCEL_CONFIG1_REG, 0x77,
+                       (uint8_t)((cfg->accel_avg << 4) | cfg->accel_bw));
+    if (regmap_batch_end(&icm42670_map) != 0) return -3;
+
+    icm_apply_accel_scale(afsr, cfg->accel_odr_hz);
+    icm_apply_gyro_scale(gfsr);
     return 0;
 }
 
 //put in low noise both acc and gyr
 int ICM42670_enable_accel_gyro_ln_mode() {
-    int rc = icm_i2c_write_byte(ICM42670_PWR_MGMT0_REG , 0x0F); // bits 3:2 = gyro LN, bits 1:0 = accel LN
-    busy_wait_us(400);
-    return rc;
+    return icm_i2c_write_byte(ICM42670_PWR_MGMT0_REG , 0x0F); // bits 3:2 = gyro LN, bits 1:0 = accel LN
 }
 
 //Remove gyro and low power mode for accelearoter
 int ICM42670_enable_ultra_low_power_mode(void) {
     // Accel = LP (10), Gyro = OFF (00)
     // PWR_MGMT0 = 0b00000010 = 0x02
-    int rc = icm_i2c_write_byte(ICM42670_PWR_MGMT0_REG , 0x02);
-    busy_wait_us(200);
-    return rc;
+    return icm_i2c_write_byte(ICM42670_PWR_MGMT0_REG , 0x02);
 }
 
 //Both gyro and acceleremoter in low power. Usually the gyro has lot of errors. 
 int ICM42670_enable_accel_gyro_lp_mode(void) {
     // Gyro = 10 (LP), Accel = 10 (LP)
     // 0b00001010 = 0x0A
-    int rc = icm_i2c_write_byte(ICM42670_PWR_MGMT0_REG, 0x0A);
-    busy_wait_us(200);
-    return rc;
+    return icm_i2c_write_byte(ICM42670_PWR_MGMT0_REG, 0x0A);
 }
 
+// The three steps are collected in the register shadow and written together:
+// GYRO_CONFIG0 + ACCEL_CONFIG0 in one burst, then PWR_MGMT0.
 int ICM42670_start_with_default_values(void) {
     int rc;
 
+    regmap_batch_begin(&icm42670_map);
+
     // Put both sensors into Low-Noise mode
     rc = ICM42670_enable_accel_gyro_ln_mode();
-    if (rc != 0) return rc;
+    if (rc == 0)
+        // Start accelerometer with defaults (e.g., 100 Hz, ±4 g)
+        rc = ICM42670_startAccel(ICM42670_ACCEL_ODR_DEFAULT,
+                                 ICM42670_ACCEL_FSR_DEFAULT);
+    if (rc == 0)
+        // Start gyroscope with defaults (e.g., 100 Hz, ±250 dps)
+        rc = ICM42670_startGyro(ICM42670_GYRO_ODR_DEFAULT,
+                                ICM42670_GYRO_FSR_DEFAULT);
+
+    if (regmap_batch_end(&icm42670_map) != 0 && rc == 0) rc = -3;
+    return rc;
+}
 
-    // Start accelerometer with defaults (e.g., 100 Hz, ±4 g)
-    rc = ICM42670_startAccel(ICM42670_ACCEL_ODR_DEFAULT,
-                             ICM42670_ACCEL_FSR_DEFAULT);
-    if (rc != 0) return rc;
 
-    // Start gyroscope with defaults (e.g., 100 Hz, ±250 dps)
-    rc = ICM42670_startGyro(ICM42670_GYRO_ODR_DEFAULT,
-                            ICM42670_GYRO_FSR_DEFAULT);
-    if (rc != 0) return rc;
+int ICM42670_read_raw(ICM42670_raw_t *raw) {
+    uint8_t buf[14]; // 14 bytes total from TEMP to GYRO Z
 
+    int rc = icm_i2c_read_bytes(ICM42670_SENSOR_DATA_START_REG, buf, sizeof(buf));
+    if (rc != 0) return rc;
 
+    // Convert to signed 16-bit integers (big-endian)
+    raw->temp = (int16_t)((buf[0] << 8) | buf[1]);
+    for (int i = 0; i < 3; ++i) {
+        raw->accel[i] = (int16_t)((buf[2 + 2 * i] << 8) | buf[3 + 2 * i]);
+        raw->gyro[i] = (int16_t)((buf[8 + 2 * i] << 8) | buf[9 + 2 * i]);
+    }
     return 0;
 }
 
+const ICM42670_scale_t *ICM42670_get_scale(void) {
+    return &icm_scale;
+}
 
+// Multiplications by the precomputed reciprocals: a soft-float division
+// costs several times as much on the M0+
 int ICM42670_read_sensor_data(float *ax, float *ay, float *az,
     float *gx, float *gy, float *gz,float *t) {
-        
-        uint8_t raw[14]; // 14 bytes total from TEMP to GYRO Z
-
-        int rc = icm_i2c_read_bytes(ICM42670_SENSOR_DATA_START_REG, raw, sizeof(raw));
+        ICM42670_raw_t raw;
+        int rc = ICM42670_read_raw(&raw);
         if (rc != 0) return rc;
 
-        // Convert to signed 16-bit integers (big-endian)
-        int16_t t_raw = (int16_t)((raw[0] << 8) | raw[1]);
-        int16_t ax_raw = ((int16_t)raw[2] << 8) | raw[3];
-        int16_t ay_raw = ((int16_t)raw[4] << 8) | raw[5];
-        int16_t az_raw = ((int16_t)raw[6] << 8) | raw[7];
-        int16_t gx_raw = (int16_t)((raw[8] << 8) | raw[9]);
-        int16_t gy_raw = (int16_t)((raw[10] << 8) | raw[11]);
-        int16_t gz_raw = (int16_t)((raw[12] << 8) | raw[13]);
-
-        *t = ((float)t_raw / 128.0f)+ 25.0;
-        *ax =  (float)ax_raw / aRes; 
-        *ay =  (float)ay_raw / aRes; 
-        *az =  (float)az_raw / aRes;
-        *gx =  (float)gx_raw / gRes; 
-        *gy =  (float)gy_raw / gRes; 
-        *gz =  (float)gz_raw / gRes;
+        *t = (float)raw.temp * (1.0f / 128.0f) + 25.0f;
+        *ax = (float)raw.accel[0] * icm_scale.accel_inv;
+        *ay = (float)raw.accel[1] * icm_scale.accel_inv;
+        *az = (float)raw.accel[2] * icm_scale.accel_inv;
+        *gx = (float)raw.gyro[0] * icm_scale.gyro_inv;
+        *gy = (float)raw.gyro[1] * icm_scale.gyro_inv;
+        *gz = (float)raw.gyro[2] * icm_scale.gyro_inv;
         return 0; // success
 }
 
+/* -------- INT1 and FIFO streaming -------- */
+
+static SemaphoreHandle_t icm_int_sem;      // given by the INT1 edge
+static volatile uint64_t icm_int_time_us;  // time of the last edge
+static volatile uint32_t icm_int_count;    // edges since boot, also guards icm_int_time_us
+static uint32_t icm_drdy_seen;             // icm_int_count at the last data-ready read
+static uint32_t icm_drdy_missed;
+static uint16_t icm_fifo_watermark;
+// FIFO time base: the packet that raised the last INT1 edge (its position
+// from the head of the FIFO until it has been read) and the newest packet
+// returned so far, which the next read continues from
+static uint32_t icm_fifo_edges;            // icm_int_count when the edge was taken
+static int32_t icm_fifo_edge_pos = -1;     // -1: no edge waiting for its packet
+static uint64_t icm_fifo_edge_us;
+static bool icm_fifo_have_last;
+static uint16_t icm_fifo_last_ts;
+static uint64_t icm_fifo_last_us;
+
+static void icm_int1_irq(void) {
+    if (!(gpio_get_irq_event_mask(ICM42670_INT) & GPIO_IRQ_EDGE_FALL)) return;
+    gpio_acknowledge_irq(ICM42670_INT, GPIO_IRQ_EDGE_FALL);
+    // Odd count while the time is being written (read by the other core)
+    icm_int_count++;
+    __dmb();
+    icm_int_time_us = time_us_64();
+    __dmb();
+    icm_int_count++;
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(icm_int_sem, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+// Raw handler, so applications keep gpio_set_irq_enabled_with_callback()
+// for their buttons.
+static int icm_int1_init(void) {
+    if (icm_int_sem != NULL) return 0;
+    icm_int_sem = xSemaphoreCreateBinary();
+    if (icm_int_sem == NULL) return -1;
+    gpio_init(ICM42670_INT);
+    gpio_set_dir(ICM42670_INT, GPIO_IN);
+    gpio_add_raw_irq_handler(ICM42670_INT, icm_int1_irq);
+    gpio_set_irq_enabled(ICM42670_INT, GPIO_IRQ_EDGE_FALL, true);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+    return 0;
+}
+
+// Time of the last INT1 edge and the number of edges so far (2 per edge)
+static uint64_t icm_int_last(uint32_t *count) {
+    uint32_t c;
+    uint64_t t;
+    do {
+        c = icm_int_count;
+        __dmb();
+        t = icm_int_time_us;
+        __dmb();
+    } while ((c & 1) || c != icm_int_count);
+    if (count) *count = c;
+    return t;
+}
+
+// BLK_SEL_W, MADDR_W and M_W are consecutive, so an MREG1 write is one burst.
+static int icm_mreg1_write(uint8_t reg, uint8_t value) {
+    uint8_t tx[4] = { ICM42670_BLK_SEL_W_REG, 0x00, reg, value };
+    int result = i2c_bus_transfer(ICM42670_I2C_ADDRESS, tx, sizeof(tx), NULL, 0);
+    busy_wait_us(10);   // datasheet: 10 µs before the next MREG access
+    return result == sizeof(tx) ? 0 : -1;
+}
+
+// Same for reads: BLK_SEL_R + MADDR_R in one burst, then M_R
+static int icm_mreg1_read(uint8_t reg, uint8_t *value) {
+    uint8_t tx[3] = { ICM42670_BLK_SEL_R_REG, 0x00, reg };
+    if (i2c_bus_transfer(ICM42670_I2C_ADDRESS, tx, sizeof(tx), NULL, 0) != sizeof(tx)) return -1;
+    busy_wait_us(10);
+    int rc = icm_i2c_read_byte(ICM42670_M_R_REG, value);
+    busy_wait_us(10);
+    return rc;
+}
+
+bool ICM42670_wait_interrupt(uint32_t timeout_ms) {
+    if (icm_int_sem == NULL) return false;
+    return xSemaphoreTake(icm_int_sem, pdMS_TO_TICKS(timeout_ms)) == pdTRUE;
+}
+
+int ICM42670_fifo_start(uint16_t watermark) {
+    if (watermark == 0 || watermark > ICM42670_FIFO_MAX_PACKETS) return -1;
+    if (icm_int1_init() != 0) return -2;
+
+    // FIFO bypassed while it is configured; 0x28-0x2B go out as one burst
+    regmap_batch_begin(&icm42670_map);
+    regmap_write(&icm42670_map, ICM42670_FIFO_CONFIG1_REG, ICM42670_FIFO_BYPASS);
+    regmap_write(&icm42670_map, ICM42670_FIFO_CONFIG2_REG, watermark & 0xFF);
+    regmap_write(&icm42670_map, ICM42670_FIFO_CONFIG3_REG, (watermark >> 8) & 0x0F);
+    regmap_update_bits(&icm42670_map, ICM42670_INT_SOURCE0_REG,
+                       ICM42670_INT_FIFO_THS, ICM42670_INT_FIFO_THS);
+    regmap_update_bits(&icm42670_map, ICM42670_INTF_CONFIG0_REG,
+                       ICM42670_FIFO_COUNT_RECORDS, ICM42670_FIFO_COUNT_RECORDS);
+    regmap_write(&icm42670_map, ICM42670_INT_CONFIG, ICM42670_INT1_CONFIG_VALUE);
+    if (regmap_batch_end(&icm42670_map) != 0) return -3;
+
+    if (icm_mreg1_write(ICM42670_MREG1_FIFO_CONFIG5, ICM42670_FIFO_CONFIG5_VALUE) != 0) return -3;
+    if (icm_i2c_write_byte(ICM42670_REG_SIGNAL_PATH_RESET, ICM42670_FIFO_FLUSH) != 0) return -3;
+    icm_fifo_watermark = watermark;
+    xSemaphoreTake(icm_int_sem, 0);     // drop an edge left from a previous run
+    icm_int_last(&icm_fifo_edges);
+    icm_fifo_edge_pos = -1;
+    icm_fifo_have_last = false;
+
+    // Stream mode
+    return icm_i2c_write_byte(ICM42670_FIFO_CONFIG1_REG, 0x00) == 0 ? 0 : -3;
+}
+
+int ICM42670_fifo_stop(void) {
+    regmap_batch_begin(&icm42670_map);
+    regmap_update_bits(&icm42670_map, ICM42670_INT_SOURCE0_REG, ICM42670_INT_FIFO_THS, 0x00);
+    regmap_write(&icm42670_map, ICM42670_FIFO_CONFIG1_REG, ICM42670_FIFO_BYPASS);
+    if (regmap_batch_end(&icm42670_map) != 0) return -1;
+    return icm_i2c_write_byte(ICM42670_REG_SIGNAL_PATH_RESET, ICM42670_FIFO_FLUSH);
+}
+
+int ICM42670_fifo_count(void) {
+    uint8_t count[2];
+    if (icm_i2c_read_bytes(ICM42670_FIFO_COUNTH_REG, count, sizeof(count)) != 0) return -1;
+    return (count[0] << 8) | count[1];     // packets (INTF_CONFIG0 set by fifo_start)
+}
+
+// Packet: header, accel X/Y/Z, gyro X/Y/Z (big-endian), temp (int8), timestamp
+static bool icm_fifo_decode(const uint8_t *p, ICM42670_sample_t *s) {
+    // Header bit 7: empty packet; bits 6/5: accel/gyro present
+    if ((p[0] & 0x80) || (p[0] & 0x60) != 0x60) return false;
+    int16_t ax_raw = (int16_t)((p[1] << 8) | p[2]);
+    if (ax_raw == INT16_MIN) return false;  // sensor not ready yet
+    s->ax = (float)ax_raw * icm_scale.accel_inv;
+    s->ay = (float)(int16_t)((p[3] << 8) | p[4]) * icm_scale.accel_inv;
+    s->az = (float)(int16_t)((p[5] << 8) | p[6]) * icm_scale.accel_inv;
+    s->gx = (float)(int16_t)((p[7] << 8) | p[8]) * icm_scale.gyro_inv;
+    s->gy = (float)(int16_t)((p[9] << 8) | p[10]) * icm_scale.gyro_inv;
+    s->gz = (float)(int16_t)((p[11] << 8) | p[12]) * icm_scale.gyro_inv;
+    s->t = (float)(int8_t)p[13] * 0.5f + 25.0f;
+    s->timestamp = (uint16_t)((p[14] << 8) | p[15]);
+    return true;
+}
+
+// Empty packets carry no time stamp
+static inline bool icm_fifo_ts(const uint8_t *p, uint16_t *ts) {
+    if (p[0] & 0x80) return false;
+    *ts = (uint16_t)((p[14] << 8) | p[15]);
+    return true;
+}
+
+int ICM42670_fifo_read(ICM42670_sample_t *samples, size_t max) {
+    int count = ICM42670_fifo_count();
+    if (count <= 0 || max == 0) return count < 0 ? count : 0;
+    size_t n = (size_t)count < max ? (size_t)count : max;
+
+    // The raw packets are read into the upper half of the caller's array.
+    // A decoded sample is twice the size of a packet, so sample i never
+    // reaches packet i + 1 and the array can be decoded in place.
+    _Static_assert(sizeof(ICM42670_sample_t) >= 2 * ICM42670_FIFO_PACKET_SIZE,
+                   "in-place FIFO decode needs samples twice the packet size");
+    uint8_t *raw = (uint8_t *)samples + n * sizeof(ICM42670_sample_t)
+                   - n * ICM42670_FIFO_PACKET_SIZE;
+    uint8_t reg = ICM42670_FIFO_DATA_REG;
+    size_t len = n * ICM42670_FIFO_PACKET_SIZE;
+    int result = i2c_bus_transfer(ICM42670_I2C_ADDRESS, &reg, 1, raw, len);
+    if (result != (int)len + 1) return -2;
+
+    // A new INT1 edge was raised by the packet at the watermark position,
+    // counted from the head of the FIFO, which is the first packet read now
+    uint32_t edges;
+    uint64_t edge_us = icm_int_last(&edges);
+    if (edges != icm_fifo_edges) {
+        icm_fifo_edges = edges;
+        icm_fifo_edge_pos = (int32_t)icm_fifo_watermark - 1;
+        icm_fifo_edge_us = edge_us;
+    }
+
+    // Sensor time of the edge packet and of the newest packet, relative to
+    // the first one. The 16-bit stamps are summed as differences between
+    // neighbours, so only the gap between two packets must stay under the
+    // 65.5 ms wrap, not the whole batch.
+    uint64_t rel = 0, rel_edge = 0;
+    uint16_t ts, first_ts = 0, prev_ts = 0;
+    int32_t valid = 0, newest = 0;
+    bool edge_read = false;
+    for (size_t i = 0; i < n; ++i) {
+        if (!icm_fifo_ts(raw + i * ICM42670_FIFO_PACKET_SIZE, &ts)) continue;
+        if (valid++) rel += (uint16_t)(ts - prev_ts);
+        else first_ts = ts;
+        prev_ts = ts;
+        newest = (int32_t)i;
+        if ((int32_t)i == icm_fifo_edge_pos) { rel_edge = rel; edge_read = true; }
+    }
+
+    // Time of the first packet: from the edge when its packet is in this
+    // batch, else continued from the newest packet of the previous read
+    uint64_t t0;
+    if (edge_read) {
+        t0 = icm_fifo_edge_us - rel_edge;
+    } else if (icm_fifo_have_last) {
+        t0 = icm_fifo_last_us + (uint16_t)(first_ts - icm_fifo_last_ts);
+    } else if (icm_fifo_edge_pos > newest && valid > 1) {
+        // First read stopped short of the edge packet: step back from the
+        // edge by the mean packet period
+        uint64_t period = rel / (uint64_t)(valid - 1);
+        t0 = icm_fifo_edge_us - rel - period * (uint64_t)(icm_fifo_edge_pos - newest);
+    } else {
+        t0 = time_us_64() - rel;    // no edge yet: the newest packet is recent
+    }
+    icm_fifo_edge_pos = icm_fifo_edge_pos >= (int32_t)n ? icm_fifo_edge_pos - (int32_t)n : -1;
+
+    int stored = 0;
+    uint64_t t = t0;
+    valid = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const uint8_t *p = raw + i * ICM42670_FIFO_PACKET_SIZE;
+        if (icm_fifo_ts(p, &ts)) {
+            if (valid++) t += (uint16_t)(ts - prev_ts);
+            prev_ts = ts;
+        }
+        ICM42670_sample_t s;
+        if (icm_fifo_decode(p, &s)) {
+            s.time_us = t;
+            samples[stored++] = s;
+        }
+    }
+    if (valid) {
+        icm_fifo_have_last = true;
+        icm_fifo_last_ts = prev_ts;
+        icm_fifo_last_us = t;
+    }
+    return stored;
+}
+
+/* -------- Data-ready sampling -------- */
+
+int ICM42670_drdy_start(void) {
+    if (icm_int1_init() != 0) return -2;
+    regmap_batch_begin(&icm42670_map);
+    regmap_write(&icm42670_map, ICM42670_INT_CONFIG, ICM42670_INT1_CONFIG_VALUE);
+    regmap_update_bits(&icm42670_map, ICM42670_INT_SOURCE0_REG,
+                       ICM42670_INT_DRDY, ICM42670_INT_DRDY);
+    if (regmap_batch_end(&icm42670_map) != 0) return -3;
+    xSemaphoreTake(icm_int_sem, 0);
+    icm_int_last(&icm_drdy_seen);
+    icm_drdy_missed = 0;
+    return 0;
+}
+
+int ICM42670_drdy_stop(void) {
+    return regmap_update_bits(&icm42670_map, ICM42670_INT_SOURCE0_REG,
+                              ICM42670_INT_DRDY, 0x00) == 0 ? 0 : -1;
+}
+
+int ICM42670_read_sample(ICM42670_sample_t *s, uint32_t timeout_ms) {
+    if (!ICM42670_wait_interrupt(timeout_ms)) return -1;
+
+    uint32_t count;
+    uint64_t t_us = icm_int_last(&count);
+    // Two count steps per edge: one edge since the last read is the normal case
+    uint32_t edges = (count - icm_drdy_seen) / 2;
+    if (edges > 1) icm_drdy_missed += edges - 1;
+    icm_drdy_seen = count;
+
+    if (ICM42670_read_sensor_data(&s->ax, &s->ay, &s->az,
+                                  &s->gx, &s->gy, &s->gz, &s->t) != 0) return -2;
+    s->timestamp = 0;
+    s->time_us = t_us;
+    return 0;
+}
+
+uint32_t ICM42670_drdy_missed(void) {
+    return icm_drdy_missed;
+}
+
+/* -------- APEX motion engine -------- */
+
+#define ICM42670_WOM_DEFAULT_THR    98      // 1/256 g: about 0.38 g between samples
+
+static int icm_mreg1_update(uint8_t reg, uint8_t mask, uint8_t value) {
+    uint8_t v;
+    if (icm_mreg1_read(reg, &v) != 0) return -1;
+    return icm_mreg1_write(reg, (uint8_t)((v & ~mask) | (value & mask)));
+}
+
+static int icm_wom_enable(uint8_t threshold) {
+    for (int i = 0; i < 3; ++i)
+        if (icm_mreg1_write(ICM42670_MREG1_WOM_X_THR + i, threshold) != 0) return -1;
+    busy_wait_us(1000);     // the thresholds must be in place before WOM_EN
+    return regmap_write(&icm42670_map, ICM42670_WOM_CONFIG_REG, ICM42670_WOM_EN_VALUE) == 0 ? 0 : -1;
+}
+
+int ICM42670_apex_start(uint8_t features) {
+    if (icm_accel_odr_hz < 50) return -1;
+    if (icm_int1_init() != 0) return -2;
+
+    // Clear the DMP memory, then run its initialization (DMP_INIT self-clears)
+    if (icm_i2c_write_byte(ICM42670_APEX_CONFIG0_REG, ICM42670_DMP_MEM_RESET) != 0) return -3;
+    busy_wait_us(1000);
+    if (icm_i2c_write_byte(ICM42670_APEX_CONFIG0_REG, ICM42670_DMP_INIT) != 0) return -3;
+    uint8_t v = ICM42670_DMP_INIT;
+    for (int i = 0; i < 50 && (v & ICM42670_DMP_INIT); ++i) {
+        sleep_ms(1);
+        if (icm_i2c_read_byte(ICM42670_APEX_CONFIG0_REG, &v) != 0) return -3;
+    }
+    if (v & ICM42670_DMP_INIT) return -4;
+
+    if ((features & ICM42670_APEX_SMD) && icm_wom_enable(ICM42670_WOM_DEFAULT_THR) != 0) return -3;
+
+    uint8_t enable = ICM42670_DMP_ODR_50HZ, source6 = 0;
+    if (features & ICM42670_APEX_STEP) {
+        enable |= ICM42670_APEX_PED_EN;
+        source6 |= ICM42670_INT_STEP_DET | ICM42670_INT_STEP_CNT_OVF;
+    }
+    if (features & ICM42670_APEX_TILT) {
+        enable |= ICM42670_APEX_TILT_EN;
+        source6 |= ICM42670_INT_TILT_DET;
+    }
+    if (features & ICM42670_APEX_FREEFALL) {
+        enable |= ICM42670_APEX_FF_EN;
+        source6 |= ICM42670_INT_FF_EN;
+    }
+    if (features & ICM42670_APEX_SMD) enable |= ICM42670_APEX_SMD_EN;
+
+    if (icm_mreg1_update(ICM42670_MREG1_INT_SOURCE6,
+                         ICM42670_INT_STEP_DET | ICM42670_INT_STEP_CNT_OVF |
+                         ICM42670_INT_TILT_DET | ICM42670_INT_FF_EN, source6) != 0) return -3;
+    regmap_batch_begin(&icm42670_map);
+    regmap_write(&icm42670_map, ICM42670_APEX_CONFIG1_REG, enable);
+    regmap_update_bits(&icm42670_map, ICM42670_INT_SOURCE1_REG, ICM42670_INT_SMD,
+                       (features & ICM42670_APEX_SMD) ? ICM42670_INT_SMD : 0);
+    regmap_write(&icm42670_map, ICM42670_INT_CONFIG, ICM42670_INT1_CONFIG_VALUE);
+    if (regmap_batch_end(&icm42670_map) != 0) return -3;
+    xSemaphoreTake(icm_int_sem, 0);
+    return 0;
+}
+
+int ICM42670_apex_stop(void) {
+    int rc = icm_mreg1_update(ICM42670_MREG1_INT_SOURCE6,
+                              ICM42670_INT_STEP_DET | ICM42670_INT_STEP_CNT_OVF |
+                              ICM42670_INT_TILT_DET | ICM42670_INT_FF_EN, 0);
+    regmap_batch_begin(&icm42670_map);
+    regmap_update_bits(&icm42670_map, ICM42670_APEX_CONFIG1_REG,
+                       ICM42670_APEX_SMD_EN | ICM42670_APEX_FF_EN |
+                       ICM42670_APEX_TILT_EN | ICM42670_APEX_PED_EN, 0);
+    regmap_update_bits(&icm42670_map, ICM42670_INT_SOURCE1_REG, ICM42670_INT_SMD, 0);
+    if (regmap_batch_end(&icm42670_map) != 0) rc = -1;
+    return rc;
+}
+
+int ICM42670_apex_wait(ICM42670_apex_event_t *ev, uint32_t timeout_ms) {
+    if (!ICM42670_wait_interrupt(timeout_ms)) return 0;
+    ev->time_us = icm_int_last(NULL);
+
+    // INT_STATUS2 and INT_STATUS3 clear on read
+    uint8_t st[2];
+    if (icm_i2c_read_bytes(ICM42670_INT_STATUS2_REG, st, sizeof(st)) != 0) return -2;
+    ev->events = 0;
+    if (st[0] & ICM42670_INT_SMD)            ev->events |= ICM42670_APEX_SMD;
+    if (st[1] & ICM42670_INT_STEP_DET)       ev->events |= ICM42670_APEX_STEP;
+    if (st[1] & ICM42670_INT_STEP_CNT_OVF)   ev->events |= ICM42670_APEX_STEP_OVERFLOW;
+    if (st[1] & ICM42670_INT_TILT_DET)       ev->events |= ICM42670_APEX_TILT;
+    if (st[1] & ICM42670_INT_FF_DET)         ev->events |= ICM42670_APEX_FREEFALL;
+
+    // APEX_DATA0..3: step count (little-endian), cadence, activity class
+    uint8_t d[4];
+    if (icm_i2c_read_bytes(ICM42670_APEX_DATA0_REG, d, sizeof(d)) != 0) return -2;
+    ev->steps = (uint16_t)(d[0] | (d[1] << 8));
+    ev->cadence = d[2];
+    ev->activity = d[3] & 0x03;
+    return ev->events ? 1 : 0;
+}
+
+/* -------- Wake-on-motion duty cycling -------- */
+
+static ICM42670_wom_config_t icm_wom_cfg;
+static ICM42670_wom_stats_t icm_wom_stats;
+static uint64_t icm_wom_last_motion_us;
+
+static void icm_wom_enter(ICM42670_wom_state_t state, uint64_t now) {
+    if (icm_wom_stats.state == ICM42670_WOM_IDLE) icm_wom_stats.idle_us += now - icm_wom_stats.last_change_us;
+    if (icm_wom_stats.state == ICM42670_WOM_ACTIVE) icm_wom_stats.active_us += now - icm_wom_stats.last_change_us;
+    if (state == ICM42670_WOM_ACTIVE) icm_wom_stats.wakeups++;
+    if (state == ICM42670_WOM_IDLE && icm_wom_stats.state == ICM42670_WOM_ACTIVE) icm_wom_stats.sleeps++;
+    icm_wom_stats.state = state;
+    icm_wom_stats.last_change_us = now;
+}
+
+// Accel LP at the idle ODR, gyro off
+static int icm_wom_go_idle(void) {
+    regmap_batch_begin(&icm42670_map);
+    int rc = ICM42670_startAccel(icm_wom_cfg.idle_odr_hz, icm_wom_cfg.accel_fsr_g);
+    if (rc == 0) rc = ICM42670_enable_ultra_low_power_mode();
+    if (regmap_batch_end(&icm42670_map) != 0 && rc == 0) rc = -3;
+    return rc;
+}
+
+// Accel + gyro LN at the active ODR: CONFIG0 burst, then PWR_MGMT0
+static int icm_wom_go_active(void) {
+    regmap_batch_begin(&icm42670_map);
+    int rc = ICM42670_startAccel(icm_wom_cfg.active_odr_hz, icm_wom_cfg.accel_fsr_g);
+    if (rc == 0) rc = ICM42670_startGyro(icm_wom_cfg.active_odr_hz, icm_wom_cfg.gyro_fsr_dps);
+    if (rc == 0) rc = ICM42670_enable_accel_gyro_ln_mode();
+    if (regmap_batch_end(&icm42670_map) != 0 && rc == 0) rc = -3;
+    return rc;
+}
+
+int ICM42670_wom_start(const ICM42670_wom_config_t *cfg) {
+    if (cfg->threshold_mg == 0 || cfg->threshold_mg > 996) return -1;
+    icm_wom_cfg = *cfg;
+    if (icm_int1_init() != 0) return -2;
+
+    // Idle settings first: WoM needs the accel running for the MREG writes
+    if (icm_wom_go_idle() != 0) return -1;
+    uint8_t thr = (uint8_t)((cfg->threshold_mg * 256u + 500) / 1000);
+    if (icm_wom_enable(thr ? thr : 1) != 0) return -3;
+    regmap_batch_begin(&icm42670_map);
+    regmap_update_bits(&icm42670_map, ICM42670_INT_SOURCE1_REG, ICM42670_INT_WOM_XYZ, ICM42670_INT_WOM_XYZ);
+    regmap_write(&icm42670_map, ICM42670_INT_CONFIG, ICM42670_INT1_CONFIG_VALUE);
+    if (regmap_batch_end(&icm42670_map) != 0) return -3;
+
+    uint8_t st;
+    icm_i2c_read_byte(ICM42670_INT_STATUS2_REG, &st);      // clear a stale event
+    xSemaphoreTake(icm_int_sem, 0);
+    icm_wom_stats = (ICM42670_wom_stats_t){ .state = ICM42670_WOM_OFF };
+    icm_wom_enter(ICM42670_WOM_IDLE, time_us_64());
+    return 0;
+}
+
+int ICM42670_wom_update(uint32_t timeout_ms) {
+    uint8_t st;
+    uint64_t now;
+
+    switch (icm_wom_stats.state) {
+    case ICM42670_WOM_IDLE:
+        if (!ICM42670_wait_interrupt(timeout_ms)) return ICM42670_WOM_IDLE;
+        if (icm_i2c_read_byte(ICM42670_INT_STATUS2_REG, &st) != 0) return -2;
+        if (!(st & ICM42670_INT_WOM_XYZ)) return ICM42670_WOM_IDLE;
+        now = icm_int_last(NULL);
+        if (icm_wom_go_active() != 0) return -2;
+        icm_wom_last_motion_us = now;
+        icm_wom_enter(ICM42670_WOM_ACTIVE, now);
+        return ICM42670_WOM_ACTIVE;
+
+    case ICM42670_WOM_ACTIVE:
+        // The comparators keep running in LN mode: their status says whether we still move
+        xSemaphoreTake(icm_int_sem, 0);
+        if (icm_i2c_read_byte(ICM42670_INT_STATUS2_REG, &st) != 0) return -2;
+        now = time_us_64();
+        if (st & ICM42670_INT_WOM_XYZ) icm_wom_last_motion_us = now;
+        if (now - icm_wom_last_motion_us < (uint64_t)icm_wom_cfg.quiet_ms * 1000u)
+            return ICM42670_WOM_ACTIVE;
+        if (icm_wom_go_idle() != 0) return -2;
+        xSemaphoreTake(icm_int_sem, 0);
+        icm_wom_enter(ICM42670_WOM_IDLE, now);
+        return ICM42670_WOM_IDLE;
+
+    default:
+        return ICM42670_WOM_OFF;
+    }
+}
+
+int ICM42670_wom_stop(void) {
+    regmap_batch_begin(&icm42670_map);
+    regmap_write(&icm42670_map, ICM42670_WOM_CONFIG_REG, 0x00);
+    regmap_update_bits(&icm42670_map, ICM42670_INT_SOURCE1_REG, ICM42670_INT_WOM_XYZ, 0x00);
+    int rc = regmap_batch_end(&icm42670_map) == 0 ? 0 : -1;
+    icm_wom_enter(ICM42670_WOM_OFF, time_us_64());
+    return rc;
+}
+
+void ICM42670_wom_get_stats(ICM42670_wom_stats_t *stats) {
+    *stats = icm_wom_stats;
+    uint64_t in_state = time_us_64() - stats->last_change_us;
+    if (stats->state == ICM42670_WOM_IDLE) stats->idle_us += in_state;
+    if (stats->state == ICM42670_WOM_ACTIVE) stats->active_us += in_state;
+}
+
+/* -------- Offset calibration -------- */
+
+// OFFSET_USER0..8 hold six 12-bit values: gyro X/Y/Z then accel X/Y/Z,
+// low bytes in their own registers and the high nibbles paired up
+static void icm_offsets_pack(const ICM42670_offsets_t *o, uint8_t b[9]) {
+    b[0] = o->gyro[0] & 0xFF;
+    b[1] = ((o->gyro[1] >> 4) & 0xF0) | ((o->gyro[0] >> 8) & 0x0F);
+    b[2] = o->gyro[1] & 0xFF;
+    b[3] = o->gyro[2] & 0xFF;
+    b[4] = ((o->accel[0] >> 4) & 0xF0) | ((o->gyro[2] >> 8) & 0x0F);
+    b[5] = o->accel[0] & 0xFF;
+    b[6] = o->accel[1] & 0xFF;
+    b[7] = ((o->accel[2] >> 4) & 0xF0) | ((o->accel[1] >> 8) & 0x0F);
+    b[8] = o->accel[2] & 0xFF;
+}
+
+static int16_t icm_sext12(uint16_t v) {
+    return (int16_t)(v & 0x800 ? v | 0xF000 : v & 0x0FFF);
+}
+
+static void icm_offsets_unpack(const uint8_t b[9], ICM42670_offsets_t *o) {
+    o->gyro[0] = icm_sext12(((b[1] & 0x0F) << 8) | b[0]);
+    o->gyro[1] = icm_sext12(((b[1] & 0xF0) << 4) | b[2]);
+    o->gyro[2] = icm_sext12(((b[4] & 0x0F) << 8) | b[3]);
+    o->accel[0] = icm_sext12(((b[4] & 0xF0) << 4) | b[5]);
+    o->accel[1] = icm_sext12(((b[7] & 0x0F) << 8) | b[6]);
+    o->accel[2] = icm_sext12(((b[7] & 0xF0) << 4) | b[8]);
+}
+
+static int16_t icm_offset_clamp(float v) {
+    if (v > ICM42670_OFFSET_MAX) return ICM42670_OFFSET_MAX;
+    if (v < -ICM42670_OFFSET_MAX) return -ICM42670_OFFSET_MAX;
+    return (int16_t)(v < 0 ? v - 0.5f : v + 0.5f);
+}
+
+int ICM42670_set_offsets(const ICM42670_offsets_t *offsets) {
+    uint8_t b[9];
+    icm_offsets_pack(offsets, b);
+    for (int i = 0; i < 9; ++i)
+        if (icm_mreg1_write(ICM42670_MREG1_OFFSET_USER0 + i, b[i]) != 0) return -1;
+    return 0;
+}
+
+int ICM42670_get_offsets(ICM42670_offsets_t *offsets) {
+    uint8_t b[9];
+    for (int i = 0; i < 9; ++i)
+        if (icm_mreg1_read(ICM42670_MREG1_OFFSET_USER0 + i, &b[i]) != 0) return -1;
+    icm_offsets_unpack(b, offsets);
+    return 0;
+}
+
+int ICM42670_calibrate(uint16_t samples, ICM42670_offsets_t *offsets) {
+    if (samples < 2 || icm_accel_odr_hz == 0 || aRes == 0 || gRes == 0) return -1;
+
+    // Measure without the previous correction
+    const ICM42670_offsets_t zero = { { 0, 0, 0 }, { 0, 0, 0 } };
+    if (ICM42670_set_offsets(&zero) != 0) return -2;
+
+    uint32_t period_us = 1000000u / icm_accel_odr_hz;
+    sleep_us(ICM42670_CALIB_SETTLE_MS * 1000);
+
+    // Welford running mean and variance, in counts
+    float mean[6] = { 0 }, m2[6] = { 0 };
+    for (uint16_t n = 1; n <= samples; ++n) {
+        ICM42670_raw_t raw;
+        if (ICM42670_read_raw(&raw) != 0) return -2;
+        for (int i = 0; i < 6; ++i) {
+            float x = i < 3 ? raw.accel[i] : raw.gyro[i - 3];
+            float d = x - mean[i];
+            mean[i] += d / n;
+            m2[i] += d * (x - mean[i]);
+        }
+        sleep_us(period_us);
+    }
+
+    // Reject the window if the board moved
+    for (int i = 0; i < 6; ++i) {
+        float sd = sqrtf(m2[i] / (samples - 1));
+        if (i < 3 ? sd / aRes > ICM42670_CALIB_ACCEL_MAX_STD_G
+                  : sd / gRes > ICM42670_CALIB_GYRO_MAX_STD_DPS) return -3;
+    }
+
+    // Gravity is on the axis with the largest reading: expect exactly ±1 g there
+    int up = 0;
+    for (int i = 1; i < 3; ++i)
+        if (fabsf(mean[i]) > fabsf(mean[up])) up = i;
+    mean[up] -= mean[up] > 0 ? aRes : -aRes;
+
+    // The offset registers are added to the output: write minus the bias
+    for (int i = 0; i < 3; ++i) {
+        offsets->accel[i] = icm_offset_clamp(-mean[i] / aRes * ICM42670_ACCEL_OFFSET_PER_G);
+        offsets->gyro[i] = icm_offset_clamp(-mean[i + 3] / gRes * ICM42670_GYRO_OFFSET_PER_DPS);
+    }
+    return ICM42670_set_offsets(offsets) == 0 ? 0 : -2;
+}
+
+
+/* =========================
+ *  SENSOR BRING-UP
+ * ========================= */
+
+static inline uint32_t boot_stamp(void) {
+    return (uint32_t)time_us_64();
+}
+
+// The resets overlap and every wait polls a status bit (the IMU's only after
+// its 1 ms without access, which the HDC2021 and VEML6030 writes fill). All I2C
+// traffic is short transfers, so the order below only decides which device
+// waits on which.
+int init_hat_sensors(hat_boot_timing_t *timing) {
+    hat_boot_timing_t t = { .start_us = boot_stamp() };
+    int failed = 0;
+
+    // 1. Kick off both resets and power the light sensor on
+    if (icm_reset_start() != 0) failed |= HAT_SENSOR_IMU;
+    hdc2021_reset_start();
+    uint8_t veml[3] = { VEML6030_CONFIG_REG, 0x00, 0x10 };   // as in init_veml6030()
+    if (i2c_bus_transfer(VEML6030_I2C_ADDR, veml, sizeof(veml), NULL, 0) == 3)
+        t.veml_config_us = boot_stamp();
+    else
+        failed |= HAT_SENSOR_VEML6030;
+
+    // 2. IMU: clock back, identity, configuration in one batch
+    if (!(failed & HAT_SENSOR_IMU) && icm_reset_wait(TKJHAT_BOOT_TIMEOUT_US) == 0) {
+        t.imu_clock_us = boot_stamp();
+        if (icm_check_identity() == 0 && ICM42670_start_with_default_values() == 0)
+            t.imu_config_us = boot_stamp();
+    }
+    if (!t.imu_config_us) failed |= HAT_SENSOR_IMU;
+
+    // 3. HDC2021: usually out of reset by now
+    if (hdc2021_reset_wait(TKJHAT_BOOT_TIMEOUT_US) == 0 && hdc2021_configure() == 0)
+        t.hdc_config_us = boot_stamp();
+    else
+        failed |= HAT_SENSOR_HDC2021;
+
+    // 4. Wait for the first data of both (status registers clear on read)
+    bool imu_wait = !(failed & HAT_SENSOR_IMU);
+    bool hdc_wait = !(failed & HAT_SENSOR_HDC2021);
+    uint64_t deadline = time_us_64() + TKJHAT_BOOT_TIMEOUT_US;
+    while ((imu_wait || hdc_wait) && time_us_64() < deadline) {
+        uint8_t v;
+        if (imu_wait && icm_i2c_read_byte(ICM42670_INT_STATUS_DRDY_REG, &v) == 0 && (v & ICM42670_DATA_RDY_INT)) {
+            t.imu_first_sample_us = boot_stamp();
+            imu_wait = false;
+        }
+        uint8_t reg = HDC2021_DRDY_STATUS_REG;
+        if (hdc_wait && i2c_bus_transfer(HDC2021_I2C_ADDRESS, &reg, 1, &v, 1) == 2 && (v & HDC2021_DRDY_STATUS)) {
+            t.hdc_first_sample_us = boot_stamp();
+            hdc_wait = false;
+        }
+        busy_wait_us(100);
+    }
+    if (imu_wait) failed |= HAT_SENSOR_IMU;
+    if (hdc_wait) failed |= HAT_SENSOR_HDC2021;
+
+    t.end_us = boot_stamp();
+    if (timing) *timing = t;
+    return failed;
+}
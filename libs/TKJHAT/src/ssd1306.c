@@ -26,6 +26,8 @@ SOFTWARE.
 #include <pico/stdlib.h>
 #include <hardware/i2c.h>
 #include <pico/binary_info.h>
+#include <tkjhat/i2c_bus.h>
+#include <tkjhat/i2c_trace.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -33,14 +35,17 @@ SOFTWARE.
 #include <tkjhat/ssd1306.h>
 #include <tkjhat/font.h>
 
-inline static void swap(int32_t *a, int32_t *b) {
-    int32_t *t=a;
-    *a=*b;
-    *b=*t;
-}
-
 inline static void fancy_write(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, char *name) {
-    switch(i2c_write_blocking(i2c, addr, src, len, false)) {
+    // The HAT display shares i2c_default with the sensors; let the bus manager schedule it
+    int ret;
+    if (i2c == i2c_default) {
+        ret = i2c_bus_transfer(addr, src, len, NULL, 0);
+    } else {
+        uint64_t start_us = time_us_64();
+        ret = i2c_write_blocking(i2c, addr, src, len, false);
+        i2c_trace_record(addr, 0, len, start_us, time_us_64(), ret);
+    }
+    switch(ret) {
     case PICO_ERROR_GENERIC:
         printf("[%s] addr not acknowledged!\n", name);
         break;
@@ -53,70 +58,180 @@ inline static void fancy_write(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src
     }
 }
 
+// Spans are kept as lo > hi when empty
+inline static void span_add(uint8_t *lo, uint8_t *hi, uint32_t page, uint32_t x) {
+    if(x<lo[page]) lo[page]=x;
+    if(x>hi[page]) hi[page]=x;
+}
+
+inline static void span_clear(uint8_t *lo, uint8_t *hi, uint32_t page) {
+    lo[page]=0xFF;
+    hi[page]=0;
+}
+
+void ssd1306_cmdlist_begin(ssd1306_cmdlist_t *l, ssd1306_t *p) {
+    l->p=p;
+    l->buf[0]=0x00;    // Co=0, D/C=0: all following bytes are commands
+    l->len=1;
+}
+
+bool ssd1306_cmdlist_add(ssd1306_cmdlist_t *l, const uint8_t *cmd, size_t len) {
+    if(len>SSD1306_CMDLIST_MAX)
+        return false;
+    if(l->len+len>sizeof(l->buf) && !ssd1306_cmdlist_send(l))
+        return false;
+    memcpy(l->buf+l->len, cmd, len);
+    l->len+=len;
+    return true;
+}
+
+static void cmdlist_write(ssd1306_cmdlist_t *l, char *name) {
+    if(l->len<=1) return;
+    fancy_write(l->p->i2c_i, l->p->address, l->buf, l->len, name);
+    l->len=1;
+}
+
+// Moves flush_state from one state to another, if it is in the first
+static bool flush_claim(ssd1306_t *p, uint8_t from, uint8_t to) {
+    critical_section_enter_blocking(&p->lock);
+    bool ok=p->flush_state==from;
+    if(ok)
+        p->flush_state=to;
+    critical_section_exit(&p->lock);
+    return ok;
+}
+
+bool ssd1306_cmdlist_send(ssd1306_cmdlist_t *l) {
+    ssd1306_t *p=l->p;
+    // A flush relies on the window and start line it set; hold it off
+    if(!flush_claim(p, SSD1306_FLUSH_IDLE, SSD1306_FLUSH_SENDING))
+        return false;
+    cmdlist_write(l, "ssd1306_cmdlist");
+    // The commands may have moved the RAM pointer, the window or the
+    // start line: the next flush sets them again
+    p->win[0]=0xFF;
+    p->win[1]=0;
+    p->start_sent=0xFF;
+    flush_claim(p, SSD1306_FLUSH_SENDING, SSD1306_FLUSH_IDLE);
+    return true;
+}
+
+// The driver's own commands, as one transaction. They know what they do to
+// the address window, so unlike ssd1306_cmdlist_send() it is kept.
+static void write_cmds(ssd1306_t *p, const uint8_t *cmd, size_t len, char *name) {
+    ssd1306_cmdlist_t l;
+    ssd1306_cmdlist_begin(&l, p);
+    ssd1306_cmdlist_add(&l, cmd, len);
+    cmdlist_write(&l, name);
+}
+
 inline static void ssd1306_write(ssd1306_t *p, uint8_t val) {
-    uint8_t d[2]= {0x00, val};
-    fancy_write(p->i2c_i, p->address, d, 2, "ssd1306_write");
+    write_cmds(p, &val, 1, "ssd1306_write");
 }
 
+// Power-up sequence for the HAT panel (128x64, internal VCC), added to a
+// command list whole so it goes out as one transaction. Other panels patch
+// a copy.
+// from https://github.com/makerportal/rpi-pico-ssd1306
+static const uint8_t init_cmds[]= {
+    SET_DISP,
+    // timing and driving scheme
+    SET_DISP_CLK_DIV,
+    0x80,
+    SET_MUX_RATIO,
+    64 - 1,                         // [INIT_MUX] height - 1
+    SET_DISP_OFFSET,
+    0x00,
+    // resolution and layout
+    SET_DISP_START_LINE,
+    // charge pump
+    SET_CHARGE_PUMP,
+    0x14,                           // [INIT_PUMP] 0x10 with external VCC
+    SET_SEG_REMAP | 0x01,           // column addr 127 mapped to SEG0
+    SET_COM_OUT_DIR | 0x08,         // scan from COM[N] to COM0
+    SET_COM_PIN_CFG,
+    0x12,                           // [INIT_COM_PIN] 0x02 if width > 2*height
+    // display
+    SET_CONTRAST,
+    0xff,
+    SET_PRECHARGE,
+    0xF1,                           // [INIT_PRECHARGE] 0x22 with external VCC
+    SET_VCOM_DESEL,
+    0x30,                           // or 0x40?
+    SET_ENTIRE_ON,                  // output follows RAM contents
+    SET_NORM_INV,                   // not inverted
+    SET_DISP | 0x01,
+    // address setting
+    SET_MEM_ADDR,
+    0x00,  // horizontal
+};
+
+enum { INIT_MUX=4, INIT_PUMP=9, INIT_COM_PIN=13, INIT_PRECHARGE=17 };
+_Static_assert(sizeof(init_cmds)<=SSD1306_CMDLIST_MAX, "init sequence must fit one command list");
+
 bool ssd1306_init(ssd1306_t *p, uint16_t width, uint16_t height, uint8_t address, i2c_inst_t *i2c_instance) {
     p->width=width;
     p->height=height;
     p->pages=height/8;
     p->address=address;
+    if(p->pages>SSD1306_MAX_PAGES)
+        return false;
 
     p->i2c_i=i2c_instance;
 
 
     p->bufsize=(p->pages)*(p->width);
-    if((p->buffer=malloc(p->bufsize+1))==NULL) {
+    if((p->buffer=malloc(2*(p->bufsize+1)))==NULL) {
         p->bufsize=0;
         return false;
     }
 
+    // Back buffer first (freed by deinit), then front; each has a spare
+    // byte in front for the 0x40 control byte
+    p->front=p->buffer+p->bufsize+2;
     ++(p->buffer);
+    memset(p->buffer, 0, p->bufsize);
+    memset(p->front, 0, p->bufsize);
+    critical_section_init(&p->lock);
+    p->flush_state=SSD1306_FLUSH_IDLE;
+
+    if(height==64 && width<=2*height && !p->external_vcc) {
+        write_cmds(p, init_cmds, sizeof(init_cmds), "ssd1306_init");
+    } else {
+        uint8_t cmds[sizeof(init_cmds)];
+        memcpy(cmds, init_cmds, sizeof(cmds));
+        cmds[INIT_MUX]=height-1;
+        cmds[INIT_PUMP]=p->external_vcc?0x10:0x14;
+        cmds[INIT_COM_PIN]=width>2*height?0x02:0x12;
+        cmds[INIT_PRECHARGE]=p->external_vcc?0x22:0xF1;
+        write_cmds(p, cmds, sizeof(cmds), "ssd1306_init");
+    }
 
-    // from https://github.com/makerportal/rpi-pico-ssd1306
-    uint8_t cmds[]= {
-        SET_DISP,
-        // timing and driving scheme
-        SET_DISP_CLK_DIV,
-        0x80,
-        SET_MUX_RATIO,
-        height - 1,
-        SET_DISP_OFFSET,
-        0x00,
-        // resolution and layout
-        SET_DISP_START_LINE,
-        // charge pump
-        SET_CHARGE_PUMP,
-        p->external_vcc?0x10:0x14,
-        SET_SEG_REMAP | 0x01,           // column addr 127 mapped to SEG0
-        SET_COM_OUT_DIR | 0x08,         // scan from COM[N] to COM0
-        SET_COM_PIN_CFG,
-        width>2*height?0x02:0x12,
-        // display
-        SET_CONTRAST,
-        0xff,
-        SET_PRECHARGE,
-        p->external_vcc?0x22:0xF1,
-        SET_VCOM_DESEL,
-        0x30,                           // or 0x40?
-        SET_ENTIRE_ON,                  // output follows RAM contents
-        SET_NORM_INV,                   // not inverted
-        SET_DISP | 0x01,
-        // address setting
-        SET_MEM_ADDR,
-        0x00,  // horizontal
-    };
-
-    for(size_t i=0; i<sizeof(cmds); ++i)
-        ssd1306_write(p, cmds[i]);
+    // The display RAM is unknown after power-up: first show sends everything
+    p->tx_bytes=p->tx_saved=0;
+    p->flush_us=p->frame_us=0;
+    p->last_swap_us=0;
+    p->win[0]=0xFF;
+    p->win[1]=0;
+    memset(&p->glyphs, 0, sizeof(p->glyphs));
+    p->start_line=p->start_front=p->start_sent=0;
+    for(uint8_t pg=0; pg<p->pages; ++pg)
+        span_clear(p->send_lo, p->send_hi, pg);
+    ssd1306_invalidate(p);
 
     return true;
 }
 
+void ssd1306_invalidate(ssd1306_t *p) {
+    for(uint8_t pg=0; pg<p->pages; ++pg) {
+        p->dirty_lo[pg]=p->ink_lo[pg]=0;
+        p->dirty_hi[pg]=p->ink_hi[pg]=p->width-1;
+    }
+}
+
 inline void ssd1306_deinit(ssd1306_t *p) {
-    free(p->buffer-1);
+    // The buffers swap roles; the allocation starts before the lower one
+    free((p->buffer<p->front?p->buffer:p->front)-1);
 }
 
 inline void ssd1306_poweroff(ssd1306_t *p) {
@@ -128,8 +243,8 @@ inline void ssd1306_poweron(ssd1306_t *p) {
 }
 
 inline void ssd1306_contrast(ssd1306_t *p, uint8_t val) {
-    ssd1306_write(p, SET_CONTRAST);
-    ssd1306_write(p, val);
+    uint8_t d[2]= {SET_CONTRAST, val};
+    write_cmds(p, d, 2, "ssd1306_contrast");
 }
 
 inline void ssd1306_invert(ssd1306_t *p, uint8_t inv) {
@@ -138,85 +253,80 @@ inline void ssd1306_invert(ssd1306_t *p, uint8_t inv) {
 
 inline void ssd1306_clear(ssd1306_t *p) {
     memset(p->buffer, 0, p->bufsize);
+    // Only the columns that had pixels change
+    for(uint8_t pg=0; pg<p->pages; ++pg) {
+        if(p->ink_lo[pg]>p->ink_hi[pg]) continue;
+        span_add(p->dirty_lo, p->dirty_hi, pg, p->ink_lo[pg]);
+        span_add(p->dirty_lo, p->dirty_hi, pg, p->ink_hi[pg]);
+        span_clear(p->ink_lo, p->ink_hi, pg);
+    }
 }
 
 void ssd1306_clear_pixel(ssd1306_t *p, uint32_t x, uint32_t y) {
     if(x>=p->width || y>=p->height) return;
 
-    p->buffer[x+p->width*(y>>3)]&=~(0x1<<(y&0x07));
+    uint8_t *b=&p->buffer[x+p->width*(y>>3)];
+    uint8_t v=*b&~(0x1<<(y&0x07));
+    if(v!=*b) {
+        *b=v;
+        span_add(p->dirty_lo, p->dirty_hi, y>>3, x);
+    }
 }
 
 void ssd1306_draw_pixel(ssd1306_t *p, uint32_t x, uint32_t y) {
     if(x>=p->width || y>=p->height) return;
 
-    p->buffer[x+p->width*(y>>3)]|=0x1<<(y&0x07); // y>>3==y/8 && y&0x7==y%8
-}
-
-void ssd1306_draw_line(ssd1306_t *p, int32_t x1, int32_t y1, int32_t x2, int32_t y2) {
-    if(x1>x2) {
-        swap(&x1, &x2);
-        swap(&y1, &y2);
+    uint8_t *b=&p->buffer[x+p->width*(y>>3)];
+    uint8_t v=*b|0x1<<(y&0x07); // y>>3==y/8 && y&0x7==y%8
+    if(v!=*b) {
+        *b=v;
+        span_add(p->dirty_lo, p->dirty_hi, y>>3, x);
+        span_add(p->ink_lo, p->ink_hi, y>>3, x);
     }
+}
 
-    if(x1==x2) {
-        if(y1>y2)
-            swap(&y1, &y2);
-        for(int32_t i=y1; i<=y2; ++i)
-            ssd1306_draw_pixel(p, x1, i);
-        return;
-    }
+raster_t ssd1306_raster(ssd1306_t *p) {
+    raster_t r= {
+        p->buffer, p->width, p->height,
+        p->dirty_lo, p->dirty_hi, p->ink_lo, p->ink_hi
+    };
+    return r;
+}
 
-    float m=(float) (y2-y1) / (float) (x2-x1);
+// Sizes beyond the screen are clipped anyway; keep them positive as int32
+static inline int32_t dim(uint64_t v) {
+    return v>INT32_MAX?INT32_MAX:(int32_t)v;
+}
 
-    for(int32_t i=x1; i<=x2; ++i) {
-        float y=m*(float) (i-x1)+(float) y1;
-        ssd1306_draw_pixel(p, i, (uint32_t) y);
-    }
+void ssd1306_draw_line(ssd1306_t *p, int32_t x1, int32_t y1, int32_t x2, int32_t y2) {
+    raster_t r=ssd1306_raster(p);
+    raster_line(&r, x1, y1, x2, y2, true);
 }
 
 void ssd1306_clear_square(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
-    for(uint32_t i=0; i<width; ++i)
-        for(uint32_t j=0; j<height; ++j)
-            ssd1306_clear_pixel(p, x+i, y+j);
+    raster_t r=ssd1306_raster(p);
+    raster_fill_rect(&r, dim(x), dim(y), dim(width), dim(height), false);
 }
 
 void ssd1306_draw_square(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
-    for(uint32_t i=0; i<width; ++i)
-        for(uint32_t j=0; j<height; ++j)
-            ssd1306_draw_pixel(p, x+i, y+j);
+    raster_t r=ssd1306_raster(p);
+    raster_fill_rect(&r, dim(x), dim(y), dim(width), dim(height), true);
 }
 
 void ssd1306_draw_empty_square(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
-    ssd1306_draw_line(p, x, y, x+width, y);
-    ssd1306_draw_line(p, x, y+height, x+width, y+height);
-    ssd1306_draw_line(p, x, y, x, y+height);
-    ssd1306_draw_line(p, x+width, y, x+width, y+height);
+    // Corners at x+width and y+height, as the four lines drawn before
+    raster_t r=ssd1306_raster(p);
+    raster_rect(&r, dim(x), dim(y), dim((uint64_t)width+1), dim((uint64_t)height+1), true);
 }
 
 void ssd1306_draw_char_with_font(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t scale, const uint8_t *font, char c) {
-    if(c<font[3]||c>font[4])
-        return;
-
-    uint32_t parts_per_line=(font[0]>>3)+((font[0]&7)>0);
-    for(uint8_t w=0; w<font[1]; ++w) { // width
-        uint32_t pp=(c-font[3])*font[1]*parts_per_line+w*parts_per_line+5;
-        for(uint32_t lp=0; lp<parts_per_line; ++lp) {
-            uint8_t line=font[pp];
-
-            for(int8_t j=0; j<8; ++j, line>>=1) {
-                if(line & 1)
-                    ssd1306_draw_square(p, x+w*scale, y+((lp<<3)+j)*scale, scale, scale);
-            }
-
-            ++pp;
-        }
-    }
+    raster_t r=ssd1306_raster(p);
+    raster_char(&r, &p->glyphs, dim(x), dim(y), scale, font, c);
 }
 
 void ssd1306_draw_string_with_font(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t scale, const uint8_t *font, const char *s) {
-    for(int32_t x_n=x; *s; x_n+=(font[1]+font[2])*scale) {
-        ssd1306_draw_char_with_font(p, x_n, y, scale, font, *(s++));
-    }
+    raster_t r=ssd1306_raster(p);
+    raster_text(&r, &p->glyphs, dim(x), dim(y), scale, font, s);
 }
 
 void ssd1306_draw_char(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t scale, char c) {
@@ -227,6 +337,136 @@ void ssd1306_draw_string(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t scale, c
     ssd1306_draw_string_with_font(p, x, y, scale, font_8x5, s);
 }
 
+// Console line row is buffer page (top+row)%pages
+static inline uint8_t console_page(const ssd1306_console_t *c, uint8_t row) {
+    return (c->top+row)%c->p->pages;
+}
+
+// Clear columns x0..x1 of page pg where the ink span says pixels may be set
+static void console_erase(ssd1306_t *p, uint8_t pg, uint8_t x0, uint8_t x1) {
+    uint8_t lo=p->ink_lo[pg], hi=p->ink_hi[pg];
+    if(lo>hi || x1<lo || x0>hi) return;
+    if(x0<lo) x0=lo;
+    if(x1>hi) x1=hi;
+    raster_t r=ssd1306_raster(p);
+    raster_fill_rect(&r, x0, pg*8, x1-x0+1, 8, false);
+    if(x0==lo && x1==hi)
+        span_clear(p->ink_lo, p->ink_hi, pg);
+}
+
+static void console_newline(ssd1306_console_t *c) {
+    ssd1306_t *p=c->p;
+    if(c->row+1<c->rows) {
+        ++c->row;
+    } else {
+        // The oldest line becomes the bottom line: move the start line
+        // instead of the buffer
+        c->top=(c->top+1)%p->pages;
+        ssd1306_set_start_line(p, c->top*8);
+    }
+    c->col=0;
+    c->newline=false;
+    c->pending=true;
+    console_erase(p, console_page(c, c->row), 0, p->width-1);
+}
+
+bool ssd1306_console_init(ssd1306_console_t *c, ssd1306_t *p, uint32_t min_us) {
+    if(p->height!=64)
+        return false;
+    c->p=p;
+    c->rows=p->pages;
+    c->cols=p->width/(font_8x5[1]+font_8x5[2]);
+    c->min_us=min_us?min_us:SSD1306_CONSOLE_MIN_US;
+    c->last_us=0;
+    ssd1306_console_clear(c);
+    return true;
+}
+
+void ssd1306_console_putc(ssd1306_console_t *c, char ch) {
+    switch(ch) {
+    case '\n':
+        // Deferred, so the last line printed stays on the bottom line
+        if(c->newline)
+            console_newline(c);
+        c->newline=true;
+        return;
+    case '\r':
+        c->col=0;
+        return;
+    case '\t':
+        do {
+            ssd1306_console_putc(c, ' ');
+        } while(c->col&3);
+        return;
+    }
+    if((uint8_t)ch<0x20)
+        return;
+    if(c->newline || c->col>=c->cols)
+        console_newline(c);
+
+    ssd1306_t *p=c->p;
+    uint8_t pg=console_page(c, c->row);
+    uint8_t cw=font_8x5[1]+font_8x5[2];
+    uint8_t x=c->col*cw;
+    console_erase(p, pg, x, x+cw-1);
+    raster_t r=ssd1306_raster(p);
+    raster_char(&r, &p->glyphs, x, pg*8, 1, font_8x5, ch);
+    ++c->col;
+    c->pending=true;
+}
+
+void ssd1306_console_print(ssd1306_console_t *c, const char *s) {
+    while(*s)
+        ssd1306_console_putc(c, *(s++));
+}
+
+bool ssd1306_console_update(ssd1306_console_t *c) {
+    if(!c->pending)
+        return false;
+    if(c->last_us && time_us_64()-c->last_us<c->min_us)
+        return false;
+    return ssd1306_console_show(c);
+}
+
+bool ssd1306_console_show(ssd1306_console_t *c) {
+    if(!ssd1306_show(c->p))
+        return false;
+    c->last_us=time_us_64();
+    c->pending=false;
+    return true;
+}
+
+void ssd1306_console_clear(ssd1306_console_t *c) {
+    ssd1306_clear(c->p);
+    c->top=c->row=c->col=0;
+    c->newline=false;
+    c->pending=true;
+    ssd1306_set_start_line(c->p, 0);
+}
+
+static void reverse_bytes(uint8_t *a, size_t n) {
+    for(size_t i=0, j=n; i+1<j; ++i) {
+        uint8_t t=a[i];
+        a[i]=a[--j];
+        a[j]=t;
+    }
+}
+
+void ssd1306_console_close(ssd1306_console_t *c) {
+    ssd1306_t *p=c->p;
+    // Rotate the pages so the top line is page 0 again; in place by three
+    // reversals, the caller's stack may be too small for a page copy
+    size_t n=(size_t)c->top*p->width;
+    reverse_bytes(p->buffer, n);
+    reverse_bytes(p->buffer+n, p->bufsize-n);
+    reverse_bytes(p->buffer, p->bufsize);
+    c->top=0;
+    ssd1306_invalidate(p);
+    ssd1306_set_start_line(p, 0);
+    c->row=c->col=0;
+    c->newline=false;
+}
+
 static inline uint32_t ssd1306_bmp_get_val(const uint8_t *data, const size_t offset, uint8_t size) {
     switch(size) {
     case 1:
@@ -290,17 +530,165 @@ inline void ssd1306_bmp_show_image(ssd1306_t *p, const uint8_t *data, const long
     ssd1306_bmp_show_image_with_offset(p, data, size, 0, 0);
 }
 
-void ssd1306_show(ssd1306_t *p) {
-    uint8_t payload[]= {SET_COL_ADDR, 0, p->width-1, SET_PAGE_ADDR, 0, p->pages-1};
-    if(p->width==64) {
-        payload[1]+=32;
-        payload[2]+=32;
+// Bus bytes (address byte included) to send pages p0..p1, columns lo..hi
+// with a new window
+static uint32_t rect_cost(const ssd1306_t *p, uint8_t p0, uint8_t p1, uint8_t lo, uint8_t hi) {
+    uint32_t w=hi-lo+1, pages=p1-p0+1;
+    uint32_t cmd=1+7;
+    if(w==p->width)
+        return cmd+2+pages*w;       // one data transaction
+    return cmd+pages*(2+w);         // one per page
+}
+
+// Send len buffer bytes as a data transaction. The byte before them is
+// borrowed for the 0x40 control byte (buffer-1 exists for the first page).
+static uint32_t send_data(ssd1306_t *p, uint8_t *data, size_t len) {
+    uint8_t saved=data[-1];
+    data[-1]=0x40;
+    fancy_write(p->i2c_i, p->address, data-1, len+1, "ssd1306_show");
+    data[-1]=saved;
+    return len+1;
+}
+
+// Start line of the front buffer, if the display shows another one
+static uint32_t send_start_line(ssd1306_t *p) {
+    if(p->start_sent==p->start_front)
+        return 0;
+    ssd1306_write(p, SET_DISP_START_LINE|p->start_front);
+    p->start_sent=p->start_front;
+    return 2;
+}
+
+static uint32_t flush_rect(ssd1306_t *p, uint8_t p0, uint8_t p1, uint8_t lo, uint8_t hi) {
+    const uint8_t col0=p->width==64?32:0;
+    uint32_t sent=0;
+    uint32_t w=hi-lo+1;
+
+    // Every rectangle fills its whole window, so the RAM pointer is back at
+    // the window start afterwards: the same window needs no commands. A
+    // wider window on the same pages is reused if the extra data is
+    // cheaper than the 8-byte command transaction.
+    if(p0==p->win[2] && p1==p->win[3] && col0+lo>=p->win[0] && col0+hi<=p->win[1] &&
+            (uint32_t)(p->win[1]-p->win[0]+1-w)*(p1-p0+1)<8) {
+        lo=p->win[0]-col0;
+        hi=p->win[1]-col0;
+        w=hi-lo+1;
+    }
+    const uint8_t win[4]= {col0+lo, col0+hi, p0, p1};
+
+    if(memcmp(win, p->win, sizeof(win))!=0) {
+        memcpy(p->win, win, sizeof(win));
+        if(p0==p1 && w<=SSD1306_INLINE_DATA_MAX) {
+            sent=send_start_line(p);
+            // Co=1 control bytes carry one command byte each, the final
+            // 0x40 switches to data for the rest of the transaction
+            uint8_t d[13+SSD1306_INLINE_DATA_MAX+1]= {
+                0x80, SET_COL_ADDR, 0x80, win[0], 0x80, win[1],
+                0x80, SET_PAGE_ADDR, 0x80, p0, 0x80, p1, 0x40
+            };
+            memcpy(d+13, p->front+p0*p->width+lo, w);
+            fancy_write(p->i2c_i, p->address, d, 13+w, "ssd1306_show");
+            return sent+13+w;
+        }
+        // One command transaction; a new start line rides along, so the
+        // scrolled picture and its data arrive together
+        uint8_t cmds[7]= {SET_COL_ADDR, win[0], win[1], SET_PAGE_ADDR, p0, p1};
+        size_t n=6;
+        if(p->start_sent!=p->start_front) {
+            cmds[n++]=SET_DISP_START_LINE|p->start_front;
+            p->start_sent=p->start_front;
+        }
+        write_cmds(p, cmds, n, "ssd1306_show");
+        sent=n+1;
+    } else {
+        sent=send_start_line(p);
     }
 
-    for(size_t i=0; i<sizeof(payload); ++i)
-        ssd1306_write(p, payload[i]);
+    if(w==p->width)
+        return sent+send_data(p, p->front+p0*p->width, (p1-p0+1)*w);
+    for(uint8_t pg=p0; pg<=p1; ++pg)
+        sent+=send_data(p, p->front+pg*p->width+lo, w);
+    return sent;
+}
+
+bool ssd1306_swap(ssd1306_t *p) {
+    // Only the drawing side leaves IDLE, so front stays ours until PENDING
+    if(p->flush_state!=SSD1306_FLUSH_IDLE)
+        return false;
 
-    *(p->buffer-1)=0x40;
+    uint8_t *drawn=p->buffer;
+    p->buffer=p->front;
+    p->front=drawn;
+    p->start_front=p->start_line;
+
+    // The new back buffer holds the frame before; bring it up to date with
+    // the changed spans only, so drawing continues from what is on screen
+    for(uint8_t pg=0; pg<p->pages; ++pg) {
+        uint8_t lo=p->dirty_lo[pg], hi=p->dirty_hi[pg];
+        if(lo>hi) continue;
+        memcpy(p->buffer+pg*p->width+lo, drawn+pg*p->width+lo, hi-lo+1);
+        span_add(p->send_lo, p->send_hi, pg, lo);
+        span_add(p->send_lo, p->send_hi, pg, hi);
+        span_clear(p->dirty_lo, p->dirty_hi, pg);
+    }
+
+    uint64_t now=time_us_64();
+    if(p->last_swap_us)
+        p->frame_us=(uint32_t)(now-p->last_swap_us);
+    p->last_swap_us=now;
+    flush_claim(p, SSD1306_FLUSH_IDLE, SSD1306_FLUSH_PENDING);
+    return true;
+}
 
-    fancy_write(p->i2c_i, p->address, p->buffer-1, p->bufsize+1, "ssd1306_show");
+void ssd1306_set_start_line(ssd1306_t *p, uint8_t line) {
+    p->start_line=line&0x3F;
+}
+
+bool ssd1306_flush_done(const ssd1306_t *p) {
+    return p->flush_state==SSD1306_FLUSH_IDLE;
+}
+
+bool ssd1306_flush(ssd1306_t *p) {
+    if(!flush_claim(p, SSD1306_FLUSH_PENDING, SSD1306_FLUSH_SENDING))
+        return false;
+    uint64_t start=time_us_64();
+    uint32_t sent=0;
+
+    for(uint8_t pg=0; pg<p->pages;) {
+        if(p->send_lo[pg]>p->send_hi[pg]) {
+            ++pg;
+            continue;
+        }
+        // Grow the rectangle down while one rectangle is cheaper than two
+        uint8_t last=pg, lo=p->send_lo[pg], hi=p->send_hi[pg];
+        while(last+1<p->pages && p->send_lo[last+1]<=p->send_hi[last+1]) {
+            uint8_t nlo=p->send_lo[last+1], nhi=p->send_hi[last+1];
+            uint8_t mlo=nlo<lo?nlo:lo, mhi=nhi>hi?nhi:hi;
+            if(rect_cost(p, pg, last+1, mlo, mhi)>rect_cost(p, pg, last, lo, hi)+rect_cost(p, last+1, last+1, nlo, nhi))
+                break;
+            lo=mlo;
+            hi=mhi;
+            ++last;
+        }
+        sent+=flush_rect(p, pg, last, lo, hi);
+        for(uint8_t k=pg; k<=last; ++k)
+            span_clear(p->send_lo, p->send_hi, k);
+        pg=last+1;
+    }
+    sent+=send_start_line(p);
+
+    const uint32_t full=7+p->bufsize+1;
+    p->tx_bytes+=sent;
+    if(sent<full)
+        p->tx_saved+=full-sent;
+    p->flush_us=(uint32_t)(time_us_64()-start);
+    flush_claim(p, SSD1306_FLUSH_SENDING, SSD1306_FLUSH_IDLE);
+    return true;
+}
+
+bool ssd1306_show(ssd1306_t *p) {
+    if(!ssd1306_swap(p))
+        return false;
+    ssd1306_flush(p);
+    return true;
 }
\ No newline at end of file
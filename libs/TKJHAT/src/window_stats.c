@@ -0,0 +1,152 @@
+/*
+
+Version 0.84
+
+MIT License
+
+Copyright (c) 2025 Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdbool.h>
+
+#include <tkjhat/window_stats.h>
+
+// qstate layout per channel
+#define MAX_HEAD    0
+#define MAX_LEN     1
+#define MIN_HEAD    2
+#define MIN_LEN     3
+
+_Static_assert((uint64_t)WSTATS_MAX_WINDOW * WSTATS_MAX_WINDOW * WSTATS_SAMPLE_MAX * WSTATS_SAMPLE_MAX
+               < (1ull << 62), "WSTATS_MAX_WINDOW too large for the 64-bit sums");
+
+static uint32_t isqrt64(uint64_t x) {
+    if (x == 0) return 0;
+    uint64_t res = 0, bit = 1ull << ((63 - __builtin_clzll(x)) & ~1);
+    while (bit) {
+        // Branch-free digit step: the test depends on the data
+        uint64_t t = res + bit;
+        uint64_t take = -(uint64_t)(x >= t);
+        x -= t & take;
+        res = (res >> 1) + (bit & take);
+        bit >>= 2;
+    }
+    return (uint32_t)res;
+}
+
+// a / n rounded, with frac fractional bits; (a / n) << frac must fit and n < 2^16
+static inline uint64_t div_frac(uint64_t a, uint32_t n, int frac) {
+    return ((a / n) << frac) + (((a % n) << frac) + n / 2) / n;
+}
+
+static inline int32_t clamp_sample(int32_t x) {
+    return x > WSTATS_SAMPLE_MAX ? WSTATS_SAMPLE_MAX : x < -WSTATS_SAMPLE_MAX ? -WSTATS_SAMPLE_MAX : x;
+}
+
+void wstats_reset(wstats_t *w) {
+    w->pos = w->count = 0;
+    for (uint16_t c = 0; c < w->channels; ++c) {
+        w->sum[c] = 0;
+        w->sumsq[c] = 0;
+        w->qstate[4 * c + MAX_HEAD] = w->qstate[4 * c + MAX_LEN] = 0;
+        w->qstate[4 * c + MIN_HEAD] = w->qstate[4 * c + MIN_LEN] = 0;
+    }
+}
+
+// Monotonic deque of ring rows, stored circularly in q[0..window).
+// Keeps the rows whose sample is larger (sign = 1) or smaller (sign = -1)
+// than every later sample, so the front is the extreme of the window.
+static inline void deque_push(const wstats_t *w, uint16_t *q, uint16_t *head, uint16_t *len,
+                              uint16_t c, int32_t x, int sign) {
+    const uint16_t win = w->window, nch = w->channels;
+    // The front leaves when its row is overwritten
+    if (*len && q[*head] == w->pos && w->count == win) {
+        if (++*head == win) *head = 0;
+        --*len;
+    }
+    while (*len) {
+        uint16_t back = *head + *len - 1;
+        if (back >= win) back -= win;
+        int32_t b = w->ring[q[back] * nch + c];
+        if (sign > 0 ? b > x : b < x) break;
+        --*len;
+    }
+    uint16_t tail = *head + *len;
+    if (tail >= win) tail -= win;
+    q[tail] = w->pos;
+    ++*len;
+}
+
+void wstats_push(wstats_t *w, const int32_t *x) {
+    const uint16_t nch = w->channels, win = w->window;
+    int32_t *row = &w->ring[w->pos * nch];
+    const bool full = w->count == win;
+
+    for (uint16_t c = 0; c < nch; ++c) {
+        int32_t v = clamp_sample(x[c]);
+        if (full) {
+            int32_t old = row[c];
+            w->sum[c] -= old;
+            w->sumsq[c] -= (uint64_t)((int64_t)old * old);
+        }
+        w->sum[c] += v;
+        w->sumsq[c] += (uint64_t)((int64_t)v * v);
+
+        // Deques first: they compare against the samples still in the ring
+        uint16_t *qs = &w->qstate[4 * c];
+        deque_push(w, &w->maxq[c * win], &qs[MAX_HEAD], &qs[MAX_LEN], c, v, 1);
+        deque_push(w, &w->minq[c * win], &qs[MIN_HEAD], &qs[MIN_LEN], c, v, -1);
+        row[c] = v;
+    }
+    if (!full) w->count++;
+    if (++w->pos == win) w->pos = 0;
+}
+
+void wstats_push_imu(wstats_t *w, const ICM42670_raw_t *raw) {
+    const int32_t x[WSTATS_IMU_CHANNELS] = {
+        raw->accel[0], raw->accel[1], raw->accel[2],
+        raw->gyro[0], raw->gyro[1], raw->gyro[2], raw->temp,
+    };
+    wstats_push(w, x);
+}
+
+void wstats_get(const wstats_t *w, uint16_t ch, wstats_result_t *r) {
+    const uint32_t n = w->count;
+    *r = (wstats_result_t){ .count = (uint16_t)n };
+    if (n == 0) return;
+
+    const int64_t sum = w->sum[ch];
+    const uint64_t sumsq = w->sumsq[ch];
+    const uint16_t *qs = &w->qstate[4 * ch];
+
+    uint64_t abs_sum = sum < 0 ? (uint64_t)-sum : (uint64_t)sum;
+    int32_t mean = (int32_t)div_frac(abs_sum, n, WSTATS_FRAC_BITS);
+    r->mean = sum < 0 ? -mean : mean;
+
+    // n^2 var = n sum(x^2) - sum(x)^2, exact in 64 bits; rms^2 = var + mean^2
+    uint64_t num = n * sumsq - (uint64_t)(sum * sum);
+    r->var = div_frac(num, n * n, 2 * WSTATS_FRAC_BITS);
+    r->std = (int32_t)isqrt64(r->var);
+    r->rms = (int32_t)isqrt64(r->var + (uint64_t)((int64_t)mean * mean));
+
+    r->max = w->ring[w->maxq[ch * w->window + qs[MAX_HEAD]] * w->channels + ch] * (1 << WSTATS_FRAC_BITS);
+    r->min = w->ring[w->minq[ch * w->window + qs[MIN_HEAD]] * w->channels + ch] * (1 << WSTATS_FRAC_BITS);
+}
@@ -0,0 +1,128 @@
+/*
+ * Host check and benchmark of the pre-trigger capture (tkjhat/capture.h).
+ *
+ * Build and run on the PC:
+ *     cc -O2 -I../include capture_bench.c ../src/capture.c -o capture_bench
+ *     ./capture_bench
+ *
+ * Frames carry their running number, so every published window can be
+ * checked: consecutive frames, the trigger frame at index pre_frames, the
+ * expected history length. The consumer releases its window after a
+ * varying delay, so some triggers land while it still holds the other
+ * ring; those windows must be counted as dropped, never corrupted.
+ * The exit status is non-zero on any mismatch.
+ *
+ * Version 0.84, MIT License, Raisul Islam, Iván Sánchez Milara.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <tkjhat/capture.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static uint64_t cycles(void) { return __rdtsc(); }
+#define CYCLE_UNIT "TSC cycles"
+#else
+static uint64_t cycles(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+#define CYCLE_UNIT "ns"
+#endif
+
+// An IMU-sized frame: running number + six int16 channels
+typedef struct {
+    uint32_t n;
+    int16_t v[6];
+} frame_t;
+
+#define PRE     50
+#define POST    30
+#define FRAMES  200000
+
+CAPTURE_DEFINE(cap, sizeof(frame_t), 100);
+
+static uint32_t rng = 1;
+static uint32_t rnd(uint32_t n) {
+    rng = rng * 1664525u + 1013904223u;
+    return (rng >> 8) % n;
+}
+
+// Walk the window in place, as a sender would
+static int check_window(const capture_window_t *w, uint32_t trig_n, uint32_t since_last) {
+    uint32_t expect = w->first_frame, k = 0;
+    for (int p = 0; p < 2; ++p) {
+        const uint8_t *b = w->part[p];
+        for (size_t off = 0; off < w->len[p]; off += sizeof(frame_t), ++k) {
+            frame_t f;
+            memcpy(&f, b + off, sizeof(f));
+            if (f.n != expect++) return 0;
+        }
+    }
+    uint32_t want_pre = since_last < PRE ? since_last : PRE;
+    return k == w->frames && w->frames == w->pre_frames + POST &&
+           w->first_frame + w->pre_frames == trig_n && w->pre_frames == want_pre;
+}
+
+int main(void) {
+    capture_init(&cap, PRE, POST);
+
+    int bad = 0;
+    uint32_t trig_n = 0, ring_start = 0, hold = 0, last_trigger_at = 0;
+    capture_window_t held;
+    bool holding = false;
+    uint64_t push_cycles = 0;
+
+    for (uint32_t n = 0; n < FRAMES; ++n) {
+        frame_t f = { .n = n };
+        for (int i = 0; i < 6; ++i) f.v[i] = (int16_t)rnd(2000);
+
+        // Random triggers, now and then in bursts
+        if (rnd(120) == 0 || (n - last_trigger_at < 200 && rnd(20) == 0)) {
+            capture_trigger(&cap);
+            last_trigger_at = n;
+        }
+
+        capture_stats_t before;
+        capture_get_stats(&cap, &before);
+        uint64_t t0 = cycles();
+        capture_push(&cap, &f);
+        push_cycles += cycles() - t0;
+
+        capture_stats_t after;
+        capture_get_stats(&cap, &after);
+        if (after.triggers != before.triggers) trig_n = n;
+        if (after.windows != before.windows || after.dropped != before.dropped) {
+            if (after.windows != before.windows) {
+                capture_window_t w;
+                if (!capture_get(&cap, &w) || !check_window(&w, trig_n, trig_n - ring_start)) {
+                    printf("bad window %u at frame %u\n", w.seq, n);
+                    bad++;
+                }
+                ring_start = n + 1;      // recording goes on in the other ring
+            }
+        }
+
+        // Consumer: take the window, hold it for a while, release
+        if (!holding && capture_get(&cap, &held)) {
+            holding = true;
+            hold = rnd(150);
+        } else if (holding && hold-- == 0) {
+            if (!check_window(&held, held.first_frame + held.pre_frames, held.pre_frames)) bad++;
+            capture_release(&cap, &held);
+            holding = false;
+        }
+    }
+
+    capture_stats_t s;
+    capture_get_stats(&cap, &s);
+    printf("%u frames, %u triggers: %u windows checked, %u dropped while the other ring was held, %d bad\n",
+           s.frames, s.triggers, s.windows, s.dropped, bad);
+    printf("push: %.1f %s per %zu-byte frame\n", (double)push_cycles / FRAMES, CYCLE_UNIT, sizeof(frame_t));
+    return bad || s.windows == 0 || s.dropped == 0 ? 1 : 0;
+}
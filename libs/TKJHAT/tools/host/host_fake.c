@@ -0,0 +1,127 @@
+/*
+ * Host fake of the Pico SDK and FreeRTOS API, see host_fake.h.
+ *
+ * Version 0.84, MIT License, Raisul Islam, Iván Sánchez Milara.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_fake.h"
+
+uint64_t host_now_us = 1;
+void (*host_idle_hook)(void);
+
+i2c_hw_t host_i2c0_hw;
+i2c_inst_t i2c0_inst = { &host_i2c0_hw };
+host_dma_t host_dma[HOST_DMA_CHANNELS];
+
+bool host_scheduler_running;
+int host_current_task;
+uint32_t host_notify[HOST_TASKS][configTASK_NOTIFICATION_ARRAY_ENTRIES];
+
+static irq_handler_t irq_handlers[32];
+static bool irq_enabled[32];
+
+void critical_section_init(critical_section_t *cs) {
+    cs->owner = 0;
+}
+
+void critical_section_enter_blocking(critical_section_t *cs) {
+    if (cs->owner) {
+        fprintf(stderr, "host_fake: critical section entered twice (deadlock on the target)\n");
+        abort();
+    }
+    cs->owner = 1;
+}
+
+void critical_section_exit(critical_section_t *cs) {
+    cs->owner = 0;
+}
+
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop) {
+    (void)i2c; (void)addr; (void)src; (void)len; (void)nostop;
+    return PICO_ERROR_GENERIC;
+}
+
+int dma_claim_unused_channel(bool required) {
+    for (int ch = 0; ch < HOST_DMA_CHANNELS; ++ch) {
+        if (!host_dma[ch].claimed) {
+            host_dma[ch].claimed = true;
+            return ch;
+        }
+    }
+    if (required) abort();
+    return -1;
+}
+
+void dma_channel_unclaim(uint ch) {
+    host_dma[ch].claimed = false;
+}
+
+dma_channel_config dma_channel_get_default_config(uint ch) {
+    (void)ch;
+    dma_channel_config c = { DMA_SIZE_32, true, false, 0 };
+    return c;
+}
+
+void dma_channel_configure(uint ch, const dma_channel_config *c, volatile void *write_addr,
+                           const volatile void *read_addr, uint count, bool trigger) {
+    host_dma_t *d = &host_dma[ch];
+    d->cfg = *c;
+    d->write_addr = write_addr;
+    d->read_addr = read_addr;
+    d->count = count;
+    if (trigger) {
+        d->busy = true;
+        d->starts++;
+    }
+}
+
+void dma_channel_abort(uint ch) {
+    host_dma[ch].busy = false;
+    host_dma[ch].aborts++;
+}
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler) {
+    irq_handlers[num] = handler;
+}
+
+void irq_set_enabled(uint num, bool enabled) {
+    irq_enabled[num] = enabled;
+}
+
+void host_irq_fire(uint num) {
+    if (irq_enabled[num] && irq_handlers[num]) irq_handlers[num]();
+}
+
+static int task_index(TaskHandle_t task) {
+    int i = (int)((uintptr_t)task - 1);
+    if (i < 0 || i >= HOST_TASKS) {
+        fprintf(stderr, "host_fake: notification to an unknown task\n");
+        abort();
+    }
+    return i;
+}
+
+BaseType_t xTaskNotifyGiveIndexed(TaskHandle_t task, UBaseType_t index) {
+    host_notify[task_index(task)][index]++;
+    return pdPASS;
+}
+
+void vTaskNotifyGiveIndexedFromISR(TaskHandle_t task, UBaseType_t index, BaseType_t *woken) {
+    host_notify[task_index(task)][index]++;
+    *woken = pdTRUE;
+}
+
+uint32_t ulTaskNotifyTakeIndexed(UBaseType_t index, BaseType_t clear, TickType_t ticks) {
+    uint32_t *n = &host_notify[host_current_task][index];
+    if (*n == 0) {
+        host_now_us += ticks == portMAX_DELAY ? 1000 : 1000ull * ticks;
+        if (host_idle_hook) host_idle_hook();
+    }
+    uint32_t v = *n;
+    if (v) *n = clear ? 0 : v - 1;
+    return v;
+}
@@ -0,0 +1,161 @@
+/*
+ * Host fake of the Pico SDK and FreeRTOS API used by the TKJHAT sources,
+ * for the host tests in tools/. The named headers next to this one
+ * (FreeRTOS.h, task.h, pico/stdlib.h, hardware/i2c.h, ...) all include it.
+ *
+ * Only what the tested modules call is provided. Hardware is replaced by
+ * plain memory the test can inspect and drive:
+ * - the I2C block is host_i2c0_hw; the test sets intr_stat and calls
+ *   host_irq_fire() to run the installed interrupt handler;
+ * - DMA channels record their last configuration in host_dma[];
+ * - time is host_now_us, advanced by the test (or by host_idle_hook);
+ * - task notifications are counted per index in host_notify[].
+ *
+ * Version 0.84, MIT License, Raisul Islam, Iván Sánchez Milara.
+ */
+
+#ifndef HOST_FAKE_H
+#define HOST_FAKE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* =========================
+ *  PICO SDK
+ * ========================= */
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;
+
+#define PICO_ERROR_NONE         0
+#define PICO_ERROR_GENERIC      -1
+#define PICO_ERROR_TIMEOUT      -2
+
+extern uint64_t host_now_us;
+extern void (*host_idle_hook)(void);    // called by tight_loop_contents()
+
+static inline uint64_t time_us_64(void) { return host_now_us; }
+static inline uint32_t time_us_32(void) { return (uint32_t)host_now_us; }
+static inline absolute_time_t get_absolute_time(void) { return host_now_us; }
+static inline absolute_time_t make_timeout_time_us(uint64_t us) { return host_now_us + us; }
+static inline absolute_time_t make_timeout_time_ms(uint32_t ms) { return host_now_us + 1000ull * ms; }
+static inline int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to) { return (int64_t)(to - from); }
+static inline void busy_wait_us(uint64_t us) { host_now_us += us; }
+static inline void sleep_us(uint64_t us) { host_now_us += us; }
+static inline void sleep_ms(uint32_t ms) { host_now_us += 1000ull * ms; }
+static inline void tight_loop_contents(void) {
+    host_now_us++;
+    if (host_idle_hook) host_idle_hook();
+}
+
+typedef struct {
+    int owner;          // nesting depth; entering a held lock is a deadlock on the target
+} critical_section_t;
+void critical_section_init(critical_section_t *cs);
+void critical_section_enter_blocking(critical_section_t *cs);
+void critical_section_exit(critical_section_t *cs);
+
+/* I2C */
+typedef struct {
+    volatile uint32_t enable, tar, data_cmd, intr_stat, intr_mask, clr_intr,
+                      clr_tx_abrt, clr_stop_det, tx_abrt_source, dma_cr, dma_tdlr, dma_rdlr;
+} i2c_hw_t;
+typedef struct i2c_inst { i2c_hw_t *hw; } i2c_inst_t;
+extern i2c_hw_t host_i2c0_hw;
+extern i2c_inst_t i2c0_inst;
+#define i2c0            (&i2c0_inst)
+#define i2c_default     i2c0
+#define I2C0_IRQ        23
+
+#define I2C_IC_DATA_CMD_CMD_BITS                        0x100u
+#define I2C_IC_DATA_CMD_STOP_BITS                       0x200u
+#define I2C_IC_DATA_CMD_RESTART_BITS                    0x400u
+#define I2C_IC_INTR_MASK_M_TX_ABRT_BITS                 0x040u
+#define I2C_IC_INTR_MASK_M_STOP_DET_BITS                0x200u
+#define I2C_IC_INTR_STAT_R_TX_ABRT_BITS                 0x040u
+#define I2C_IC_INTR_STAT_R_STOP_DET_BITS                0x200u
+#define I2C_IC_INTR_STAT_R_TX_EMPTY_BITS                0x010u
+#define I2C_IC_DMA_CR_RDMAE_BITS                        0x1u
+#define I2C_IC_DMA_CR_TDMAE_BITS                        0x2u
+#define I2C_IC_TX_ABRT_SOURCE_ABRT_7B_ADDR_NOACK_BITS   0x01u
+#define I2C_IC_TX_ABRT_SOURCE_ABRT_TXDATA_NOACK_BITS    0x08u
+
+static inline i2c_hw_t *i2c_get_hw(i2c_inst_t *i2c) { return i2c->hw; }
+static inline uint i2c_hw_index(i2c_inst_t *i2c) { (void)i2c; return 0; }
+static inline uint i2c_get_dreq(i2c_inst_t *i2c, bool tx) { (void)i2c; return tx ? 32 : 33; }
+// Blocking SDK calls; nothing answers on a bus other than i2c_default
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop);
+
+/* DMA */
+enum dma_channel_transfer_size { DMA_SIZE_8 = 0, DMA_SIZE_16 = 1, DMA_SIZE_32 = 2 };
+typedef struct { enum dma_channel_transfer_size size; bool read_inc, write_inc; uint dreq; } dma_channel_config;
+typedef struct {
+    bool claimed;
+    bool busy;          // triggered and not aborted; the test clears it when "done"
+    dma_channel_config cfg;
+    volatile void *write_addr;
+    const volatile void *read_addr;
+    uint count;
+    uint starts, aborts;
+} host_dma_t;
+#define HOST_DMA_CHANNELS 12
+extern host_dma_t host_dma[HOST_DMA_CHANNELS];
+
+int dma_claim_unused_channel(bool required);
+void dma_channel_unclaim(uint ch);
+dma_channel_config dma_channel_get_default_config(uint ch);
+static inline void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size s) { c->size = s; }
+static inline void channel_config_set_read_increment(dma_channel_config *c, bool inc) { c->read_inc = inc; }
+static inline void channel_config_set_write_increment(dma_channel_config *c, bool inc) { c->write_inc = inc; }
+static inline void channel_config_set_dreq(dma_channel_config *c, uint dreq) { c->dreq = dreq; }
+void dma_channel_configure(uint ch, const dma_channel_config *c, volatile void *write_addr,
+                           const volatile void *read_addr, uint count, bool trigger);
+void dma_channel_abort(uint ch);
+static inline bool dma_channel_is_busy(uint ch) { return host_dma[ch].busy; }
+
+/* IRQ */
+typedef void (*irq_handler_t)(void);
+void irq_set_exclusive_handler(uint num, irq_handler_t handler);
+void irq_set_enabled(uint num, bool enabled);
+void host_irq_fire(uint num);       // run the handler, as the NVIC would
+
+/* =========================
+ *  FreeRTOS
+ * ========================= */
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void *TaskHandle_t;
+
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define pdPASS                  1
+#define portMAX_DELAY           0xFFFFFFFFu
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms))
+#define portYIELD_FROM_ISR(w)   ((void)(w))
+#define taskSCHEDULER_NOT_STARTED   1
+#define taskSCHEDULER_RUNNING       2
+#define configTASK_NOTIFICATION_ARRAY_ENTRIES   2
+
+#define HOST_TASKS 4
+extern bool host_scheduler_running;
+extern int host_current_task;                               // index of the running task
+extern uint32_t host_notify[HOST_TASKS][configTASK_NOTIFICATION_ARRAY_ENTRIES];
+#define HOST_TASK(i)            ((TaskHandle_t)(uintptr_t)((i) + 1))
+
+static inline BaseType_t xTaskGetSchedulerState(void) {
+    return host_scheduler_running ? taskSCHEDULER_RUNNING : taskSCHEDULER_NOT_STARTED;
+}
+static inline TaskHandle_t xTaskGetCurrentTaskHandle(void) { return HOST_TASK(host_current_task); }
+BaseType_t xTaskNotifyGiveIndexed(TaskHandle_t task, UBaseType_t index);
+void vTaskNotifyGiveIndexedFromISR(TaskHandle_t task, UBaseType_t index, BaseType_t *woken);
+// Takes pending notifications of the current task; with none pending it
+// runs host_idle_hook once (time passes while "blocked") and retries
+uint32_t ulTaskNotifyTakeIndexed(UBaseType_t index, BaseType_t clear, TickType_t ticks);
+
+/* PIO, only for the types in pdm_microphone.h */
+typedef struct pio_hw *PIO;
+
+#endif /* HOST_FAKE_H */
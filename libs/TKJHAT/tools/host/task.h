@@ -0,0 +1,2 @@
+// Host fake, see host_fake.h
+#include "host_fake.h"
@@ -0,0 +1,374 @@
+/*
+ * Host test and benchmark of the asynchronous I2C engine (tkjhat/i2c_async.h).
+ *
+ * Build and run on the PC:
+ *     cc -O2 -Ihost -I../include i2c_async_test.c host/host_fake.c ../src/i2c_async.c -o i2c_async_test
+ *     ./i2c_async_test
+ *
+ * src/i2c_async.c runs unchanged against the fake in host/: the test plays
+ * the I2C block and the DMA channels. It decodes the command words the TX
+ * channel was given, fills the RX buffer, then raises STOP_DET (and TX_ABRT
+ * for a NAK) and runs the interrupt handler. Checked:
+ * - queue order: one transfer on the bus, the next started from the
+ *   interrupt, callbacks and task notifications in submit order;
+ * - command words of writes, reads and write-then-read (RESTART, STOP);
+ * - NAK and other aborts, i2c_async_reset() with transfers pending,
+ *   a stray STOP with nothing queued, resubmitting from a callback;
+ * - the controller after i2c_init() (IC_INTR_MASK at its reset value
+ *   0x8FF): i2c_async_rearm() masks everything, and a TX_EMPTY that still
+ *   gets through is masked by the handler instead of firing again;
+ * - rejected descriptors, i2c_xfer_wait() completion and timeout, and that
+ *   only notification index TKJHAT_I2C_NOTIFY_INDEX is used.
+ * The benchmark reports submit + completion cost per transfer on the PC.
+ * The exit status is non-zero on any failure.
+ *
+ * Version 0.84, MIT License, Raisul Islam, Iván Sánchez Milara.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <tkjhat/i2c_async.h>
+
+static int failures;
+#define CHECK(cond) do { \
+        if (!(cond)) { printf("line %d: %s\n", __LINE__, #cond); failures++; } \
+    } while (0)
+
+
+/* =========================
+ *  FAKE BUS
+ * ========================= */
+
+static int tx_ch = -1, rx_ch = -1;
+
+// Transfer as seen on the wire, decoded from the TX command words
+typedef struct {
+    uint8_t addr;
+    uint8_t tx[32];
+    size_t tx_len, rx_len;
+    int restart_at;     // index of the word with RESTART, -1 if none
+    int stop_at;        // index of the word with STOP
+} wire_t;
+
+static void find_channels(void) {
+    for (int ch = 0; ch < HOST_DMA_CHANNELS; ++ch) {
+        if (!host_dma[ch].claimed) continue;
+        if (host_dma[ch].cfg.dreq == i2c_get_dreq(i2c_default, true)) tx_ch = ch;
+        if (host_dma[ch].cfg.dreq == i2c_get_dreq(i2c_default, false)) rx_ch = ch;
+    }
+}
+
+static bool bus_busy(void) {
+    find_channels();
+    return tx_ch >= 0 && host_dma[tx_ch].busy;
+}
+
+static wire_t decode(void) {
+    wire_t w = { .addr = (uint8_t)host_i2c0_hw.tar, .restart_at = -1, .stop_at = -1 };
+    const volatile uint16_t *cmd = host_dma[tx_ch].read_addr;
+    for (uint i = 0; i < host_dma[tx_ch].count; ++i) {
+        if (cmd[i] & I2C_IC_DATA_CMD_RESTART_BITS) w.restart_at = (int)i;
+        if (cmd[i] & I2C_IC_DATA_CMD_STOP_BITS) w.stop_at = (int)i;
+        if (cmd[i] & I2C_IC_DATA_CMD_CMD_BITS) w.rx_len++;
+        else if (w.tx_len < sizeof(w.tx)) w.tx[w.tx_len++] = (uint8_t)cmd[i];
+    }
+    return w;
+}
+
+// Finish the running transfer: abort = 0 for success, else TX_ABRT_SOURCE
+static wire_t finish(uint32_t abort) {
+    find_channels();
+    wire_t w = decode();
+    if (!abort && w.rx_len) {
+        volatile uint8_t *dst = host_dma[rx_ch].write_addr;
+        for (size_t i = 0; i < w.rx_len; ++i) dst[i] = (uint8_t)(0xA0 + i);
+    }
+    host_dma[tx_ch].busy = false;
+    host_dma[rx_ch].busy = false;
+    host_now_us += 10 * (w.tx_len + w.rx_len + 1);
+    if (abort) {
+        host_i2c0_hw.tx_abrt_source = abort;
+        host_i2c0_hw.intr_stat = I2C_IC_INTR_STAT_R_TX_ABRT_BITS;
+        host_irq_fire(I2C0_IRQ);
+    }
+    host_i2c0_hw.intr_stat = I2C_IC_INTR_STAT_R_STOP_DET_BITS;
+    host_irq_fire(I2C0_IRQ);
+    host_i2c0_hw.intr_stat = 0;
+    return w;
+}
+
+// Completion log filled by on_done
+static i2c_xfer_t *done_log[16];
+static int done_count;
+static void log_done(i2c_xfer_t *x) {
+    if (done_count < 16) done_log[done_count++] = x;
+}
+
+static void idle_finish(void) {
+    if (bus_busy()) finish(0);
+}
+
+
+/* =========================
+ *  CHECKS
+ * ========================= */
+
+static void check_order(void) {
+    static const uint8_t wdata[3] = { 0x10, 0x20, 0x30 };
+    static const uint8_t reg = 0x1F;
+    uint8_t rbuf[2], rbuf2[4];
+    i2c_xfer_t a, b, c;
+
+    i2c_xfer_write(&a, 0x3C, wdata, sizeof(wdata));
+    i2c_xfer_read(&b, 0x10, rbuf, sizeof(rbuf));
+    i2c_xfer_write_read(&c, 0x69, &reg, 1, rbuf2, sizeof(rbuf2));
+    a.on_done = b.on_done = c.on_done = log_done;
+    done_count = 0;
+    memset(host_notify, 0, sizeof(host_notify));
+
+    CHECK(i2c_submit_async(&a));
+    CHECK(i2c_submit_async(&b));
+    CHECK(i2c_submit_async(&c));
+    CHECK(a.status == I2C_XFER_BUSY && b.status == I2C_XFER_QUEUED && c.status == I2C_XFER_QUEUED);
+    CHECK(i2c_async_busy());
+    CHECK(!i2c_submit_async(&b));                   // already queued
+
+    wire_t w = finish(0);
+    CHECK(w.addr == 0x3C && w.tx_len == 3 && w.rx_len == 0 && memcmp(w.tx, wdata, 3) == 0);
+    CHECK(w.restart_at == -1 && w.stop_at == 2);
+    CHECK(a.status == I2C_XFER_DONE && b.status == I2C_XFER_BUSY && c.status == I2C_XFER_QUEUED);
+    CHECK(host_notify[0][TKJHAT_I2C_NOTIFY_INDEX] == 1);
+
+    w = finish(0);
+    CHECK(w.addr == 0x10 && w.tx_len == 0 && w.rx_len == 2 && w.stop_at == 1 && w.restart_at == -1);
+    CHECK(b.status == I2C_XFER_DONE && rbuf[0] == 0xA0 && rbuf[1] == 0xA1);
+
+    w = finish(0);
+    CHECK(w.addr == 0x69 && w.tx_len == 1 && w.tx[0] == reg && w.rx_len == 4);
+    CHECK(w.restart_at == 1 && w.stop_at == 4);
+    CHECK(c.status == I2C_XFER_DONE && rbuf2[3] == 0xA3);
+
+    CHECK(done_count == 3 && done_log[0] == &a && done_log[1] == &b && done_log[2] == &c);
+    CHECK(host_notify[0][TKJHAT_I2C_NOTIFY_INDEX] == 3);
+    for (int i = 0; i < configTASK_NOTIFICATION_ARRAY_ENTRIES; ++i)
+        if (i != TKJHAT_I2C_NOTIFY_INDEX) CHECK(host_notify[0][i] == 0);
+    CHECK(!i2c_async_busy() && host_i2c0_hw.intr_mask == 0);
+    CHECK(a.submit_us <= a.start_us && a.start_us < a.done_us && a.done_us <= b.start_us);
+}
+
+static void check_aborts(void) {
+    static const uint8_t d = 0;
+    i2c_xfer_t x[3];
+    for (int i = 0; i < 3; ++i) {
+        i2c_xfer_write(&x[i], (uint8_t)(0x40 + i), &d, 1);
+        CHECK(i2c_submit_async(&x[i]));
+    }
+    uint32_t aborts = host_dma[tx_ch].aborts;
+    finish(I2C_IC_TX_ABRT_SOURCE_ABRT_7B_ADDR_NOACK_BITS);
+    finish(I2C_IC_TX_ABRT_SOURCE_ABRT_TXDATA_NOACK_BITS);
+    finish(1u << 12);                               // arbitration lost
+    CHECK(x[0].status == I2C_XFER_NAK && x[0].abort_source == I2C_IC_TX_ABRT_SOURCE_ABRT_7B_ADDR_NOACK_BITS);
+    CHECK(x[1].status == I2C_XFER_NAK);
+    CHECK(x[2].status == I2C_XFER_ERROR && x[2].abort_source == (1u << 12));
+    CHECK(host_dma[tx_ch].aborts == aborts + 3);
+    CHECK(!i2c_async_busy());
+
+    // Stray STOP (e.g. from a blocking transfer) with nothing queued
+    host_i2c0_hw.intr_mask = I2C_IC_INTR_MASK_M_STOP_DET_BITS;
+    host_i2c0_hw.intr_stat = I2C_IC_INTR_STAT_R_STOP_DET_BITS;
+    host_irq_fire(I2C0_IRQ);
+    host_i2c0_hw.intr_stat = 0;
+    CHECK(host_i2c0_hw.intr_mask == 0);
+}
+
+static void check_reset(void) {
+    static const uint8_t d = 0;
+    i2c_xfer_t x[3];
+    done_count = 0;
+    memset(host_notify, 0, sizeof(host_notify));
+    for (int i = 0; i < 3; ++i) {
+        i2c_xfer_write(&x[i], 0x50, &d, 1);
+        x[i].on_done = log_done;
+        CHECK(i2c_submit_async(&x[i]));
+    }
+    i2c_async_reset();
+    CHECK(!i2c_async_busy() && !bus_busy());
+    CHECK(done_count == 3 && done_log[0] == &x[0] && done_log[2] == &x[2]);
+    for (int i = 0; i < 3; ++i) CHECK(x[i].status == I2C_XFER_ERROR);
+    CHECK(host_notify[0][TKJHAT_I2C_NOTIFY_INDEX] == 3);
+
+    // The engine takes new work right away
+    CHECK(i2c_submit_async(&x[0]) && x[0].status == I2C_XFER_BUSY);
+    finish(0);
+    CHECK(x[0].status == I2C_XFER_DONE);
+}
+
+// Fire the I2C interrupt while a masked status bit of raw is set, like the
+// NVIC does for a level interrupt; returns how often it ran (at most 4)
+static int fire_while_pending(uint32_t raw) {
+    int fired = 0;
+    while (fired < 4 && (host_i2c0_hw.intr_stat = raw & host_i2c0_hw.intr_mask) != 0) {
+        host_irq_fire(I2C0_IRQ);
+        fired++;
+    }
+    host_i2c0_hw.intr_stat = 0;
+    return fired;
+}
+
+static void check_controller_reset(void) {
+    static const uint8_t d = 0;
+    const uint32_t tx_empty = I2C_IC_INTR_STAT_R_TX_EMPTY_BITS;
+
+    // i2c_init() during bus recovery: the engine restores its idle state
+    host_i2c0_hw.intr_mask = 0x8FF;
+    host_i2c0_hw.dma_cr = I2C_IC_DMA_CR_TDMAE_BITS | I2C_IC_DMA_CR_RDMAE_BITS;
+    i2c_async_rearm();
+    CHECK(host_i2c0_hw.intr_mask == 0 && host_i2c0_hw.dma_cr == 0);
+    CHECK(fire_while_pending(tx_empty) == 0);
+
+    // Without it, TX_EMPTY of an empty FIFO reaches the handler once
+    host_i2c0_hw.intr_mask = 0x8FF;
+    CHECK(fire_while_pending(tx_empty) == 1);
+    CHECK(host_i2c0_hw.intr_mask == 0);
+
+    // Also in the middle of a transfer, which still completes
+    i2c_xfer_t x;
+    i2c_xfer_write(&x, 0x3C, &d, 1);
+    CHECK(i2c_submit_async(&x));
+    host_i2c0_hw.intr_mask |= 0x8FF;
+    CHECK(fire_while_pending(tx_empty) == 1);
+    CHECK(host_i2c0_hw.intr_mask == (I2C_IC_INTR_MASK_M_STOP_DET_BITS | I2C_IC_INTR_MASK_M_TX_ABRT_BITS));
+    CHECK(x.status == I2C_XFER_BUSY);
+    finish(0);
+    CHECK(x.status == I2C_XFER_DONE && host_i2c0_hw.intr_mask == 0);
+}
+
+// A callback that queues the next transfer, from interrupt context
+static i2c_xfer_t chain_next;
+static void chain(i2c_xfer_t *x) {
+    (void)x;
+    CHECK(i2c_submit_async(&chain_next));
+}
+
+static void check_callbacks(void) {
+    static const uint8_t d = 0;
+    i2c_xfer_t first;
+    i2c_xfer_write(&first, 0x3C, &d, 1);
+    i2c_xfer_write(&chain_next, 0x3D, &d, 1);
+    first.on_done = chain;
+    CHECK(i2c_submit_async(&first));
+    finish(0);
+    CHECK(first.status == I2C_XFER_DONE && chain_next.status == I2C_XFER_BUSY);
+    CHECK(finish(0).addr == 0x3D && chain_next.status == I2C_XFER_DONE);
+
+    // The fill helpers reset every field, callback included
+    i2c_xfer_t junk;
+    memset(&junk, 0xA5, sizeof(junk));
+    i2c_xfer_write(&junk, 0x3C, &d, 1);
+    CHECK(junk.on_done == NULL && junk.user_data == NULL && junk.status == I2C_XFER_IDLE);
+}
+
+static void check_rejects(void) {
+    static uint8_t big[TKJHAT_I2C_ASYNC_MAX_LEN + 1];
+    i2c_xfer_t x;
+    CHECK(!i2c_submit_async(NULL));
+    i2c_xfer_write(&x, 0x3C, big, 0);
+    CHECK(!i2c_submit_async(&x));
+    i2c_xfer_write(&x, 0x3C, big, sizeof(big));
+    CHECK(!i2c_submit_async(&x) && x.status == I2C_XFER_IDLE);
+    i2c_xfer_write(&x, 0x3C, big, TKJHAT_I2C_ASYNC_MAX_LEN);
+    CHECK(i2c_submit_async(&x));
+    finish(0);
+    CHECK(x.status == I2C_XFER_DONE);
+}
+
+static void check_wait(void) {
+    static const uint8_t d = 0;
+    i2c_xfer_t x;
+
+    // Blocked on the notification while the "bus" finishes the transfer
+    i2c_xfer_write(&x, 0x3C, &d, 1);
+    CHECK(i2c_submit_async(&x) && x.notify_task == HOST_TASK(0));
+    host_idle_hook = idle_finish;
+    CHECK(i2c_xfer_wait(&x, 10) == I2C_XFER_DONE);
+
+    // Nothing happens on the bus: gives up after the timeout
+    host_idle_hook = NULL;
+    i2c_xfer_write(&x, 0x3C, &d, 1);
+    CHECK(i2c_submit_async(&x));
+    uint64_t t0 = host_now_us;
+    CHECK(i2c_xfer_wait(&x, 5) == I2C_XFER_BUSY);
+    CHECK(host_now_us - t0 >= 5000);
+    finish(0);
+
+    // Before the scheduler runs: no task to notify, wait spins
+    host_scheduler_running = false;
+    memset(host_notify, 0, sizeof(host_notify));
+    i2c_xfer_write(&x, 0x3C, &d, 1);
+    CHECK(i2c_submit_async(&x) && x.notify_task == NULL);
+    host_idle_hook = idle_finish;
+    CHECK(i2c_xfer_wait(&x, 10) == I2C_XFER_DONE);
+    host_idle_hook = NULL;
+    for (int i = 0; i < configTASK_NOTIFICATION_ARRAY_ENTRIES; ++i) CHECK(host_notify[0][i] == 0);
+    host_scheduler_running = true;
+}
+
+
+/* =========================
+ *  BENCHMARK
+ * ========================= */
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void bench(void) {
+    static const uint8_t reg = 0x1F;
+    static uint8_t raw[14];
+    static i2c_xfer_t x[8];
+    const int rounds = 200000;
+
+    double t = now_s();
+    for (int k = 0; k < rounds; ++k) {
+        for (int i = 0; i < 8; ++i) {
+            i2c_xfer_write_read(&x[i], 0x69, &reg, 1, raw, sizeof(raw));
+            i2c_submit_async(&x[i]);
+        }
+        for (int i = 0; i < 8; ++i) {
+            host_dma[tx_ch].busy = host_dma[rx_ch].busy = false;
+            host_i2c0_hw.intr_stat = I2C_IC_INTR_STAT_R_STOP_DET_BITS;
+            host_irq_fire(I2C0_IRQ);
+        }
+    }
+    double s = now_s() - t;
+    host_i2c0_hw.intr_stat = 0;
+    CHECK(x[7].status == I2C_XFER_DONE && !i2c_async_busy());
+    printf("submit + complete, 8 deep, 1+14 bytes: %.0f ns per transfer on the PC\n",
+           s / (rounds * 8.0) * 1e9);
+}
+
+int main(void) {
+    static const uint8_t d = 0;
+    i2c_xfer_t x;
+    i2c_xfer_write(&x, 0x3C, &d, 1);
+    CHECK(!i2c_submit_async(&x));                  // engine not started
+    CHECK(init_i2c_async());
+    CHECK(init_i2c_async());                        // second call is a no-op
+    host_scheduler_running = true;
+
+    check_order();
+    check_aborts();
+    check_reset();
+    check_controller_reset();
+    check_callbacks();
+    check_rejects();
+    check_wait();
+    printf("queue, completion and abort checks: %d failed\n", failures);
+    bench();
+    return failures ? 1 : 0;
+}
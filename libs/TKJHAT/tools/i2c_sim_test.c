@@ -0,0 +1,361 @@
+/*
+ * Host test of the simulated I2C devices (tkjhat/i2c_sim.h).
+ *
+ * Build and run on the PC:
+ *     cc -O2 -Ihost -I../include i2c_sim_test.c host/host_fake.c ../src/i2c_sim.c -lm -o i2c_sim_test
+ *     ./i2c_sim_test
+ *
+ * The models are driven through i2c_sim_write()/i2c_sim_read(), the calls
+ * i2c_bus makes in a TKJHAT_I2C_SIM build, with the register sequences of
+ * the SDK drivers. Time is the fake clock in host/, moved by busy_wait_us()
+ * like on the target. Checked:
+ * - bus: NAK of an empty address, fault injection, recovery, detach;
+ * - ICM-42670: identity, MCLK_RDY low for 1 ms after a soft reset,
+ *   INT_STATUS_DRDY once per output data period and cleared on read,
+ *   data registers in the selected full scale;
+ * - HDC2021: soft reset, DRDY_STATUS after a triggered conversion and then
+ *   once per auto measurement period, cleared on read, TEMP/HUMIDITY;
+ * - VEML6030 counts for the gain and integration time, SSD1306 GDDRAM;
+ * - the bring-up of init_hat_sensors() (resets, configuration, first data
+ *   of both sensors) finishes well inside TKJHAT_BOOT_TIMEOUT_US.
+ * The exit status is non-zero on any failure.
+ *
+ * Version 0.84, MIT License, Raisul Islam, Iván Sánchez Milara.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include <tkjhat/sdk.h>
+#include <tkjhat/i2c_sim.h>
+
+static int failures;
+#define CHECK(cond) do { \
+        if (!(cond)) { printf("line %d: %s\n", __LINE__, #cond); failures++; } \
+    } while (0)
+
+static i2c_sim_icm42670_t imu;
+static i2c_sim_hdc2021_t hdc;
+static i2c_sim_veml6030_t veml;
+static i2c_sim_ssd1306_t oled;
+
+
+/* =========================
+ *  REGISTER ACCESS (as i2c_bus_transfer does it)
+ * ========================= */
+
+static int reg_write(uint8_t addr, uint8_t reg, const uint8_t *src, size_t len) {
+    uint8_t buf[16];
+    buf[0] = reg;
+    memcpy(&buf[1], src, len);
+    return i2c_sim_write(addr, buf, len + 1, false);
+}
+
+static int reg_write1(uint8_t addr, uint8_t reg, uint8_t v) {
+    return reg_write(addr, reg, &v, 1);
+}
+
+static int reg_read(uint8_t addr, uint8_t reg, uint8_t *dst, size_t len) {
+    int rc = i2c_sim_write(addr, &reg, 1, true);
+    if (rc < 0) return rc;
+    return i2c_sim_read(addr, dst, len, false);
+}
+
+static uint8_t reg_read1(uint8_t addr, uint8_t reg) {
+    uint8_t v = 0;
+    reg_read(addr, reg, &v, 1);
+    return v;
+}
+
+
+/* =========================
+ *  BUS
+ * ========================= */
+
+static void check_bus(void) {
+    uint8_t v = 0x55;
+    CHECK(i2c_sim_write(0x50, &v, 1, false) == PICO_ERROR_GENERIC);    // nobody there
+    CHECK(i2c_sim_read(0x50, &v, 1, false) == PICO_ERROR_GENERIC);
+
+    hdc.rf.dev.nak = true;
+    CHECK(reg_read1(HDC2021_I2C_ADDRESS, 0xFE) != 0xD0);
+    hdc.rf.dev.nak = false;
+    CHECK(reg_read1(HDC2021_I2C_ADDRESS, 0xFE) == 0xD0);
+
+    veml.dev.stuck = true;      // any device holding SDA blocks everyone
+    CHECK(reg_read(ICM42670_I2C_ADDRESS, ICM42670_REG_WHO_AM_I, &v, 1) == PICO_ERROR_TIMEOUT);
+    i2c_sim_recover();
+    CHECK(reg_read(ICM42670_I2C_ADDRESS, ICM42670_REG_WHO_AM_I, &v, 1) == 1);
+    CHECK(v == ICM42670_WHO_AM_I_RESPONSE);
+
+    i2c_sim_detach(&veml.dev);
+    CHECK(reg_read(VEML6030_I2C_ADDR, VEML6030_ALS_REG, &v, 1) == PICO_ERROR_GENERIC);
+    i2c_sim_attach(&veml.dev);
+    i2c_sim_attach(&veml.dev);  // attaching twice keeps one entry
+    i2c_sim_detach(&veml.dev);
+    CHECK(reg_read(VEML6030_I2C_ADDR, VEML6030_ALS_REG, &v, 1) == PICO_ERROR_GENERIC);
+    i2c_sim_attach(&veml.dev);
+}
+
+
+/* =========================
+ *  ICM-42670
+ * ========================= */
+
+#define IMU ICM42670_I2C_ADDRESS
+
+static bool imu_drdy(void) {
+    return reg_read1(IMU, ICM42670_INT_STATUS_DRDY_REG) & ICM42670_DATA_RDY_INT;
+}
+
+static void check_icm(void) {
+    CHECK(reg_read1(IMU, ICM42670_REG_WHO_AM_I) == ICM42670_WHO_AM_I_RESPONSE);
+    CHECK(reg_read1(IMU, ICM42670_REG_MCLK_RDY) & ICM42670_MCLK_RDY);
+
+    // Soft reset: no clock for 1 ms
+    uint32_t resets = imu.resets;
+    CHECK(reg_write1(IMU, ICM42670_REG_SIGNAL_PATH_RESET, ICM42670_RESET_CONFIG_BITS) == 2);
+    CHECK(imu.resets == resets + 1);
+    CHECK(!(reg_read1(IMU, ICM42670_REG_MCLK_RDY) & ICM42670_MCLK_RDY));
+    busy_wait_us(999);
+    CHECK(!(reg_read1(IMU, ICM42670_REG_MCLK_RDY) & ICM42670_MCLK_RDY));
+    busy_wait_us(1);
+    CHECK(reg_read1(IMU, ICM42670_REG_MCLK_RDY) & ICM42670_MCLK_RDY);
+
+    // Sensors off: no data ready however long we wait
+    busy_wait_us(100000);
+    CHECK(!imu_drdy());
+
+    // 100 Hz, ±4 g, ±250 dps, then both sensors in low-noise mode
+    uint8_t config[2] = { (ICM42670_GYRO_FSR_250DPS << 5) | 0x09, (ICM42670_ACCEL_FSR_4G << 5) | 0x09 };
+    CHECK(reg_write(IMU, ICM42670_GYRO_CONFIG0_REG, config, 2) == 3);
+    CHECK(reg_write1(IMU, ICM42670_PWR_MGMT0_REG, 0x0F) == 2);
+    CHECK(!imu_drdy());
+    busy_wait_us(9999);
+    CHECK(!imu_drdy());
+    busy_wait_us(1);
+    CHECK(imu_drdy());
+    CHECK(!imu_drdy());                     // cleared by the previous read
+    busy_wait_us(25000);                    // two and a half periods: one flag
+    CHECK(imu_drdy());
+    CHECK(!imu_drdy());
+    busy_wait_us(5000);                     // next sample on the 10 ms grid
+    CHECK(imu_drdy());
+
+    // A burst that covers INT_STATUS_DRDY clears it too, one that does not leaves it
+    uint8_t buf[16];
+    busy_wait_us(10000);
+    reg_read(IMU, ICM42670_INT_STATUS_DRDY_REG - 4, buf, 4);
+    CHECK(imu_drdy());
+    busy_wait_us(10000);
+    reg_read(IMU, ICM42670_INT_STATUS_DRDY_REG - 4, buf, 8);
+    CHECK(buf[4] & ICM42670_DATA_RDY_INT);
+    CHECK(!imu_drdy());
+
+    // 1600 Hz code
+    reg_write1(IMU, ICM42670_ACCEL_CONFIG0_REG, (ICM42670_ACCEL_FSR_4G << 5) | 0x05);
+    busy_wait_us(10000);
+    imu_drdy();
+    busy_wait_us(624);
+    CHECK(!imu_drdy());
+    busy_wait_us(1);
+    CHECK(imu_drdy());
+    reg_write1(IMU, ICM42670_ACCEL_CONFIG0_REG, (ICM42670_ACCEL_FSR_4G << 5) | 0x09);
+
+    // Data registers: big-endian, in the selected full scale
+    imu.accel[2].value = 1.0f;
+    imu.gyro[0].value = -10.0f;
+    imu.temp.value = 30.0f;
+    CHECK(reg_read(IMU, ICM42670_SENSOR_DATA_START_REG, buf, 14) == 14);
+    CHECK((int16_t)(buf[0] << 8 | buf[1]) == 5 * 128);         // (30 - 25) * 128
+    CHECK((int16_t)(buf[6] << 8 | buf[7]) == 8192);            // 1 g at ±4 g
+    CHECK((int16_t)(buf[8] << 8 | buf[9]) == -1312);           // -10 dps at ±250 dps
+
+    // Powering down stops the samples
+    reg_write1(IMU, ICM42670_PWR_MGMT0_REG, 0x00);
+    imu_drdy();
+    busy_wait_us(50000);
+    CHECK(!imu_drdy());
+    CHECK(reg_read(IMU, ICM42670_SENSOR_DATA_START_REG, buf, 14) == 14);
+    CHECK((int16_t)(buf[6] << 8 | buf[7]) == INT16_MIN);       // sensor off
+}
+
+
+/* =========================
+ *  HDC2021
+ * ========================= */
+
+#define HDC HDC2021_I2C_ADDRESS
+
+static bool hdc_drdy(void) {
+    return reg_read1(HDC, HDC2021_DRDY_STATUS_REG) & HDC2021_DRDY_STATUS;
+}
+
+// hdc2021_configure(): CONFIG..MEASUREMENT_CONFIG in one burst
+static void hdc_configure(uint8_t config, uint8_t meas) {
+    uint8_t v[2] = { config, meas };
+    CHECK(reg_write(HDC, HDC2021_CONFIG, v, 2) == 3);
+}
+
+static void check_hdc(void) {
+    CHECK(reg_read1(HDC, 0xFC) == 0x49 && reg_read1(HDC, 0xFD) == 0x54);
+    CHECK(reg_write1(HDC, 0xFE, 0x00) == 2);
+    CHECK(reg_read1(HDC, 0xFE) == 0xD0);                        // read-only
+
+    uint32_t resets = hdc.resets;
+    CHECK(reg_write1(HDC, HDC2021_CONFIG, 0x80) == 2);
+    CHECK(hdc.resets == resets + 1);
+    CHECK(!(reg_read1(HDC, HDC2021_CONFIG) & 0x80));           // SOFT_RES cleared
+
+    // No conversion yet
+    busy_wait_us(100000);
+    CHECK(!hdc_drdy());
+
+    // One triggered conversion (AMM off)
+    uint32_t triggers = hdc.triggers;
+    hdc_configure(0x00, 0x01);
+    CHECK(hdc.triggers == triggers + 1);
+    CHECK(!(reg_read1(HDC, HDC2021_MEASUREMENT_CONFIG) & 0x01));   // MEAS_TRIG self-clears
+    busy_wait_us(1299);
+    CHECK(!hdc_drdy());
+    busy_wait_us(1);
+    CHECK(hdc_drdy());
+    CHECK(!hdc_drdy());                     // cleared by the previous read
+    busy_wait_us(2000000);
+    CHECK(!hdc_drdy());                     // no automatic conversions
+
+    // Trigger with AMM at 1 Hz, as the SDK configures it
+    hdc_configure(0x50, 0x01);
+    busy_wait_us(1300);
+    CHECK(hdc_drdy());
+    busy_wait_us(999999);                   // periods run from the end of the first conversion
+    CHECK(!hdc_drdy());
+    busy_wait_us(1);
+    CHECK(hdc_drdy());
+    busy_wait_us(3500000);                  // missed periods: one flag
+    CHECK(hdc_drdy());
+    CHECK(!hdc_drdy());
+
+    // TEMP/HUMIDITY, LSB first: T = raw * 165 / 65536 - 40, RH = raw * 100 / 65536
+    uint8_t buf[5];
+    hdc.temp.value = 22.0f;
+    hdc.humidity.value = 40.0f;
+    CHECK(reg_read(HDC, HDC2021_TEMP_LOW, buf, 4) == 4);
+    float t = (float)(buf[0] | buf[1] << 8) * 165.0f / 65536.0f - 40.0f;
+    float h = (float)(buf[2] | buf[3] << 8) * 100.0f / 65536.0f;
+    CHECK(fabsf(t - 22.0f) < 0.01f);
+    CHECK(fabsf(h - 40.0f) < 0.01f);
+
+    // A burst over TEMP..DRDY_STATUS returns and clears the flag
+    busy_wait_us(1000000);
+    CHECK(reg_read(HDC, HDC2021_TEMP_LOW, buf, 5) == 5);
+    CHECK(buf[4] & HDC2021_DRDY_STATUS);
+    CHECK(!hdc_drdy());
+
+    // Soft reset stops the automatic conversions
+    reg_write1(HDC, HDC2021_CONFIG, 0x80);
+    busy_wait_us(3000000);
+    CHECK(!hdc_drdy());
+}
+
+
+/* =========================
+ *  VEML6030, SSD1306
+ * ========================= */
+
+static uint16_t veml_read(uint8_t cmd) {
+    uint8_t v[2] = { 0 };
+    CHECK(reg_read(VEML6030_I2C_ADDR, cmd, v, 2) == 2);
+    return (uint16_t)(v[0] | v[1] << 8);
+}
+
+static void check_veml_ssd1306(void) {
+    CHECK(veml_read(VEML6030_CONFIG_REG) == 0x0001);            // shut down
+    uint8_t on[2] = { 0x00, 0x10 };                             // gain 1/8, 100 ms, as init_veml6030()
+    CHECK(reg_write(VEML6030_I2C_ADDR, VEML6030_CONFIG_REG, on, 2) == 3);
+    veml.lux.value = 300.0f;
+    CHECK(veml_read(VEML6030_ALS_REG) == 651);                  // 300 / (0.0576 * 8)
+    uint8_t bad[2] = { 0x20, 0x00 };                            // unknown command code
+    CHECK(i2c_sim_write(VEML6030_I2C_ADDR, bad, 2, false) == PICO_ERROR_GENERIC);
+
+    static const uint8_t cmds[] = { 0x00, 0xAF, 0x20, 0x00, 0x21, 8, 15, 0x22, 2, 3, 0x81, 0x40 };
+    CHECK(i2c_sim_write(SSD1306_I2C_ADDRESS, cmds, sizeof(cmds), false) == (int)sizeof(cmds));
+    CHECK(oled.display_on && oled.mode == 0 && oled.contrast == 0x40);
+    uint8_t data[1 + 17];
+    data[0] = 0x40;
+    memset(&data[1], 0x81, 17);                                 // one byte wraps to (8, page 2)
+    data[17] = 0xFF;
+    CHECK(i2c_sim_write(SSD1306_I2C_ADDRESS, data, sizeof(data), false) == (int)sizeof(data));
+    CHECK(i2c_sim_ssd1306_pixel(&oled, 9, 16) && i2c_sim_ssd1306_pixel(&oled, 9, 23));
+    CHECK(!i2c_sim_ssd1306_pixel(&oled, 9, 17));
+    CHECK(i2c_sim_ssd1306_pixel(&oled, 15, 31) && !i2c_sim_ssd1306_pixel(&oled, 16, 31));
+    CHECK(oled.gddram[2][8] == 0xFF);                           // the 17th byte
+}
+
+
+/* =========================
+ *  BRING-UP (init_hat_sensors)
+ * ========================= */
+
+static void check_bringup(void) {
+    i2c_sim_icm42670_init(&imu);
+    i2c_sim_hdc2021_init(&hdc);
+    i2c_sim_attach(&imu.rf.dev);
+    i2c_sim_attach(&hdc.rf.dev);
+    uint64_t start = time_us_64(), deadline = start + TKJHAT_BOOT_TIMEOUT_US;
+
+    // 1. Both resets
+    CHECK(reg_write1(IMU, ICM42670_REG_SIGNAL_PATH_RESET, ICM42670_RESET_CONFIG_BITS) == 2);
+    CHECK(reg_write1(HDC, HDC2021_CONFIG, 0x80) == 2);
+    busy_wait_us(1000);                                         // icm_reset_wait()
+
+    // 2. IMU clock, identity, configuration
+    while (!(reg_read1(IMU, ICM42670_REG_MCLK_RDY) & ICM42670_MCLK_RDY) && time_us_64() < deadline)
+        busy_wait_us(50);
+    CHECK(reg_read1(IMU, ICM42670_REG_WHO_AM_I) == ICM42670_WHO_AM_I_RESPONSE);
+    uint8_t config[2] = { (ICM42670_GYRO_FSR_250DPS << 5) | 0x09, (ICM42670_ACCEL_FSR_4G << 5) | 0x09 };
+    reg_write(IMU, ICM42670_GYRO_CONFIG0_REG, config, 2);
+    reg_write1(IMU, ICM42670_PWR_MGMT0_REG, 0x0F);
+
+    // 3. HDC2021 out of reset, configured and triggered
+    while ((reg_read1(HDC, HDC2021_CONFIG) & 0x80) && time_us_64() < deadline)
+        busy_wait_us(100);
+    hdc_configure(0x50, 0x01);
+
+    // 4. First data of both
+    bool imu_wait = true, hdc_wait = true;
+    uint64_t imu_at = 0, hdc_at = 0;
+    while ((imu_wait || hdc_wait) && time_us_64() < deadline) {
+        if (imu_wait && imu_drdy()) { imu_wait = false; imu_at = time_us_64() - start; }
+        if (hdc_wait && hdc_drdy()) { hdc_wait = false; hdc_at = time_us_64() - start; }
+        busy_wait_us(100);
+    }
+    CHECK(!imu_wait && !hdc_wait);
+    CHECK(imu_at >= 10000 && imu_at < 12000);                   // one period at 100 Hz
+    CHECK(hdc_at >= 2300 && hdc_at < 4000);                     // reset + one conversion
+    printf("bring-up: HDC2021 data at %llu us, IMU data at %llu us (simulated)\n",
+           (unsigned long long)hdc_at, (unsigned long long)imu_at);
+}
+
+
+int main(void) {
+    host_now_us = 1000000;
+    i2c_sim_icm42670_init(&imu);
+    i2c_sim_hdc2021_init(&hdc);
+    i2c_sim_veml6030_init(&veml);
+    i2c_sim_ssd1306_init(&oled);
+    i2c_sim_attach(&imu.rf.dev);
+    i2c_sim_attach(&hdc.rf.dev);
+    i2c_sim_attach(&veml.dev);
+    i2c_sim_attach(&oled.dev);
+
+    check_bus();
+    check_icm();
+    check_hdc();
+    check_veml_ssd1306();
+    check_bringup();
+    printf("bus, status register and data checks: %d failed\n", failures);
+    return failures ? 1 : 0;
+}
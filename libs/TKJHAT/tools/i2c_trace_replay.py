@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""
+Replay an I2C trace dumped by i2c_trace_dump() and report bus usage per device.
+
+Usage:
+    python3 i2c_trace_replay.py trace.csv [--speed 400000]
+
+The trace is the CSV text printed on the CDC0 port (lines starting with '#'
+and the column header are skipped, so the raw capture can be used as is).
+
+Two views are reported for every device on the HAT bus:
+
+* measured: what the firmware saw (transfer count, errors, bytes, time the bus
+  was busy, worst transfer duration);
+* replayed: the same sequence of transfers re-timed on an ideal bus at
+  --speed, with the HAT devices modelled as in i2c_sim.c (no clock
+  stretching, NAK ends the transfer after the address byte). A transfer waits
+  while the bus is busy, so the replayed latency includes queueing behind the
+  other devices. A large gap between measured duration and replayed wire time
+  points at software overhead (task switches, blocking waits) rather than the
+  bus.
+
+Version 0.84, MIT License, Raisul Islam, Iván Sánchez Milara.
+"""
+
+import argparse
+import csv
+import sys
+from collections import OrderedDict
+
+DEVICES = {
+    0x69: "ICM42670",
+    0x68: "ICM42670",
+    0x10: "VEML6030",
+    0x40: "HDC2021",
+    0x3C: "SSD1306",
+}
+
+FLAG_READ = 0x01
+FLAG_NOSTOP = 0x02
+FLAG_ASYNC = 0x04
+
+PICO_ERROR_TIMEOUT = -2       # as in the Pico SDK
+
+
+def read_trace(path):
+    """Return the trace as a list of dicts with unwrapped 64-bit timestamps."""
+    entries = []
+    with open(path, newline="") as f:
+        rows = (line for line in f if line.strip() and not line.startswith("#"))
+        for row in csv.DictReader(rows):
+            entries.append({
+                "t_us": int(row["t_us"]),
+                "dur_us": int(row["dur_us"]),
+                "addr": int(row["addr"], 16),
+                "read": row["dir"].strip() == "R",
+                "len": int(row["len"]),
+                "result": int(row["result"]),
+                "flags": int(row["flags"]),
+            })
+    # t_us holds the low 32 bits of time_us_64(); undo the wrap-around
+    offset, last = 0, None
+    for e in entries:
+        if last is not None and e["t_us"] + offset < last - (1 << 31):
+            offset += 1 << 32
+        e["t_us"] += offset
+        last = e["t_us"]
+    return entries
+
+
+def wire_time_us(e, speed):
+    """Time the transfer occupies the bus on an ideal bus at `speed` Hz."""
+    bit_us = 1e6 / speed
+    addr_bytes = 1
+    data_bytes = e["len"]
+    if e["flags"] & FLAG_ASYNC and e["read"]:
+        addr_bytes += 1           # write-then-read: repeated START + address
+    if e["result"] < 0 and e["result"] != PICO_ERROR_TIMEOUT:
+        data_bytes = 0            # NAK: the model stops after the address byte
+    stop_bits = 0 if e["flags"] & FLAG_NOSTOP else 1
+    # 9 clocks per byte (8 data + ACK), START and STOP about one bit time each
+    return bit_us * (1 + 9 * (addr_bytes + data_bytes) + stop_bits)
+
+
+def replay(entries, speed):
+    stats = OrderedDict()
+    bus_free_us = 0.0
+    for e in entries:
+        name = DEVICES.get(e["addr"], "0x%02X" % e["addr"])
+        s = stats.setdefault(name, {
+            "transfers": 0, "errors": 0, "timeouts": 0, "bytes": 0,
+            "busy_us": 0, "worst_us": 0, "wire_us": 0.0, "worst_replay_us": 0.0,
+        })
+        s["transfers"] += 1
+        if e["result"] < 0:
+            s["errors"] += 1
+            if e["result"] == PICO_ERROR_TIMEOUT:
+                s["timeouts"] += 1
+        else:
+            s["bytes"] += e["len"]
+        s["busy_us"] += e["dur_us"]
+        s["worst_us"] = max(s["worst_us"], e["dur_us"])
+
+        wire = wire_time_us(e, speed)
+        start = max(float(e["t_us"]), bus_free_us)
+        bus_free_us = start + wire
+        s["wire_us"] += wire
+        s["worst_replay_us"] = max(s["worst_replay_us"], bus_free_us - e["t_us"])
+    return stats
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    ap.add_argument("trace", help="CSV captured from i2c_trace_dump()")
+    ap.add_argument("--speed", type=int, default=400000, help="bus clock in Hz (default 400000)")
+    args = ap.parse_args()
+
+    entries = read_trace(args.trace)
+    if not entries:
+        sys.exit("no entries in %s" % args.trace)
+
+    span_us = max(e["t_us"] + e["dur_us"] for e in entries) - entries[0]["t_us"]
+    stats = replay(entries, args.speed)
+
+    print("%d transfers over %.3f s, replayed at %d Hz" %
+          (len(entries), span_us / 1e6, args.speed))
+    print()
+    hdr = ("device", "xfers", "errors", "t/o", "bytes", "util%", "worst us",
+           "wire util%", "worst replay us")
+    fmt = "%-10s %7s %6s %4s %8s %6s %9s %10s %16s"
+    print(fmt % hdr)
+    total_busy = total_wire = 0.0
+    for name, s in stats.items():
+        total_busy += s["busy_us"]
+        total_wire += s["wire_us"]
+        print(fmt % (name, s["transfers"], s["errors"], s["timeouts"], s["bytes"],
+                     "%.2f" % (100.0 * s["busy_us"] / span_us), s["worst_us"],
+                     "%.2f" % (100.0 * s["wire_us"] / span_us),
+                     "%.0f" % s["worst_replay_us"]))
+    print()
+    print("bus busy (measured): %.2f %%   bus busy (wire time): %.2f %%" %
+          (100.0 * total_busy / span_us, 100.0 * total_wire / span_us))
+
+
+if __name__ == "__main__":
+    main()
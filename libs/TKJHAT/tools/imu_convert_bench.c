@@ -0,0 +1,118 @@
+/*
+ * Host benchmark of the IMU sample conversions (see tkjhat/imu_fixed.h).
+ *
+ * Build and run on the PC:
+ *     cc -O2 -I../include imu_convert_bench.c ../src/imu_fixed.c -o imu_convert_bench -lm
+ *     ./imu_convert_bench
+ *
+ * The same three conversions run on the Pico in examples/hat_imu_bench.
+ * On a PC with an FPU the float versions are cheap; the numbers that matter
+ * are the ones measured on the RP2040.
+ *
+ * Version 0.84, MIT License, Raisul Islam, Iván Sánchez Milara.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include <tkjhat/imu_fixed.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static uint64_t cycles(void) { return __rdtsc(); }
+#define CYCLE_UNIT "TSC cycles"
+#else
+static uint64_t cycles(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+#define CYCLE_UNIT "ns"
+#endif
+
+#define N       256
+#define ROUNDS  2000
+
+typedef struct { float a[3], g[3], t; } sample_f;
+
+static ICM42670_raw_t raw[N];
+static ICM42670_q16_t q[N];
+static sample_f f[N];
+
+// What ICM42670_read_sensor_data() did before: seven divisions per sample
+static void convert_div(const ICM42670_raw_t *r, sample_f *o, size_t n, float ares, float gres) {
+    for (size_t i = 0; i < n; ++i) {
+        for (int k = 0; k < 3; ++k) {
+            o[i].a[k] = (float)r[i].accel[k] / ares;
+            o[i].g[k] = (float)r[i].gyro[k] / gres;
+        }
+        o[i].t = ((float)r[i].temp / 128.0f) + 25.0;
+    }
+}
+
+// Current float API: multiplications by the precomputed reciprocals
+static void convert_mul(const ICM42670_scale_t *sc, const ICM42670_raw_t *r, sample_f *o, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        for (int k = 0; k < 3; ++k) {
+            o[i].a[k] = (float)r[i].accel[k] * sc->accel_inv;
+            o[i].g[k] = (float)r[i].gyro[k] * sc->gyro_inv;
+        }
+        o[i].t = (float)r[i].temp * (1.0f / 128.0f) + 25.0f;
+    }
+}
+
+static volatile float sink;
+
+int main(void) {
+    const float ares = 8192.0f, gres = 131.0f;     // ±4 g, ±250 dps
+    ICM42670_scale_t sc;
+    ICM42670_scale_set_accel(&sc, ares);
+    ICM42670_scale_set_gyro(&sc, gres);
+
+    srand(1);
+    for (int i = 0; i < N; ++i) {
+        for (int k = 0; k < 3; ++k) {
+            raw[i].accel[k] = (int16_t)(rand() - RAND_MAX / 2);
+            raw[i].gyro[k] = (int16_t)(rand() - RAND_MAX / 2);
+        }
+        raw[i].temp = (int16_t)(rand() % 4000 - 2000);
+    }
+
+    uint64_t best_div = UINT64_MAX, best_mul = UINT64_MAX, best_q16 = UINT64_MAX;
+    for (int r = 0; r < ROUNDS; ++r) {
+        uint64_t t0 = cycles();
+        convert_div(raw, f, N, ares, gres);
+        uint64_t t1 = cycles();
+        sink = f[N - 1].a[0];
+        convert_mul(&sc, raw, f, N);
+        uint64_t t2 = cycles();
+        sink = f[N - 1].a[0];
+        ICM42670_convert_q16(&sc, raw, q, N);
+        uint64_t t3 = cycles();
+        sink = (float)q[N - 1].accel[0];
+        if (t1 - t0 < best_div) best_div = t1 - t0;
+        if (t2 - t1 < best_mul) best_mul = t2 - t1;
+        if (t3 - t2 < best_q16) best_q16 = t3 - t2;
+    }
+
+    // Q16 against the float reference
+    convert_div(raw, f, N, ares, gres);
+    double err_a = 0, err_g = 0, err_t = 0;
+    for (int i = 0; i < N; ++i) {
+        for (int k = 0; k < 3; ++k) {
+            err_a = fmax(err_a, fabs(q[i].accel[k] / 65536.0 - f[i].a[k]));
+            err_g = fmax(err_g, fabs(q[i].gyro[k] / 65536.0 - f[i].g[k]));
+        }
+        err_t = fmax(err_t, fabs(q[i].temp / 65536.0 - f[i].t));
+    }
+
+    printf("%d samples, best of %d rounds, %s per sample\n", N, ROUNDS, CYCLE_UNIT);
+    printf("  float, division (old)    %8.2f\n", (double)best_div / N);
+    printf("  float, reciprocal        %8.2f\n", (double)best_mul / N);
+    printf("  Q16.16 batch             %8.2f\n", (double)best_q16 / N);
+    printf("max |Q16 - float|: accel %.2e g, gyro %.2e dps, temp %.2e C\n", err_a, err_g, err_t);
+    return 0;
+}
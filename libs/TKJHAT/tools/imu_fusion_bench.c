@@ -0,0 +1,185 @@
+/*
+ * Host accuracy test and benchmark of the orientation filter (tkjhat/imu_fusion.h).
+ *
+ * Build and run on the PC:
+ *     cc -O2 -I../include imu_fusion_bench.c ../src/imu_fusion.c ../src/imu_fixed.c -o imu_fusion_bench -lm
+ *     ./imu_fusion_bench
+ *
+ * Each scenario rotates a simulated sensor (exact quaternion integration in
+ * double precision), quantizes accel and gyro like the ICM-42670 at ±4 g /
+ * ±250 dps, feeds the filter at 400 Hz and compares its orientation with the
+ * truth. The exit status is non-zero if a scenario exceeds its error bound.
+ *
+ * Version 0.84, MIT License, Raisul Islam, Iván Sánchez Milara.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+
+#include <tkjhat/imu_fusion.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static uint64_t cycles(void) { return __rdtsc(); }
+#define CYCLE_UNIT "TSC cycles"
+#else
+static uint64_t cycles(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+#define CYCLE_UNIT "ns"
+#endif
+
+#define ODR_HZ      400
+#define DT_US       (1000000 / ODR_HZ)
+#define ACCEL_LSB   8192.0      // counts per g at ±4 g
+#define GYRO_LSB    131.0       // counts per dps at ±250 dps
+
+typedef struct { double w, x, y, z; } quat_d;
+
+typedef struct {
+    const char *name;
+    double seconds;
+    double rate_dps[3];         // body angular rate
+    double bias_dps[3];         // gyro bias added to the measurement
+    double tilt_deg;            // truth starts rolled by this much while the filter starts level
+    double settle_s;            // error is checked after this time
+    double max_err_deg;         // pass bound
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+    { "level, at rest",          5, {   0,   0,   0 }, {  0, 0, 0 },  0, 0.0, 0.2 },
+    { "30 deg tilt step",       10, {   0,   0,   0 }, {  0, 0, 0 }, 30, 5.0, 0.5 },
+    { "yaw 90 dps",              4, {   0,   0,  90 }, {  0, 0, 0 },  0, 0.0, 1.0 },
+    { "roll 45 dps",             8, {  45,   0,   0 }, {  0, 0, 0 },  0, 0.0, 1.0 },
+    { "tumble 45/30/-60 dps",    8, {  45,  30, -60 }, {  0, 0, 0 },  0, 0.0, 1.5 },
+    { "gyro bias 1 dps on X",   60, {   0,   0,   0 }, {  1, 0, 0 },  0, 40.0, 0.3 },
+};
+
+static quat_d qmul(quat_d a, quat_d b) {
+    return (quat_d){
+        a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+        a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+        a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+        a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+    };
+}
+
+static void gravity_d(quat_d q, double v[3]) {
+    v[0] = 2 * (q.x * q.z - q.w * q.y);
+    v[1] = 2 * (q.w * q.x + q.y * q.z);
+    v[2] = q.w * q.w - q.x * q.x - q.y * q.y + q.z * q.z;
+}
+
+// Angle between two orientations, degrees
+static double angle_deg(quat_d a, imu_quat_t b) {
+    double d = fabs(a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z) / (1 << 30);
+    if (d > 1) d = 1;
+    return 2 * acos(d) * 180 / M_PI;
+}
+
+static int16_t counts(double v, double lsb) {
+    double c = round(v * lsb);
+    if (c > 32767) c = 32767;
+    if (c < -32768) c = -32768;
+    return (int16_t)c;
+}
+
+static int run(const scenario_t *sc, const ICM42670_scale_t *scale,
+               uint64_t *cyc, uint64_t *updates) {
+    imu_fusion_t f;
+    imu_fusion_init(&f, IMU_FUSION_KP_DEFAULT, IMU_FUSION_KI_DEFAULT);
+
+    double r = sc->tilt_deg * M_PI / 360;
+    quat_d truth = { cos(r), sin(r), 0, 0 };
+    double w[3];
+    for (int i = 0; i < 3; ++i) w[i] = sc->rate_dps[i] * M_PI / 180;
+    double wn = sqrt(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]);
+    double half = wn * DT_US * 1e-6 / 2;
+    quat_d step = { 1, 0, 0, 0 };
+    if (wn > 0)
+        step = (quat_d){ cos(half), sin(half) * w[0] / wn, sin(half) * w[1] / wn, sin(half) * w[2] / wn };
+
+    int n = (int)(sc->seconds * ODR_HZ);
+    double max_err = 0, err = 0;
+    for (int k = 0; k < n; ++k) {
+        double g[3];
+        // The filter's first sample is level for the tilt-step scenario
+        gravity_d(k == 0 ? (quat_d){ 1, 0, 0, 0 } : truth, g);
+        ICM42670_raw_t raw = { .temp = 0 };
+        for (int i = 0; i < 3; ++i) {
+            raw.accel[i] = counts(g[i], ACCEL_LSB);
+            raw.gyro[i] = counts(sc->rate_dps[i] + sc->bias_dps[i], GYRO_LSB);
+        }
+        ICM42670_q16_t s;
+        ICM42670_convert_q16(scale, &raw, &s, 1);
+
+        uint64_t t0 = cycles();
+        imu_fusion_update(&f, &s, (uint64_t)k * DT_US);
+        *cyc += cycles() - t0;
+        ++*updates;
+
+        truth = qmul(truth, step);      // orientation at the next sample
+        // the filter has integrated up to the current sample: compare with it
+        quat_d now = qmul(truth, (quat_d){ step.w, -step.x, -step.y, -step.z });
+        err = angle_deg(now, f.q);
+        if (k >= sc->settle_s * ODR_HZ && err > max_err) max_err = err;
+    }
+
+    int32_t roll, pitch, yaw;
+    imu_fusion_euler(&f, &roll, &pitch, &yaw);
+    bool ok = max_err <= sc->max_err_deg;
+    printf("  %-24s max %6.3f  final %6.3f  bound %4.1f  rpy %7.2f %7.2f %7.2f  %s\n",
+           sc->name, max_err, err, sc->max_err_deg,
+           roll / 65536.0, pitch / 65536.0, yaw / 65536.0, ok ? "ok" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+// Euler angles against the double-precision formulas
+static double euler_check(void) {
+    double worst = 0;
+    for (int i = 0; i < 2000; ++i) {
+        double rr = fmod(i * 0.37, 358) - 179, pp = fmod(i * 0.71, 160) - 80, yy = fmod(i * 1.13, 358) - 179;
+        double cr = cos(rr * M_PI / 360), sr = sin(rr * M_PI / 360);
+        double cp = cos(pp * M_PI / 360), sp = sin(pp * M_PI / 360);
+        double cy = cos(yy * M_PI / 360), sy = sin(yy * M_PI / 360);
+        imu_fusion_t f;
+        imu_fusion_init(&f, 0, 0);
+        f.q.w = (int32_t)llround((cr * cp * cy + sr * sp * sy) * (1 << 30));
+        f.q.x = (int32_t)llround((sr * cp * cy - cr * sp * sy) * (1 << 30));
+        f.q.y = (int32_t)llround((cr * sp * cy + sr * cp * sy) * (1 << 30));
+        f.q.z = (int32_t)llround((cr * cp * sy - sr * sp * cy) * (1 << 30));
+        int32_t r, p, y;
+        imu_fusion_euler(&f, &r, &p, &y);
+        double e[3] = { r / 65536.0 - rr, p / 65536.0 - pp, y / 65536.0 - yy };
+        for (int k = 0; k < 3; ++k) {
+            e[k] = fabs(fmod(e[k] + 540, 360) - 180);
+            if (e[k] > worst) worst = e[k];
+        }
+    }
+    return worst;
+}
+
+int main(void) {
+    ICM42670_scale_t scale;
+    ICM42670_scale_set_accel(&scale, ACCEL_LSB);
+    ICM42670_scale_set_gyro(&scale, GYRO_LSB);
+
+    int failures = 0;
+    uint64_t cyc = 0, updates = 0;
+    printf("orientation error vs. truth, degrees (%d Hz, kp %.2f, ki %.3f)\n",
+           ODR_HZ, IMU_FUSION_KP_DEFAULT / 65536.0, IMU_FUSION_KI_DEFAULT / 65536.0);
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); ++i)
+        failures += run(&scenarios[i], &scale, &cyc, &updates);
+
+    double eul = euler_check();
+    printf("euler conversion: worst error %.3f deg %s\n", eul, eul <= 0.1 ? "ok" : "FAIL");
+    if (eul > 0.1) failures++;
+
+    printf("update: %.1f %s on average over %llu updates\n",
+           (double)cyc / updates, CYCLE_UNIT, (unsigned long long)updates);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,506 @@
+/*
+ * Host check and benchmark of the raster core (tkjhat/raster.h).
+ *
+ * Build and run on the PC:
+ *     cc -O2 -I../include raster_bench.c ../src/raster.c -o raster_bench
+ *     ./raster_bench
+ *
+ * Checks:
+ * - golden images: a few lines whose pixels are listed by hand, drawn in
+ *   both directions, and a fixed scene compared by checksum;
+ * - random lines, spans and rectangles (partly or fully off-screen) against
+ *   per-pixel reference code, plus the change tracking: every byte that
+ *   changed lies in its page's dirty span, every set pixel in the ink span;
+ * - random text in font_8x5 and two made-up fonts (16 rows high, 10 columns
+ *   wide), scales 0 to 6, with and without the glyph cache, the same way.
+ * The benchmark compares pixels/s with the drawing code the SSD1306 driver
+ * used before (float slope lines, draw_pixel per pixel for fills and spans)
+ * and characters/ms of full screens of text with the old draw_char (one
+ * draw_square per set font pixel).
+ * On the PC float is in hardware; on the RP2040 it is emulated, so the gap
+ * for lines is larger there. The exit status is non-zero on any mismatch.
+ *
+ * Version 0.84, MIT License, Raisul Islam, Iván Sánchez Milara.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <tkjhat/raster.h>
+#include <tkjhat/font.h>
+
+#define W       128
+#define H       64
+#define PAGES   (H / 8)
+#define SCENE_FNV   0xA7F2A88Au   // checksum of the golden scene
+
+static uint8_t fb[PAGES * W], ref[PAGES * W];
+static uint8_t dirty_lo[PAGES], dirty_hi[PAGES], ink_lo[PAGES], ink_hi[PAGES];
+static const raster_t r = { fb, W, H, dirty_lo, dirty_hi, ink_lo, ink_hi };
+static raster_glyph_cache_t cache;
+
+// Random glyph data, header set in main()
+static uint8_t font_tall[5 + 95 * 5 * 2], font_wide[5 + 95 * 10];
+
+static uint32_t rng = 1;
+static int32_t rnd(int32_t lo, int32_t hi) {
+    rng = rng * 1664525u + 1013904223u;
+    return lo + (int32_t)((rng >> 8) % (uint32_t)(hi - lo + 1));
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void spans_clear(uint8_t *lo, uint8_t *hi) {
+    memset(lo, 0xFF, PAGES);
+    memset(hi, 0, PAGES);
+}
+
+static int get(const uint8_t *b, int x, int y) {
+    return (b[(y >> 3) * W + x] >> (y & 7)) & 1;
+}
+
+
+/* =========================
+ *  REFERENCE: one pixel at a time
+ * ========================= */
+
+static void ref_pixel(int64_t x, int64_t y, int on) {
+    if (x < 0 || y < 0 || x >= W || y >= H) return;
+    uint8_t *b = &ref[(y >> 3) * W + x];
+    if (on) *b |= (uint8_t)(1u << (y & 7));
+    else    *b &= (uint8_t)~(1u << (y & 7));
+}
+
+// Textbook Bresenham over the whole length, major axis increasing
+static void ref_line(int32_t x0, int32_t y0, int32_t x1, int32_t y1, int on) {
+    int32_t adx = x1 > x0 ? x1 - x0 : x0 - x1, ady = y1 > y0 ? y1 - y0 : y0 - y1;
+    int steep = ady > adx;
+    int32_t a0 = steep ? y0 : x0, b0 = steep ? x0 : y0, a1 = steep ? y1 : x1, b1 = steep ? x1 : y1;
+    if (a0 > a1) { int32_t t = a0; a0 = a1; a1 = t; t = b0; b0 = b1; b1 = t; }
+    int32_t da = a1 - a0, db = b1 > b0 ? b1 - b0 : b0 - b1, sb = b1 > b0 ? 1 : -1;
+    int32_t d = 2 * db - da, b = b0;
+    for (int32_t a = a0; a <= a1; ++a) {
+        if (steep) ref_pixel(b, a, on); else ref_pixel(a, b, on);
+        if (d > 0) { b += sb; d -= 2 * da; }
+        d += 2 * db;
+    }
+}
+
+static void ref_fill(int64_t x, int64_t y, int64_t w, int64_t h, int on) {
+    for (int64_t j = y < 0 ? 0 : y; j < y + h && j < H; ++j)
+        for (int64_t i = x < 0 ? 0 : x; i < x + w && i < W; ++i)
+            ref_pixel(i, j, on);
+}
+
+static void ref_rect(int64_t x, int64_t y, int64_t w, int64_t h, int on) {
+    if (w <= 0 || h <= 0) return;
+    ref_fill(x, y, w, 1, on);
+    ref_fill(x, y + h - 1, w, 1, on);
+    ref_fill(x, y, 1, h, on);
+    ref_fill(x + w - 1, y, 1, h, on);
+}
+
+// Every set font bit as a scale x scale square
+static void ref_char(int64_t x, int64_t y, uint32_t scale, const uint8_t *font, char c) {
+    uint8_t ch = (uint8_t)c;
+    if (ch < font[3] || ch > font[4]) return;
+    uint32_t parts = (font[0] + 7u) / 8;
+    for (uint32_t w = 0; w < font[1]; ++w)
+        for (uint32_t lp = 0; lp < parts; ++lp) {
+            uint8_t line = font[5 + ((ch - font[3]) * font[1] + w) * parts + lp];
+            for (uint32_t j = 0; j < 8; ++j)
+                if ((line >> j) & 1)
+                    ref_fill(x + (int64_t)w * scale, y + (int64_t)(lp * 8 + j) * scale, scale, scale, 1);
+        }
+}
+
+static void ref_text(int64_t x, int64_t y, uint32_t scale, const uint8_t *font, const char *s) {
+    for (; *s; ++s, x += (int64_t)(font[1] + font[2]) * scale)
+        ref_char(x, y, scale, font, *s);
+}
+
+
+/* =========================
+ *  PREVIOUS DRIVER CODE (benchmark baseline)
+ * ========================= */
+
+static void old_draw_pixel(uint32_t x, uint32_t y) {
+    if (x >= W || y >= H) return;
+    uint8_t *b = &ref[x + W * (y >> 3)];
+    uint8_t v = *b | 0x1 << (y & 0x07);
+    if (v != *b) {
+        *b = v;
+        if (x < dirty_lo[y >> 3]) dirty_lo[y >> 3] = (uint8_t)x;
+        if (x > dirty_hi[y >> 3]) dirty_hi[y >> 3] = (uint8_t)x;
+    }
+}
+
+static void old_draw_line(int32_t x1, int32_t y1, int32_t x2, int32_t y2) {
+    float m = (float)(y2 - y1) / (float)(x2 - x1);
+    for (int32_t i = x1; i <= x2; ++i) {
+        float y = m * (float)(i - x1) + (float)y1;
+        old_draw_pixel(i, (uint32_t)y);
+    }
+}
+
+static void old_draw_square(uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+    for (uint32_t i = 0; i < width; ++i)
+        for (uint32_t j = 0; j < height; ++j)
+            old_draw_pixel(x + i, y + j);
+}
+
+static void old_hspan(int16_t x1, int16_t x2, int16_t y) {
+    for (int16_t x = x1; x <= x2; ++x)
+        old_draw_pixel((uint32_t)x, (uint32_t)y);
+}
+
+static void old_draw_string(uint32_t x, uint32_t y, uint32_t scale, const uint8_t *font, const char *s) {
+    for (int32_t x_n = x; *s; x_n += (font[1] + font[2]) * scale) {
+        char c = *(s++);
+        if (c < font[3] || c > font[4]) continue;
+        uint32_t parts_per_line = (font[0] >> 3) + ((font[0] & 7) > 0);
+        for (uint8_t w = 0; w < font[1]; ++w) {
+            uint32_t pp = (c - font[3]) * font[1] * parts_per_line + w * parts_per_line + 5;
+            for (uint32_t lp = 0; lp < parts_per_line; ++lp) {
+                uint8_t line = font[pp];
+                for (int8_t j = 0; j < 8; ++j, line >>= 1)
+                    if (line & 1)
+                        old_draw_square(x_n + w * scale, y + ((lp << 3) + j) * scale, scale, scale);
+                ++pp;
+            }
+        }
+    }
+}
+
+
+/* =========================
+ *  CHECKS
+ * ========================= */
+
+static int check_golden(void) {
+    // (0,0)-(7,3): ties step on odd columns
+    static const uint8_t line_a[][2] = { {0,0},{1,0},{2,1},{3,1},{4,2},{5,2},{6,3},{7,3} };
+    // (3,10)-(1,16): steep, right to left (did not draw with the old swap())
+    static const uint8_t line_b[][2] = { {3,10},{3,11},{2,12},{2,13},{2,14},{1,15},{1,16} };
+    static const struct { int32_t x0, y0, x1, y1; const uint8_t (*px)[2]; int n; } cases[] = {
+        { 0, 0, 7, 3, line_a, 8 },
+        { 3, 10, 1, 16, line_b, 7 },
+    };
+    int bad = 0;
+    for (unsigned c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c) {
+        for (int dir = 0; dir < 2; ++dir) {
+            memset(fb, 0, sizeof(fb));
+            if (dir) raster_line(&r, cases[c].x1, cases[c].y1, cases[c].x0, cases[c].y0, true);
+            else     raster_line(&r, cases[c].x0, cases[c].y0, cases[c].x1, cases[c].y1, true);
+            int set = 0;
+            for (int y = 0; y < H; ++y)
+                for (int x = 0; x < W; ++x) set += get(fb, x, y);
+            for (int i = 0; i < cases[c].n; ++i)
+                set -= get(fb, cases[c].px[i][0], cases[c].px[i][1]);
+            if (set != 0) {
+                printf("golden line %u (dir %d) wrong\n", c, dir);
+                bad++;
+            }
+        }
+    }
+
+    // 'A' copied column by column, page aligned and 3 rows down
+    const uint8_t *A = font_8x5 + 5 + ('A' - 32) * 5;
+    memset(fb, 0, sizeof(fb));
+    raster_char(&r, NULL, 0, 0, 1, font_8x5, 'A');
+    raster_char(&r, NULL, 10, 19, 1, font_8x5, 'A');
+    for (int i = 0; i < 5; ++i) {
+        if (fb[i] != A[i] || fb[2 * W + 10 + i] != (uint8_t)(A[i] << 3) ||
+            fb[3 * W + 10 + i] != (A[i] >> 5)) {
+            printf("golden glyph column %d wrong\n", i);
+            bad++;
+        }
+    }
+
+    // Scene: all octants, clipped lines, spans, rectangles, clears
+    memset(fb, 0, sizeof(fb));
+    for (int i = 0; i < 16; ++i) {
+        raster_line(&r, 64, 32, 64 + (i - 8) * 9, i & 1 ? -20 : 90, true);
+        raster_line(&r, 64, 32, i & 1 ? -30 : 160, 32 + (i - 8) * 5, true);
+    }
+    raster_fill_rect(&r, 5, 5, 30, 19, true);
+    raster_fill_rect(&r, 9, 7, 22, 13, false);
+    raster_rect(&r, 90, 3, 33, 58, true);
+    raster_hline(&r, -5, 300, 61, true);
+    raster_vline(&r, 126, 70, -3, true);
+    uint32_t h = 2166136261u;       // FNV-1a
+    for (size_t i = 0; i < sizeof(fb); ++i) h = (h ^ fb[i]) * 16777619u;
+    if (h != SCENE_FNV) {
+        printf("golden scene: checksum 0x%08X, expected 0x%08X\n", (unsigned)h, (unsigned)SCENE_FNV);
+        bad++;
+    }
+    return bad;
+}
+
+// Bytes changed since before must be in the dirty spans, set bytes in the ink spans
+static int check_spans(const uint8_t *before, int n, int bad) {
+    int found = 0;
+    for (int pg = 0; pg < PAGES; ++pg) {
+        for (int x = 0; x < W; ++x) {
+            uint8_t b = fb[pg * W + x];
+            if ((b != before[pg * W + x] && (x < dirty_lo[pg] || x > dirty_hi[pg])) ||
+                (b && (x < ink_lo[pg] || x > ink_hi[pg]))) {
+                if (bad + found < 5) printf("op %d: page %d column %d outside its span\n", n, pg, x);
+                found++;
+            }
+        }
+    }
+    return found;
+}
+
+static int check_random(int ops) {
+    int bad = 0;
+    uint8_t before[sizeof(fb)];
+    memset(fb, 0, sizeof(fb));
+    memset(ref, 0, sizeof(ref));
+    spans_clear(ink_lo, ink_hi);
+
+    for (int n = 0; n < ops; ++n) {
+        if (rnd(0, 50) == 0) {      // as ssd1306_clear()
+            memset(fb, 0, sizeof(fb));
+            memset(ref, 0, sizeof(ref));
+            spans_clear(ink_lo, ink_hi);
+        }
+        memcpy(before, fb, sizeof(fb));
+        spans_clear(dirty_lo, dirty_hi);
+        int on = rnd(0, 3) != 0;
+        int32_t x0 = rnd(-80, W + 80), y0 = rnd(-80, H + 80);
+        int32_t x1 = rnd(-80, W + 80), y1 = rnd(-80, H + 80);
+        switch (rnd(0, 5)) {
+            case 0:
+                raster_line(&r, x0, y0, x1, y1, on);
+                ref_line(x0, y0, x1, y1, on);
+                break;
+            case 1: {   // short lines near the screen, all directions
+                x1 = x0 + rnd(-12, 12);
+                y1 = y0 + rnd(-12, 12);
+                raster_line(&r, x0, y0, x1, y1, on);
+                ref_line(x0, y0, x1, y1, on);
+                break;
+            }
+            case 2:
+                raster_hline(&r, x0, x1, y0, on);
+                ref_line(x0, y0, x1, y0, on);
+                break;
+            case 3:
+                raster_vline(&r, x0, y0, y1, on);
+                ref_line(x0, y0, x0, y1, on);
+                break;
+            case 4: {
+                int32_t w = rnd(-3, 150), h = rnd(-3, 80);
+                raster_fill_rect(&r, x0, y0, w, h, on);
+                ref_fill(x0, y0, w, h, on);
+                break;
+            }
+            default: {
+                int32_t w = rnd(-3, 150), h = rnd(-3, 80);
+                raster_rect(&r, x0, y0, w, h, on);
+                ref_rect(x0, y0, w, h, on);
+                break;
+            }
+        }
+        if (memcmp(fb, ref, sizeof(fb)) != 0) {
+            if (bad < 5) printf("op %d: image differs from reference\n", n);
+            bad++;
+            memcpy(fb, ref, sizeof(fb));
+            continue;
+        }
+        bad += check_spans(before, n, bad);
+    }
+
+    // Far away coordinates: clipped, nothing hangs
+    raster_line(&r, -200000000, -100000000, 200000000, 100000000, true);
+    raster_fill_rect(&r, -2000000000, -2000000000, 2000000000, 2000000000, true);
+    raster_rect(&r, INT32_MAX - 5, 0, 100, 100, true);
+    return bad;
+}
+
+static int check_text(int ops) {
+    static const uint8_t *const fonts[] = { font_8x5, font_tall, font_wide };
+    int bad = 0;
+    uint8_t before[sizeof(fb)];
+    char str[8];
+    memset(fb, 0, sizeof(fb));
+    memset(ref, 0, sizeof(ref));
+    spans_clear(ink_lo, ink_hi);
+
+    for (int n = 0; n < ops; ++n) {
+        if (rnd(0, 20) == 0) {
+            memset(fb, 0, sizeof(fb));
+            memset(ref, 0, sizeof(ref));
+            spans_clear(ink_lo, ink_hi);
+        }
+        memcpy(before, fb, sizeof(fb));
+        spans_clear(dirty_lo, dirty_hi);
+        const uint8_t *font = fonts[rnd(0, 2)];
+        int len = rnd(1, (int)sizeof(str) - 1);
+        for (int i = 0; i < len; ++i) str[i] = (char)rnd(20, 130);    // some outside the font
+        str[len] = 0;
+        uint32_t scale = (uint32_t)rnd(0, 6);
+        int32_t x = rnd(-70, W + 10), y = rnd(-70, H + 10);
+        raster_text(&r, rnd(0, 3) ? &cache : NULL, x, y, scale, font, str);
+        ref_text(x, y, scale, font, str);
+        if (memcmp(fb, ref, sizeof(fb)) != 0) {
+            if (bad < 5) printf("text %d: \"%s\" scale %u at %d,%d differs from reference\n",
+                                n, str, (unsigned)scale, (int)x, (int)y);
+            bad++;
+            memcpy(fb, ref, sizeof(fb));
+            continue;
+        }
+        bad += check_spans(before, n, bad);
+    }
+
+    // Far away and huge: clipped, nothing hangs
+    raster_text(&r, &cache, INT32_MIN, -5, 1u << 31, font_8x5, "MW");
+    raster_text(&r, &cache, INT32_MAX, INT32_MAX, 3, font_8x5, "MW");
+    return bad;
+}
+
+
+/* =========================
+ *  BENCHMARK
+ * ========================= */
+
+typedef struct { int32_t x0, y0, x1, y1; } seg_t;
+#define SEGS    4096
+static seg_t segs[SEGS];
+
+static void report(const char *what, double old_s, double new_s, double pixels) {
+    printf("%-28s %8.1f -> %8.1f Mpixel/s  (x%.1f)\n", what,
+           pixels / old_s * 1e-6, pixels / new_s * 1e-6, old_s / new_s);
+}
+
+static void bench(void) {
+    const int reps = 400;
+    double t, old_s, new_s, px;
+
+    // Lines left to right (the old code only drew those)
+    px = 0;
+    for (int i = 0; i < SEGS; ++i) {
+        segs[i] = (seg_t){ rnd(0, 60), rnd(0, H - 1), rnd(64, W - 1), rnd(0, H - 1) };
+        px += segs[i].x1 - segs[i].x0 + 1;
+    }
+    px *= reps;
+    t = now_s();
+    for (int k = 0; k < reps; ++k)
+        for (int i = 0; i < SEGS; ++i) old_draw_line(segs[i].x0, segs[i].y0, segs[i].x1, segs[i].y1);
+    old_s = now_s() - t;
+    t = now_s();
+    for (int k = 0; k < reps; ++k)
+        for (int i = 0; i < SEGS; ++i) raster_line(&r, segs[i].x0, segs[i].y0, segs[i].x1, segs[i].y1, true);
+    new_s = now_s() - t;
+    report("line", old_s, new_s, px);
+
+    // 40x20 filled rectangles, any alignment
+    px = 0;
+    for (int i = 0; i < SEGS; ++i) {
+        segs[i] = (seg_t){ rnd(0, W - 41), rnd(0, H - 21), 40, 20 };
+        px += 40 * 20;
+    }
+    px *= reps / 4;
+    t = now_s();
+    for (int k = 0; k < reps / 4; ++k)
+        for (int i = 0; i < SEGS; ++i) old_draw_square(segs[i].x0, segs[i].y0, 40, 20);
+    old_s = now_s() - t;
+    t = now_s();
+    for (int k = 0; k < reps / 4; ++k)
+        for (int i = 0; i < SEGS; ++i) raster_fill_rect(&r, segs[i].x0, segs[i].y0, 40, 20, true);
+    new_s = now_s() - t;
+    report("fill rect 40x20", old_s, new_s, px);
+
+    // Horizontal spans as in the filled circle of sdk.c
+    px = 0;
+    for (int i = 0; i < SEGS; ++i) {
+        segs[i] = (seg_t){ rnd(0, 50), rnd(0, H - 1), rnd(60, W - 1), 0 };
+        px += segs[i].x1 - segs[i].x0 + 1;
+    }
+    px *= reps;
+    t = now_s();
+    for (int k = 0; k < reps; ++k)
+        for (int i = 0; i < SEGS; ++i) old_hspan(segs[i].x0, segs[i].x1, segs[i].y0);
+    old_s = now_s() - t;
+    t = now_s();
+    for (int k = 0; k < reps; ++k)
+        for (int i = 0; i < SEGS; ++i) raster_hline(&r, segs[i].x0, segs[i].x1, segs[i].y0, true);
+    new_s = now_s() - t;
+    report("hspan", old_s, new_s, px);
+
+    // Full screens of text: 8 lines of 21 characters at scale 1, then
+    // fewer, bigger lines; the buffer is cleared before every screen
+    static const struct { const char *what; uint32_t scale; int32_t y0; int use_cache; } text[] = {
+        { "text scale 1, page aligned", 1, 0, 1 },
+        { "text scale 1, unaligned", 1, 3, 1 },
+        { "text scale 2", 2, 0, 1 },
+        { "text scale 3, no cache", 3, 5, 0 },
+        { "text scale 3", 3, 5, 1 },
+    };
+    static const char *const lines[] = {
+        "ax=-0.12 ay=0.98 az=0", "gx=12.5 gy=-3.1 gz=0.4", "T=23.4C RH=41%",
+        "lux=1234 bus 400kHz", "The quick brown fox", "jumps over the lazy",
+        "dog. 0123456789 !?#", "[ready] {ok} <tkjhat>",
+    };
+    const int screens = 20000;
+    for (unsigned t_i = 0; t_i < sizeof(text) / sizeof(text[0]); ++t_i) {
+        uint32_t sc = text[t_i].scale;
+        int nlines = (H - text[t_i].y0) / (8 * (int)sc);
+        int ncols = W / (6 * (int)sc);
+        double chars = 0;
+        for (int l = 0; l < nlines; ++l) {
+            size_t n = strlen(lines[l]);
+            chars += n < (size_t)ncols ? n : (size_t)ncols;
+        }
+        chars *= screens;
+        char clipped[8][24];
+        for (int l = 0; l < nlines; ++l) {
+            snprintf(clipped[l], sizeof(clipped[l]), "%.*s", ncols, lines[l]);
+        }
+        t = now_s();
+        for (int k = 0; k < screens; ++k) {
+            memset(ref, 0, sizeof(ref));
+            for (int l = 0; l < nlines; ++l)
+                old_draw_string(0, (uint32_t)(text[t_i].y0 + l * 8 * (int)sc), sc, font_8x5, clipped[l]);
+        }
+        old_s = now_s() - t;
+        raster_glyph_cache_t *c = text[t_i].use_cache ? &cache : NULL;
+        t = now_s();
+        for (int k = 0; k < screens; ++k) {
+            memset(fb, 0, sizeof(fb));
+            for (int l = 0; l < nlines; ++l)
+                raster_text(&r, c, 0, text[t_i].y0 + l * 8 * (int)sc, sc, font_8x5, clipped[l]);
+        }
+        new_s = now_s() - t;
+        if (memcmp(fb, ref, sizeof(fb)) != 0) printf("%s: screens differ\n", text[t_i].what);
+        printf("%-28s %8.0f -> %8.0f char/ms    (x%.1f)\n", text[t_i].what,
+               chars / old_s * 1e-3, chars / new_s * 1e-3, old_s / new_s);
+    }
+
+    uint32_t sum = 0;
+    for (size_t i = 0; i < sizeof(fb); ++i) sum += fb[i] + ref[i];
+    printf("(checksum %u)\n", (unsigned)sum);
+}
+
+int main(void) {
+    int bad = check_golden();
+    bad += check_random(200000);
+    printf("golden images and 200000 random primitives: %d bad\n", bad);
+    memcpy(font_tall, (const uint8_t[]){ 16, 5, 1, 32, 126 }, 5);
+    memcpy(font_wide, (const uint8_t[]){ 8, 10, 0, 32, 126 }, 5);
+    for (size_t i = 5; i < sizeof(font_tall); ++i) font_tall[i] = (uint8_t)rnd(0, 255);
+    for (size_t i = 5; i < sizeof(font_wide); ++i) font_wide[i] = (uint8_t)rnd(0, 255);
+    int text_bad = check_text(100000);
+    printf("100000 random strings: %d bad\n", text_bad);
+    bad += text_bad;
+    bench();
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,218 @@
+/*
+ * Host model of the SSD1306 traffic on the I2C bus (tkjhat/ssd1306.h).
+ *
+ * Build and run on the PC:
+ *     cc -O2 -Ihost -I../include ssd1306_bus_bench.c host/host_fake.c ../src/ssd1306.c ../src/raster.c -o ssd1306_bus_bench
+ *     ./ssd1306_bus_bench
+ *
+ * src/ssd1306.c runs unchanged against the fake in host/. The bench stands
+ * in for i2c_bus_transfer(): it counts transfers and bytes (address byte
+ * included) and decodes them like the panel does, control bytes, address
+ * window, start line and GDDRAM, so every flush is checked against the
+ * buffer that was sent. A command list of the application that moves the
+ * start line must not leave the next flush out of step, and is held off
+ * while a frame waits to be flushed. Wire time is START + 9 clocks per byte + STOP at 400 kHz, without
+ * the gaps between transfers.
+ *
+ * The scenarios are the usual display work of the course: power-up, the
+ * first frame, small changes (a glyph, a value field redrawn ten times),
+ * nothing changed, and a contrast change. Build the parent of a display
+ * change to get the numbers to compare with.
+ * The exit status is non-zero if the panel ever differs from the buffer.
+ *
+ * Version 0.84, MIT License, Raisul Islam, Iván Sánchez Milara.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <tkjhat/ssd1306.h>
+
+static int failures;
+
+
+/* =========================
+ *  PANEL MODEL
+ * ========================= */
+
+static uint8_t gddram[SSD1306_MAX_PAGES][128];
+static uint8_t col_lo, col_hi = 127, page_lo, page_hi = 7;
+static uint8_t col, page, start_line;
+static uint8_t cmd[3];
+static int cmd_len;
+static long transfers, bytes;
+
+// Bytes taken by a command (opcode included); single byte otherwise
+static int command_size(uint8_t op) {
+    switch (op) {
+    case 0x21: case 0x22:
+        return 3;
+    case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xD3:
+    case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+        return 2;
+    default:
+        return 1;
+    }
+}
+
+static void panel_command(uint8_t b) {
+    cmd[cmd_len++] = b;
+    if (cmd_len < command_size(cmd[0]))
+        return;
+    if (cmd[0] == 0x21) {
+        col_lo = col = cmd[1];
+        col_hi = cmd[2];
+    } else if (cmd[0] == 0x22) {
+        page_lo = page = cmd[1];
+        page_hi = cmd[2];
+    } else if (cmd[0] >= 0x40 && cmd[0] <= 0x7F) {
+        start_line = cmd[0] & 0x3F;
+    }
+    cmd_len = 0;
+}
+
+static void panel_data(uint8_t b) {
+    gddram[page][col] = b;
+    if (++col > col_hi) {
+        col = col_lo;
+        if (++page > page_hi)
+            page = page_lo;
+    }
+}
+
+int i2c_bus_transfer(uint8_t addr, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len) {
+    (void)addr; (void)rx; (void)rx_len;
+    transfers++;
+    bytes += tx_len + 1;
+    // Co=1: one byte follows the control byte, then another control byte
+    int control = -1;
+    cmd_len = 0;
+    for (size_t i = 0; i < tx_len; ++i) {
+        if (control < 0) {
+            control = tx[i];
+            continue;
+        }
+        if (control & 0x40)
+            panel_data(tx[i]);
+        else
+            panel_command(tx[i]);
+        if (control & 0x80)
+            control = -1;
+    }
+    host_now_us += (2 + 9 * (tx_len + 1)) * 5 / 2;
+    return (int)tx_len;
+}
+
+
+/* =========================
+ *  SCENARIOS
+ * ========================= */
+
+static ssd1306_t disp;
+
+static void report(const char *name) {
+    printf("%-28s %3ld transfers %5ld bytes %6ld us\n",
+           name, transfers, bytes, (transfers * 2 + bytes * 9) * 5 / 2);
+    transfers = bytes = 0;
+}
+
+// The panel must show what was sent: front, scrolled by its start line
+static void check_panel(const char *name) {
+    if (start_line != disp.start_front) {
+        printf("%s: panel start line %d, buffer %d\n", name, start_line, disp.start_front);
+        failures++;
+        return;
+    }
+    for (int pg = 0; pg < disp.pages; ++pg) {
+        int src = (pg + disp.start_front / 8) % disp.pages;
+        if (memcmp(gddram[pg], disp.front + src * disp.width, disp.width)) {
+            printf("%s: page %d differs from the buffer\n", name, pg);
+            failures++;
+            return;
+        }
+    }
+}
+
+static void show(const char *name) {
+    ssd1306_show(&disp);
+    check_panel(name);
+}
+
+static void field(const char *name, int x0, int w, int y) {
+    for (int i = 0; i < 10; ++i) {
+        for (int x = x0; x < x0 + w; ++x) {
+            if ((x + i) % 3)
+                ssd1306_draw_pixel(&disp, x, y);
+            else
+                ssd1306_clear_pixel(&disp, x, y);
+        }
+        show(name);
+    }
+    report(name);
+}
+
+int main(void) {
+    if (!ssd1306_init(&disp, 128, 64, 0x3c, i2c_default)) {
+        printf("init failed\n");
+        return 1;
+    }
+    report("init");
+
+    show("first full frame");
+    report("first full frame");
+
+    ssd1306_draw_pixel(&disp, 10, 10);
+    ssd1306_draw_pixel(&disp, 14, 12);
+    show("one glyph-sized change");
+    report("one glyph-sized change");
+
+    ssd1306_draw_pixel(&disp, 0, 0);
+    ssd1306_draw_pixel(&disp, 127, 63);
+    show("two corners");
+    report("two corners");
+
+    show("no change");
+    report("no change");
+
+    ssd1306_contrast(&disp, 10);
+    report("contrast");
+
+    field("24-col field x10 frames", 100, 24, 3);
+    field("12-col field x10 frames", 0, 12, 40);
+
+    // The application scrolls with its own command list
+    static const uint8_t scroll[] = { 0x40 | 8 };
+    ssd1306_cmdlist_t l;
+    ssd1306_cmdlist_begin(&l, &disp);
+    ssd1306_cmdlist_add(&l, scroll, sizeof(scroll));
+    if (!ssd1306_cmdlist_send(&l) || start_line != 8) {
+        printf("command list not sent\n");
+        failures++;
+    }
+    ssd1306_draw_pixel(&disp, 20, 20);
+    show("flush after a command list");
+    report("command list + one change");
+
+    // Refused while a frame waits for its flush; sent after it
+    ssd1306_draw_pixel(&disp, 21, 20);
+    ssd1306_swap(&disp);
+    ssd1306_cmdlist_add(&l, scroll, sizeof(scroll));
+    if (ssd1306_cmdlist_send(&l)) {
+        printf("command list sent during a flush\n");
+        failures++;
+    }
+    ssd1306_flush(&disp);
+    check_panel("flush after a refused command list");
+    if (!ssd1306_cmdlist_send(&l)) {
+        printf("command list not sent after the flush\n");
+        failures++;
+    }
+    show("flush after a command list");
+    report("held-off command list");
+
+    ssd1306_deinit(&disp);
+    if (failures)
+        printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,190 @@
+/*
+ * Host check and benchmark of the sliding-window statistics (tkjhat/window_stats.h).
+ *
+ * Build and run on the PC:
+ *     cc -O2 -I../include window_stats_bench.c ../src/window_stats.c -o window_stats_bench -lm
+ *     ./window_stats_bench
+ *
+ * Feeds IMU-like data (7 channels of int16 counts: slow drift, noise and
+ * occasional spikes) through windows of several lengths and compares every
+ * result with a direct double-precision computation over the window. Then
+ * times one push + read of all channels against the usual O(window) float
+ * loop. The exit status is non-zero if a result is off by more than the
+ * fixed-point rounding.
+ *
+ * Version 0.84, MIT License, Raisul Islam, Iván Sánchez Milara.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include <tkjhat/window_stats.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static uint64_t cycles(void) { return __rdtsc(); }
+#define CYCLE_UNIT "TSC cycles"
+#else
+static uint64_t cycles(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+#define CYCLE_UNIT "ns"
+#endif
+
+#define NCH         WSTATS_IMU_CHANNELS
+#define SAMPLES     20000
+#define ONE         (double)(1 << WSTATS_FRAC_BITS)
+
+static uint32_t rng = 12345;
+static int32_t rnd(int32_t span) {
+    rng = rng * 1664525u + 1013904223u;
+    return (int32_t)((rng >> 8) % (2u * span + 1)) - span;
+}
+
+static void make_sample(int i, int32_t *x) {
+    for (int c = 0; c < NCH; ++c) {
+        double base = c == WSTATS_IMU_AZ ? 8192 : 3000 * sin(i * 0.001 * (c + 1));
+        int32_t v = (int32_t)base + rnd(200);
+        if (rnd(500) == 0) v += rnd(30000);         // spike
+        x[c] = v > 32767 ? 32767 : v < -32768 ? -32768 : v;
+    }
+}
+
+// Direct computation over the last n samples of channel c
+static void reference(const int32_t *hist, int i, int n, int c,
+                      double *mean, double *sd, double *rms, int32_t *mn, int32_t *mx) {
+    double s = 0, s2 = 0;
+    *mn = INT32_MAX; *mx = INT32_MIN;
+    for (int k = i - n + 1; k <= i; ++k) {
+        int32_t v = hist[k * NCH + c];
+        s += v; s2 += (double)v * v;
+        if (v < *mn) *mn = v;
+        if (v > *mx) *mx = v;
+    }
+    *mean = s / n;
+    double var = s2 / n - *mean * *mean;
+    *sd = sqrt(var > 0 ? var : 0);
+    *rms = sqrt(s2 / n);
+}
+
+static int check(int window) {
+    static int32_t hist[SAMPLES * NCH];
+    int64_t sum[NCH]; uint64_t sumsq[NCH];
+    int32_t *ring = malloc(sizeof(int32_t) * window * NCH);
+    uint16_t *maxq = malloc(sizeof(uint16_t) * window * NCH), *minq = malloc(sizeof(uint16_t) * window * NCH);
+    uint16_t qstate[4 * NCH];
+    wstats_t w = { .channels = NCH, .window = window, .sum = sum, .sumsq = sumsq,
+                   .ring = ring, .maxq = maxq, .minq = minq, .qstate = qstate };
+    wstats_reset(&w);
+
+    double worst_mean = 0, worst_sd = 0, worst_rms = 0;
+    int bad_minmax = 0;
+    for (int i = 0; i < SAMPLES; ++i) {
+        make_sample(i, &hist[i * NCH]);
+        wstats_push(&w, &hist[i * NCH]);
+        int n = i + 1 < window ? i + 1 : window;
+        for (int c = 0; c < NCH; ++c) {
+            wstats_result_t r;
+            double mean, sd, rms;
+            int32_t mn, mx;
+            wstats_get(&w, c, &r);
+            reference(hist, i, n, c, &mean, &sd, &rms, &mn, &mx);
+            worst_mean = fmax(worst_mean, fabs(r.mean / ONE - mean));
+            worst_sd = fmax(worst_sd, fabs(r.std / ONE - sd));
+            worst_rms = fmax(worst_rms, fabs(r.rms / ONE - rms));
+            if (r.min != mn * (1 << WSTATS_FRAC_BITS) || r.max != mx * (1 << WSTATS_FRAC_BITS) || r.count != n)
+                bad_minmax++;
+        }
+    }
+    free(ring); free(maxq); free(minq);
+
+    // Rounding of the Q8 results: half an LSB for the mean, a little more after the square roots
+    int ok = worst_mean <= 0.5 / ONE + 1e-9 && worst_sd <= 2.0 / ONE && worst_rms <= 2.0 / ONE && !bad_minmax;
+    printf("window %3d: worst error mean %.5f  std %.5f  rms %.5f counts, min/max mismatches %d  %s\n",
+           window, worst_mean, worst_sd, worst_rms, bad_minmax, ok ? "ok" : "FAIL");
+    return ok;
+}
+
+// The usual application code: float loop over a copy of the window
+typedef struct { float mean, std, rms, min, max; } float_stats_t;
+static void naive_stats(const int32_t *ring, int window, int c, float_stats_t *r) {
+    float s = 0, mn = INFINITY, mx = -INFINITY, s2 = 0;
+    for (int k = 0; k < window; ++k) {
+        float v = (float)ring[k * NCH + c];
+        s += v;
+        if (v < mn) mn = v;
+        if (v > mx) mx = v;
+    }
+    float mean = s / window;
+    for (int k = 0; k < window; ++k) {
+        float d = (float)ring[k * NCH + c] - mean;
+        s2 += d * d;
+    }
+    r->mean = mean; r->min = mn; r->max = mx;
+    r->std = sqrtf(s2 / window);
+    r->rms = sqrtf(r->std * r->std + mean * mean);
+}
+
+static void bench(int window) {
+    enum { RUNS = 20000 };
+    int64_t sum[NCH]; uint64_t sumsq[NCH];
+    int32_t *ring = malloc(sizeof(int32_t) * window * NCH);
+    uint16_t *maxq = malloc(sizeof(uint16_t) * window * NCH), *minq = malloc(sizeof(uint16_t) * window * NCH);
+    uint16_t qstate[4 * NCH];
+    wstats_t w = { .channels = NCH, .window = window, .sum = sum, .sumsq = sumsq,
+                   .ring = ring, .maxq = maxq, .minq = minq, .qstate = qstate };
+    wstats_reset(&w);
+
+    // Inputs generated beforehand so only the statistics are timed
+    int32_t *in = malloc(sizeof(int32_t) * RUNS * NCH);
+    for (int i = 0; i < RUNS; ++i) make_sample(i, &in[i * NCH]);
+
+    volatile int32_t sink = 0;
+    wstats_result_t r;
+    uint64_t push = 0, get = 0;
+    for (int i = 0; i < RUNS; ++i) {
+        uint64_t t0 = cycles();
+        wstats_push(&w, &in[i * NCH]);
+        uint64_t t1 = cycles();
+        for (int c = 0; c < NCH; ++c) { wstats_get(&w, c, &r); sink += r.std; }
+        uint64_t t2 = cycles();
+        push += t1 - t0;
+        get += t2 - t1;
+    }
+
+    int32_t *copy = malloc(sizeof(int32_t) * window * NCH);
+    int pos = 0;
+    float_stats_t f;
+    uint64_t naive = 0;
+    for (int i = 0; i < RUNS; ++i) {
+        for (int c = 0; c < NCH; ++c) copy[pos * NCH + c] = in[i * NCH + c];
+        if (++pos == window) pos = 0;
+        uint64_t t0 = cycles();
+        for (int c = 0; c < NCH; ++c) { naive_stats(copy, window, c, &f); sink += (int32_t)f.std; }
+        naive += cycles() - t0;
+    }
+    (void)sink;
+
+    printf("window %3d, %d channels: push %5.0f + read all %5.0f %s/sample, O(window) float loop %7.0f\n",
+           window, NCH, (double)push / RUNS, (double)get / RUNS, CYCLE_UNIT, (double)naive / RUNS);
+    free(in);
+    free(ring); free(maxq); free(minq); free(copy);
+}
+
+int main(void) {
+    static const int windows[] = { 1, 2, 7, 64, 100, 256 };
+    int ok = 1;
+    for (size_t i = 0; i < sizeof(windows) / sizeof(windows[0]); ++i)
+        ok &= check(windows[i]);
+    printf("\n");
+    printf("Host timings; the float loop has an FPU here, the RP2040 emulates float in software.\n");
+    bench(16);
+    bench(100);
+    bench(256);
+    return ok ? 0 : 1;
+}